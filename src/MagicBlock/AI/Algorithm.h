@@ -21,6 +21,7 @@
 #include <immintrin.h>      // For AVX2
 
 #include "MagicBlock/AI/support/RT_PowerOf2.h"
+#include "MagicBlock/AI/Config.h"
 
 #ifndef NOMINMAX
 #define NOMINMAX
@@ -536,6 +537,98 @@ static int find_uint16_avx2(std::uint16_t * buf, std::size_t len, std::uint16_t
     return find_uint16_avx2(buf, 0, len, value);
 }
 
+//
+// The 32-bit ids of the trie rows that have more than 5 cells, see SparseBitset.
+// The buffers are not aligned, so the unaligned loads are used.
+//
+static int find_uint32(std::uint32_t * buf, std::size_t first, std::size_t last, std::uint32_t value)
+{
+    for (std::size_t pos = first; pos < last; pos++) {
+        if (buf[pos] == value)
+            return (int)pos;
+    }
+    return -1;
+}
+
+static int find_uint32_sse2(std::uint32_t * buf, std::size_t first,
+                            std::size_t last, std::uint32_t value)
+{
+#ifdef __SSE2__
+    static const std::size_t kSingelStepSize = sizeof(__m128i) / sizeof(std::uint32_t);
+    static const std::size_t kDoubleStepSize = 2 * kSingelStepSize;
+
+    __m128i value128 = _mm_set1_epi32((int)value);
+    std::size_t pos = first;
+    while ((pos + kDoubleStepSize) <= last) {
+        __m128i index128_0 = _mm_loadu_si128((__m128i const *)(buf + pos) + 0);
+        __m128i index128_1 = _mm_loadu_si128((__m128i const *)(buf + pos) + 1);
+        __m128i mask128_0 = _mm_cmpeq_epi32(index128_0, value128);
+        __m128i mask128_1 = _mm_cmpeq_epi32(index128_1, value128);
+        std::uint32_t mask32 = (std::uint32_t)_mm_movemask_epi8(mask128_0) |
+                               ((std::uint32_t)_mm_movemask_epi8(mask128_1) << 16U);
+        if (mask32 != 0) {
+            unsigned int index = jstd::run_time::BitScanForward_nonzero(mask32);
+            return (int)(pos + index / 4);
+        }
+        pos += kDoubleStepSize;
+    }
+    return find_uint32(buf, pos, last, value);
+#else
+    return find_uint32(buf, first, last, value);
+#endif // __SSE2__
+}
+
+static int find_uint32_avx2(std::uint32_t * buf, std::size_t first,
+                            std::size_t last, std::uint32_t value)
+{
+#ifdef __AVX2__
+    static const std::size_t kSingelStepSize = sizeof(__m256i) / sizeof(std::uint32_t);
+
+    __m256i value256 = _mm256_set1_epi32((int)value);
+    std::size_t pos = first;
+    while ((pos + kSingelStepSize) <= last) {
+        __m256i index256 = _mm256_loadu_si256((__m256i const *)(buf + pos));
+        __m256i mask256 = _mm256_cmpeq_epi32(index256, value256);
+        std::uint32_t mask32 = (std::uint32_t)_mm256_movemask_epi8(mask256);
+        if (mask32 != 0) {
+            unsigned int index = jstd::run_time::BitScanForward_nonzero(mask32);
+            return (int)(pos + index / 4);
+        }
+        pos += kSingelStepSize;
+    }
+    return find_uint32(buf, pos, last, value);
+#else
+    return find_uint32_sse2(buf, first, last, value);
+#endif // __AVX2__
+}
+
+//
+// Search a 16-bit or 32-bit id, for the containers that are templated on the id type.
+//
+static inline int find_ident(std::uint16_t * buf, std::size_t first, std::size_t last, std::uint16_t value) {
+    return find_uint16(buf, first, last, value);
+}
+
+static inline int find_ident(std::uint32_t * buf, std::size_t first, std::size_t last, std::uint32_t value) {
+    return find_uint32(buf, first, last, value);
+}
+
+static inline int find_ident_sse2(std::uint16_t * buf, std::size_t first, std::size_t last, std::uint16_t value) {
+    return find_uint16_sse2(buf, first, last, value);
+}
+
+static inline int find_ident_sse2(std::uint32_t * buf, std::size_t first, std::size_t last, std::uint32_t value) {
+    return find_uint32_sse2(buf, first, last, value);
+}
+
+static inline int find_ident_avx2(std::uint16_t * buf, std::size_t first, std::size_t last, std::uint16_t value) {
+    return find_uint16_avx2(buf, first, last, value);
+}
+
+static inline int find_ident_avx2(std::uint32_t * buf, std::size_t first, std::size_t last, std::uint32_t value) {
+    return find_uint32_avx2(buf, first, last, value);
+}
+
 #if 0
 
 static int find_uint16_sse2_has_bug(std::uint16_t * buf, std::size_t len, std::uint16_t value)
@@ -609,14 +702,17 @@ static int find_uint16_sse2_has_bug(std::uint16_t * buf, std::size_t len, std::u
 
 #endif
 
+//
+// Merge the two sorted runs [first, middle) and [middle, last) into new_indexs.
+//
 static void merge_sort(std::uint16_t * indexs, std::uint16_t * new_indexs,
-                       std::size_t first, std::size_t last)
+                       std::size_t first, std::size_t middle, std::size_t last)
 {
     assert(indexs != nullptr);
     assert(new_indexs != nullptr);
     assert(first < last);
+    assert(first <= middle && middle <= last);
     std::size_t left = first;
-    std::size_t middle = (first + last) / 2;
     std::size_t right = middle;
     std::size_t cur = first;
     while (left < middle && right < last) {
@@ -635,17 +731,23 @@ static void merge_sort(std::uint16_t * indexs, std::uint16_t * new_indexs,
     }
 }
 
+static void merge_sort(std::uint16_t * indexs, std::uint16_t * new_indexs,
+                       std::size_t first, std::size_t last)
+{
+    merge_sort(indexs, new_indexs, first, (first + last) / 2, last);
+}
+
 static void merge_sort(std::uint16_t * indexs, std::uintptr_t ** values,
                        std::uint16_t * new_indexs, std::uintptr_t ** new_values,
-                       std::size_t first, std::size_t last)
+                       std::size_t first, std::size_t middle, std::size_t last)
 {
     assert(indexs != nullptr);
     assert(new_indexs != nullptr);
     assert(values != nullptr);
     assert(new_values != nullptr);
     assert(first < last);
+    assert(first <= middle && middle <= last);
     std::size_t left = first;
-    std::size_t middle = (first + last) / 2;
     std::size_t right = middle;
     std::size_t cur = first;
     while (left < middle && right < last) {
@@ -681,6 +783,13 @@ static void merge_sort(std::uint16_t * indexs, std::uintptr_t ** values,
     }
 }
 
+static void merge_sort(std::uint16_t * indexs, std::uintptr_t ** values,
+                       std::uint16_t * new_indexs, std::uintptr_t ** new_values,
+                       std::size_t first, std::size_t last)
+{
+    merge_sort(indexs, values, new_indexs, new_values, first, (first + last) / 2, last);
+}
+
 #if 1
 //
 // See: https://www.cnblogs.com/skywang12345/p/3596746.html
@@ -830,6 +939,99 @@ static void quick_sort(std::uint16_t * indexs, std::uintptr_t ** values,
 }
 #endif
 
+//
+// Same as above, but the values are stored inline (a small POD type),
+// such as the values of the leaf containers in SparseHashMap<K, V>.
+//
+template <typename T>
+static void merge_sort(std::uint16_t * indexs, T * values,
+                       std::uint16_t * new_indexs, T * new_values,
+                       std::size_t first, std::size_t middle, std::size_t last)
+{
+    assert(indexs != nullptr);
+    assert(new_indexs != nullptr);
+    assert(values != nullptr);
+    assert(new_values != nullptr);
+    assert(first < last);
+    assert(first <= middle && middle <= last);
+    std::size_t left = first;
+    std::size_t right = middle;
+    std::size_t cur = first;
+    while (left < middle && right < last) {
+        if (indexs[left] <= indexs[right]) {
+            new_indexs[cur] = indexs[left];
+            new_values[cur] = values[left];
+            left++;
+        }
+        else {
+            new_indexs[cur] = indexs[right];
+            new_values[cur] = values[right];
+            right++;
+        }
+        cur++;
+    }
+
+    while (left < middle) {
+        new_indexs[cur] = indexs[left];
+        new_values[cur] = values[left];
+        cur++;
+        left++;
+    }
+
+    while (right < last) {
+        new_indexs[cur] = indexs[right];
+        new_values[cur] = values[right];
+        cur++;
+        right++;
+    }
+}
+
+template <typename T>
+static void merge_sort(std::uint16_t * indexs, T * values,
+                       std::uint16_t * new_indexs, T * new_values,
+                       std::size_t first, std::size_t last)
+{
+    merge_sort(indexs, values, new_indexs, new_values, first, (first + last) / 2, last);
+}
+
+// Prerequisite: all elements are unique
+template <typename T>
+static void quick_sort(std::uint16_t * indexs, T * values,
+                       std::ptrdiff_t first, std::ptrdiff_t last)
+{
+    assert(indexs != nullptr);
+    assert(values != nullptr);
+    if (first < last) {
+        std::ptrdiff_t left = first;
+        std::ptrdiff_t right = last;
+        std::uint16_t pivot = indexs[left];
+        T pivot_value = values[left];
+        while (left < right) {
+            while (left < right && indexs[right] > pivot) {
+                right--;
+            }
+            if (left < right) {
+                indexs[left] = indexs[right];
+                values[left] = values[right];
+                left++;
+            }
+            while (left < right && indexs[left] < pivot) {
+                left++;
+            }
+            if (left < right) {
+                indexs[right] = indexs[left];
+                values[right] = values[left];
+                right--;
+            }
+        }
+        indexs[left] = pivot;
+        values[left] = pivot_value;
+
+        quick_sort(indexs, values, first, left - 1);
+        quick_sort(indexs, values, left + 1, last);
+    }
+}
+
 #if 1
 static int binary_search(std::uint16_t * buf, std::size_t first,
                          std::size_t last, std::uint16_t value)
@@ -920,6 +1122,177 @@ static int binary_search(std::uint16_t * buf, std::size_t first,
 }
 #endif
 
+//
+// The 32-bit id versions of merge_sort(), quick_sort() and binary_search(),
+// for the trie rows that have more than 5 cells, see SparseBitset.
+//
+static void merge_sort(std::uint32_t * indexs, std::uint32_t * new_indexs,
+                       std::size_t first, std::size_t middle, std::size_t last)
+{
+    assert(indexs != nullptr);
+    assert(new_indexs != nullptr);
+    assert(first < last);
+    assert(first <= middle && middle <= last);
+    std::size_t left = first;
+    std::size_t right = middle;
+    std::size_t cur = first;
+    while (left < middle && right < last) {
+        if (indexs[left] <= indexs[right])
+            new_indexs[cur++] = indexs[left++];
+        else
+            new_indexs[cur++] = indexs[right++];
+    }
+
+    while (left < middle) {
+        new_indexs[cur++] = indexs[left++];
+    }
+
+    while (right < last) {
+        new_indexs[cur++] = indexs[right++];
+    }
+}
+
+static void merge_sort(std::uint32_t * indexs, std::uint32_t * new_indexs,
+                       std::size_t first, std::size_t last)
+{
+    merge_sort(indexs, new_indexs, first, (first + last) / 2, last);
+}
+
+static void merge_sort(std::uint32_t * indexs, std::uintptr_t ** values,
+                       std::uint32_t * new_indexs, std::uintptr_t ** new_values,
+                       std::size_t first, std::size_t middle, std::size_t last)
+{
+    assert(indexs != nullptr);
+    assert(new_indexs != nullptr);
+    assert(values != nullptr);
+    assert(new_values != nullptr);
+    assert(first < last);
+    assert(first <= middle && middle <= last);
+    std::size_t left = first;
+    std::size_t right = middle;
+    std::size_t cur = first;
+    while (left < middle && right < last) {
+        if (indexs[left] <= indexs[right]) {
+            new_indexs[cur] = indexs[left];
+            new_values[cur] = values[left];
+            left++;
+        }
+        else {
+            new_indexs[cur] = indexs[right];
+            new_values[cur] = values[right];
+            right++;
+        }
+        cur++;
+    }
+
+    while (left < middle) {
+        new_indexs[cur] = indexs[left];
+        new_values[cur] = values[left];
+        cur++;
+        left++;
+    }
+
+    while (right < last) {
+        new_indexs[cur] = indexs[right];
+        new_values[cur] = values[right];
+        cur++;
+        right++;
+    }
+}
+
+static void merge_sort(std::uint32_t * indexs, std::uintptr_t ** values,
+                       std::uint32_t * new_indexs, std::uintptr_t ** new_values,
+                       std::size_t first, std::size_t last)
+{
+    merge_sort(indexs, values, new_indexs, new_values, first, (first + last) / 2, last);
+}
+
+// Prerequisite: all elements are unique
+static void quick_sort(std::uint32_t * indexs, std::ptrdiff_t first, std::ptrdiff_t last)
+{
+    assert(indexs != nullptr);
+    if (first < last) {
+        std::ptrdiff_t left = first;
+        std::ptrdiff_t right = last;
+        std::uint32_t pivot = indexs[left];
+        while (left < right) {
+            while (left < right && indexs[right] > pivot) {
+                right--;
+            }
+            if (left < right) {
+                indexs[left++] = indexs[right];
+            }
+            while (left < right && indexs[left] < pivot) {
+                left++;
+            }
+            if (left < right) {
+                indexs[right--] = indexs[left];
+            }
+        }
+        indexs[left] = pivot;
+
+        quick_sort(indexs, first, left - 1);
+        quick_sort(indexs, left + 1, last);
+    }
+}
+
+// Prerequisite: all elements are unique
+static void quick_sort(std::uint32_t * indexs, std::uintptr_t ** values,
+                       std::ptrdiff_t first, std::ptrdiff_t last)
+{
+    assert(indexs != nullptr);
+    assert(values != nullptr);
+    if (first < last) {
+        std::ptrdiff_t left = first;
+        std::ptrdiff_t right = last;
+        std::uint32_t pivot = indexs[left];
+        std::uintptr_t * pivot_value = values[left];
+        while (left < right) {
+            while (left < right && indexs[right] > pivot) {
+                right--;
+            }
+            if (left < right) {
+                indexs[left] = indexs[right];
+                values[left] = values[right];
+                left++;
+            }
+            while (left < right && indexs[left] < pivot) {
+                left++;
+            }
+            if (left < right) {
+                indexs[right] = indexs[left];
+                values[right] = values[left];
+                right--;
+            }
+        }
+        indexs[left] = pivot;
+        values[left] = pivot_value;
+
+        quick_sort(indexs, values, first, left - 1);
+        quick_sort(indexs, values, left + 1, last);
+    }
+}
+
+static int binary_search(std::uint32_t * buf, std::size_t first,
+                         std::size_t last, std::uint32_t value)
+{
+    std::size_t low = first;
+    std::size_t high = last;
+
+    while (low < high) {
+        std::size_t mid = (low + high) / 2;
+        std::uint32_t middle = buf[mid];
+        if (value < middle)
+            high = mid;
+        else if (value > middle)
+            low = mid + 1;
+        else
+            return (int)mid;
+    }
+
+    return -1;
+}
+
 } // namespace Algorithm
 } // namespace AI
 } // namespace MagicBlock
@@ -12,7 +12,8 @@
 #include <set>
 #include <algorithm>    // For std::swap(), until C++11
 #include <utility>      // For std::swap(), since C++11
-#include <climits>      // For std::numeric_limits<T>
+#include <climits>
+#include <limits>       // For std::numeric_limits<T>
 #include <type_traits>  // For std::forward<T>
 
 #include "MagicBlock/AI/Constant.h"
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>        // For std::fill(), until C++11
+#include <utility>          // For std::swap(), since C++11
+
+#include "MagicBlock/AI/Value128.h"
+#include "MagicBlock/AI/PackedKey.h"
+
+namespace MagicBlock {
+namespace AI {
+
+//
+// A blocked Bloom filter for Value128 (or PackedKey<Words>) keys.
+//
+// All of the bits of a key are in one 64-byte block, so a lookup touches
+// only one cache line. It never reports an inserted key as absent, but it
+// may report a new key as present (a false positive).
+//
+class BlockedBloomFilter {
+public:
+    typedef std::size_t     size_type;
+
+    static const size_type  kBlockWords = 8;
+    static const size_type  kBlockBits = kBlockWords * 64;
+    static const size_type  kHashNums = 8;
+    static const size_type  kDefaultBitsPerKey = 12;
+
+    struct Stats {
+        size_type definitelyNew;    // The filter said it's a new key
+        size_type maybeExists;      // The filter said the key may exist
+        size_type falsePositive;    // The filter said the key may exist, but it's new
+    };
+
+private:
+    // std::allocator doesn't align to 64 bytes until C++17,
+    // so the blocks are aligned by hand inside the storage.
+    std::vector<std::uint64_t>  storage_;
+    std::uint64_t *             words_;
+    size_type                   block_count_;
+    size_type                   block_mask_;
+    size_type                   capacity_;
+    Stats                       stats_;
+
+    static std::uint64_t hash64(const Value128 & value) {
+        // The finalizer of MurmurHash3
+        std::uint64_t h = value.low ^ (value.high * 0x9E3779B97F4A7C15ULL);
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    template <size_type Words>
+    static std::uint64_t hash64(const PackedKey<Words> & key) {
+        return std::uint64_t(key.hash());
+    }
+
+public:
+    BlockedBloomFilter() : words_(nullptr), block_count_(0), block_mask_(0), capacity_(0) {
+        this->clear_stats();
+    }
+
+    BlockedBloomFilter(const BlockedBloomFilter & src) = delete;
+    BlockedBloomFilter & operator = (const BlockedBloomFilter & rhs) = delete;
+
+    ~BlockedBloomFilter() {}
+
+    size_type capacity() const {
+        return this->capacity_;
+    }
+
+    size_type blocks() const {
+        return this->block_count_;
+    }
+
+    size_type memory_usage() const {
+        return (this->storage_.capacity() * sizeof(std::uint64_t));
+    }
+
+    bool empty() const {
+        return (this->block_count_ == 0);
+    }
+
+    Stats & stats() {
+        return this->stats_;
+    }
+
+    const Stats & stats() const {
+        return this->stats_;
+    }
+
+    void clear_stats() {
+        this->stats_.definitelyNew = 0;
+        this->stats_.maybeExists = 0;
+        this->stats_.falsePositive = 0;
+    }
+
+    //
+    // Size the filter for expected_count keys, the number of blocks is
+    // rounded up to a power of 2. All keys are removed.
+    //
+    void reserve(size_type expected_count, size_type bits_per_key = kDefaultBitsPerKey) {
+        size_type total_bits = expected_count * bits_per_key;
+        size_type block_count = 1;
+        while (block_count * kBlockBits < total_bits) {
+            block_count *= 2;
+        }
+        std::vector<std::uint64_t>(block_count * kBlockWords + kBlockWords - 1).swap(this->storage_);
+        std::size_t address = reinterpret_cast<std::size_t>(this->storage_.data());
+        std::size_t aligned = (address + kBlockWords * sizeof(std::uint64_t) - 1) &
+                              ~(kBlockWords * sizeof(std::uint64_t) - 1);
+        this->words_ = reinterpret_cast<std::uint64_t *>(aligned);
+        this->block_count_ = block_count;
+        this->block_mask_ = block_count - 1;
+        this->capacity_ = expected_count;
+        this->clear();
+    }
+
+    void clear() {
+        std::fill(this->storage_.begin(), this->storage_.end(), 0);
+    }
+
+    void destroy() {
+        std::vector<std::uint64_t>().swap(this->storage_);
+        this->words_ = nullptr;
+        this->block_count_ = 0;
+        this->block_mask_ = 0;
+        this->capacity_ = 0;
+    }
+
+    void swap(BlockedBloomFilter & other) {
+        if (&other != this) {
+            // The vector keeps its buffer, so words_ is still valid.
+            std::swap(this->storage_, other.storage_);
+            std::swap(this->words_, other.words_);
+            std::swap(this->block_count_, other.block_count_);
+            std::swap(this->block_mask_, other.block_mask_);
+            std::swap(this->capacity_, other.capacity_);
+            std::swap(this->stats_, other.stats_);
+        }
+    }
+
+    template <typename Key>
+    bool contains(const Key & value) const {
+        assert(!this->empty());
+        std::uint64_t hash = hash64(value);
+        const std::uint64_t * block = this->words_ + (hash & this->block_mask_) * kBlockWords;
+        std::uint64_t bits = hash >> 32;
+        for (size_type i = 0; i < kHashNums; i++) {
+            // 9 bits for one of the 512 bits in the block
+            size_type bit = size_type((bits * (2 * i + 1) + (hash >> 16)) & (kBlockBits - 1));
+            if ((block[bit / 64] & (std::uint64_t(1) << (bit % 64))) == 0)
+                return false;
+        }
+        return true;
+    }
+
+    //
+    // Add the key, return true if all of its bits were already set.
+    //
+    template <typename Key>
+    bool test_and_set(const Key & value) {
+        assert(!this->empty());
+        std::uint64_t hash = hash64(value);
+        std::uint64_t * block = this->words_ + (hash & this->block_mask_) * kBlockWords;
+        std::uint64_t bits = hash >> 32;
+        bool exists = true;
+        for (size_type i = 0; i < kHashNums; i++) {
+            size_type bit = size_type((bits * (2 * i + 1) + (hash >> 16)) & (kBlockBits - 1));
+            std::uint64_t mask = std::uint64_t(1) << (bit % 64);
+            if ((block[bit / 64] & mask) == 0) {
+                block[bit / 64] |= mask;
+                exists = false;
+            }
+        }
+        return exists;
+    }
+
+    template <typename Key>
+    void insert(const Key & value) {
+        this->test_and_set(value);
+    }
+};
+
+} // namespace AI
+} // namespace MagicBlock
@@ -10,12 +10,15 @@
 #include <vector>
 #include <type_traits>  // For std::conditional<bool, T1, T2>
 #include <algorithm>    // For std::fill_n()
+#include <utility>      // For std::swap()
 
 #include "MagicBlock/AI/Color.h"
 #include "MagicBlock/AI/Number.h"
 #include "MagicBlock/AI/Move.h"
 #include "MagicBlock/AI/MoveSeq.h"
 #include "MagicBlock/AI/Value128.h"
+#include "MagicBlock/AI/PackedKey.h"
+#include "MagicBlock/AI/CellPack.h"
 
 namespace MagicBlock {
 namespace AI {
@@ -64,6 +67,17 @@ union Board
 
     static const size_type kRemainUnits = (kRemainAutoBytes + kUnitBytes - 1) / kUnitBytes;
 
+    static const size_type kKeyWords = (BoardSize * 3 + 63) / 64;
+
+    // The packed cells of the board, value128() for at most 42 cells, see key().
+    typedef typename std::conditional<
+                (BoardSize <= 42), Value128, PackedKey<kKeyWords>
+            >::type  key_type;
+
+    typedef typename std::conditional<
+                (BoardSize <= 42), Value128_Hash, PackedKey_Hash<kKeyWords>
+            >::type  key_hash_t;
+
     std::uint8_t    cells[BoardSize];
     unit_type       units[kTotalUnits];
 
@@ -135,8 +149,6 @@ union Board
                 unit_type * _units = (unit_type *)auto_units;
                 for (size_type n = 0; n < kRemainUnits; n++) {
                     *_units++ = 0;
-                    if (n < kRemainUnits - 1)
-                        _units++;
                 }
             }
         }
@@ -347,74 +359,133 @@ union Board
     }
 
     size_type value() const noexcept {
-        size_type value = 0;
-        for (ssize_type pos = BoardSize - 1; pos >= 0; pos--) {
-            value <<= 3;
-            value |= (this->cells[pos] & 0x07U);
-        }
-        return value;
+        return size_type(this->value64());
     }
 
     std::uint64_t value64() const noexcept {
-        std::uint64_t value64 = 0;
-        for (ssize_type pos = BoardSize - 1; pos >= 0; pos--) {
-            value64 <<= 3;
-            value64 |= (this->cells[pos] & 0x07U);
+        // The same as the low 64 bits of value128()
+        if (BoardSize <= 21) {
+            return CellPack::pack(this->cells, BoardSize);
+        }
+        else {
+            std::uint64_t low, high;
+            CellPack::pack128(this->cells, BoardSize, low, high);
+            return low;
         }
-        return value64;
     }
 
     template <size_type kEmptyColor = Color::Empty>
     size_type compactValue() const noexcept {
-        size_type value = 0;
-        for (ssize_type pos = BoardSize - 1; pos >= 0; pos--) {
-            if (this->cells[pos] != kEmptyColor) {
-                value <<= 3;
-                value |= (this->cells[pos] & 0x07U);
-            }
-        }
-        return value;
+        return size_type(this->template compactValue64<kEmptyColor>());
     }
 
     template <size_type kEmptyColor = Color::Empty>
     std::uint64_t compactValue64() const noexcept {
-        std::uint64_t value64 = 0;
-        for (ssize_type pos = BoardSize - 1; pos >= 0; pos--) {
-            if (this->cells[pos] != kEmptyColor) {
-                value64 <<= 3;
-                value64 |= (this->cells[pos] & 0x07U);
-            }
-        }
-        return value64;
+        return CellPack::pack_compact(this->cells, BoardSize, std::uint8_t(kEmptyColor));
     }
 
     Value128 value128() const noexcept {
-        std::uint64_t low = 0, high = 0;
-        if (BoardSize <= 21) {
-            for (ssize_type pos = BoardSize - 1; pos >= 0; pos--) {
-                low <<= 3;
-                low |= std::uint64_t(this->cells[pos] & 0x07U);
+        // Low: bit 0 ~ 62 for cell 0 ~ 20, bit 63 for the bit 0 of cell 21.
+        // High: bit 0 ~ 1 for the bit 1 ~ 2 of cell 21, then cell 22 ...
+        std::uint64_t low, high;
+        CellPack::pack128(this->cells, BoardSize, low, high);
+        return Value128(low, high);
+    }
+
+    //
+    // Where the 3-bit field of a cell is in value128(). Cell 21 is split,
+    // bit 0 is the bit 63 of low, bit 1 ~ 2 are the bit 0 ~ 1 of high.
+    //
+    //   low  ^= (color << lowShift) & lowMask;
+    //   high ^= ((color << highShift) >> 1) & highMask;
+    //
+    struct Value128Field {
+        std::uint64_t lowMask;
+        std::uint64_t highMask;
+        std::uint32_t lowShift;
+        std::uint32_t highShift;
+    };
+
+    struct Value128Layout {
+        Value128Field fields[BoardSize];
+
+        Value128Layout() noexcept {
+            for (size_type pos = 0; pos < BoardSize; pos++) {
+                Value128Field & field = this->fields[pos];
+                if (BoardSize <= 21 || pos < 21) {
+                    field.lowMask = ~std::uint64_t(0);
+                    field.highMask = 0;
+                    field.lowShift = std::uint32_t(pos * 3);
+                    field.highShift = 0;
+                }
+                else if (pos == 21) {
+                    field.lowMask = ~std::uint64_t(0);
+                    field.highMask = ~std::uint64_t(0);
+                    field.lowShift = 63;
+                    field.highShift = 0;
+                }
+                else {
+                    field.lowMask = 0;
+                    field.highMask = ~std::uint64_t(0);
+                    field.lowShift = 0;
+                    field.highShift = std::uint32_t((pos - 21) * 3);
+                }
             }
         }
-        else {
-            // Low: bit 0 ~ 62, 21 * 3 = 63 bits
-            for (ssize_type pos = 20; pos >= 0; pos--) {
-                low <<= 3;
-                low |= std::uint64_t(this->cells[pos] & 0x07U);
-            }
-            // Low: bit 63
-            low |= std::uint64_t(this->cells[21] & 0x01U) << 63;
+    };
 
-            // High: bit 2 ~ 63
-            for (ssize_type pos = BoardSize - 1; pos >= 21; pos--) {
-                high <<= 3;
-                high |= std::uint64_t(this->cells[pos] & 0x07U);
-            }
+    static const Value128Field * value128_layout() noexcept {
+        static const Value128Layout layout;
+        return layout.fields;
+    }
 
-            // High: bit 0 ~ 1
-            high >>= 1;
-        }
-        return Value128(low, high);
+    // XOR a 3-bit delta into the field of the cell at pos, in O(1).
+    static void update_value128(Value128 & value, size_type pos, std::uint32_t delta) noexcept {
+        assert(pos < BoardSize);
+        const Value128Field & field = value128_layout()[pos];
+        value.low  ^= (std::uint64_t(delta) << field.lowShift) & field.lowMask;
+        value.high ^= ((std::uint64_t(delta) << field.highShift) >> 1) & field.highMask;
+    }
+
+    //
+    // Swap two cells, and update value (the value128() of this board) in O(1)
+    // instead of packing all the cells again.
+    //
+    void swap_cells(size_type pos1, size_type pos2, Value128 & value) noexcept {
+        std::uint32_t delta = std::uint32_t(this->cells[pos1] ^ this->cells[pos2]) & 0x07U;
+        update_value128(value, pos1, delta);
+        update_value128(value, pos2, delta);
+        std::swap(this->cells[pos1], this->cells[pos2]);
+    }
+
+    //
+    // Swap two cells, and update key (the key() of a board that has more than 42 cells).
+    //
+    template <size_type Words>
+    void swap_cells(size_type pos1, size_type pos2, PackedKey<Words> & key) noexcept {
+        std::uint32_t delta = std::uint32_t(this->cells[pos1] ^ this->cells[pos2]) & 0x07U;
+        key.update_cell(pos1, delta);
+        key.update_cell(pos2, delta);
+        std::swap(this->cells[pos1], this->cells[pos2]);
+    }
+
+    void make_key(Value128 & key) const noexcept {
+        key = this->value128();
+    }
+
+    template <size_type Words>
+    void make_key(PackedKey<Words> & key) const noexcept {
+        key.pack(this->cells, BoardSize);
+    }
+
+    //
+    // The key of the board in the visited sets and the stages, it's the same as
+    // value128() when the board fits in it.
+    //
+    key_type key() const noexcept {
+        key_type key;
+        this->make_key(key);
+        return key;
     }
 
     // clockwise rotate 90 degrees
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "MagicBlock/AI/Color.h"
+#include "MagicBlock/AI/Board.h"
+#include "MagicBlock/AI/BitUtils.h"
+#include "MagicBlock/AI/Config.h"
+
+#if MBG_USE_BMI2 && (defined(__BMI2__) || defined(_MSC_VER))
+#include <immintrin.h>  // For _pext_u64(), _pdep_u64(), _tzcnt_u64()
+#define MBG_BOARD_RANK_BMI2     1
+#else
+#define MBG_BOARD_RANK_BMI2     0
+#endif
+
+namespace MagicBlock {
+namespace AI {
+
+//
+// The rank of a board among all the boards that have the same colors, it is a
+// multiset permutation. For the 5x5 board (6 colors x 4 cells + 1 empty cell)
+// there are 25! / (4!)^6 boards, so a rank fits in 57 bits instead of the 75 bits
+// of value128(). The colors can be any of 0 ~ 7, so the boards that contain
+// Color::Unknown cells have their own ranks too.
+//
+//   rank = empty_pos + BoardSize * (r[0] + C[0] * (r[1] + C[1] * (...)))
+//
+// Where r[k] is the colex rank of the cells of the k-th color among the cells
+// that are not empty and not in the colors before it, and C[k] is the binomial
+// coefficient of that choice. The cells of the last color are the cells left.
+//
+// The cells that are not empty are in the same order when the empty cell moves
+// left or right, so only empty_pos changes, see move().
+//
+template <std::size_t BoardX, std::size_t BoardY>
+class BoardRank {
+public:
+    typedef std::size_t         size_type;
+    typedef std::ptrdiff_t      ssize_type;
+
+    typedef Board<BoardX, BoardY>   board_type;
+
+    static const size_type BoardSize = BoardX * BoardY;
+    static const size_type kMaxColors = Color::Maximum;
+
+    static_assert((BoardSize <= 64), "BoardRank: BoardX * BoardY must be <= 64.");
+
+private:
+    std::uint8_t    empty_color_;
+    bool            is_valid_;
+    size_type       chain_colors_;      // The colors in the chain, the last one is not ranked
+    std::uint64_t   total_;
+
+    std::uint8_t    colors_[kMaxColors];
+    std::uint8_t    counts_[kMaxColors];
+    std::uint64_t   weights_[kMaxColors];
+    std::uint64_t   radixes_[kMaxColors];
+
+    std::uint64_t   binomial_[BoardSize + 1][BoardSize + 1];
+
+    static const std::uint64_t kFullMask = (BoardSize >= 64) ? ~std::uint64_t(0) :
+                                           ((std::uint64_t(1) << (BoardSize % 64)) - 1);
+
+    void init_binomial() {
+        for (size_type n = 0; n <= BoardSize; n++) {
+            this->binomial_[n][0] = 1;
+            for (size_type k = 1; k <= BoardSize; k++) {
+                if (n == 0)
+                    this->binomial_[n][k] = 0;
+                else
+                    this->binomial_[n][k] = this->binomial_[n - 1][k - 1] + this->binomial_[n - 1][k];
+            }
+        }
+    }
+
+    static void make_masks(const board_type & board, std::uint64_t masks[kMaxColors]) {
+        for (size_type color = 0; color < kMaxColors; color++) {
+            masks[color] = 0;
+        }
+        for (size_type pos = 0; pos < BoardSize; pos++) {
+            assert(board.cells[pos] < kMaxColors);
+            masks[board.cells[pos]] |= std::uint64_t(1) << pos;
+        }
+    }
+
+    static size_type lowest_bit(std::uint64_t mask) {
+        assert(mask != 0);
+#if MBG_BOARD_RANK_BMI2
+        return size_type(_tzcnt_u64(mask));
+#else
+        size_type pos = 0;
+        while ((mask & 1) == 0) {
+            mask >>= 1;
+            pos++;
+        }
+        return pos;
+#endif
+    }
+
+    // The colex rank of the cells in mask, counted in the cells of remain.
+    std::uint64_t subset_rank(std::uint64_t mask, std::uint64_t remain) const {
+        std::uint64_t rank = 0;
+#if MBG_BOARD_RANK_BMI2
+        std::uint64_t compact = _pext_u64(mask, remain);
+        for (size_type i = 1; compact != 0; i++) {
+            rank += this->binomial_[lowest_bit(compact)][i];
+            compact &= compact - 1;
+        }
+#else
+        for (size_type i = 1; mask != 0; i++) {
+            size_type pos = lowest_bit(mask);
+            std::uint64_t lower = remain & ((std::uint64_t(1) << pos) - 1);
+            rank += this->binomial_[jstd::BitUtils::popcnt<64>(lower)][i];
+            mask &= mask - 1;
+        }
+#endif
+        return rank;
+    }
+
+    // The reverse of subset_rank(), the cells of count cells are picked from remain.
+    std::uint64_t subset_unrank(std::uint64_t rank, size_type count, std::uint64_t remain) const {
+        std::uint64_t compact = 0;
+        size_type index = jstd::BitUtils::popcnt<64>(remain);
+        for (size_type i = count; i > 0; i--) {
+            do {
+                index--;
+            } while (this->binomial_[index][i] > rank);
+            rank -= this->binomial_[index][i];
+            compact |= std::uint64_t(1) << index;
+        }
+#if MBG_BOARD_RANK_BMI2
+        return _pdep_u64(compact, remain);
+#else
+        std::uint64_t mask = 0;
+        index = 0;
+        for (size_type pos = 0; pos < BoardSize; pos++) {
+            if ((remain & (std::uint64_t(1) << pos)) != 0) {
+                if ((compact & (std::uint64_t(1) << index)) != 0)
+                    mask |= std::uint64_t(1) << pos;
+                index++;
+            }
+        }
+        return mask;
+#endif
+    }
+
+public:
+    explicit BoardRank(const board_type & board, std::uint8_t empty_color = Color::Empty)
+        : empty_color_(empty_color), is_valid_(false), chain_colors_(0), total_(0) {
+        this->init_binomial();
+        this->init(board);
+    }
+
+    ~BoardRank() {}
+
+    //
+    // The colors are counted from board, all the boards that can be ranked have
+    // the same counts. It's not valid if the board hasn't one empty cell, or the
+    // number of the boards doesn't fit in 64 bits.
+    //
+    void init(const board_type & board) {
+        size_type counts[kMaxColors];
+        for (size_type color = 0; color < kMaxColors; color++) {
+            counts[color] = 0;
+        }
+        for (size_type pos = 0; pos < BoardSize; pos++) {
+            counts[board.cells[pos] & (kMaxColors - 1)]++;
+        }
+
+        this->is_valid_ = (counts[this->empty_color_] == 1);
+        this->chain_colors_ = 0;
+        this->total_ = BoardSize;
+        if (!this->is_valid_)
+            return;
+
+        size_type remain = BoardSize - 1;
+        for (size_type color = 0; color < kMaxColors; color++) {
+            if (color == this->empty_color_ || counts[color] == 0)
+                continue;
+            size_type k = this->chain_colors_++;
+            std::uint64_t radix = this->binomial_[remain][counts[color]];
+            this->colors_[k] = std::uint8_t(color);
+            this->counts_[k] = std::uint8_t(counts[color]);
+            this->weights_[k] = this->total_;
+            this->radixes_[k] = radix;
+            if (this->total_ > (~std::uint64_t(0) / radix))
+                this->is_valid_ = false;
+            else
+                this->total_ *= radix;
+            remain -= counts[color];
+        }
+    }
+
+    bool is_valid() const { return this->is_valid_; }
+
+    // The number of the boards, every rank is less than it.
+    std::uint64_t total() const { return this->total_; }
+
+    std::uint64_t rank(const board_type & board) const {
+        assert(this->is_valid());
+        std::uint64_t masks[kMaxColors];
+        make_masks(board, masks);
+
+        std::uint64_t empty_mask = masks[this->empty_color_];
+        std::uint64_t remain = kFullMask & ~empty_mask;
+        std::uint64_t rank = lowest_bit(empty_mask);
+        for (size_type k = 0; (k + 1) < this->chain_colors_; k++) {
+            std::uint64_t mask = masks[this->colors_[k]];
+            rank += this->subset_rank(mask, remain) * this->weights_[k];
+            remain &= ~mask;
+        }
+        return rank;
+    }
+
+    void unrank(std::uint64_t rank, board_type & board) const {
+        assert(this->is_valid());
+        assert(rank < this->total());
+        size_type empty_pos = size_type(rank % BoardSize);
+        rank /= BoardSize;
+
+        std::uint64_t remain = kFullMask & ~(std::uint64_t(1) << empty_pos);
+        board.cells[empty_pos] = this->empty_color_;
+        for (size_type k = 0; k < this->chain_colors_; k++) {
+            std::uint64_t mask;
+            if ((k + 1) < this->chain_colors_) {
+                mask = this->subset_unrank(rank % this->radixes_[k], this->counts_[k], remain);
+                rank /= this->radixes_[k];
+            }
+            else {
+                mask = remain;
+            }
+            for (std::uint64_t bits = mask; bits != 0; bits &= bits - 1) {
+                board.cells[lowest_bit(bits)] = this->colors_[k];
+            }
+            remain &= ~mask;
+        }
+    }
+
+    //
+    // The rank after the empty cell moved from empty_pos to move_pos, board is the
+    // board after the move. A move in the same row only changes empty_pos.
+    //
+    std::uint64_t move(std::uint64_t rank, const board_type & board,
+                       size_type empty_pos, size_type move_pos) const {
+        if ((empty_pos / BoardX) == (move_pos / BoardX))
+            return (rank + move_pos - empty_pos);
+        else
+            return this->rank(board);
+    }
+};
+
+} // namespace AI
+} // namespace MagicBlock
@@ -0,0 +1,262 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "MagicBlock/AI/Board.h"
+
+namespace MagicBlock {
+namespace AI {
+
+struct Symmetry {
+    enum {
+        Identity,
+        Rotate90,           // Clockwise, the same as Board::rotate_to_90()
+        Rotate180,
+        Rotate270,
+        MirrorX,            // Left <--> right
+        MirrorY,            // Top <--> bottom
+        Transpose,          // The main diagonal
+        AntiTranspose,      // The anti-diagonal
+        Maximum
+    };
+
+    // Rotate90, Rotate270 and the transposes swap the width and the height
+    static bool is_square_only(std::size_t type) {
+        return (type == Rotate90 || type == Rotate270 ||
+                type == Transpose || type == AntiTranspose);
+    }
+};
+
+//
+// The symmetries of a board (the dihedral group of the square, or the half of it
+// for a rectangle board) that keep the targets of a search, and the canonical
+// board of a symmetric class: the one that has the minimum value().
+//
+// A sliding move is a move after any symmetry too, so when the set of the targets
+// is the same after a symmetry (e.g. AllowRotate and all rotations of the target
+// are accepted), the boards of one class have the same distance to the targets.
+// A BFS can keep only one board of each class in its visited set.
+//
+// The stages keep the boards as they are reached, only the visited set is keyed
+// on the canonical boards, so the move paths need no transform back.
+//
+template <std::size_t BoardX, std::size_t BoardY>
+class BoardSymmetry {
+public:
+    typedef std::size_t         size_type;
+    typedef std::ptrdiff_t      ssize_type;
+
+    typedef Board<BoardX, BoardY>   board_type;
+
+    static const size_type BoardSize = BoardX * BoardY;
+
+    // The packed value is transformed 3 cells (9 bits) at a time, with a table
+    static const size_type kChunkCells = 3;
+    static const size_type kChunkBits = kChunkCells * 3;
+    static const size_type kChunkSize = size_type(1) << kChunkBits;
+    static const size_type kChunks = (BoardSize + kChunkCells - 1) / kChunkCells;
+
+    // The value() of the boards over 21 cells doesn't hold all of the cells
+    static const bool kHasValueTable = (BoardSize <= 21);
+
+private:
+    std::uint8_t    dest_pos_[Symmetry::Maximum][BoardSize];
+    size_type       types_[Symmetry::Maximum];
+    size_type       count_;
+
+    // The transformed values of the chunks, of the types_[1, count_)
+    std::vector<std::uint64_t> tables_;
+
+    void init_dest_pos() {
+        for (size_type type = 0; type < Symmetry::Maximum; type++) {
+            for (size_type y = 0; y < BoardY; y++) {
+                for (size_type x = 0; x < BoardX; x++) {
+                    size_type dest_x = x, dest_y = y;
+                    switch (type) {
+                        case Symmetry::Rotate90:
+                            dest_x = (BoardY - 1) - y;
+                            dest_y = x;
+                            break;
+                        case Symmetry::Rotate180:
+                            dest_x = (BoardX - 1) - x;
+                            dest_y = (BoardY - 1) - y;
+                            break;
+                        case Symmetry::Rotate270:
+                            dest_x = y;
+                            dest_y = (BoardX - 1) - x;
+                            break;
+                        case Symmetry::MirrorX:
+                            dest_x = (BoardX - 1) - x;
+                            break;
+                        case Symmetry::MirrorY:
+                            dest_y = (BoardY - 1) - y;
+                            break;
+                        case Symmetry::Transpose:
+                            dest_x = y;
+                            dest_y = x;
+                            break;
+                        case Symmetry::AntiTranspose:
+                            dest_x = (BoardY - 1) - y;
+                            dest_y = (BoardX - 1) - x;
+                            break;
+                        default:
+                            break;
+                    }
+                    if (Symmetry::is_square_only(type) && BoardX != BoardY) {
+                        dest_x = x;
+                        dest_y = y;
+                    }
+                    this->dest_pos_[type][y * BoardX + x] = std::uint8_t(dest_y * BoardX + dest_x);
+                }
+            }
+        }
+    }
+
+    void init_tables() {
+        this->tables_.clear();
+        if (!kHasValueTable || this->count_ <= 1)
+            return;
+
+        this->tables_.resize((this->count_ - 1) * kChunks * kChunkSize);
+        for (size_type i = 1; i < this->count_; i++) {
+            const std::uint8_t * dest_pos = this->dest_pos_[this->types_[i]];
+            std::uint64_t * table = &this->tables_[(i - 1) * kChunks * kChunkSize];
+            for (size_type chunk = 0; chunk < kChunks; chunk++) {
+                for (size_type bits = 0; bits < kChunkSize; bits++) {
+                    std::uint64_t value = 0;
+                    for (size_type k = 0; k < kChunkCells; k++) {
+                        size_type pos = chunk * kChunkCells + k;
+                        if (pos >= BoardSize)
+                            break;
+                        std::uint64_t cell = (bits >> (k * 3)) & 0x07U;
+                        value |= cell << (dest_pos[pos] * 3);
+                    }
+                    table[chunk * kChunkSize + bits] = value;
+                }
+            }
+        }
+    }
+
+    static bool contains(const board_type targets[], size_type target_len, const board_type & board) {
+        for (size_type i = 0; i < target_len; i++) {
+            if (targets[i] == board)
+                return true;
+        }
+        return false;
+    }
+
+public:
+    BoardSymmetry() : count_(0) {
+        this->init_dest_pos();
+        this->reset();
+    }
+
+    ~BoardSymmetry() {}
+
+    // Only the Identity, the canonical board is the board itself
+    void reset() {
+        this->types_[0] = Symmetry::Identity;
+        this->count_ = 1;
+        this->tables_.clear();
+    }
+
+    //
+    // Keep the symmetries that map the set of the targets to itself,
+    // targets[0, target_len) are the accepted targets of the search.
+    //
+    void init(const board_type targets[], size_type target_len) {
+        this->reset();
+        for (size_type type = Symmetry::Identity + 1; type < Symmetry::Maximum; type++) {
+            if (Symmetry::is_square_only(type) && BoardX != BoardY)
+                continue;
+            bool is_kept = true;
+            for (size_type i = 0; i < target_len; i++) {
+                board_type target;
+                this->transform(targets[i], type, target);
+                if (!contains(targets, target_len, target)) {
+                    is_kept = false;
+                    break;
+                }
+            }
+            if (is_kept) {
+                this->types_[this->count_++] = type;
+            }
+        }
+        this->init_tables();
+    }
+
+    // The number of the symmetries in use, including the Identity
+    size_type count() const { return this->count_; }
+
+    bool is_enabled() const { return (this->count_ > 1); }
+
+    size_type type(size_type index) const {
+        assert(index < this->count_);
+        return this->types_[index];
+    }
+
+    void transform(const board_type & board, size_type type, board_type & dest) const {
+        assert(type < Symmetry::Maximum);
+        const std::uint8_t * dest_pos = this->dest_pos_[type];
+        for (size_type pos = 0; pos < BoardSize; pos++) {
+            dest.cells[dest_pos[pos]] = board.cells[pos];
+        }
+    }
+
+    // The value() of the board after the index-th symmetry, only for the boards up to 21 cells
+    std::uint64_t transform_value(std::uint64_t value, size_type index) const {
+        static_assert(kHasValueTable, "BoardSymmetry::transform_value(): The board is over 21 cells.");
+        assert(index > 0 && index < this->count_);
+        const std::uint64_t * table = &this->tables_[(index - 1) * kChunks * kChunkSize];
+        std::uint64_t result = 0;
+        for (size_type chunk = 0; chunk < kChunks; chunk++) {
+            result |= table[chunk * kChunkSize + ((value >> (chunk * kChunkBits)) & (kChunkSize - 1))];
+        }
+        return result;
+    }
+
+    // The minimum value() of the symmetric boards, and the symmetry that gives it
+    std::uint64_t canonical_value(std::uint64_t value, size_type & index) const {
+        std::uint64_t min_value = value;
+        index = 0;
+        for (size_type i = 1; i < this->count_; i++) {
+            std::uint64_t sym_value = this->transform_value(value, i);
+            if (sym_value < min_value) {
+                min_value = sym_value;
+                index = i;
+            }
+        }
+        return min_value;
+    }
+
+    std::uint64_t canonical_value(std::uint64_t value) const {
+        size_type index;
+        return this->canonical_value(value, index);
+    }
+
+    // The board keys of any size, the symmetric boards are built cell by cell
+    typename board_type::key_type canonical_key(const board_type & board, size_type & index) const {
+        typedef typename board_type::key_type key_type;
+        key_type min_key = board.key();
+        index = 0;
+        for (size_type i = 1; i < this->count_; i++) {
+            board_type sym_board;
+            this->transform(board, this->types_[i], sym_board);
+            key_type sym_key = sym_board.key();
+            if (sym_key < min_key) {
+                min_key = sym_key;
+                index = i;
+            }
+        }
+        return min_key;
+    }
+};
+
+} // namespace AI
+} // namespace MagicBlock
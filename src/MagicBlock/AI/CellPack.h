@@ -0,0 +1,223 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>      // For std::memcpy()
+
+#include "MagicBlock/AI/Config.h"
+
+#if MBG_USE_BMI2 && (defined(__BMI2__) || defined(_MSC_VER))
+#include <immintrin.h>  // For _pext_u64(), _pdep_u64(), _mm_popcnt_u64()
+#define MBG_CELL_PACK_BMI2  1
+#else
+#define MBG_CELL_PACK_BMI2  0
+#endif
+
+namespace MagicBlock {
+namespace AI {
+
+//
+// Pack the cells (one color per byte) into 3-bit fields and back.
+//
+// Cell i is stored in bits [3 * i, 3 * i + 3) of the result, so at most 21 cells
+// fit in one 64-bit word. With BMI2, 8 cells are loaded at once and one
+// _pext_u64() / _pdep_u64() packs or unpacks all of them.
+//
+struct CellPack {
+    static const std::uint64_t kCellMask8 = 0x0707070707070707ULL;
+    static const std::uint64_t kLowBit8   = 0x0101010101010101ULL;
+    static const std::uint64_t kLow7Bit8  = 0x7F7F7F7F7F7F7F7FULL;
+    static const std::uint64_t kHighBit8  = 0x8080808080808080ULL;
+
+    static std::uint64_t load8(const std::uint8_t * cells) noexcept {
+        std::uint64_t value;
+        std::memcpy(&value, cells, sizeof(value));
+        return value;
+    }
+
+    // Load the last (count < 8) cells, never reads past cells[count - 1].
+    static std::uint64_t load_tail(const std::uint8_t * cells, std::size_t count) noexcept {
+        std::uint64_t value = 0;
+        std::memcpy(&value, cells, count);
+        return value;
+    }
+
+    //
+    // The scalar kernels, the reference of the BMI2 ones.
+    //
+
+    static std::uint64_t pack_scalar(const std::uint8_t * cells, std::size_t count) noexcept {
+        std::uint64_t value = 0;
+        for (std::ptrdiff_t pos = std::ptrdiff_t(count) - 1; pos >= 0; pos--) {
+            value <<= 3;
+            value |= std::uint64_t(cells[pos] & 0x07U);
+        }
+        return value;
+    }
+
+    static void pack128_scalar(const std::uint8_t * cells, std::size_t count,
+                               std::uint64_t & low, std::uint64_t & high) noexcept {
+        if (count <= 21) {
+            low = pack_scalar(cells, count);
+            high = 0;
+        }
+        else {
+            low = pack_scalar(cells, 21) | (std::uint64_t(cells[21] & 0x01U) << 63);
+            high = pack_scalar(cells + 21, count - 21) >> 1;
+        }
+    }
+
+    static std::uint64_t pack_compact_scalar(const std::uint8_t * cells, std::size_t count,
+                                             std::uint8_t empty_color) noexcept {
+        std::uint64_t value = 0;
+        for (std::ptrdiff_t pos = std::ptrdiff_t(count) - 1; pos >= 0; pos--) {
+            if (cells[pos] != empty_color) {
+                value <<= 3;
+                value |= std::uint64_t(cells[pos] & 0x07U);
+            }
+        }
+        return value;
+    }
+
+    static void unpack_scalar(std::uint8_t * cells, std::size_t count, std::uint64_t value) noexcept {
+        assert(count <= 21);
+        for (std::size_t pos = 0; pos < count; pos++) {
+            cells[pos] = std::uint8_t(value & 0x07U);
+            value >>= 3;
+        }
+    }
+
+#if MBG_CELL_PACK_BMI2
+    //
+    // The BMI2 kernels, 8 cells per _pext_u64() / _pdep_u64().
+    //
+
+    static std::uint64_t pack_bmi2(const std::uint8_t * cells, std::size_t count) noexcept {
+        std::uint64_t value = 0;
+        std::size_t pos = 0;
+        for (; (pos + 8) <= count && pos < 24; pos += 8) {
+            value |= _pext_u64(load8(cells + pos), kCellMask8) << (pos * 3);
+        }
+        if (pos < count && pos < 24) {
+            value |= _pext_u64(load_tail(cells + pos, count - pos), kCellMask8) << (pos * 3);
+        }
+        return value;
+    }
+
+    static void append128(std::uint64_t bits, std::size_t shift,
+                          std::uint64_t & low, std::uint64_t & high) noexcept {
+        if (shift < 64) {
+            low |= bits << shift;
+            if (shift > 40)
+                high |= bits >> (64 - shift);
+        }
+        else {
+            high |= bits << (shift - 64);
+        }
+    }
+
+    static void pack128_bmi2(const std::uint8_t * cells, std::size_t count,
+                             std::uint64_t & low, std::uint64_t & high) noexcept {
+        low = 0;
+        high = 0;
+        std::size_t pos = 0;
+        for (; (pos + 8) <= count && pos < 48; pos += 8) {
+            append128(_pext_u64(load8(cells + pos), kCellMask8), pos * 3, low, high);
+        }
+        if (pos < count && pos < 48) {
+            append128(_pext_u64(load_tail(cells + pos, count - pos), kCellMask8), pos * 3, low, high);
+        }
+    }
+
+    static void append_compact(std::uint64_t chunk, std::uint8_t empty_color, std::uint64_t valid,
+                               std::uint64_t & value, std::size_t & shift) noexcept {
+        // The high bit of each byte is set when the byte is not empty_color
+        std::uint64_t diff = chunk ^ (kLowBit8 * empty_color);
+        std::uint64_t non_empty = (((diff & kLow7Bit8) + kLow7Bit8) | diff) & kHighBit8 & valid;
+        std::uint64_t mask = (non_empty >> 7) * 0x07U;
+        if (shift < 64) {
+            value |= _pext_u64(chunk, mask) << shift;
+        }
+        shift += std::size_t(_mm_popcnt_u64(mask));
+    }
+
+    static std::uint64_t pack_compact_bmi2(const std::uint8_t * cells, std::size_t count,
+                                           std::uint8_t empty_color) noexcept {
+        std::uint64_t value = 0;
+        std::size_t shift = 0;
+        std::size_t pos = 0;
+        for (; (pos + 8) <= count; pos += 8) {
+            append_compact(load8(cells + pos), empty_color, ~std::uint64_t(0), value, shift);
+        }
+        if (pos < count) {
+            std::uint64_t valid = (std::uint64_t(1) << ((count - pos) * 8)) - 1;
+            append_compact(load_tail(cells + pos, count - pos), empty_color, valid, value, shift);
+        }
+        return value;
+    }
+
+    static void unpack_bmi2(std::uint8_t * cells, std::size_t count, std::uint64_t value) noexcept {
+        assert(count <= 21);
+        std::size_t pos = 0;
+        for (; (pos + 8) <= count; pos += 8) {
+            std::uint64_t chunk = _pdep_u64(value >> (pos * 3), kCellMask8);
+            std::memcpy(cells + pos, &chunk, sizeof(chunk));
+        }
+        if (pos < count) {
+            std::uint64_t chunk = _pdep_u64(value >> (pos * 3), kCellMask8);
+            std::memcpy(cells + pos, &chunk, count - pos);
+        }
+    }
+#endif // MBG_CELL_PACK_BMI2
+
+    //
+    // Pack cells[0, count). Only 21 cells fit, the fields past bit 63 are dropped,
+    // like a scalar shift would do.
+    //
+    static std::uint64_t pack(const std::uint8_t * cells, std::size_t count) noexcept {
+#if MBG_CELL_PACK_BMI2
+        return pack_bmi2(cells, count);
+#else
+        return pack_scalar(cells, count);
+#endif
+    }
+
+    //
+    // Pack cells[0, count) into 128 bits, cell i in bits [3 * i, 3 * i + 3),
+    // cell 21 is split across low and high. Only 42 cells fit.
+    //
+    static void pack128(const std::uint8_t * cells, std::size_t count,
+                        std::uint64_t & low, std::uint64_t & high) noexcept {
+#if MBG_CELL_PACK_BMI2
+        pack128_bmi2(cells, count, low, high);
+#else
+        pack128_scalar(cells, count, low, high);
+#endif
+    }
+
+    // Pack the cells of cells[0, count) that are not empty_color, in order.
+    static std::uint64_t pack_compact(const std::uint8_t * cells, std::size_t count,
+                                      std::uint8_t empty_color) noexcept {
+#if MBG_CELL_PACK_BMI2
+        return pack_compact_bmi2(cells, count, empty_color);
+#else
+        return pack_compact_scalar(cells, count, empty_color);
+#endif
+    }
+
+    // The reverse of pack(), count <= 21.
+    static void unpack(std::uint8_t * cells, std::size_t count, std::uint64_t value) noexcept {
+#if MBG_CELL_PACK_BMI2
+        unpack_bmi2(cells, count, value);
+#else
+        unpack_scalar(cells, count, value);
+#endif
+    }
+};
+
+} // namespace AI
+} // namespace MagicBlock
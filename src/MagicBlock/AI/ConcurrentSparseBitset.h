@@ -0,0 +1,165 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <thread>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <xmmintrin.h>      // For _mm_pause()
+#endif
+
+#include "MagicBlock/AI/SparseBitset.h"
+
+namespace MagicBlock {
+namespace AI {
+
+//
+// A SparseBitset that many threads can insert into at the same time.
+//
+// The children of the root layer are kept here, one slot per root id, and each
+// root id is guarded by one of kLockCount spinlocks (root id % kLockCount). A
+// thread only changes the subtree of its own root id under that lock, so the
+// containers below the root need no atomic operations, and exactly one thread
+// sees a key as new. The keys are moved into a normal SparseBitset for reading
+// by detach().
+//
+template <typename Board, std::size_t Bits, std::size_t Length,
+          std::size_t Order = LayerOrder::Interleaved>
+class ConcurrentSparseBitset {
+public:
+    typedef std::size_t         size_type;
+
+    typedef Board               board_type;
+    typedef SparseBitset<Board, Bits, Length, Order>    bitset_type;
+    typedef typename bitset_type::IContainer            IContainer;
+    typedef typename bitset_type::LayerPolicy           LayerPolicy;
+
+    static const size_type      BoardY = bitset_type::BoardY;
+    static const size_type      kMaxArraySize = bitset_type::kMaxArraySize;
+    static const size_type      kLayerOrder = Order;
+
+    static const size_type      kLockCount = 1024;
+
+private:
+    // One lock per cache line
+    struct SpinLock {
+        std::atomic<bool>   locked;
+        char                padding[64 - sizeof(std::atomic<bool>)];
+
+        void lock() {
+            for (;;) {
+                if (!this->locked.exchange(true, std::memory_order_acquire))
+                    return;
+                // Yield sometimes, the owner may be waiting for a CPU
+                std::size_t spins = 0;
+                while (this->locked.load(std::memory_order_relaxed)) {
+                    if (++spins < 64) {
+                        _mm_pause();
+                    }
+                    else {
+                        std::this_thread::yield();
+                        spins = 0;
+                    }
+                }
+            }
+        }
+
+        void unlock() {
+            this->locked.store(false, std::memory_order_release);
+        }
+    };
+
+    class LockGuard {
+    private:
+        SpinLock & lock_;
+
+    public:
+        LockGuard(SpinLock & lock) : lock_(lock) {
+            this->lock_.lock();
+        }
+
+        ~LockGuard() {
+            this->lock_.unlock();
+        }
+    };
+
+    // Only provides the layer policy and the container code, its own trie is unused.
+    bitset_type             trie_;
+    IContainer *            children_[kMaxArraySize];
+    SpinLock                locks_[kLockCount];
+    std::atomic<size_type>  size_;
+
+public:
+    ConcurrentSparseBitset() : size_(0) {
+        for (size_type id = 0; id < kMaxArraySize; id++) {
+            this->children_[id] = nullptr;
+        }
+        for (size_type i = 0; i < kLockCount; i++) {
+            this->locks_[i].locked.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    ConcurrentSparseBitset(const ConcurrentSparseBitset & src) = delete;
+    ConcurrentSparseBitset & operator = (const ConcurrentSparseBitset & rhs) = delete;
+
+    ~ConcurrentSparseBitset() {
+        this->clear();
+    }
+
+    size_type size() const {
+        return this->size_.load(std::memory_order_relaxed);
+    }
+
+    // Not thread-safe, call it before the insertions.
+    void set_layer_policy(const LayerPolicy policy[BoardY]) {
+        this->trie_.set_layer_policy(policy);
+    }
+
+    bool try_insert(const board_type & board) {
+        size_type root_id = this->trie_.get_layer_value(board, 0);
+        bool insert_new;
+        {
+            LockGuard guard(this->locks_[root_id % kLockCount]);
+            insert_new = this->trie_.try_insert_subtree(board, this->children_[root_id]);
+        }
+        if (insert_new) {
+            this->size_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return insert_new;
+    }
+
+    bool insert(const board_type & board) {
+        return this->try_insert(board);
+    }
+
+    bool contains(const board_type & board) {
+        size_type root_id = this->trie_.get_layer_value(board, 0);
+        LockGuard guard(this->locks_[root_id % kLockCount]);
+        return this->trie_.contains_subtree(board, this->children_[root_id]);
+    }
+
+    //
+    // Move all the keys into bitset, this one is empty after it.
+    // Not thread-safe, call it after the insertions.
+    //
+    void detach(bitset_type & bitset) {
+        bitset.assign_root_children(this->children_, this->size());
+        this->size_.store(0, std::memory_order_relaxed);
+    }
+
+    // Not thread-safe.
+    void clear() {
+        bitset_type bitset;
+        this->detach(bitset);
+    }
+};
+
+} // namespace AI
+} // namespace MagicBlock
@@ -0,0 +1,22 @@
+#pragma once
+
+//
+// The instruction set switches of the project.
+//
+// Every header that tests them includes this file, so all the translation units
+// see the same values and the inline functions have one definition. They can be
+// overridden from the compiler command line, e.g. -DMBG_USE_AVX2=0.
+//
+
+#ifndef MBG_USE_SSE2
+#define MBG_USE_SSE2    1
+#endif
+
+#ifndef MBG_USE_AVX2
+#define MBG_USE_AVX2    1
+#endif
+
+// The PEXT/PDEP kernels are only used when the compiler targets BMI2 as well, see CellPack.h
+#ifndef MBG_USE_BMI2
+#define MBG_USE_BMI2    1
+#endif
@@ -6,11 +6,54 @@
 #include <cstdint>
 #include <cstddef>
 
+#include "MagicBlock/AI/LayerOrder.h"
+
 #ifndef NOMINMAX
 #define NOMINMAX
 #endif
 
 #define STAGES_USE_EMPLACE_PUSH     0
+#define STAGES_USE_TRIE_FRONTIER    0
+#define STAGES_USE_BATCH_INSERT     0
+#define STAGES_USE_BLOOM_FILTER     0
+
+// Expand the forward stages from a structure-of-arrays copy of the frontier, the
+// children are made in AVX2 registers and inserted in batches, see FrontierSoA.
+// Off by default: the main 5x5 game takes 2.56 s with it and 2.57 s without it
+// (the mean of 10 runs), and it loses the trie path reuse of the serial loop.
+#define STAGES_USE_SOA_FRONTIER     0
+
+// Restart the visited trie search of a child at the first row it changed, from the
+// trie path of its parent. It's only used by the default (serial) expansion.
+#define STAGES_USE_PATH_REUSE       1
+
+// Prune the duplicate move strings with MoveFsm instead of the reverse move only,
+// the stages carry the FSM state in Stage::fsm_state.
+#define STAGES_USE_MOVE_FSM         1
+
+// Keep only the canonical board of each symmetric class in the visited set, when the
+// targets are the same after the symmetry, see BoardSymmetry. SlidingColorPuzzle only.
+#define STAGES_USE_SYMMETRY         1
+
+// Carry the mismatched cell counts of the goal regions in the TwoPhase stages, a child
+// updates them in O(1) and is_satisfy() only runs when a region is matched.
+#define STAGES_USE_GOAL_COUNTER     1
+
+// Compare the target region of a TwoPhase child with all the rotated targets at once,
+// see TargetMatcher.
+#define STAGES_USE_TARGET_MATCHER   1
+
+// Keep the moves of the TwoEndpoint and SlidingColorPuzzle stages in a shared MoveTree,
+// a child appends one node instead of copying the MoveSeq of its parent.
+#define STAGES_USE_MOVE_TREE        1
+
+// Carve the stage lists and the trie paths of a TwoEndpoint depth from a LayerRegion,
+// the region of the oldest depth is recycled at once in clear_prev_depth().
+#define STAGES_USE_LAYER_REGION     1
+
+// Keep the Value128 visited set of stdset_solve() in an open-addressing Value128HashSet
+// instead of a std::set.
+#define STAGES_USE_VALUE128_HASHSET 1
 
 namespace MagicBlock {
 namespace AI {
@@ -18,6 +61,9 @@ namespace AI {
 static const std::size_t MAX_ROTATE_TYPE = 4;
 static const std::size_t MAX_PHASE1_TYPE = 4;
 
+// The trie layer order of the Two-Endpoint visited sets
+static const std::size_t TRIE_LAYER_ORDER = LayerOrder::CenterFirst;
+
 #ifdef NDEBUG
 
 static const std::size_t MAX_PHASE2_DEPTH = 26;
@@ -16,6 +16,13 @@ struct ErrorCode {
         PlayerBoardNumberOverflow,
         TargetBoardNumberIsDuplicated,
         PlayerBoardNumberIsDuplicated,
+        FileOpenFailed = -30,
+        FileWriteFailed,
+        FileMapFailed,
+        FileFormatIsInvalid,
+        FileVersionIsMismatched,
+        FileLayoutIsMismatched,
+        FileSourceIsMismatched,
         TargetBoardColorOverflow = -7,
         PlayerBoardColorOverflow = -6,
         UnknownTargetBoardColor = -5,
@@ -52,6 +59,20 @@ struct ErrorCode {
                 return "Unknown target board color";
             case ErrorType::UnknownPlayerBoardColor:
                 return "Unknown player board color";
+            case ErrorType::FileOpenFailed:
+                return "Open file failed";
+            case ErrorType::FileWriteFailed:
+                return "Write file failed";
+            case ErrorType::FileMapFailed:
+                return "Map file failed";
+            case ErrorType::FileFormatIsInvalid:
+                return "File format is invalid";
+            case ErrorType::FileVersionIsMismatched:
+                return "File version is mismatched";
+            case ErrorType::FileLayoutIsMismatched:
+                return "File layout is mismatched";
+            case ErrorType::FileSourceIsMismatched:
+                return "File source is mismatched";
             case ErrorCode::ifstream_IsFailed:
                 return "ifstream_IsFailed";
             case ErrorCode::ifstream_IsBad:
@@ -83,6 +104,14 @@ struct ErrorCode {
                 return "Error";
             case ErrorType::UnknownPlayerBoardColor:
                 return "Error";
+            case ErrorType::FileOpenFailed:
+            case ErrorType::FileWriteFailed:
+            case ErrorType::FileMapFailed:
+            case ErrorType::FileFormatIsInvalid:
+            case ErrorType::FileVersionIsMismatched:
+            case ErrorType::FileLayoutIsMismatched:
+            case ErrorType::FileSourceIsMismatched:
+                return "FileError";
             case ErrorCode::ifstream_IsFailed:
                 return "FileError";
             case ErrorCode::ifstream_IsBad:
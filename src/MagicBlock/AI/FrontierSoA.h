@@ -0,0 +1,309 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>      // For std::memcpy()
+#include <vector>
+#include <type_traits>  // For std::integral_constant<T, v>
+
+#include "MagicBlock/AI/Config.h"
+
+#if MBG_USE_AVX2
+#include <immintrin.h>  // For AVX2
+#endif
+
+#include "MagicBlock/AI/Constant.h"
+#include "MagicBlock/AI/Color.h"
+#include "MagicBlock/AI/Move.h"
+#include "MagicBlock/AI/MoveTable.h"
+#include "MagicBlock/AI/MoveFsm.h"
+#include "MagicBlock/AI/Value128.h"
+#include "MagicBlock/AI/Board.h"
+
+namespace MagicBlock {
+namespace AI {
+
+//
+// The frontier of a BFS depth in structure-of-arrays form: the boards are padded
+// to 32 bytes (one AVX2 register for up to 32 cells), the empty positions, the
+// last directions and the MoveFsm states are in their own arrays.
+//
+// expand() generates the children of a group of parents. With AVX2, a child is
+// made in a register: the empty cell and the moved cell are XOR-ed with their
+// difference through a precomputed swap mask, then its value128() is packed in
+// the same register, so no Board copy is touched before the batched insert.
+//
+template <std::size_t BoardX, std::size_t BoardY>
+class FrontierSoA {
+public:
+    typedef std::size_t         size_type;
+    typedef std::ptrdiff_t      ssize_type;
+
+    typedef Board<BoardX, BoardY>               board_type;
+    typedef typename board_type::key_type       key_type;
+    typedef MoveTable<BoardX, BoardY>           move_table_t;
+
+    static const size_type BoardSize = BoardX * BoardY;
+    static const size_type kPaddedBytes = (BoardSize + 31) / 32 * 32;
+
+    // The parents of one expand()
+    static const size_type kGroupSize = 8;
+    static const size_type kMaxChildren = kGroupSize * Dir::Maximum;
+
+#if MBG_USE_AVX2
+    static const bool kUseAVX2 = (BoardSize <= 32);
+#else
+    static const bool kUseAVX2 = false;
+#endif
+
+    struct PaddedBoard {
+        std::uint8_t cells[kPaddedBytes];
+    };
+
+    // A child made by expand(), parent is the index of its parent in the frontier.
+    struct Child {
+        key_type        value;
+        std::uint32_t   parent;
+        std::uint8_t    move_pos;
+        std::uint8_t    cur_dir;
+        std::uint8_t    fsm_state;
+    };
+
+private:
+    std::vector<PaddedBoard>    boards_;
+    std::vector<std::uint8_t>   empty_pos_;
+    std::vector<std::uint8_t>   last_dir_;
+    std::vector<std::uint8_t>   fsm_state_;
+
+    //
+    // masks[empty_pos][n] is 0xFF at empty_pos and at the cell moved by the n-th
+    // direction, XOR-ing a board with (difference & mask) swaps the two cells.
+    //
+    struct SwapMasks {
+        PaddedBoard masks[BoardSize][Dir::Maximum];
+
+        SwapMasks() noexcept {
+            std::memset((void *)this->masks, 0, sizeof(this->masks));
+            for (size_type pos = 0; pos < BoardSize; pos++) {
+                const MoveEntry * moves = move_table_t::moves(pos);
+                for (size_type n = 0; n < Dir::Maximum; n++) {
+                    if (moves[n].valid == 0)
+                        continue;
+                    this->masks[pos][n].cells[pos] = 0xFF;
+                    this->masks[pos][n].cells[moves[n].pos] = 0xFF;
+                }
+            }
+        }
+    };
+
+    static const SwapMasks & swap_masks() noexcept {
+        static const SwapMasks masks;
+        return masks;
+    }
+
+    // The next MoveFsm state of a move, or MoveFsm::kPruned.
+    std::uint8_t next_state(size_type index, size_type n, std::uint8_t cur_dir) const {
+#if STAGES_USE_MOVE_FSM
+        (void)cur_dir;
+        return MoveFsm::getInstance().next(this->fsm_state_[index], n);
+#else
+        return (cur_dir == this->last_dir_[index]) ? MoveFsm::kPruned : MoveFsm::kStart;
+#endif
+    }
+
+    size_type expand_impl(size_type first, size_type count, board_type * boards,
+                          Child * children, std::false_type) const {
+        size_type total = 0;
+        for (size_type j = 0; j < count; j++) {
+            size_type index = first + j;
+            board_type parent;
+            std::memcpy((void *)parent.cells, (const void *)this->boards_[index].cells, BoardSize);
+            key_type parent_value = parent.key();
+
+            std::uint8_t empty_pos = this->empty_pos_[index];
+            const MoveEntry * moves = move_table_t::moves(empty_pos);
+            for (size_type n = 0; n < Dir::Maximum; n++) {
+                if (moves[n].valid == 0)
+                    continue;
+
+                std::uint8_t cur_dir = moves[n].dir;
+                std::uint8_t fsm_state = this->next_state(index, n, cur_dir);
+                if (fsm_state == MoveFsm::kPruned)
+                    continue;
+
+                boards[total] = parent;
+                children[total].value = parent_value;
+                boards[total].swap_cells(empty_pos, moves[n].pos, children[total].value);
+                children[total].parent = std::uint32_t(index);
+                children[total].move_pos = moves[n].pos;
+                children[total].cur_dir = cur_dir;
+                children[total].fsm_state = fsm_state;
+                total++;
+            }
+        }
+        return total;
+    }
+
+#if MBG_USE_AVX2
+    // Pack the cells of a register, the same as board.value128(), the padding must be zero.
+    static Value128 pack_value128(__m256i cells) {
+        // 2 cells to 6 bits in each 16-bit lane, then 4 cells to 12 bits in each 32-bit lane
+        __m256i pairs = _mm256_maddubs_epi16(cells, _mm256_set1_epi16(0x0801));
+        __m256i quads = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00400001));
+        // 8 cells to 24 bits in each 64-bit lane
+        __m256i octs  = _mm256_or_si256(_mm256_and_si256(quads, _mm256_set1_epi64x(0xFFFFFFFFLL)),
+                                        _mm256_srli_epi64(quads, 20));
+        __m128i low  = _mm256_castsi256_si128(octs);
+        __m128i high = _mm256_extracti128_si256(octs, 1);
+        std::uint64_t cells_0_7   = (std::uint64_t)_mm_cvtsi128_si64(low);
+        std::uint64_t cells_8_15  = (std::uint64_t)_mm_extract_epi64(low, 1);
+        std::uint64_t cells_16_23 = (std::uint64_t)_mm_cvtsi128_si64(high);
+        std::uint64_t cells_24_31 = (std::uint64_t)_mm_extract_epi64(high, 1);
+        return Value128(cells_0_7 | (cells_8_15 << 24) | (cells_16_23 << 48),
+                        (cells_16_23 >> 16) | (cells_24_31 << 8));
+    }
+
+    size_type expand_impl(size_type first, size_type count, board_type * boards,
+                          Child * children, std::true_type) const {
+        static_assert(((sizeof(board_type) % 4) == 0 && sizeof(board_type) <= 32),
+                      "FrontierSoA::expand(): board_type must be 4-byte units and fit in 32 bytes.");
+        const SwapMasks & swap = swap_masks();
+
+        // The 32-bit units of a Board in a 32-byte register
+        const __m256i store_mask = _mm256_cmpgt_epi32(
+                                    _mm256_set1_epi32(int(sizeof(board_type) / 4)),
+                                    _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+        __m256i parents[kGroupSize];
+        for (size_type j = 0; j < count; j++) {
+            parents[j] = _mm256_loadu_si256((const __m256i *)this->boards_[first + j].cells);
+        }
+
+        size_type total = 0;
+        for (size_type j = 0; j < count; j++) {
+            size_type index = first + j;
+            const std::uint8_t * cells = this->boards_[index].cells;
+            std::uint8_t empty_pos = this->empty_pos_[index];
+            const MoveEntry * moves = move_table_t::moves(empty_pos);
+            for (size_type n = 0; n < Dir::Maximum; n++) {
+                if (moves[n].valid == 0)
+                    continue;
+
+                std::uint8_t cur_dir = moves[n].dir;
+                std::uint8_t fsm_state = this->next_state(index, n, cur_dir);
+                if (fsm_state == MoveFsm::kPruned)
+                    continue;
+
+                std::uint8_t move_pos = moves[n].pos;
+                __m256i delta = _mm256_set1_epi8(char(cells[empty_pos] ^ cells[move_pos]));
+                __m256i mask  = _mm256_loadu_si256((const __m256i *)swap.masks[empty_pos][n].cells);
+                __m256i child = _mm256_xor_si256(parents[j], _mm256_and_si256(delta, mask));
+
+                _mm256_maskstore_epi32((int *)&boards[total], store_mask, child);
+                children[total].value = pack_value128(child);
+                children[total].parent = std::uint32_t(index);
+                children[total].move_pos = move_pos;
+                children[total].cur_dir = cur_dir;
+                children[total].fsm_state = fsm_state;
+                total++;
+            }
+        }
+        return total;
+    }
+#endif // MBG_USE_AVX2
+
+public:
+    FrontierSoA() {}
+    ~FrontierSoA() {}
+
+    size_type size() const {
+        return this->empty_pos_.size();
+    }
+
+    bool empty() const {
+        return this->empty_pos_.empty();
+    }
+
+    void clear() {
+        this->boards_.clear();
+        this->empty_pos_.clear();
+        this->last_dir_.clear();
+        this->fsm_state_.clear();
+    }
+
+    void reserve(size_type capacity) {
+        this->boards_.reserve(capacity);
+        this->empty_pos_.reserve(capacity);
+        this->last_dir_.reserve(capacity);
+        this->fsm_state_.reserve(capacity);
+    }
+
+    void swap(FrontierSoA & other) {
+        this->boards_.swap(other.boards_);
+        this->empty_pos_.swap(other.empty_pos_);
+        this->last_dir_.swap(other.last_dir_);
+        this->fsm_state_.swap(other.fsm_state_);
+    }
+
+    void push_back(const board_type & board, std::uint8_t empty_pos,
+                   std::uint8_t last_dir, std::uint8_t fsm_state) {
+        PaddedBoard padded;
+        std::memcpy((void *)padded.cells, (const void *)board.cells, BoardSize);
+        std::memset((void *)&padded.cells[BoardSize], 0, kPaddedBytes - BoardSize);
+        this->boards_.push_back(padded);
+        this->empty_pos_.push_back(empty_pos);
+        this->last_dir_.push_back(last_dir);
+        this->fsm_state_.push_back(fsm_state);
+    }
+
+    // Rebuild the frontier from a stage list.
+    template <typename StageT, typename Allocator>
+    void assign(const std::vector<StageT, Allocator> & stages) {
+        this->clear();
+        this->reserve(stages.size());
+        for (size_type i = 0; i < stages.size(); i++) {
+            const StageT & stage = stages[i];
+            this->push_back(stage.board, stage.empty_pos, stage.last_dir, stage.fsm_state);
+        }
+    }
+
+    const std::uint8_t * cells(size_type index) const {
+        assert(index < this->size());
+        return this->boards_[index].cells;
+    }
+
+    std::uint8_t empty_pos(size_type index) const {
+        assert(index < this->size());
+        return this->empty_pos_[index];
+    }
+
+    std::uint8_t last_dir(size_type index) const {
+        assert(index < this->size());
+        return this->last_dir_[index];
+    }
+
+    std::uint8_t fsm_state(size_type index) const {
+        assert(index < this->size());
+        return this->fsm_state_[index];
+    }
+
+    //
+    // Generate the children of the parents [first, first + count), count <= kGroupSize,
+    // the pruned moves are skipped. The children are written to boards[] and children[],
+    // both must have room for kMaxChildren. Return the number of the children.
+    //
+    size_type expand(size_type first, size_type count, board_type * boards, Child * children) const {
+        assert(count <= kGroupSize);
+        assert((first + count) <= this->size());
+        return this->expand_impl(first, count, boards, children,
+                                 std::integral_constant<bool, kUseAVX2>());
+    }
+};
+
+} // namespace AI
+} // namespace MagicBlock
@@ -0,0 +1,730 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>        // For std::sort(), std::swap()
+#include <utility>          // For std::pair<T1, T2>, std::swap()
+#include <iterator>         // For std::forward_iterator_tag
+
+#include "MagicBlock/AI/Color.h"
+#include "MagicBlock/AI/Board.h"
+#include "MagicBlock/AI/CellPack.h"
+#include "MagicBlock/AI/Algorithm.h"
+#include "MagicBlock/AI/BitUtils.h"
+#include "MagicBlock/AI/LayerOrder.h"
+#include "MagicBlock/AI/ErrorCode.h"
+#include "MagicBlock/AI/MappedFile.h"
+#include "MagicBlock/AI/SparseBitset.h"
+
+namespace MagicBlock {
+namespace AI {
+
+//
+// A read-only copy of SparseBitset<T>, made by freeze().
+//
+// The trie is stored layer by layer in breadth-first order. Each layer has one
+// sorted id array for all of its nodes, and node n of a layer owns the ids
+// [offsets[n], offsets[n + 1]). The i-th id of a layer is the parent of the
+// i-th node of the next layer, so no child pointers are stored.
+//
+// The root layer is also kept as a bitmap with a rank table, it's found
+// without searching.
+//
+// There are no pointers in the arrays, save() writes them to a file as they are,
+// and open() maps the file read-only and uses it in place.
+//
+// File layout (native byte order, every section is 64 bytes aligned):
+//
+//   FileHeader
+//   LayerHeader[BoardY]
+//   root bitmap: uint64[root_words], root rank: uint32[root_words]
+//   for each layer: ids: ident_type[id_count], offsets: uint32[offset_count]
+//   values: value_size bytes per board, in the order of the leaf layer
+//
+// The values section is empty here, FrozenSparseHashMap stores the values of
+// a SparseHashMap in it.
+//
+// The header also keeps a Source, what the boards were made from (e.g. a key of
+// the target and the search depth). open() rejects a file of another source,
+// and checks the offsets and the root rank table, so a corrupt file can't make
+// a lookup read out of the mapping. The order of the ids is trusted.
+//
+// The ids are uint16, or uint32 for the rows of more than 5 cells, see SparseBitset.
+//
+template <typename Board, std::size_t Bits, std::size_t Length,
+          std::size_t Order = LayerOrder::Interleaved>
+class FrozenSparseBitset {
+public:
+    typedef std::size_t         size_type;
+    typedef std::ptrdiff_t      ssize_type;
+
+    typedef Board               board_type;
+    typedef FrozenSparseBitset<Board, Bits, Length, Order>  this_type;
+    typedef SparseBitset<Board, Bits, Length, Order>        sparse_bitset_type;
+    typedef typename sparse_bitset_type::IContainer         IContainer;
+    typedef typename sparse_bitset_type::ident_type         ident_type;
+
+    static const size_type      BoardX = board_type::Y;
+    static const size_type      BoardY = board_type::X;
+    static const size_type      BoardSize = board_type::BoardSize;
+    static const size_type      kLayerOrder = Order;
+
+    static const size_type      kBitMask = (size_type(1) << Bits) - 1;
+    static const size_type      kMaxLayerValue = size_type(1) << (Bits * BoardX);
+    static const size_type      kRootWords = (kMaxLayerValue + 63) / 64;
+
+    static const std::uint32_t  kFileVersion = 3;
+    static const std::uint32_t  kByteOrderMark = 0x01020304U;
+    static const size_type      kSectionAlignment = 64;
+
+    // find_index() of a board that is not in the set
+    static const size_type      kNotFound = size_type(-1);
+
+    // What the boards of a file were made from, it's chosen by the owner.
+    struct Source {
+        std::uint64_t   key;
+        std::uint64_t   depth;
+
+        Source() : key(0), depth(0) {}
+        Source(std::uint64_t _key, std::uint64_t _depth) : key(_key), depth(_depth) {}
+    };
+
+#pragma pack(push, 1)
+
+    struct FileHeader {
+        char            magic[8];
+        std::uint32_t   version;
+        std::uint32_t   byte_order;
+        std::uint32_t   header_size;
+        std::uint32_t   board_x;
+        std::uint32_t   board_y;
+        std::uint32_t   bits;
+        std::uint32_t   layer_order;
+        std::uint32_t   value_size;
+        std::uint64_t   size;
+        std::uint64_t   file_size;
+        std::uint64_t   root_bits_offset;
+        std::uint64_t   root_rank_offset;
+        std::uint64_t   root_words;
+        std::uint64_t   values_offset;
+        std::uint64_t   source_key;
+        std::uint64_t   source_depth;
+    };
+
+    struct LayerHeader {
+        std::uint64_t   ids_offset;
+        std::uint64_t   id_count;
+        std::uint64_t   offsets_offset;
+        std::uint64_t   offset_count;
+    };
+
+#pragma pack(pop)
+
+    class const_iterator {
+    public:
+        typedef std::forward_iterator_tag   iterator_category;
+        typedef board_type                  value_type;
+        typedef std::ptrdiff_t              difference_type;
+        typedef const board_type *          pointer;
+        typedef const board_type &          reference;
+
+    private:
+        const this_type *   owner_;
+        size_type           pos_[BoardY];
+        size_type           last_[BoardY];
+        board_type          board_;
+
+        // Move the layers after layer to the first entries of their nodes
+        void seek(size_type layer) {
+            for (size_type i = layer; i < BoardY; i++) {
+                size_type node = this->pos_[i - 1];
+                this->pos_[i]  = this->owner_->offsets_[i][node];
+                this->last_[i] = this->owner_->offsets_[i][node + 1];
+                assert(this->pos_[i] < this->last_[i]);
+                this->owner_->compose_layer_to_board(this->board_, i, this->owner_->ids_[i][this->pos_[i]]);
+            }
+        }
+
+    public:
+        const_iterator() noexcept : owner_(nullptr) {
+            std::fill_n(this->pos_, BoardY, 0);
+            std::fill_n(this->last_, BoardY, 0);
+        }
+
+        const_iterator(const this_type * owner, bool is_end) noexcept : owner_(owner) {
+            std::fill_n(this->pos_, BoardY, 0);
+            std::fill_n(this->last_, BoardY, 0);
+            if (is_end || owner->size() == 0) {
+                this->pos_[BoardY - 1] = owner->size();
+            }
+            else {
+                this->last_[0] = owner->id_counts_[0];
+                owner->compose_layer_to_board(this->board_, 0, owner->ids_[0][0]);
+                this->seek(1);
+            }
+        }
+
+        reference operator * () const {
+            return this->board_;
+        }
+
+        // The index of the board in the leaf layer
+        size_type rank() const {
+            return this->pos_[BoardY - 1];
+        }
+
+        pointer operator -> () const {
+            return &this->board_;
+        }
+
+        const_iterator & operator ++ () {
+            size_type layer = BoardY - 1;
+            this->pos_[layer]++;
+            while (this->pos_[layer] >= this->last_[layer]) {
+                if (layer == 0) {
+                    this->pos_[BoardY - 1] = this->owner_->size();
+                    return *this;
+                }
+                layer--;
+                this->pos_[layer]++;
+            }
+            this->owner_->compose_layer_to_board(this->board_, layer, this->owner_->ids_[layer][this->pos_[layer]]);
+            this->seek(layer + 1);
+            return *this;
+        }
+
+        const_iterator operator ++ (int) {
+            const_iterator copy(*this);
+            ++(*this);
+            return copy;
+        }
+
+        // The position in the leaf layer is the rank of the board
+        bool operator == (const const_iterator & rhs) const {
+            return (this->pos_[BoardY - 1] == rhs.pos_[BoardY - 1]);
+        }
+
+        bool operator != (const const_iterator & rhs) const {
+            return (this->pos_[BoardY - 1] != rhs.pos_[BoardY - 1]);
+        }
+    };
+
+    typedef const_iterator iterator;
+
+    friend class const_iterator;
+
+protected:
+    // The views of the arrays, they point to the vectors below or to the mapped file.
+    const ident_type *       ids_[BoardY];
+    const std::uint32_t *       offsets_[BoardY];
+    size_type                   id_counts_[BoardY];
+    const std::uint64_t *       root_bits_;
+    const std::uint32_t *       root_rank_;
+
+    std::vector<ident_type>  id_store_[BoardY];
+    std::vector<std::uint32_t>  offset_store_[BoardY];
+    std::vector<std::uint64_t>  root_bits_store_;
+    std::vector<std::uint32_t>  root_rank_store_;
+    MappedFile                  file_;
+
+    size_type                   y_index_[BoardY];
+
+    void init() {
+        LayerOrder::make_index<Order>(this->y_index_);
+        this->reset_views();
+    }
+
+    void reset_views() {
+        for (size_type layer = 0; layer < BoardY; layer++) {
+            this->ids_[layer] = nullptr;
+            this->offsets_[layer] = nullptr;
+            this->id_counts_[layer] = 0;
+        }
+        this->root_bits_ = nullptr;
+        this->root_rank_ = nullptr;
+    }
+
+    void attach_store() {
+        for (size_type layer = 0; layer < BoardY; layer++) {
+            this->ids_[layer] = this->id_store_[layer].data();
+            this->offsets_[layer] = this->offset_store_[layer].data();
+            this->id_counts_[layer] = this->id_store_[layer].size();
+        }
+        this->root_bits_ = this->root_bits_store_.data();
+        this->root_rank_ = this->root_rank_store_.data();
+    }
+
+    static size_type align_section(size_type offset) {
+        return ((offset + kSectionAlignment - 1) / kSectionAlignment * kSectionAlignment);
+    }
+
+    static bool write_padding(FILE * fp, size_type & offset, size_type new_offset) {
+        static const char zeros[kSectionAlignment] = { 0 };
+        assert(new_offset >= offset && (new_offset - offset) <= kSectionAlignment);
+        size_type padding = new_offset - offset;
+        if (padding > 0 && std::fwrite(zeros, 1, padding, fp) != padding)
+            return false;
+        offset = new_offset;
+        return true;
+    }
+
+    static bool write_section(FILE * fp, size_type & offset, const void * data, size_type bytes) {
+        if (bytes > 0 && std::fwrite(data, 1, bytes, fp) != bytes)
+            return false;
+        offset += bytes;
+        return true;
+    }
+
+    template <typename T>
+    static bool is_valid_section(size_type file_size, std::uint64_t offset, std::uint64_t count) {
+        if ((offset % sizeof(T)) != 0 || offset > file_size)
+            return false;
+        return (count <= (file_size - offset) / sizeof(T));
+    }
+
+    size_type get_layer_value(const board_type & board, size_type layer) const {
+        size_type y = this->y_index_[layer];
+        ssize_type cell_y = y * BoardX;
+        if (Bits == 3) {
+            return size_type(CellPack::pack(&board.cells[cell_y], BoardX));
+        }
+        size_type layer_value = 0;
+        for (ssize_type x = BoardX - 1; x >= 0; x--) {
+            layer_value <<= 3;
+            layer_value |= size_type(board.cells[cell_y + x] & kBitMask);
+        }
+        return layer_value;
+    }
+
+    void compose_layer_to_board(board_type & board, size_type layer, std::uint32_t value) const {
+        size_type y = this->y_index_[layer];
+        size_type base_pos = y * BoardX;
+        assert((base_pos + BoardX) <= BoardSize);
+        CellPack::unpack(&board.cells[base_pos], BoardX, value);
+#ifndef NDEBUG
+        for (size_type x = 0; x < BoardX; x++) {
+            std::uint32_t color = board.cells[base_pos + x];
+            assert(color >= Color::First && color < Color::Maximum);
+        }
+#endif
+    }
+
+    size_type find_root(size_type id) const {
+        size_type word = id / 64;
+        std::uint64_t mask = std::uint64_t(1) << (id % 64);
+        std::uint64_t bits = this->root_bits_[word];
+        if ((bits & mask) != 0) {
+            unsigned int count = jstd::BitUtils::popcnt<64>(bits & (mask - 1));
+            return (size_type(this->root_rank_[word]) + count);
+        }
+        return kNotFound;
+    }
+
+    // The index of id in ids[first, last), the ids are sorted.
+    static size_type find_id(const ident_type * ids, size_type first, size_type last, ident_type id) {
+        const ident_type * pos = std::lower_bound(ids + first, ids + last, id);
+        if (pos != (ids + last) && *pos == id)
+            return size_type(pos - ids);
+        else
+            return kNotFound;
+    }
+
+    void build_root_index() {
+        this->root_bits_store_.assign(kRootWords, 0);
+        this->root_rank_store_.assign(kRootWords, 0);
+        const std::vector<ident_type> & ids = this->id_store_[0];
+        for (size_type i = 0; i < ids.size(); i++) {
+            size_type id = ids[i];
+            this->root_bits_store_[id / 64] |= std::uint64_t(1) << (id % 64);
+        }
+        std::uint32_t rank = 0;
+        for (size_type word = 0; word < kRootWords; word++) {
+            this->root_rank_store_[word] = rank;
+            rank += jstd::BitUtils::popcnt<64>(this->root_bits_store_[word]);
+        }
+    }
+
+public:
+    FrozenSparseBitset() {
+        this->init();
+    }
+
+    explicit FrozenSparseBitset(const sparse_bitset_type & bitset) {
+        this->init();
+        this->freeze(bitset);
+    }
+
+    FrozenSparseBitset(const FrozenSparseBitset & src) = delete;
+    FrozenSparseBitset & operator = (const FrozenSparseBitset & rhs) = delete;
+
+    ~FrozenSparseBitset() {
+        this->clear();
+    }
+
+    size_type size() const {
+        return this->id_counts_[BoardY - 1];
+    }
+
+    // The arrays are used in place from a mapped file
+    bool is_mapped() const {
+        return this->file_.is_open();
+    }
+
+    bool empty() const {
+        return (this->size() == 0);
+    }
+
+    void clear() {
+        this->reset_views();
+        for (size_type layer = 0; layer < BoardY; layer++) {
+            std::vector<ident_type>().swap(this->id_store_[layer]);
+            std::vector<std::uint32_t>().swap(this->offset_store_[layer]);
+        }
+        std::vector<std::uint64_t>().swap(this->root_bits_store_);
+        std::vector<std::uint32_t>().swap(this->root_rank_store_);
+        this->file_.close();
+    }
+
+    void swap(this_type & other) {
+        if (&other != this) {
+            for (size_type layer = 0; layer < BoardY; layer++) {
+                std::swap(this->ids_[layer], other.ids_[layer]);
+                std::swap(this->offsets_[layer], other.offsets_[layer]);
+                std::swap(this->id_counts_[layer], other.id_counts_[layer]);
+                this->id_store_[layer].swap(other.id_store_[layer]);
+                this->offset_store_[layer].swap(other.offset_store_[layer]);
+            }
+            std::swap(this->root_bits_, other.root_bits_);
+            std::swap(this->root_rank_, other.root_rank_);
+            this->root_bits_store_.swap(other.root_bits_store_);
+            this->root_rank_store_.swap(other.root_rank_store_);
+            this->file_.swap(other.file_);
+        }
+    }
+
+    //
+    // Copy all of the boards in bitset, bitset is not changed.
+    //
+    void freeze(const sparse_bitset_type & bitset) {
+        this->clear();
+        this->freeze_trie(bitset, [](const IContainer * leaf, size_type index) {
+            (void)leaf;
+            (void)index;
+        });
+    }
+
+    int save(const char * filename, const Source & source = Source()) const {
+        return this->save_file(filename, source, nullptr, 0);
+    }
+
+    //
+    // Map a file written by save() from the same source, nothing is copied or decoded.
+    //
+    int open(const char * filename, const Source & source = Source()) {
+        const void * values = nullptr;
+        return this->open_file(filename, source, 0, values);
+    }
+
+protected:
+    //
+    // Copy the layers of a SparseBitset or a SparseHashMap. The entries of the
+    // leaf layer are passed to visit(leaf, index) in their frozen order.
+    //
+    template <typename Trie, typename LeafVisitor>
+    void freeze_trie(const Trie & trie, LeafVisitor && visit) {
+        typedef typename Trie::IContainer trie_container;
+
+        const trie_container * root = trie.root();
+        if (root == nullptr || root->size() == 0) {
+            this->build_root_index();
+            this->attach_store();
+            return;
+        }
+
+        std::vector<const trie_container *> nodes, next_nodes;
+        std::vector<std::pair<ident_type, size_type>> entries;
+        nodes.push_back(root);
+
+        for (size_type layer = 0; layer < BoardY; layer++) {
+            size_type total = 0;
+            for (size_type n = 0; n < nodes.size(); n++) {
+                total += nodes[n]->size();
+            }
+
+            std::vector<ident_type> & ids = this->id_store_[layer];
+            std::vector<std::uint32_t> & offsets = this->offset_store_[layer];
+            ids.reserve(total);
+            offsets.reserve(nodes.size() + 1);
+            next_nodes.clear();
+            if (layer < BoardY - 1)
+                next_nodes.reserve(total);
+
+            for (size_type n = 0; n < nodes.size(); n++) {
+                const trie_container * container = nodes[n];
+                offsets.push_back(static_cast<std::uint32_t>(ids.size()));
+
+                entries.clear();
+                for (size_type i = container->begin(); i < container->end(); container->next(i)) {
+                    int id = container->getId(i);
+                    if (id == -1)
+                        continue;
+                    entries.push_back(std::make_pair(ident_type(id), i));
+                }
+                std::sort(entries.begin(), entries.end());
+
+                for (size_type i = 0; i < entries.size(); i++) {
+                    ids.push_back(entries[i].first);
+                    if (layer < BoardY - 1) {
+                        const trie_container * child = container->getValue(entries[i].second);
+                        assert(child != nullptr);
+                        next_nodes.push_back(child);
+                    }
+                    else {
+                        visit(container, entries[i].second);
+                    }
+                }
+            }
+            offsets.push_back(static_cast<std::uint32_t>(ids.size()));
+
+            nodes.swap(next_nodes);
+        }
+
+        this->build_root_index();
+        this->attach_store();
+        assert(this->size() == trie.size());
+    }
+
+    // values has size() entries of value_size bytes, it's written after the last layer.
+    int save_file(const char * filename, const Source & source,
+                  const void * values, size_type value_size) const {
+        FileHeader header;
+        LayerHeader layers[BoardY];
+
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "MBGTRIE", 8);
+        header.version      = kFileVersion;
+        header.byte_order   = kByteOrderMark;
+        header.header_size  = sizeof(FileHeader);
+        header.board_x      = static_cast<std::uint32_t>(BoardX);
+        header.board_y      = static_cast<std::uint32_t>(BoardY);
+        header.bits         = static_cast<std::uint32_t>(Bits);
+        header.layer_order  = static_cast<std::uint32_t>(Order);
+        header.value_size   = static_cast<std::uint32_t>(value_size);
+        header.size         = this->size();
+        header.source_key   = source.key;
+        header.source_depth = source.depth;
+        header.root_words   = (this->root_bits_ != nullptr) ? kRootWords : 0;
+
+        size_type offset = sizeof(FileHeader) + sizeof(LayerHeader) * BoardY;
+        offset = align_section(offset);
+        header.root_bits_offset = offset;
+        offset += header.root_words * sizeof(std::uint64_t);
+        offset = align_section(offset);
+        header.root_rank_offset = offset;
+        offset += header.root_words * sizeof(std::uint32_t);
+        for (size_type layer = 0; layer < BoardY; layer++) {
+            size_type offset_count = (this->offsets_[layer] != nullptr) ?
+                                     ((layer == 0) ? 1 : this->id_counts_[layer - 1]) + 1 : 0;
+            offset = align_section(offset);
+            layers[layer].ids_offset = offset;
+            layers[layer].id_count = this->id_counts_[layer];
+            offset += this->id_counts_[layer] * sizeof(ident_type);
+            offset = align_section(offset);
+            layers[layer].offsets_offset = offset;
+            layers[layer].offset_count = offset_count;
+            offset += offset_count * sizeof(std::uint32_t);
+        }
+        size_type value_bytes = (values != nullptr) ? this->size() * value_size : 0;
+        offset = align_section(offset);
+        header.values_offset = offset;
+        offset += value_bytes;
+        header.file_size = offset;
+
+        FILE * fp = std::fopen(filename, "wb");
+        if (fp == nullptr)
+            return ErrorCode::FileOpenFailed;
+
+        offset = 0;
+        bool success = write_section(fp, offset, &header, sizeof(header));
+        success = success && write_section(fp, offset, layers, sizeof(layers));
+        success = success && write_padding(fp, offset, header.root_bits_offset);
+        success = success && write_section(fp, offset, this->root_bits_, header.root_words * sizeof(std::uint64_t));
+        success = success && write_padding(fp, offset, header.root_rank_offset);
+        success = success && write_section(fp, offset, this->root_rank_, header.root_words * sizeof(std::uint32_t));
+        for (size_type layer = 0; layer < BoardY; layer++) {
+            success = success && write_padding(fp, offset, layers[layer].ids_offset);
+            success = success && write_section(fp, offset, this->ids_[layer],
+                                               layers[layer].id_count * sizeof(ident_type));
+            success = success && write_padding(fp, offset, layers[layer].offsets_offset);
+            success = success && write_section(fp, offset, this->offsets_[layer],
+                                               layers[layer].offset_count * sizeof(std::uint32_t));
+        }
+        success = success && write_padding(fp, offset, header.values_offset);
+        success = success && write_section(fp, offset, values, value_bytes);
+        assert(!success || offset == header.file_size);
+
+        if (std::fclose(fp) != 0)
+            success = false;
+        return (success ? ErrorCode::Success : ErrorCode::FileWriteFailed);
+    }
+
+    // values points to the values section of the file, it's nullptr if the file is empty.
+    int open_file(const char * filename, const Source & source,
+                  size_type value_size, const void *& values) {
+        this->clear();
+        values = nullptr;
+
+        int status = this->file_.open(filename);
+        if (ErrorCode::isFailure(status))
+            return status;
+
+        status = this->attach_file(source, value_size, values);
+        if (ErrorCode::isFailure(status)) {
+            this->clear();
+            values = nullptr;
+        }
+        return status;
+    }
+
+private:
+    int attach_file(const Source & source, size_type value_size, const void *& values) {
+        const char * data = this->file_.data();
+        size_type file_size = this->file_.size();
+
+        if (file_size < sizeof(FileHeader) + sizeof(LayerHeader) * BoardY)
+            return ErrorCode::FileFormatIsInvalid;
+
+        FileHeader header;
+        LayerHeader layers[BoardY];
+        std::memcpy(&header, data, sizeof(header));
+        std::memcpy(layers, data + sizeof(header), sizeof(layers));
+
+        if (std::memcmp(header.magic, "MBGTRIE", 8) != 0 || header.byte_order != kByteOrderMark ||
+            header.header_size != sizeof(FileHeader) || header.file_size != file_size)
+            return ErrorCode::FileFormatIsInvalid;
+        if (header.version != kFileVersion)
+            return ErrorCode::FileVersionIsMismatched;
+        if (header.board_x != BoardX || header.board_y != BoardY ||
+            header.bits != Bits || header.layer_order != Order || header.value_size != value_size)
+            return ErrorCode::FileLayoutIsMismatched;
+        if (header.source_key != source.key || header.source_depth != source.depth)
+            return ErrorCode::FileSourceIsMismatched;
+
+        if (header.size == 0) {
+            return ErrorCode::Success;
+        }
+
+        if (header.root_words != kRootWords ||
+            !is_valid_section<std::uint64_t>(file_size, header.root_bits_offset, header.root_words) ||
+            !is_valid_section<std::uint32_t>(file_size, header.root_rank_offset, header.root_words))
+            return ErrorCode::FileFormatIsInvalid;
+
+        for (size_type layer = 0; layer < BoardY; layer++) {
+            const LayerHeader & info = layers[layer];
+            std::uint64_t node_count = (layer == 0) ? 1 : layers[layer - 1].id_count;
+            if (info.offset_count != node_count + 1 ||
+                !is_valid_section<ident_type>(file_size, info.ids_offset, info.id_count) ||
+                !is_valid_section<std::uint32_t>(file_size, info.offsets_offset, info.offset_count))
+                return ErrorCode::FileFormatIsInvalid;
+
+            // Every node has one id at least, so the offsets go up strictly
+            const std::uint32_t * offsets = (const std::uint32_t *)(data + info.offsets_offset);
+            if (offsets[0] != 0 || offsets[info.offset_count - 1] != info.id_count)
+                return ErrorCode::FileFormatIsInvalid;
+            for (size_type n = 1; n < info.offset_count; n++) {
+                if (offsets[n] <= offsets[n - 1])
+                    return ErrorCode::FileFormatIsInvalid;
+            }
+
+            this->ids_[layer] = (const ident_type *)(data + info.ids_offset);
+            this->offsets_[layer] = offsets;
+            this->id_counts_[layer] = static_cast<size_type>(info.id_count);
+        }
+        if (layers[BoardY - 1].id_count != header.size)
+            return ErrorCode::FileFormatIsInvalid;
+
+        if (value_size != 0) {
+            if ((header.values_offset % kSectionAlignment) != 0 || header.values_offset > file_size ||
+                header.size > (file_size - header.values_offset) / value_size)
+                return ErrorCode::FileFormatIsInvalid;
+            values = data + header.values_offset;
+        }
+
+        // The rank of a root id must be an index of the root layer
+        const std::uint64_t * root_bits = (const std::uint64_t *)(data + header.root_bits_offset);
+        const std::uint32_t * root_rank = (const std::uint32_t *)(data + header.root_rank_offset);
+        std::uint64_t rank = 0;
+        for (size_type word = 0; word < kRootWords; word++) {
+            if (root_rank[word] != rank)
+                return ErrorCode::FileFormatIsInvalid;
+            rank += jstd::BitUtils::popcnt<64>(root_bits[word]);
+        }
+        if (rank != layers[0].id_count)
+            return ErrorCode::FileFormatIsInvalid;
+
+        this->root_bits_ = root_bits;
+        this->root_rank_ = root_rank;
+        return ErrorCode::Success;
+    }
+
+public:
+
+    // Return the index of the board in the leaf layer, or kNotFound.
+    size_type find_index(const board_type & board) const {
+        if (this->empty())
+            return kNotFound;
+
+        size_type index = this->find_root(this->get_layer_value(board, 0));
+        if (index == kNotFound)
+            return kNotFound;
+
+        for (size_type layer = 1; layer < BoardY; layer++) {
+            const std::uint32_t * offsets = this->offsets_[layer];
+            size_type layer_id = this->get_layer_value(board, layer);
+            index = find_id(this->ids_[layer], offsets[index], offsets[index + 1], ident_type(layer_id));
+            if (index == kNotFound)
+                return kNotFound;
+        }
+        return index;
+    }
+
+    bool contains(const board_type & board) const {
+        return (this->find_index(board) != kNotFound);
+    }
+
+    const_iterator begin() const {
+        return const_iterator(this, false);
+    }
+
+    const_iterator end() const {
+        return const_iterator(this, true);
+    }
+
+    // The bytes of a mapped file are counted too, they are shared with the page cache.
+    size_type memory_usage() const {
+        size_type total_bytes = sizeof(this_type);
+        if (this->is_mapped()) {
+            total_bytes += this->file_.size();
+        }
+        else {
+            for (size_type layer = 0; layer < BoardY; layer++) {
+                total_bytes += this->id_store_[layer].capacity() * sizeof(ident_type);
+                total_bytes += this->offset_store_[layer].capacity() * sizeof(std::uint32_t);
+            }
+            total_bytes += this->root_bits_store_.capacity() * sizeof(std::uint64_t);
+            total_bytes += this->root_rank_store_.capacity() * sizeof(std::uint32_t);
+        }
+        return total_bytes;
+    }
+};
+
+} // namespace AI
+} // namespace MagicBlock
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <utility>          // For std::swap()
+#include <type_traits>
+
+#include "MagicBlock/AI/LayerOrder.h"
+#include "MagicBlock/AI/ErrorCode.h"
+#include "MagicBlock/AI/SparseHashMap.h"
+#include "MagicBlock/AI/FrozenSparseBitset.h"
+
+namespace MagicBlock {
+namespace AI {
+
+//
+// A read-only copy of SparseHashMap<K, V>, made by freeze().
+//
+// The keys are frozen the same way as FrozenSparseBitset, the values are kept
+// in one array in the order of the leaf layer, so the value of a key is found
+// by the index of its leaf. save() writes the array to the values section of
+// the trie file, and open() uses it in place from the mapping.
+//
+template <typename Key, typename Value, std::size_t Bits, std::size_t Length,
+          std::size_t Order = LayerOrder::Interleaved>
+class FrozenSparseHashMap : public FrozenSparseBitset<Key, Bits, Length, Order> {
+public:
+    typedef FrozenSparseBitset<Key, Bits, Length, Order>            base_type;
+    typedef FrozenSparseHashMap<Key, Value, Bits, Length, Order>    this_type;
+    typedef SparseHashMap<Key, Value, Bits, Length, Order>          sparse_hashmap_type;
+    typedef typename sparse_hashmap_type::IContainer                IContainer;
+    typedef typename sparse_hashmap_type::LeafContainer             LeafContainer;
+
+    typedef typename base_type::size_type       size_type;
+    typedef typename base_type::Source          Source;
+    typedef typename base_type::const_iterator  const_iterator;
+    typedef typename base_type::iterator        iterator;
+
+    typedef Key                 key_type;
+    typedef Value               value_type;
+
+    static_assert(std::is_trivially_copyable<Value>::value,
+                  "FrozenSparseHashMap<K, V>: V must be trivially copyable.");
+
+private:
+    // The view of the values, it points to value_store_ or to the mapped file.
+    const value_type *          values_;
+    std::vector<value_type>     value_store_;
+
+public:
+    FrozenSparseHashMap() : base_type(), values_(nullptr) {
+    }
+
+    explicit FrozenSparseHashMap(const sparse_hashmap_type & hashmap) : base_type(), values_(nullptr) {
+        this->freeze(hashmap);
+    }
+
+    FrozenSparseHashMap(const FrozenSparseHashMap & src) = delete;
+    FrozenSparseHashMap & operator = (const FrozenSparseHashMap & rhs) = delete;
+
+    ~FrozenSparseHashMap() {
+        this->clear();
+    }
+
+    void clear() {
+        this->values_ = nullptr;
+        std::vector<value_type>().swap(this->value_store_);
+        base_type::clear();
+    }
+
+    void swap(this_type & other) {
+        if (&other != this) {
+            base_type::swap(other);
+            std::swap(this->values_, other.values_);
+            this->value_store_.swap(other.value_store_);
+        }
+    }
+
+    //
+    // Copy all of the keys and values in hashmap, hashmap is not changed.
+    //
+    void freeze(const sparse_hashmap_type & hashmap) {
+        this->clear();
+        this->value_store_.reserve(hashmap.size());
+        this->freeze_trie(hashmap, [this](const IContainer * leaf, size_type index) {
+            const value_type * value = static_cast<const LeafContainer *>(leaf)->getData(index);
+            assert(value != nullptr);
+            this->value_store_.push_back(*value);
+        });
+        this->values_ = this->value_store_.data();
+        assert(this->value_store_.size() == this->size());
+    }
+
+    int save(const char * filename, const Source & source = Source()) const {
+        return this->save_file(filename, source, this->values_, sizeof(value_type));
+    }
+
+    //
+    // Map a file written by save() from the same source, the value size must be the same.
+    //
+    int open(const char * filename, const Source & source = Source()) {
+        this->clear();
+        const void * values = nullptr;
+        int status = this->open_file(filename, source, sizeof(value_type), values);
+        if (ErrorCode::isSuccess(status)) {
+            this->values_ = static_cast<const value_type *>(values);
+        }
+        return status;
+    }
+
+    // Return the value of the key, or nullptr if the key does not exist.
+    const value_type * find(const key_type & key) const {
+        size_type index = this->find_index(key);
+        return ((index != base_type::kNotFound) ? &this->values_[index] : nullptr);
+    }
+
+    const value_type & value(const const_iterator & iter) const {
+        assert(iter.rank() < this->size());
+        return this->values_[iter.rank()];
+    }
+
+    size_type memory_usage() const {
+        size_type total_bytes = base_type::memory_usage() + sizeof(this_type) - sizeof(base_type);
+        if (!this->is_mapped()) {
+            total_bytes += this->value_store_.capacity() * sizeof(value_type);
+        }
+        return total_bytes;
+    }
+};
+
+} // namespace AI
+} // namespace MagicBlock
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>      // For std::memset()
+
+#include "MagicBlock/AI/Config.h"
+
+#if MBG_USE_SSE2 || MBG_USE_AVX2
+#include <emmintrin.h>  // For SSE2
+#endif
+
+#include "MagicBlock/AI/Constant.h"
+#include "MagicBlock/AI/Color.h"
+#include "MagicBlock/AI/Board.h"
+
+namespace MagicBlock {
+namespace AI {
+
+//
+// The number of mismatched cells in some regions of the targets, one slot per
+// (target, region), e.g. the 4 sides of the 4 rotated targets of phase 1.
+//
+// A slide moves one color into the empty cell and leaves the empty cell behind,
+// so a child updates the counts of its parent with two table rows instead of
+// scanning the regions again. A region is matched when its count is zero, only
+// then the full goal test (the color counts and so on) needs to run.
+//
+template <std::size_t BoardX, std::size_t BoardY,
+          std::size_t TargetX, std::size_t TargetY>
+class GoalCounter {
+public:
+    typedef std::size_t         size_type;
+    typedef std::ptrdiff_t      ssize_type;
+
+    static const size_type BoardSize = BoardX * BoardY;
+    static const size_type kMaxSlots = MAX_ROTATE_TYPE * MAX_PHASE1_TYPE;
+
+    static const ptrdiff_t kStartX = (BoardX - TargetX) / 2;
+    static const ptrdiff_t kStartY = (BoardY - TargetY) / 2;
+
+    // The goal summary of a stage
+    struct Summary {
+        std::uint8_t mismatches[kMaxSlots];
+    };
+
+private:
+    // The target color of each slot at each board cell, Color::Maximum if it's not in the region.
+    std::uint8_t    targets_[BoardSize][kMaxSlots];
+
+    //
+    // deltas_[pos][color][slot]: the change of the count of slot when color is moved
+    // into the empty cell at pos, it's negated for the cell left empty.
+    //
+    std::int8_t     deltas_[BoardSize][Color::Maximum][kMaxSlots];
+
+    size_type       slots_;
+
+    static int is_mismatch(std::uint8_t target, size_type color) {
+        return ((target != Color::Maximum && target != color) ? 1 : 0);
+    }
+
+    void update_deltas(size_type slot) {
+        for (size_type pos = 0; pos < BoardSize; pos++) {
+            std::uint8_t target = this->targets_[pos][slot];
+            for (size_type color = 0; color < Color::Maximum; color++) {
+                this->deltas_[pos][color][slot] =
+                    std::int8_t(is_mismatch(target, color) - is_mismatch(target, Color::Empty));
+            }
+        }
+    }
+
+public:
+    GoalCounter() {
+        this->clear();
+    }
+
+    ~GoalCounter() {}
+
+    size_type slots() const { return this->slots_; }
+
+    void clear() {
+        std::memset((void *)this->targets_, Color::Maximum, sizeof(this->targets_));
+        std::memset((void *)this->deltas_, 0, sizeof(this->deltas_));
+        this->slots_ = 0;
+    }
+
+    //
+    // Add the region [firstTargetX, lastTargetX) x [firstTargetY, lastTargetY) of target,
+    // return its slot.
+    //
+    size_type add_region(const Board<TargetX, TargetY> & target,
+                         size_type firstTargetX, size_type lastTargetX,
+                         size_type firstTargetY, size_type lastTargetY) {
+        assert(this->slots_ < kMaxSlots);
+        size_type slot = this->slots_++;
+        for (size_type y = firstTargetY; y < lastTargetY; y++) {
+            for (size_type x = firstTargetX; x < lastTargetX; x++) {
+                size_type pos = (kStartY + y) * BoardX + (kStartX + x);
+                this->targets_[pos][slot] = target.cells[y * TargetX + x];
+            }
+        }
+        this->update_deltas(slot);
+        return slot;
+    }
+
+    void count(const Board<BoardX, BoardY> & board, Summary & summary) const {
+        for (size_type slot = 0; slot < kMaxSlots; slot++) {
+            int mismatches = 0;
+            for (size_type pos = 0; pos < BoardSize; pos++) {
+                mismatches += is_mismatch(this->targets_[pos][slot], board.cells[pos]);
+            }
+            summary.mismatches[slot] = std::uint8_t(mismatches);
+        }
+    }
+
+    // The color at move_pos is moved into the empty cell at empty_pos.
+    void move(Summary & summary, size_type empty_pos, size_type move_pos, size_type color) const {
+        assert(empty_pos < BoardSize && move_pos < BoardSize);
+        assert(color < Color::Maximum);
+        const std::int8_t * fill  = this->deltas_[empty_pos][color];
+        const std::int8_t * leave = this->deltas_[move_pos][color];
+#if MBG_USE_SSE2 || MBG_USE_AVX2
+        __m128i counts = _mm_loadu_si128((const __m128i *)summary.mismatches);
+        counts = _mm_add_epi8(counts, _mm_loadu_si128((const __m128i *)fill));
+        counts = _mm_sub_epi8(counts, _mm_loadu_si128((const __m128i *)leave));
+        _mm_storeu_si128((__m128i *)summary.mismatches, counts);
+#else
+        for (size_type slot = 0; slot < kMaxSlots; slot++) {
+            summary.mismatches[slot] = std::uint8_t(summary.mismatches[slot] + fill[slot] - leave[slot]);
+        }
+#endif
+    }
+
+    // Bit k is set when slot k has no mismatched cell.
+    std::uint32_t matched_mask(const Summary & summary) const {
+        std::uint32_t mask;
+#if MBG_USE_SSE2 || MBG_USE_AVX2
+        __m128i counts = _mm_loadu_si128((const __m128i *)summary.mismatches);
+        mask = (std::uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(counts, _mm_setzero_si128()));
+#else
+        mask = 0;
+        for (size_type slot = 0; slot < kMaxSlots; slot++) {
+            if (summary.mismatches[slot] == 0)
+                mask |= std::uint32_t(1) << slot;
+        }
+#endif
+        return (mask & ((std::uint32_t(1) << this->slots_) - 1));
+    }
+};
+
+} // namespace AI
+} // namespace MagicBlock
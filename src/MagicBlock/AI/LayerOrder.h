@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+
+namespace MagicBlock {
+namespace AI {
+
+//
+// The order of the board rows used as the trie layers of
+// SparseBitset<T> and SparseHashMap<K, V>.
+//
+struct LayerOrder {
+    enum {
+        // 0, 1, 2, 3, 4
+        Natural,
+        // The top and bottom rows alternately: 0, 4, 1, 3, 2
+        Interleaved,
+        // The center rows first, where the target of magic block is: 2, 1, 3, 0, 4
+        CenterFirst,
+        Last
+    };
+
+    template <std::size_t Order, std::size_t Rows>
+    static void make_index(std::size_t (&y_index)[Rows]) {
+        static_assert((Order < Last), "LayerOrder::make_index(): Unknown Order.");
+
+        if (Order == Natural) {
+            for (std::size_t yi = 0; yi < Rows; yi++) {
+                y_index[yi] = yi;
+            }
+        }
+        else if (Order == Interleaved) {
+            std::size_t top = 0, bottom = Rows - 1;
+            for (std::size_t yi = 0; yi < (Rows / 2); yi++) {
+                y_index[yi * 2 + 0] = top++;
+                y_index[yi * 2 + 1] = bottom--;
+            }
+            if ((Rows % 2) != 0) {
+                y_index[Rows - 1] = top;
+            }
+        }
+        else {
+            // CenterFirst
+            std::size_t top = Rows / 2 - 1, bottom = Rows / 2;
+            std::size_t yi = 0;
+            if ((Rows % 2) != 0) {
+                y_index[yi++] = bottom++;
+            }
+            for (std::size_t i = 0; i < (Rows / 2); i++) {
+                y_index[yi++] = top--;
+                y_index[yi++] = bottom++;
+            }
+        }
+    }
+
+    static const char * toString(std::size_t order) {
+        switch (order) {
+        case Natural:
+            return "Natural";
+        case Interleaved:
+            return "Interleaved";
+        case CenterFirst:
+            return "CenterFirst";
+        default:
+            return "Unknown";
+        }
+    }
+};
+
+} // namespace AI
+} // namespace MagicBlock
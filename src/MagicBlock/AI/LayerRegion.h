@@ -0,0 +1,193 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <new>          // For std::bad_alloc
+#include <vector>
+#include <type_traits>  // For std::true_type
+
+namespace MagicBlock {
+namespace AI {
+
+//
+// A region (bump) allocator for the memory of one BFS depth.
+//
+// The allocations are carved from large chunks and never freed one by one,
+// reset() drops all of them at once and keeps the chunks for the next depth.
+// A chunk that is too small for a request of the new depth is released when
+// it is skipped, so the region follows the growth of the frontier.
+//
+class LayerRegion {
+public:
+    typedef std::size_t     size_type;
+
+    static const size_type kChunkSize = size_type(16) * 1024 * 1024;
+    static const size_type kAlignment = 64;
+
+private:
+    struct Chunk {
+        char *      data;
+        size_type   size;
+        size_type   used;
+    };
+
+    std::vector<Chunk>  chunks_;
+    size_type           current_;
+    size_type           used_bytes_;
+    size_type           capacity_;
+
+    static size_type align_up(size_type size, size_type alignment) {
+        return ((size + alignment - 1) & ~(alignment - 1));
+    }
+
+    void add_chunk(size_type size) {
+        Chunk chunk;
+        chunk.size = align_up(size, kChunkSize);
+        chunk.data = (char *)std::malloc(chunk.size);
+        if (chunk.data == nullptr) {
+            throw std::bad_alloc();
+        }
+        chunk.used = 0;
+        this->chunks_.push_back(chunk);
+        this->capacity_ += chunk.size;
+    }
+
+    void free_chunk(size_type index) {
+        assert(index < this->chunks_.size());
+        this->capacity_ -= this->chunks_[index].size;
+        std::free(this->chunks_[index].data);
+        this->chunks_.erase(this->chunks_.begin() + index);
+    }
+
+public:
+    LayerRegion() : current_(0), used_bytes_(0), capacity_(0) {}
+
+    ~LayerRegion() {
+        this->release();
+    }
+
+    size_type used_bytes() const {
+        return this->used_bytes_;
+    }
+
+    size_type capacity() const {
+        return this->capacity_;
+    }
+
+    size_type chunk_count() const {
+        return this->chunks_.size();
+    }
+
+    void * allocate(size_type size, size_type alignment = kAlignment) {
+        assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+        while (this->current_ < this->chunks_.size()) {
+            Chunk & chunk = this->chunks_[this->current_];
+            size_type offset = align_up(chunk.used, alignment);
+            if ((offset + size) <= chunk.size) {
+                chunk.used = offset + size;
+                this->used_bytes_ += size;
+                return (void *)(chunk.data + offset);
+            }
+            if (chunk.used == 0) {
+                // An unused chunk of the last depth is too small
+                this->free_chunk(this->current_);
+            }
+            else {
+                this->current_++;
+            }
+        }
+
+        this->add_chunk(size);
+        Chunk & chunk = this->chunks_.back();
+        chunk.used = size;
+        this->used_bytes_ += size;
+        return (void *)chunk.data;
+    }
+
+    // Drop all the allocations, keep the chunks.
+    void reset() {
+        for (size_type i = 0; i < this->chunks_.size(); i++) {
+            this->chunks_[i].used = 0;
+        }
+        this->current_ = 0;
+        this->used_bytes_ = 0;
+    }
+
+    // Drop all the allocations and the chunks.
+    void release() {
+        for (size_type i = 0; i < this->chunks_.size(); i++) {
+            std::free(this->chunks_[i].data);
+        }
+        this->chunks_.clear();
+        this->current_ = 0;
+        this->used_bytes_ = 0;
+        this->capacity_ = 0;
+    }
+};
+
+//
+// The STL allocator of a LayerRegion, deallocate() does nothing, the memory
+// comes back when the region is reset.
+//
+template <typename T>
+class RegionAllocator {
+public:
+    typedef T               value_type;
+    typedef std::size_t     size_type;
+    typedef std::ptrdiff_t  difference_type;
+
+    typedef std::true_type  propagate_on_container_copy_assignment;
+    typedef std::true_type  propagate_on_container_move_assignment;
+    typedef std::true_type  propagate_on_container_swap;
+
+    template <typename U>
+    struct rebind {
+        typedef RegionAllocator<U> other;
+    };
+
+private:
+    template <typename U> friend class RegionAllocator;
+
+    LayerRegion * region_;
+
+public:
+    RegionAllocator() noexcept : region_(nullptr) {}
+    explicit RegionAllocator(LayerRegion * region) noexcept : region_(region) {}
+
+    template <typename U>
+    RegionAllocator(const RegionAllocator<U> & src) noexcept : region_(src.region_) {}
+
+    LayerRegion * region() const {
+        return this->region_;
+    }
+
+    T * allocate(size_type n) {
+        assert(this->region_ != nullptr);
+        size_type alignment = (alignof(T) > sizeof(void *)) ? alignof(T) : sizeof(void *);
+        return (T *)this->region_->allocate(n * sizeof(T), alignment);
+    }
+
+    void deallocate(T * ptr, size_type n) noexcept {
+        (void)ptr;
+        (void)n;
+    }
+
+    template <typename U>
+    bool operator == (const RegionAllocator<U> & rhs) const noexcept {
+        return (this->region_ == rhs.region_);
+    }
+
+    template <typename U>
+    bool operator != (const RegionAllocator<U> & rhs) const noexcept {
+        return (this->region_ != rhs.region_);
+    }
+};
+
+} // namespace AI
+} // namespace MagicBlock
@@ -15,8 +15,7 @@
 #define __AVX2__
 #endif
 
-#define MBG_USE_SSE2    1
-#define MBG_USE_AVX2    1
+#include "MagicBlock/AI/Config.h"
 
 #define DISABLE_CPU_WARM_UP
 
@@ -26,6 +25,9 @@
 #include <cstdio>
 #include <iostream>
 #include <cstring>
+#include <memory>
+#include <vector>
+#include <thread>
 
 #include "MagicBlock/AI/ErrorCode.h"
 #include "MagicBlock/AI/SlidingPuzzle/SlidingPuzzle.h"
@@ -35,6 +37,8 @@
 #include "MagicBlock/AI/TwoPhase_v1/Game.h"
 #include "MagicBlock/AI/TwoPhase_ida/IDAGame.h"
 #include "MagicBlock/AI/TwoEndpoint/Game.h"
+#include "MagicBlock/AI/FrozenSparseBitset.h"
+#include "MagicBlock/AI/ConcurrentSparseBitset.h"
 #include "MagicBlock/AI/Algorithm.h"
 #include "MagicBlock/AI/UnitTest.h"
 
@@ -291,15 +295,18 @@ void solve_sliding_unknown_puzzle_5x5()
     printf("Total elapsed time: %0.3f ms\n\n", elapsed_time);
 }
 
-template <std::size_t N_SolverId, bool AllowRotate = true>
+template <std::size_t N_SolverId, bool AllowRotate = true, bool UsePackedBoard = false>
 void solve_sliding_color_puzzle()
 {
     printf("-------------------------------------------------------\n\n");
-    printf("solve_sliding_color_puzzle<%s, AllowRotate = %s>()\n\n",
+    printf("solve_sliding_color_puzzle<%s, AllowRotate = %s, UsePackedBoard = %s>()\n\n",
             get_solver_name<N_SolverId>(),
-            (AllowRotate ? "true" : "false"));
+            (AllowRotate ? "true" : "false"),
+            (UsePackedBoard ? "true" : "false"));
+
+    typedef typename std::conditional<UsePackedBoard, PackedBoard<3, 3>, Board<3, 3>>::type board_type;
 
-    SlidingColorPuzzle<3, 3, AllowRotate> slidingPuzzle;
+    SlidingColorPuzzle<3, 3, AllowRotate, board_type> slidingPuzzle;
     int readStatus = slidingPuzzle.readConfig(PUZZLES_PATH("sliding_color_puzzle.txt"));
     if (ErrorCode::isFailure(readStatus)) {
         printf("readStatus = %d (Error: %s)\n\n", readStatus, ErrorCode::toString(readStatus));
@@ -508,6 +515,600 @@ void solve_magic_block()
     }
 }
 
+//
+// The 6x6 and 7x7 boards with a 4x4 target, the boards are keyed by PackedKey
+// when they don't fit in Value128, and the trie rows use 32-bit ids.
+//
+template <std::size_t BoardN>
+void solve_magic_block_large(const char * filename, std::size_t max_depth)
+{
+    printf("-------------------------------------------------------\n\n");
+    printf("solve_magic_block_large<%u x %u>(\"%s\")\n\n",
+           (uint32_t)BoardN, (uint32_t)BoardN, filename);
+
+    TwoEndpoint::Game<BoardN, BoardN, 4, 4, false> game;
+
+    int readStatus = game.readConfig(filename);
+    if (ErrorCode::isFailure(readStatus)) {
+        printf("readStatus = %d (Error: %s)\n\n", readStatus, ErrorCode::toString(readStatus));
+        return;
+    }
+
+    jtest::StopWatch sw;
+
+    sw.start();
+    bool solvable = game.bitset_solve(max_depth, max_depth);
+    sw.stop();
+    double elapsed_time = sw.getElapsedMillisec();
+
+    if (solvable) {
+        printf("Found a answer!\n\n");
+        printf("MinSteps: %d\n\n", (int)game.getMinSteps());
+        printf("Map Used: %d\n\n", (int)game.getMapUsed());
+    }
+    else {
+        printf("Not found a answer!\n\n");
+    }
+
+    printf("Total elapsed time: %0.3f ms\n\n", elapsed_time);
+}
+
+template <typename BitsetType>
+double sparse_bitset_insert_boards(BitsetType & bitset,
+                                   const std::vector<typename BitsetType::board_type> & boards)
+{
+    jtest::StopWatch sw;
+
+    sw.start();
+    for (std::size_t i = 0; i < boards.size(); i++) {
+        bitset.try_insert(boards[i]);
+    }
+    sw.stop();
+
+    return sw.getElapsedMillisec();
+}
+
+void sparse_bitset_policy_benchmark(const char * filename, std::size_t max_depth)
+{
+    typedef TwoEndpoint::Game<5, 5, 3, 3, false>    game_type;
+    typedef game_type::TForwardSolver              solver_type;
+    typedef solver_type::bitset_type               bitset_type;
+    typedef bitset_type::board_type                board_type;
+    typedef bitset_type::LayerPolicy               LayerPolicy;
+
+    printf("-------------------------------------------------------\n\n");
+    printf("sparse_bitset_policy_benchmark(\"%s\", depth = %u)\n\n",
+           filename, (std::uint32_t)max_depth);
+
+    game_type game;
+    int readStatus = game.readConfig(filename);
+    if (ErrorCode::isFailure(readStatus)) {
+        printf("readStatus = %d (Error: %s)\n\n", readStatus, ErrorCode::toString(readStatus));
+        return;
+    }
+
+    // Collect the visited boards of a forward search
+    std::vector<board_type> boards;
+    {
+        solver_type forward_solver(&game.data());
+        for (std::size_t depth = 0; depth < max_depth; depth++) {
+            int status = forward_solver.bitset_solve(depth, max_depth);
+            if (status != 0)
+                break;
+            forward_solver.clear_prev_depth();
+        }
+        const bitset_type & visited = forward_solver.visited();
+        boards.reserve(visited.size());
+        for (auto iter = visited.begin(); iter != visited.end(); ++iter) {
+            boards.push_back(*iter);
+        }
+    }
+
+    LayerPolicy policy[5];
+
+    bitset_type default_bitset;
+    double default_time = sparse_bitset_insert_boards(default_bitset, boards);
+
+    default_bitset.autotune_layer_policy();
+    default_bitset.get_layer_policy(policy);
+
+    bitset_type tuned_bitset;
+    tuned_bitset.set_layer_policy(policy);
+    double tuned_time = sparse_bitset_insert_boards(tuned_bitset, boards);
+
+    for (std::size_t layer = 0; layer < 5; layer++) {
+        printf("layer %u: initCapacity = %5u, bitmapThreshold = %5u, growthRate = %3u\n",
+               (std::uint32_t)layer, policy[layer].initCapacity,
+               policy[layer].bitmapThreshold, policy[layer].growthRate);
+    }
+    printf("\n");
+
+    printf("default policy: size = %u, memory = %0.3f MB, time = %0.3f ms\n",
+           (std::uint32_t)default_bitset.size(),
+           default_bitset.memory_usage() / (1024.0 * 1024.0), default_time);
+    printf("tuned policy:   size = %u, memory = %0.3f MB, time = %0.3f ms\n\n",
+           (std::uint32_t)tuned_bitset.size(),
+           tuned_bitset.memory_usage() / (1024.0 * 1024.0), tuned_time);
+}
+
+template <std::size_t Order, typename GameType, typename BoardType>
+void sparse_trie_join_with_order(GameType & game,
+                                 const std::vector<BoardType> & fw_boards,
+                                 const std::vector<BoardType> & bw_boards)
+{
+    typedef SparseBitset<BoardType, 3, BoardType::BoardSize, Order> bitset_type;
+    typedef typename bitset_type::LayerInfo                         LayerInfo;
+
+    bitset_type fw_visited, bw_visited;
+    for (std::size_t i = 0; i < fw_boards.size(); i++) {
+        fw_visited.try_insert(fw_boards[i]);
+    }
+    for (std::size_t i = 0; i < bw_boards.size(); i++) {
+        bw_visited.try_insert(bw_boards[i]);
+    }
+
+    LayerInfo fw_info[bitset_type::BoardY], bw_info[bitset_type::BoardY];
+    fw_visited.collect_layer_info(fw_info);
+    bw_visited.collect_layer_info(bw_info);
+
+    std::size_t fw_nodes = 0, bw_nodes = 0;
+    for (std::size_t layer = 0; layer < bitset_type::BoardY; layer++) {
+        fw_nodes += fw_info[layer].childCount;
+        bw_nodes += bw_info[layer].childCount;
+    }
+
+    jtest::StopWatch sw;
+
+    sw.start();
+    int total = game.find_trie_intersection(fw_visited, bw_visited);
+    sw.stop();
+
+    printf("%-12s fw_nodes = %8u, bw_nodes = %8u, answers = %d, join time = %0.3f ms\n",
+           LayerOrder::toString(Order), (std::uint32_t)fw_nodes, (std::uint32_t)bw_nodes,
+           total, sw.getElapsedMillisec());
+}
+
+void sparse_trie_layer_order_benchmark(const char * filename,
+                                       std::size_t forward_depth, std::size_t backward_depth)
+{
+    typedef TwoEndpoint::Game<5, 5, 3, 3, false>    game_type;
+    typedef game_type::TForwardSolver              fw_solver_type;
+    typedef game_type::TBackwardSolver             bw_solver_type;
+    typedef game_type::board_type                  board_type;
+
+    printf("-------------------------------------------------------\n\n");
+    printf("sparse_trie_layer_order_benchmark(\"%s\", fw_depth = %u, bw_depth = %u)\n\n",
+           filename, (std::uint32_t)forward_depth, (std::uint32_t)backward_depth);
+
+    game_type game;
+    int readStatus = game.readConfig(filename);
+    if (ErrorCode::isFailure(readStatus)) {
+        printf("readStatus = %d (Error: %s)\n\n", readStatus, ErrorCode::toString(readStatus));
+        return;
+    }
+
+    // Collect the visited boards of both endpoints
+    std::vector<board_type> fw_boards, bw_boards;
+    {
+        fw_solver_type forward_solver(&game.data());
+        for (std::size_t depth = 0; depth < forward_depth; depth++) {
+            if (forward_solver.bitset_solve(depth, forward_depth) != 0)
+                break;
+            forward_solver.clear_prev_depth();
+        }
+        fw_boards.assign(forward_solver.visited().begin(), forward_solver.visited().end());
+
+        bw_solver_type backward_solver(&game.data());
+        for (std::size_t depth = 0; depth < backward_depth; depth++) {
+            if (backward_solver.bitset_solve(depth, backward_depth) != 0)
+                break;
+            backward_solver.clear_prev_depth();
+        }
+        bw_boards.assign(backward_solver.visited().begin(), backward_solver.visited().end());
+    }
+
+    sparse_trie_join_with_order<LayerOrder::Natural>(game, fw_boards, bw_boards);
+    sparse_trie_join_with_order<LayerOrder::Interleaved>(game, fw_boards, bw_boards);
+    sparse_trie_join_with_order<LayerOrder::CenterFirst>(game, fw_boards, bw_boards);
+    printf("\n");
+}
+
+void sparse_bitset_freeze_benchmark(const char * filename, std::size_t max_depth)
+{
+    typedef TwoEndpoint::Game<5, 5, 3, 3, false>    game_type;
+    typedef game_type::TForwardSolver              solver_type;
+    typedef solver_type::bitset_type               bitset_type;
+    typedef bitset_type::board_type                board_type;
+    typedef FrozenSparseBitset<board_type, 3, board_type::BoardSize,
+                               bitset_type::kLayerOrder>   frozen_bitset_type;
+
+    printf("-------------------------------------------------------\n\n");
+    printf("sparse_bitset_freeze_benchmark(\"%s\", depth = %u)\n\n",
+           filename, (std::uint32_t)max_depth);
+
+    game_type game;
+    int readStatus = game.readConfig(filename);
+    if (ErrorCode::isFailure(readStatus)) {
+        printf("readStatus = %d (Error: %s)\n\n", readStatus, ErrorCode::toString(readStatus));
+        return;
+    }
+
+    solver_type forward_solver(&game.data());
+    for (std::size_t depth = 0; depth < max_depth; depth++) {
+        if (forward_solver.bitset_solve(depth, max_depth) != 0)
+            break;
+        forward_solver.clear_prev_depth();
+    }
+    const bitset_type & visited = forward_solver.visited();
+
+    std::vector<board_type> boards(visited.begin(), visited.end());
+
+    jtest::StopWatch sw;
+
+    sw.start();
+    frozen_bitset_type frozen(visited);
+    sw.stop();
+    double freeze_time = sw.getElapsedMillisec();
+
+    std::size_t found = 0;
+    sw.start();
+    for (std::size_t i = 0; i < boards.size(); i++) {
+        found += visited.contains(boards[i]) ? 1 : 0;
+    }
+    sw.stop();
+    double bitset_time = sw.getElapsedMillisec();
+
+    std::size_t frozen_found = 0;
+    sw.start();
+    for (std::size_t i = 0; i < boards.size(); i++) {
+        frozen_found += frozen.contains(boards[i]) ? 1 : 0;
+    }
+    sw.stop();
+    double frozen_time = sw.getElapsedMillisec();
+
+    const char * trie_file = "sparse_bitset_freeze_benchmark.trie";
+    sw.start();
+    int saveStatus = frozen.save(trie_file);
+    sw.stop();
+    double save_time = sw.getElapsedMillisec();
+
+    frozen_bitset_type mapped;
+    sw.start();
+    int openStatus = mapped.open(trie_file);
+    sw.stop();
+    double open_time = sw.getElapsedMillisec();
+
+    std::size_t mapped_found = 0;
+    sw.start();
+    for (std::size_t i = 0; i < boards.size(); i++) {
+        mapped_found += mapped.contains(boards[i]) ? 1 : 0;
+    }
+    sw.stop();
+    double mapped_time = sw.getElapsedMillisec();
+
+    printf("freeze time = %0.3f ms, save time = %0.3f ms (%s), open time = %0.3f ms (%s)\n\n",
+           freeze_time, save_time, ErrorCode::toString(saveStatus),
+           open_time, ErrorCode::toString(openStatus));
+    printf("SparseBitset:       size = %u, found = %u, memory = %0.3f MB, contains time = %0.3f ms\n",
+           (std::uint32_t)visited.size(), (std::uint32_t)found,
+           visited.memory_usage() / (1024.0 * 1024.0), bitset_time);
+    printf("FrozenSparseBitset: size = %u, found = %u, memory = %0.3f MB, contains time = %0.3f ms\n\n",
+           (std::uint32_t)frozen.size(), (std::uint32_t)frozen_found,
+           frozen.memory_usage() / (1024.0 * 1024.0), frozen_time);
+    printf("Mapped file:        size = %u, found = %u, file size = %0.3f MB, contains time = %0.3f ms\n\n",
+           (std::uint32_t)mapped.size(), (std::uint32_t)mapped_found,
+           mapped.memory_usage() / (1024.0 * 1024.0), mapped_time);
+
+    mapped.clear();
+    std::remove(trie_file);
+}
+
+void sparse_bitset_bloom_filter_benchmark(const char * filename, std::size_t max_depth)
+{
+    typedef TwoEndpoint::Game<5, 5, 3, 3, false>    game_type;
+    typedef game_type::TForwardSolver              solver_type;
+    typedef solver_type::bitset_type               bitset_type;
+    typedef bitset_type::board_type                board_type;
+    typedef game_type::can_move_list_t             can_move_list_t;
+
+    struct Node {
+        board_type      board;
+        std::uint8_t    empty_pos;
+        std::uint8_t    last_dir;
+    };
+
+    printf("-------------------------------------------------------\n\n");
+    printf("sparse_bitset_bloom_filter_benchmark(\"%s\", depth = %u)\n\n",
+           filename, (std::uint32_t)max_depth);
+
+    game_type game;
+    int readStatus = game.readConfig(filename);
+    if (ErrorCode::isFailure(readStatus)) {
+        printf("readStatus = %d (Error: %s)\n\n", readStatus, ErrorCode::toString(readStatus));
+        return;
+    }
+
+    Node start;
+    start.board = game.data().player_board;
+    start.empty_pos = 0;
+    start.last_dir = std::uint8_t(-1);
+    for (std::size_t pos = 0; pos < board_type::BoardSize; pos++) {
+        if (start.board.cells[pos] == Color::Empty) {
+            start.empty_pos = std::uint8_t(pos);
+            break;
+        }
+    }
+
+    bitset_type visited, filtered;
+    visited.try_insert(start.board);
+    filtered.try_insert(start.board);
+
+    std::vector<Node> curr, next;
+    curr.push_back(start);
+
+    double total_time = 0.0, total_filtered_time = 0.0;
+    jtest::StopWatch sw;
+
+    for (std::size_t depth = 1; depth <= max_depth && !curr.empty(); depth++) {
+        // Generate all the next boards first, both sets insert the same sequence
+        next.clear();
+        for (std::size_t i = 0; i < curr.size(); i++) {
+            const Node & node = curr[i];
+            const can_move_list_t & can_moves = game.data().can_moves[node.empty_pos];
+            for (std::size_t n = 0; n < can_moves.size(); n++) {
+                std::uint8_t cur_dir = can_moves[n].dir;
+                if (cur_dir == node.last_dir)
+                    continue;
+                Node child;
+                child.board = node.board;
+                child.empty_pos = can_moves[n].pos;
+                child.last_dir = Dir::opp_dir(cur_dir);
+                std::swap(child.board.cells[node.empty_pos], child.board.cells[child.empty_pos]);
+                next.push_back(child);
+            }
+        }
+
+        std::vector<bool> inserted(next.size());
+        sw.start();
+        for (std::size_t i = 0; i < next.size(); i++) {
+            inserted[i] = visited.try_insert(next[i].board);
+        }
+        sw.stop();
+        double insert_time = sw.getElapsedMillisec();
+
+        sw.start();
+        filtered.reserve_filter(filtered.size() + next.size());
+        sw.stop();
+        double reserve_time = sw.getElapsedMillisec();
+
+        filtered.clear_filter_stats();
+        sw.start();
+        for (std::size_t i = 0; i < next.size(); i++) {
+            filtered.try_insert_filtered(next[i].board);
+        }
+        sw.stop();
+        double filtered_time = sw.getElapsedMillisec() + reserve_time;
+
+        const BlockedBloomFilter::Stats & stats = filtered.filter_stats();
+        printf("depth = %2u, boards = %8u, new = %8u, maybe = %8u, false positive = %5u, "
+               "try_insert = %8.3f ms, filtered = %8.3f ms (reserve = %7.3f ms), speedup = %0.3f\n",
+               (std::uint32_t)depth, (std::uint32_t)next.size(),
+               (std::uint32_t)stats.definitelyNew, (std::uint32_t)stats.maybeExists,
+               (std::uint32_t)stats.falsePositive, insert_time, filtered_time, reserve_time,
+               (filtered_time > 0.0) ? (insert_time / filtered_time) : 0.0);
+
+        total_time += insert_time;
+        total_filtered_time += filtered_time;
+
+        curr.clear();
+        for (std::size_t i = 0; i < next.size(); i++) {
+            if (inserted[i])
+                curr.push_back(next[i]);
+        }
+    }
+
+    printf("\n");
+    printf("visited.size() = %u, filtered.size() = %u, filter memory = %0.3f MB\n",
+           (std::uint32_t)visited.size(), (std::uint32_t)filtered.size(),
+           filtered.filter().memory_usage() / (1024.0 * 1024.0));
+    printf("try_insert = %0.3f ms, filtered = %0.3f ms, speedup = %0.3f\n\n",
+           total_time, total_filtered_time,
+           (total_filtered_time > 0.0) ? (total_time / total_filtered_time) : 0.0);
+}
+
+void sparse_bitset_paged_benchmark(const char * filename, std::size_t max_depth)
+{
+    typedef TwoEndpoint::Game<5, 5, 3, 3, false>    game_type;
+    typedef game_type::TForwardSolver              solver_type;
+    typedef solver_type::bitset_type               bitset_type;
+    typedef bitset_type::board_type                board_type;
+
+    printf("-------------------------------------------------------\n\n");
+    printf("sparse_bitset_paged_benchmark(\"%s\", depth = %u)\n\n",
+           filename, (std::uint32_t)max_depth);
+
+    game_type game;
+    int readStatus = game.readConfig(filename);
+    if (ErrorCode::isFailure(readStatus)) {
+        printf("readStatus = %d (Error: %s)\n\n", readStatus, ErrorCode::toString(readStatus));
+        return;
+    }
+
+    std::vector<board_type> boards;
+    {
+        solver_type forward_solver(&game.data());
+        for (std::size_t depth = 0; depth < max_depth; depth++) {
+            if (forward_solver.bitset_solve(depth, max_depth) != 0)
+                break;
+            forward_solver.clear_prev_depth();
+        }
+        const bitset_type & visited = forward_solver.visited();
+        boards.assign(visited.begin(), visited.end());
+    }
+
+    // Shuffle the boards, the insertion order of a search is not clustered
+    std::uint64_t seed = 0x2545F4914F6CDD1DULL;
+    for (std::size_t i = boards.size(); i > 1; i--) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        std::swap(boards[i - 1], boards[seed % i]);
+    }
+
+    jtest::StopWatch sw;
+
+    bitset_type heap_bitset;
+    double heap_time = sparse_bitset_insert_boards(heap_bitset, boards);
+
+    PagedArena arena;
+    int arenaStatus = arena.create("sparse_bitset_paged_benchmark.arena",
+                                   std::size_t(4) * 1024 * 1024 * 1024);
+    if (ErrorCode::isFailure(arenaStatus)) {
+        printf("arenaStatus = %d (Error: %s)\n\n", arenaStatus, ErrorCode::toString(arenaStatus));
+        return;
+    }
+
+    double paged_time, clustered_time;
+    std::size_t paged_size, paged_mapped;
+    {
+        bitset_type paged_bitset;
+        paged_bitset.attach_arena(&arena);
+        paged_time = sparse_bitset_insert_boards(paged_bitset, boards);
+        paged_size = paged_bitset.size();
+        paged_mapped = arena.mapped_bytes();
+        paged_bitset.destroy();
+    }
+
+    // A fresh arena, the regions of the first one are not reused
+    arenaStatus = arena.create("sparse_bitset_paged_benchmark.arena",
+                               std::size_t(4) * 1024 * 1024 * 1024);
+    if (ErrorCode::isFailure(arenaStatus)) {
+        printf("arenaStatus = %d (Error: %s)\n\n", arenaStatus, ErrorCode::toString(arenaStatus));
+        return;
+    }
+
+    bitset_type clustered_bitset;
+    clustered_bitset.attach_arena(&arena);
+    sw.start();
+    clustered_bitset.try_insert_clustered(boards.data(), boards.size());
+    sw.stop();
+    clustered_time = sw.getElapsedMillisec();
+
+    std::size_t resident = arena.resident_bytes();
+
+    // Drop all but 4 segments, then fault them back in
+    arena.evict_lru(4);
+    std::size_t evicted_resident = arena.resident_bytes();
+
+    std::size_t found = 0;
+    sw.start();
+    for (std::size_t i = 0; i < boards.size(); i++) {
+        found += clustered_bitset.contains(boards[i]) ? 1 : 0;
+    }
+    sw.stop();
+    double contains_time = sw.getElapsedMillisec();
+
+    printf("heap:      size = %u, memory = %0.3f MB, time = %0.3f ms\n",
+           (std::uint32_t)heap_bitset.size(), heap_bitset.memory_usage() / (1024.0 * 1024.0), heap_time);
+    printf("paged:     size = %u, mapped = %0.3f MB, time = %0.3f ms\n",
+           (std::uint32_t)paged_size, paged_mapped / (1024.0 * 1024.0), paged_time);
+    printf("clustered: size = %u, mapped = %0.3f MB, used = %0.3f MB, time = %0.3f ms\n\n",
+           (std::uint32_t)clustered_bitset.size(), arena.mapped_bytes() / (1024.0 * 1024.0),
+           arena.used_bytes() / (1024.0 * 1024.0), clustered_time);
+    printf("resident = %0.3f MB, after evict_lru(4) = %0.3f MB, "
+           "contains (fault back) = %0.3f ms, found = %u\n\n",
+           resident / (1024.0 * 1024.0), evicted_resident / (1024.0 * 1024.0),
+           contains_time, (std::uint32_t)found);
+
+    clustered_bitset.destroy();
+}
+
+void concurrent_sparse_bitset_benchmark(const char * filename, std::size_t max_depth)
+{
+    typedef TwoEndpoint::Game<5, 5, 3, 3, false>    game_type;
+    typedef game_type::TForwardSolver              solver_type;
+    typedef solver_type::bitset_type               bitset_type;
+    typedef bitset_type::board_type                board_type;
+    typedef ConcurrentSparseBitset<board_type, 3, board_type::BoardSize,
+                                   bitset_type::kLayerOrder>   concurrent_bitset_type;
+
+    printf("-------------------------------------------------------\n\n");
+    printf("concurrent_sparse_bitset_benchmark(\"%s\", depth = %u)\n\n",
+           filename, (std::uint32_t)max_depth);
+
+    game_type game;
+    int readStatus = game.readConfig(filename);
+    if (ErrorCode::isFailure(readStatus)) {
+        printf("readStatus = %d (Error: %s)\n\n", readStatus, ErrorCode::toString(readStatus));
+        return;
+    }
+
+    std::vector<board_type> boards;
+    {
+        solver_type forward_solver(&game.data());
+        for (std::size_t depth = 0; depth < max_depth; depth++) {
+            if (forward_solver.bitset_solve(depth, max_depth) != 0)
+                break;
+            forward_solver.clear_prev_depth();
+        }
+        const bitset_type & visited = forward_solver.visited();
+        boards.assign(visited.begin(), visited.end());
+    }
+
+    // Every board is inserted twice, the second time it's a duplicate
+    std::size_t count = boards.size();
+    boards.reserve(count * 2);
+    for (std::size_t i = 0; i < count; i++) {
+        boards.push_back(boards[i]);
+    }
+
+    // Shuffle the boards, the insertion order of a search is not clustered
+    std::uint64_t seed = 0x2545F4914F6CDD1DULL;
+    for (std::size_t i = boards.size(); i > 1; i--) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        std::swap(boards[i - 1], boards[seed % i]);
+    }
+
+    bitset_type serial_bitset;
+    double serial_time = sparse_bitset_insert_boards(serial_bitset, boards);
+    printf("hardware threads = %u\n\n", (std::uint32_t)std::thread::hardware_concurrency());
+    printf("SparseBitset:           threads = 1, size = %u, time = %0.3f ms, %0.3f M/s\n",
+           (std::uint32_t)serial_bitset.size(), serial_time,
+           boards.size() / serial_time / 1000.0);
+
+    jtest::StopWatch sw;
+
+    static const std::size_t thread_counts[] = { 1, 2, 4, 8 };
+    for (std::size_t n = 0; n < sizeof(thread_counts) / sizeof(thread_counts[0]); n++) {
+        std::size_t thread_count = thread_counts[n];
+        std::unique_ptr<concurrent_bitset_type> concurrent(new concurrent_bitset_type);
+
+        std::vector<std::thread> threads;
+        sw.start();
+        for (std::size_t t = 0; t < thread_count; t++) {
+            threads.emplace_back([&boards, &concurrent, t, thread_count]() {
+                std::size_t first = boards.size() * t / thread_count;
+                std::size_t last = boards.size() * (t + 1) / thread_count;
+                for (std::size_t i = first; i < last; i++) {
+                    concurrent->try_insert(boards[i]);
+                }
+            });
+        }
+        for (std::size_t t = 0; t < thread_count; t++) {
+            threads[t].join();
+        }
+        sw.stop();
+        double concurrent_time = sw.getElapsedMillisec();
+
+        printf("ConcurrentSparseBitset: threads = %u, size = %u, time = %0.3f ms, %0.3f M/s\n",
+               (std::uint32_t)thread_count, (std::uint32_t)concurrent->size(), concurrent_time,
+               boards.size() / concurrent_time / 1000.0);
+    }
+    printf("\n");
+}
+
 int main(int argc, char * argv[])
 {
     jtest::cpu::warmUp(1000);
@@ -518,6 +1119,42 @@ int main(int argc, char * argv[])
     //return 0;
 #endif
 
+#if 0
+    concurrent_sparse_bitset_benchmark(PUZZLES_PATH("magic_block.txt"), 16);
+    concurrent_sparse_bitset_benchmark(PUZZLES_PATH("magic_block-2.txt"), 16);
+    Console::readKeyLine();
+#endif
+
+#if 0
+    sparse_bitset_paged_benchmark(PUZZLES_PATH("magic_block.txt"), 16);
+    sparse_bitset_paged_benchmark(PUZZLES_PATH("magic_block-2.txt"), 16);
+    Console::readKeyLine();
+#endif
+
+#if 0
+    sparse_bitset_bloom_filter_benchmark(PUZZLES_PATH("magic_block.txt"), 16);
+    sparse_bitset_bloom_filter_benchmark(PUZZLES_PATH("magic_block-2.txt"), 16);
+    Console::readKeyLine();
+#endif
+
+#if 0
+    sparse_bitset_freeze_benchmark(PUZZLES_PATH("magic_block.txt"), 16);
+    sparse_bitset_freeze_benchmark(PUZZLES_PATH("magic_block-2.txt"), 16);
+    Console::readKeyLine();
+#endif
+
+#if 0
+    sparse_trie_layer_order_benchmark(PUZZLES_PATH("magic_block.txt"), 14, 14);
+    sparse_trie_layer_order_benchmark(PUZZLES_PATH("magic_block-2.txt"), 14, 14);
+    Console::readKeyLine();
+#endif
+
+#if 0
+    sparse_bitset_policy_benchmark(PUZZLES_PATH("magic_block.txt"), 16);
+    sparse_bitset_policy_benchmark(PUZZLES_PATH("magic_block-2.txt"), 16);
+    Console::readKeyLine();
+#endif
+
     if (0) {
 
 #if 0
@@ -555,6 +1192,9 @@ int main(int argc, char * argv[])
     solve_sliding_color_puzzle<SolverId::Normal, false>();
     solve_sliding_color_puzzle<SolverId::Queue, false>();
 
+    solve_sliding_color_puzzle<SolverId::Normal, true, true>();
+    solve_sliding_color_puzzle<SolverId::Queue, true, true>();
+
     Console::readKeyLine();
 #endif
 
@@ -640,6 +1280,12 @@ int main(int argc, char * argv[])
 
     }
 
+#if 0
+    solve_magic_block_large<6>(PUZZLES_PATH("magic_block-6x6.txt"), 12);
+    solve_magic_block_large<7>(PUZZLES_PATH("magic_block-7x7.txt"), 12);
+    Console::readKeyLine();
+#endif
+
     ////////////////////////////////////////////////////////////////////////
 
     if (1) {
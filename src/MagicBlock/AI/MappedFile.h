@@ -0,0 +1,168 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <utility>          // For std::swap()
+
+#if defined(_WIN32) || defined(_MSC_VER)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "MagicBlock/AI/ErrorCode.h"
+
+namespace MagicBlock {
+namespace AI {
+
+//
+// A read-only memory mapping of a whole file.
+//
+// The pages are shared with the page cache, so the processes that map
+// the same file share one copy of it.
+//
+class MappedFile {
+private:
+    const char *    data_;
+    std::size_t     size_;
+#if defined(_WIN32) || defined(_MSC_VER)
+    HANDLE          file_;
+    HANDLE          mapping_;
+#else
+    int             fd_;
+#endif
+
+public:
+    MappedFile() noexcept : data_(nullptr), size_(0),
+#if defined(_WIN32) || defined(_MSC_VER)
+        file_(INVALID_HANDLE_VALUE), mapping_(nullptr) {
+#else
+        fd_(-1) {
+#endif
+    }
+
+    MappedFile(const MappedFile & src) = delete;
+    MappedFile & operator = (const MappedFile & rhs) = delete;
+
+    ~MappedFile() {
+        this->close();
+    }
+
+    const char * data() const {
+        return this->data_;
+    }
+
+    std::size_t size() const {
+        return this->size_;
+    }
+
+    bool is_open() const {
+        return (this->data_ != nullptr);
+    }
+
+    int open(const char * filename) {
+        this->close();
+
+#if defined(_WIN32) || defined(_MSC_VER)
+        this->file_ = ::CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (this->file_ == INVALID_HANDLE_VALUE)
+            return ErrorCode::FileOpenFailed;
+
+        LARGE_INTEGER file_size;
+        if (!::GetFileSizeEx(this->file_, &file_size) || file_size.QuadPart == 0) {
+            this->close();
+            return ErrorCode::FileMapFailed;
+        }
+
+        this->mapping_ = ::CreateFileMappingA(this->file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (this->mapping_ == nullptr) {
+            this->close();
+            return ErrorCode::FileMapFailed;
+        }
+
+        void * data = ::MapViewOfFile(this->mapping_, FILE_MAP_READ, 0, 0, 0);
+        if (data == nullptr) {
+            this->close();
+            return ErrorCode::FileMapFailed;
+        }
+        this->data_ = (const char *)data;
+        this->size_ = static_cast<std::size_t>(file_size.QuadPart);
+#else
+        this->fd_ = ::open(filename, O_RDONLY);
+        if (this->fd_ < 0)
+            return ErrorCode::FileOpenFailed;
+
+        struct stat st;
+        if (::fstat(this->fd_, &st) != 0 || st.st_size == 0) {
+            this->close();
+            return ErrorCode::FileMapFailed;
+        }
+
+        void * data = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, this->fd_, 0);
+        if (data == MAP_FAILED) {
+            this->close();
+            return ErrorCode::FileMapFailed;
+        }
+        this->data_ = (const char *)data;
+        this->size_ = static_cast<std::size_t>(st.st_size);
+#endif
+        return ErrorCode::Success;
+    }
+
+    void close() {
+#if defined(_WIN32) || defined(_MSC_VER)
+        if (this->data_ != nullptr) {
+            ::UnmapViewOfFile(this->data_);
+        }
+        if (this->mapping_ != nullptr) {
+            ::CloseHandle(this->mapping_);
+            this->mapping_ = nullptr;
+        }
+        if (this->file_ != INVALID_HANDLE_VALUE) {
+            ::CloseHandle(this->file_);
+            this->file_ = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (this->data_ != nullptr) {
+            ::munmap((void *)this->data_, this->size_);
+        }
+        if (this->fd_ >= 0) {
+            ::close(this->fd_);
+            this->fd_ = -1;
+        }
+#endif
+        this->data_ = nullptr;
+        this->size_ = 0;
+    }
+
+    void swap(MappedFile & other) {
+        if (&other != this) {
+            std::swap(this->data_, other.data_);
+            std::swap(this->size_, other.size_);
+#if defined(_WIN32) || defined(_MSC_VER)
+            std::swap(this->file_, other.file_);
+            std::swap(this->mapping_, other.mapping_);
+#else
+            std::swap(this->fd_, other.fd_);
+#endif
+        }
+    }
+};
+
+} // namespace AI
+} // namespace MagicBlock
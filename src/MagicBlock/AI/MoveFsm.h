@@ -0,0 +1,284 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <set>
+#include <map>
+#include <algorithm>    // For std::sort(), std::find(), std::includes()
+#include <utility>      // For std::pair<T1, T2>, std::swap()
+
+#include "MagicBlock/AI/Move.h"
+
+namespace MagicBlock {
+namespace AI {
+
+//
+// The duplicate move pruning FSM (Taylor and Korf, 1993).
+//
+// A move is the direction n of the empty cell in Dir_Offset order, the same as
+// the entry n of MoveTable. Two move strings of the same length are duplicates
+// when they give the same board from any start, and the empty cell of the smaller
+// one stays inside the cells visited by the larger one, so both fit on the board.
+// The larger one of each pair (up to kMaxLength moves) is forbidden, the reverse
+// moves are forbidden too, and the FSM matches all forbidden strings at once
+// (an Aho-Corasick automaton).
+//
+// The pruning is exact for a BFS that expands each depth in lexicographic order,
+// that is, the stages in the order they were pushed and the moves in MoveTable
+// order: every board is still reached first by its smallest shortest move string.
+//
+class MoveFsm {
+public:
+    typedef std::size_t         size_type;
+
+    static const size_type kMaxLength = 8;
+    static const size_type kMaxStates = 255;
+
+    static const std::uint8_t kStart = 0;
+    static const std::uint8_t kPruned = 0xFF;
+
+private:
+    typedef std::vector<std::uint8_t>   move_string_t;
+
+    struct Node {
+        int     child[Dir::Maximum];
+        int     next[Dir::Maximum];
+        int     fail;
+        bool    forbidden;
+
+        Node() : fail(0), forbidden(false) {
+            for (size_type n = 0; n < Dir::Maximum; n++) {
+                this->child[n] = -1;
+                this->next[n] = -1;
+            }
+        }
+    };
+
+    std::uint8_t next_[kMaxStates][Dir::Maximum];
+    size_type states_;
+    size_type forbidden_;
+
+    // A move string of at most 14 moves as an integer, 2 bits per move and the length.
+    static std::uint32_t string_key(const move_string_t & moves, size_type first) {
+        std::uint32_t key = std::uint32_t(moves.size() - first);
+        for (size_type i = first; i < moves.size(); i++) {
+            key = (key << 2) | moves[i];
+        }
+        return key;
+    }
+
+    static bool has_forbidden_suffix(const std::set<std::uint32_t> & forbidden_keys,
+                                     const move_string_t & moves) {
+        for (size_type i = 0; (i + 2) <= moves.size(); i++) {
+            if (forbidden_keys.count(string_key(moves, i)) > 0)
+                return true;
+        }
+        return false;
+    }
+
+    //
+    // Play the moves on an unbounded board of distinct cells, key is the moved cells
+    // and their new positions, visited is the sorted cells that the empty cell passed.
+    //
+    static void play_moves(const move_string_t & moves,
+                           std::vector<int> & key, std::vector<int> & visited) {
+        static const int kSize = int(kMaxLength) * 2 + 3;
+        // The cells that the empty cell passed, the others are not moved
+        int cells[kMaxLength + 1];
+
+        int x = kSize / 2, y = kSize / 2;
+        visited.clear();
+        visited.push_back(y * kSize + x);
+        cells[0] = y * kSize + x;
+        size_type empty = 0;
+        for (size_type i = 0; i < moves.size(); i++) {
+            x += Dir_Offset[moves[i]].x;
+            y += Dir_Offset[moves[i]].y;
+            int move_pos = y * kSize + x;
+            size_type index = std::find(visited.begin(), visited.end(), move_pos) - visited.begin();
+            if (index == visited.size()) {
+                visited.push_back(move_pos);
+                cells[index] = move_pos;
+            }
+            std::swap(cells[empty], cells[index]);
+            empty = index;
+        }
+
+        std::vector<std::pair<int, int>> moved_cells;
+        for (size_type i = 0; i < visited.size(); i++) {
+            if (cells[i] != visited[i]) {
+                moved_cells.push_back(std::make_pair(visited[i], cells[i]));
+            }
+        }
+        std::sort(moved_cells.begin(), moved_cells.end());
+        std::sort(visited.begin(), visited.end());
+
+        key.clear();
+        for (size_type i = 0; i < moved_cells.size(); i++) {
+            key.push_back(moved_cells[i].first);
+            key.push_back(moved_cells[i].second);
+        }
+    }
+
+    static void find_forbidden(std::set<move_string_t> & forbidden) {
+        std::set<std::uint32_t> forbidden_keys;
+        for (std::uint8_t n = 0; n < Dir::Maximum; n++) {
+            move_string_t reverse_moves;
+            reverse_moves.push_back(n);
+            reverse_moves.push_back(Dir::opp_dir(n));
+            forbidden.insert(reverse_moves);
+            forbidden_keys.insert(string_key(reverse_moves, 0));
+        }
+
+        // The strings of each length are in lexicographic order
+        std::vector<move_string_t> curr_strings(1);
+        for (size_type length = 1; length <= kMaxLength; length++) {
+            std::vector<move_string_t> next_strings;
+            for (size_type i = 0; i < curr_strings.size(); i++) {
+                for (std::uint8_t n = 0; n < Dir::Maximum; n++) {
+                    move_string_t moves(curr_strings[i]);
+                    moves.push_back(n);
+                    if (!has_forbidden_suffix(forbidden_keys, moves))
+                        next_strings.push_back(moves);
+                }
+            }
+
+            std::vector<std::vector<int>> visited(next_strings.size());
+            std::map<std::vector<int>, std::vector<size_type>> duplicates;
+            for (size_type i = 0; i < next_strings.size(); i++) {
+                std::vector<int> key;
+                play_moves(next_strings[i], key, visited[i]);
+                duplicates[key].push_back(i);
+            }
+
+            std::vector<bool> is_forbidden(next_strings.size(), false);
+            typedef std::map<std::vector<int>, std::vector<size_type>>::const_iterator const_iterator;
+            for (const_iterator iter = duplicates.begin(); iter != duplicates.end(); ++iter) {
+                const std::vector<size_type> & list = iter->second;
+                for (size_type j = 1; j < list.size(); j++) {
+                    const std::vector<int> & larger = visited[list[j]];
+                    for (size_type i = 0; i < j; i++) {
+                        const std::vector<int> & smaller = visited[list[i]];
+                        if (std::includes(larger.begin(), larger.end(), smaller.begin(), smaller.end())) {
+                            is_forbidden[list[j]] = true;
+                            break;
+                        }
+                    }
+                }
+            }
+
+            curr_strings.clear();
+            for (size_type i = 0; i < next_strings.size(); i++) {
+                if (is_forbidden[i]) {
+                    forbidden.insert(next_strings[i]);
+                    forbidden_keys.insert(string_key(next_strings[i], 0));
+                }
+                else
+                    curr_strings.push_back(next_strings[i]);
+            }
+        }
+    }
+
+    void build() {
+        std::set<move_string_t> forbidden;
+        find_forbidden(forbidden);
+        this->forbidden_ = forbidden.size();
+
+        // The trie of the forbidden strings
+        std::vector<Node> nodes(1);
+        typedef std::set<move_string_t>::const_iterator const_iterator;
+        for (const_iterator iter = forbidden.begin(); iter != forbidden.end(); ++iter) {
+            int node = 0;
+            for (size_type i = 0; i < iter->size(); i++) {
+                std::uint8_t n = (*iter)[i];
+                if (nodes[node].child[n] < 0) {
+                    nodes[node].child[n] = int(nodes.size());
+                    nodes.push_back(Node());
+                }
+                node = nodes[node].child[n];
+            }
+            nodes[node].forbidden = true;
+        }
+
+        // The failure links and the transitions, in BFS order
+        std::vector<int> queue;
+        for (size_type n = 0; n < Dir::Maximum; n++) {
+            int child = nodes[0].child[n];
+            if (child >= 0) {
+                nodes[child].fail = 0;
+                nodes[0].next[n] = child;
+                queue.push_back(child);
+            }
+            else {
+                nodes[0].next[n] = 0;
+            }
+        }
+        for (size_type head = 0; head < queue.size(); head++) {
+            int node = queue[head];
+            nodes[node].forbidden = nodes[node].forbidden || nodes[nodes[node].fail].forbidden;
+            for (size_type n = 0; n < Dir::Maximum; n++) {
+                int child = nodes[node].child[n];
+                if (child >= 0) {
+                    nodes[child].fail = nodes[nodes[node].fail].next[n];
+                    nodes[node].next[n] = child;
+                    queue.push_back(child);
+                }
+                else {
+                    nodes[node].next[n] = nodes[nodes[node].fail].next[n];
+                }
+            }
+        }
+
+        // Number the states, the forbidden nodes become kPruned
+        std::vector<int> state_of(nodes.size(), kPruned);
+        size_type states = 0;
+        state_of[0] = states++;
+        for (size_type i = 0; i < queue.size(); i++) {
+            if (!nodes[queue[i]].forbidden)
+                state_of[queue[i]] = int(states++);
+        }
+        assert(states <= kMaxStates);
+        this->states_ = states;
+
+        for (size_type node = 0; node < nodes.size(); node++) {
+            if (state_of[node] == kPruned)
+                continue;
+            for (size_type n = 0; n < Dir::Maximum; n++) {
+                this->next_[state_of[node]][n] = std::uint8_t(state_of[nodes[node].next[n]]);
+            }
+        }
+    }
+
+public:
+    MoveFsm() : states_(0), forbidden_(0) {
+        this->build();
+    }
+
+    ~MoveFsm() {}
+
+    size_type states() const { return this->states_; }
+    size_type forbidden() const { return this->forbidden_; }
+
+    //
+    // The state after the empty cell moves in the direction n, see MoveTable,
+    // or kPruned if the move string becomes a forbidden one.
+    //
+    std::uint8_t next(std::uint8_t state, size_type n) const {
+        assert(state < this->states_);
+        assert(n < Dir::Maximum);
+        return this->next_[state][n];
+    }
+
+    static const MoveFsm & getInstance() {
+        static MoveFsm move_fsm;
+        return move_fsm;
+    }
+};
+
+} // namespace AI
+} // namespace MagicBlock
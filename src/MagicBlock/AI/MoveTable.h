@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "MagicBlock/AI/Move.h"
+
+namespace MagicBlock {
+namespace AI {
+
+//
+// One move of the empty cell, see MoveTable.
+//
+struct MoveEntry {
+    std::uint8_t    valid;          // 0 if the move is out of the board
+    std::uint8_t    pos;            // The moved cell, it's the next empty cell
+    std::uint8_t    dir;            // The direction of the moved cell, the same as Move::dir
+    std::uint8_t    opp_dir;        // Dir::opp_dir(dir), the last_dir of the next stage
+    std::uint8_t    first_row;      // The rows of the empty cell and the moved cell,
+    std::uint8_t    last_row;       //   first_row <= last_row
+    std::uint8_t    empty_shift;    // The bit offsets of the empty cell and the moved cell
+    std::uint8_t    move_shift;     //   in the packed key, 3 bits per cell
+};
+
+template <std::size_t... Indexes>
+struct MoveIndexSeq {};
+
+template <std::size_t N, std::size_t... Indexes>
+struct MakeMoveIndexSeq : MakeMoveIndexSeq<N - 1, N - 1, Indexes...> {};
+
+template <std::size_t... Indexes>
+struct MakeMoveIndexSeq<0, Indexes...> {
+    typedef MoveIndexSeq<Indexes...> type;
+};
+
+//
+// The moves of the empty cell, generated at compile time. moves(empty_pos)[n] is the
+// n-th direction (Down, Left, Up, Right) of Dir_Offset from the empty cell, in the
+// same order as CanMoves, the invalid ones are marked with valid = 0. So a search can
+// loop over the Dir::Maximum entries with a constant trip count.
+//
+template <std::size_t BoardX, std::size_t BoardY>
+struct MoveTable {
+    static const std::size_t BoardSize = BoardX * BoardY;
+    static const std::size_t kTableSize = BoardSize * Dir::Maximum;
+
+    static_assert((BoardSize <= 85), "MoveTable: the bit offsets must fit in 8 bits.");
+
+    // The same as Dir_Offset[], which is not a constant expression
+    static constexpr int offset_x(std::size_t dir) {
+        return ((dir == Dir::Left) ? -1 : ((dir == Dir::Right) ? 1 : 0));
+    }
+
+    static constexpr int offset_y(std::size_t dir) {
+        return ((dir == Dir::Up) ? -1 : ((dir == Dir::Down) ? 1 : 0));
+    }
+
+    static constexpr std::uint8_t opp_dir(std::size_t dir) {
+        return std::uint8_t((dir + 2) % Dir::Maximum);
+    }
+
+    static constexpr bool is_valid(std::size_t pos, std::size_t dir) {
+        return (((int)(pos % BoardX) + offset_x(dir)) >= 0) &&
+               (((int)(pos % BoardX) + offset_x(dir)) < (int)BoardX) &&
+               (((int)(pos / BoardX) + offset_y(dir)) >= 0) &&
+               (((int)(pos / BoardX) + offset_y(dir)) < (int)BoardY);
+    }
+
+    static constexpr std::size_t move_pos(std::size_t pos, std::size_t dir) {
+        return (is_valid(pos, dir) ? std::size_t((int)pos + offset_y(dir) * (int)BoardX + offset_x(dir)) : pos);
+    }
+
+    static constexpr std::size_t min_row(std::size_t pos1, std::size_t pos2) {
+        return (((pos1 / BoardX) < (pos2 / BoardX)) ? (pos1 / BoardX) : (pos2 / BoardX));
+    }
+
+    static constexpr std::size_t max_row(std::size_t pos1, std::size_t pos2) {
+        return (((pos1 / BoardX) > (pos2 / BoardX)) ? (pos1 / BoardX) : (pos2 / BoardX));
+    }
+
+    static constexpr MoveEntry make_entry(std::size_t pos, std::size_t dir) {
+        return MoveEntry {
+            std::uint8_t(is_valid(pos, dir) ? 1 : 0),
+            std::uint8_t(move_pos(pos, dir)),
+            opp_dir(dir),
+            std::uint8_t(dir),
+            std::uint8_t(min_row(pos, move_pos(pos, dir))),
+            std::uint8_t(max_row(pos, move_pos(pos, dir))),
+            std::uint8_t(pos * 3),
+            std::uint8_t(move_pos(pos, dir) * 3)
+        };
+    }
+
+    template <typename IndexSeq>
+    struct Data;
+
+    template <std::size_t... Indexes>
+    struct Data<MoveIndexSeq<Indexes...>> {
+        static constexpr MoveEntry entries[sizeof...(Indexes)] = {
+            make_entry(Indexes / Dir::Maximum, Indexes % Dir::Maximum)...
+        };
+    };
+
+    typedef Data<typename MakeMoveIndexSeq<kTableSize>::type>   data_type;
+
+    static constexpr const MoveEntry & get(std::size_t empty_pos, std::size_t n) {
+        return data_type::entries[empty_pos * Dir::Maximum + n];
+    }
+
+    static constexpr const MoveEntry * moves(std::size_t empty_pos) {
+        return &data_type::entries[empty_pos * Dir::Maximum];
+    }
+};
+
+template <std::size_t BoardX, std::size_t BoardY>
+template <std::size_t... Indexes>
+constexpr MoveEntry
+MoveTable<BoardX, BoardY>::Data<MoveIndexSeq<Indexes...>>::entries[sizeof...(Indexes)];
+
+} // namespace AI
+} // namespace MagicBlock
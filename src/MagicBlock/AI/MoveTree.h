@@ -0,0 +1,147 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <stdexcept>     // For std::runtime_error
+
+#include "MagicBlock/AI/MoveSeq.h"
+
+namespace MagicBlock {
+namespace AI {
+
+//
+// The move sequences of a BFS as a tree with shared prefixes.
+//
+// Each node is one move: the index of its parent node and the direction,
+// packed in 32 bits. A child stage appends one node instead of copying the
+// MoveSeq of its parent, and the sequence is only rebuilt by get_move_seq()
+// for the answers. The nodes are kept in fixed-size blocks, so the indexes
+// are stable and the arena never copies itself when it grows.
+//
+class MoveTree {
+public:
+    typedef std::size_t     size_type;
+    typedef std::uint32_t   node_type;
+
+    // Dir::Down to Dir::Right
+    static const size_type kDirBits = 2;
+    static const node_type kDirMask = (node_type(1) << kDirBits) - 1;
+
+    // The empty sequence, the node of the start stages
+    static const node_type kRoot = node_type(-1) >> kDirBits;
+    static const size_type kMaxNodes = kRoot;
+
+    // The longest sequence of a MoveSeq
+    static const size_type kMaxDepth = 255;
+
+    static const size_type kBlockShift = 16;
+    static const size_type kBlockSize = size_type(1) << kBlockShift;
+    static const size_type kBlockMask = kBlockSize - 1;
+
+private:
+    std::vector<node_type *>    blocks_;
+    size_type                   size_;
+
+    void add_block() {
+        node_type * block = new node_type[kBlockSize];
+        this->blocks_.push_back(block);
+    }
+
+    node_type get(node_type index) const {
+        assert(index < this->size_);
+        return this->blocks_[index >> kBlockShift][index & kBlockMask];
+    }
+
+public:
+    MoveTree() : size_(0) {}
+
+    ~MoveTree() {
+        this->destroy();
+    }
+
+    void destroy() {
+        for (size_type i = 0; i < this->blocks_.size(); i++) {
+            delete[] this->blocks_[i];
+        }
+        this->blocks_.clear();
+        this->size_ = 0;
+    }
+
+    size_type size() const {
+        return this->size_;
+    }
+
+    bool empty() const {
+        return (this->size_ == 0);
+    }
+
+    size_type block_count() const {
+        return this->blocks_.size();
+    }
+
+    // Keep the blocks for the next search.
+    void clear() {
+        this->size_ = 0;
+    }
+
+    // Append the move dir after the sequence of parent, return the new node.
+    // The parent index has 30 bits, a tree of kMaxNodes nodes throws.
+    node_type append(node_type parent, size_type dir) {
+        assert(parent == kRoot || parent < this->size_);
+        if (this->size_ >= kMaxNodes) {
+            throw std::runtime_error("Exception: MoveTree::append(): the tree is full.");
+        }
+        size_type index = this->size_;
+        if ((index >> kBlockShift) >= this->blocks_.size()) {
+            this->add_block();
+        }
+        this->blocks_[index >> kBlockShift][index & kBlockMask] =
+            (parent << kDirBits) | (node_type(dir) & kDirMask);
+        this->size_++;
+        return node_type(index);
+    }
+
+    node_type parent(node_type node) const {
+        return (this->get(node) >> kDirBits);
+    }
+
+    size_type dir(node_type node) const {
+        return size_type(this->get(node) & kDirMask);
+    }
+
+    size_type depth(node_type node) const {
+        size_type depth = 0;
+        while (node != kRoot) {
+            node = this->parent(node);
+            depth++;
+        }
+        return depth;
+    }
+
+    // Rebuild the move sequence from the root to node.
+    // A MoveSeq holds at most kMaxDepth moves, a deeper node throws.
+    void get_move_seq(node_type node, MoveSeq & move_seq) const {
+        std::uint8_t dirs[kMaxDepth];
+        size_type depth = 0;
+        while (node != kRoot) {
+            if (depth >= kMaxDepth) {
+                throw std::runtime_error("Exception: MoveTree::get_move_seq(): the node is too deep for a MoveSeq.");
+            }
+            node_type value = this->get(node);
+            dirs[depth++] = std::uint8_t(value & kDirMask);
+            node = value >> kDirBits;
+        }
+        move_seq.clear();
+        while (depth > 0) {
+            move_seq.push_back(dirs[--depth]);
+        }
+    }
+};
+
+} // namespace AI
+} // namespace MagicBlock
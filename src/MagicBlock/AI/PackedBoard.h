@@ -0,0 +1,274 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>  // For std::conditional<bool, T1, T2>
+#include <utility>      // For std::swap()
+
+#include "MagicBlock/AI/Color.h"
+#include "MagicBlock/AI/Board.h"
+#include "MagicBlock/AI/Value128.h"
+
+namespace MagicBlock {
+namespace AI {
+
+//
+// The bit operations of the words of PackedBoard, a field is at most 32 bits.
+//
+struct PackedWord {
+    static std::uint32_t get_bits(std::uint32_t word, std::size_t shift, std::size_t bits) noexcept {
+        return std::uint32_t((std::uint64_t(word) >> shift) & ((std::uint64_t(1) << bits) - 1));
+    }
+
+    static std::uint32_t get_bits(std::uint64_t word, std::size_t shift, std::size_t bits) noexcept {
+        return std::uint32_t((word >> shift) & ((std::uint64_t(1) << bits) - 1));
+    }
+
+    static std::uint32_t get_bits(const Value128 & word, std::size_t shift, std::size_t bits) noexcept {
+        std::uint64_t value;
+        if (shift >= 64)
+            value = word.high >> (shift - 64);
+        else if (shift == 0)
+            value = word.low;
+        else
+            value = (word.low >> shift) | (word.high << (64 - shift));
+        return std::uint32_t(value & ((std::uint64_t(1) << bits) - 1));
+    }
+
+    static void xor_bits(std::uint32_t & word, std::size_t shift, std::uint32_t delta) noexcept {
+        word ^= delta << shift;
+    }
+
+    static void xor_bits(std::uint64_t & word, std::size_t shift, std::uint32_t delta) noexcept {
+        word ^= std::uint64_t(delta) << shift;
+    }
+
+    static void xor_bits(Value128 & word, std::size_t shift, std::uint32_t delta) noexcept {
+        if (shift < 64) {
+            word.low ^= std::uint64_t(delta) << shift;
+            if (shift > 32)
+                word.high ^= std::uint64_t(delta) >> (64 - shift);
+        }
+        else {
+            word.high ^= std::uint64_t(delta) << (shift - 64);
+        }
+    }
+
+    static bool is_equal(std::uint32_t lhs, std::uint32_t rhs) noexcept {
+        return (lhs == rhs);
+    }
+
+    static bool is_equal(std::uint64_t lhs, std::uint64_t rhs) noexcept {
+        return (lhs == rhs);
+    }
+
+    static bool is_equal(const Value128 & lhs, const Value128 & rhs) noexcept {
+        return lhs.is_equal(rhs);
+    }
+
+    static bool is_equal_masked(std::uint32_t lhs, std::uint32_t rhs, std::uint32_t mask) noexcept {
+        return (((lhs ^ rhs) & mask) == 0);
+    }
+
+    static bool is_equal_masked(std::uint64_t lhs, std::uint64_t rhs, std::uint64_t mask) noexcept {
+        return (((lhs ^ rhs) & mask) == 0);
+    }
+
+    static bool is_equal_masked(const Value128 & lhs, const Value128 & rhs, const Value128 & mask) noexcept {
+        return ((((lhs.low ^ rhs.low) & mask.low) | ((lhs.high ^ rhs.high) & mask.high)) == 0);
+    }
+
+    static void from_value128(std::uint32_t & word, const Value128 & value) noexcept {
+        word = std::uint32_t(value.low);
+    }
+
+    static void from_value128(std::uint64_t & word, const Value128 & value) noexcept {
+        word = value.low;
+    }
+
+    static void from_value128(Value128 & word, const Value128 & value) noexcept {
+        word = value;
+    }
+
+    static Value128 to_value128(std::uint32_t word) noexcept {
+        return Value128(word, 0);
+    }
+
+    static Value128 to_value128(std::uint64_t word) noexcept {
+        return Value128(word, 0);
+    }
+
+    static Value128 to_value128(const Value128 & word) noexcept {
+        return word;
+    }
+};
+
+//
+// A board that is always stored packed, cell i is in bits [3 * i, 3 * i + 3),
+// the same layout as Board::value128(). The word is a uint32_t for 3x3,
+// a uint64_t up to 21 cells, and a Value128 for 5x5.
+//
+// It has the interface of Board that the BFS solvers use (swap_cells(),
+// value(), value128(), operator ==), so a solver can take it as its board type.
+//
+template <std::size_t BoardX, std::size_t BoardY>
+class PackedBoard
+{
+public:
+    typedef std::size_t         size_type;
+    typedef std::ptrdiff_t      ssize_type;
+
+    static const size_type X = BoardX;
+    static const size_type Y = BoardY;
+    static const size_type BoardSize = BoardX * BoardY;
+
+    static const size_type kCellBits = 3;
+    static const std::uint32_t kCellMask = 0x07U;
+
+    typedef typename std::conditional<
+                (BoardSize <= 10), std::uint32_t,
+                typename std::conditional<
+                    (BoardSize <= 21), std::uint64_t, Value128
+                >::type
+            >::type  word_type;
+
+    typedef PackedBoard<BoardX, BoardY>     this_type;
+    typedef Board<BoardX, BoardY>           board_type;
+
+    typedef Value128                        key_type;
+    typedef Value128_Hash                   key_hash_t;
+
+    static_assert((BoardSize <= 42), "PackedBoard: BoardX * BoardY must be <= 42.");
+    static_assert((BoardX * kCellBits <= 32), "PackedBoard: a row must fit in 32 bits.");
+
+    word_type word;
+
+    PackedBoard() noexcept : word() {}
+    PackedBoard(const PackedBoard & src) noexcept : word(src.word) {}
+
+    explicit PackedBoard(const board_type & board) noexcept : word() {
+        this->assign(board);
+    }
+
+    ~PackedBoard() {}
+
+    PackedBoard & operator = (const PackedBoard & rhs) noexcept {
+        this->word = rhs.word;
+        return *this;
+    }
+
+    PackedBoard & operator = (const board_type & rhs) noexcept {
+        this->assign(rhs);
+        return *this;
+    }
+
+    friend bool operator == (const PackedBoard & lhs, const PackedBoard & rhs) noexcept {
+        return lhs.is_equal(rhs);
+    }
+
+    friend bool operator != (const PackedBoard & lhs, const PackedBoard & rhs) noexcept {
+        return !lhs.is_equal(rhs);
+    }
+
+    void assign(const board_type & board) noexcept {
+        PackedWord::from_value128(this->word, board.value128());
+    }
+
+    board_type to_board() const noexcept {
+        board_type board;
+        for (size_type pos = 0; pos < BoardSize; pos++) {
+            board.cells[pos] = std::uint8_t(this->get(pos));
+        }
+        return board;
+    }
+
+    void clear() noexcept {
+        this->word = word_type();
+    }
+
+    std::uint32_t get(size_type pos) const noexcept {
+        assert(pos < BoardSize);
+        return PackedWord::get_bits(this->word, pos * kCellBits, kCellBits);
+    }
+
+    void set(size_type pos, std::uint32_t color) noexcept {
+        assert(pos < BoardSize);
+        std::uint32_t delta = (this->get(pos) ^ color) & kCellMask;
+        PackedWord::xor_bits(this->word, pos * kCellBits, delta);
+    }
+
+    // The packed cells of row y, cell x in bits [3 * x, 3 * x + 3).
+    std::uint32_t row(size_type y) const noexcept {
+        assert(y < BoardY);
+        return PackedWord::get_bits(this->word, y * BoardX * kCellBits, BoardX * kCellBits);
+    }
+
+    void swap_cells(size_type pos1, size_type pos2) noexcept {
+        std::uint32_t delta = this->get(pos1) ^ this->get(pos2);
+        PackedWord::xor_bits(this->word, pos1 * kCellBits, delta);
+        PackedWord::xor_bits(this->word, pos2 * kCellBits, delta);
+    }
+
+    // The same as Board::swap_cells(), value is the value128() of this board.
+    void swap_cells(size_type pos1, size_type pos2, Value128 & value) noexcept {
+        std::uint32_t delta = this->get(pos1) ^ this->get(pos2);
+        PackedWord::xor_bits(this->word, pos1 * kCellBits, delta);
+        PackedWord::xor_bits(this->word, pos2 * kCellBits, delta);
+        PackedWord::xor_bits(value, pos1 * kCellBits, delta);
+        PackedWord::xor_bits(value, pos2 * kCellBits, delta);
+    }
+
+    size_type value() const noexcept {
+        return size_type(PackedWord::to_value128(this->word).low);
+    }
+
+    Value128 value128() const noexcept {
+        return PackedWord::to_value128(this->word);
+    }
+
+    key_type key() const noexcept {
+        return this->value128();
+    }
+
+    bool is_equal(const PackedBoard & other) const noexcept {
+        return PackedWord::is_equal(this->word, other.word);
+    }
+
+    // Only compares the cells whose fields are set in mask, see region_mask().
+    bool is_equal(const PackedBoard & other, const PackedBoard & mask) const noexcept {
+        return PackedWord::is_equal_masked(this->word, other.word, mask.word);
+    }
+
+    // The mask of the cells in [left, left + width) x [top, top + height).
+    static PackedBoard region_mask(size_type left, size_type top,
+                                   size_type width, size_type height) noexcept {
+        assert((left + width) <= BoardX);
+        assert((top + height) <= BoardY);
+        PackedBoard mask;
+        for (size_type y = top; y < (top + height); y++) {
+            for (size_type x = left; x < (left + width); x++) {
+                mask.set(y * BoardX + x, kCellMask);
+            }
+        }
+        return mask;
+    }
+
+    void swap(PackedBoard & other) noexcept {
+        if (&other != this) {
+            std::swap(this->word, other.word);
+        }
+    }
+};
+
+template <std::size_t BoardX, std::size_t BoardY>
+inline
+void swap(PackedBoard<BoardX, BoardY> & lhs, PackedBoard<BoardX, BoardY> & rhs) noexcept {
+    lhs.swap(rhs);
+}
+
+} // namespace AI
+} // namespace MagicBlock
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>   // For std::hash<T>
+
+#include "MagicBlock/AI/Config.h"
+
+#if MBG_USE_AVX2
+#include <immintrin.h>  // For AVX2
+#elif MBG_USE_SSE2
+#include <emmintrin.h>  // For SSE2
+#endif
+
+#include "MagicBlock/AI/CellPack.h"
+
+namespace MagicBlock {
+namespace AI {
+
+//
+// The packed cells of a board that doesn't fit in Value128 (more than 42 cells),
+// in the same layout: cell i is in bits [3 * i, 3 * i + 3) of the Words words,
+// a cell may be split across two words.
+//
+// Two keys are compared from the highest word down, like Value128.
+//
+template <std::size_t Words>
+struct PackedKey {
+    typedef std::size_t     size_type;
+
+    static const size_type kWords = Words;
+    static const size_type kMaxCells = Words * 64 / 3;
+
+    static_assert((Words > 0), "PackedKey<Words>: Words can not be 0.");
+
+    std::uint64_t words[Words];
+
+    PackedKey() noexcept {
+        for (size_type i = 0; i < Words; i++) {
+            this->words[i] = 0;
+        }
+    }
+
+    PackedKey(const PackedKey & other) noexcept {
+        for (size_type i = 0; i < Words; i++) {
+            this->words[i] = other.words[i];
+        }
+    }
+
+    ~PackedKey() {}
+
+    PackedKey & operator = (const PackedKey & rhs) noexcept {
+        for (size_type i = 0; i < Words; i++) {
+            this->words[i] = rhs.words[i];
+        }
+        return *this;
+    }
+
+    friend bool operator == (const PackedKey & lhs, const PackedKey & rhs) noexcept {
+        return lhs.is_equal(rhs);
+    }
+
+    friend bool operator != (const PackedKey & lhs, const PackedKey & rhs) noexcept {
+        return !(lhs.is_equal(rhs));
+    }
+
+    friend bool operator > (const PackedKey & lhs, const PackedKey & rhs) noexcept {
+        return (lhs.compare(rhs) == 1);
+    }
+
+    friend bool operator < (const PackedKey & lhs, const PackedKey & rhs) noexcept {
+        return (lhs.compare(rhs) == -1);
+    }
+
+    friend bool operator >= (const PackedKey & lhs, const PackedKey & rhs) noexcept {
+        return (lhs.compare(rhs) != -1);
+    }
+
+    friend bool operator <= (const PackedKey & lhs, const PackedKey & rhs) noexcept {
+        return (lhs.compare(rhs) != 1);
+    }
+
+    bool is_equal(const PackedKey & other) const noexcept {
+        size_type i = 0;
+#if MBG_USE_AVX2
+        for (; (i + 4) <= Words; i += 4) {
+            __m256i lhs = _mm256_loadu_si256((const __m256i *)&this->words[i]);
+            __m256i rhs = _mm256_loadu_si256((const __m256i *)&other.words[i]);
+            __m256i diff = _mm256_xor_si256(lhs, rhs);
+            if (_mm256_testz_si256(diff, diff) == 0)
+                return false;
+        }
+#endif
+#if MBG_USE_SSE2 || MBG_USE_AVX2
+        for (; (i + 2) <= Words; i += 2) {
+            __m128i lhs = _mm_loadu_si128((const __m128i *)&this->words[i]);
+            __m128i rhs = _mm_loadu_si128((const __m128i *)&other.words[i]);
+            __m128i equal = _mm_cmpeq_epi32(lhs, rhs);
+            if (_mm_movemask_epi8(equal) != 0xFFFF)
+                return false;
+        }
+#endif
+        for (; i < Words; i++) {
+            if (this->words[i] != other.words[i])
+                return false;
+        }
+        return true;
+    }
+
+    int compare(const PackedKey & other) const noexcept {
+        for (size_type i = Words; i > 0; i--) {
+            if (this->words[i - 1] > other.words[i - 1])
+                return 1;
+            else if (this->words[i - 1] < other.words[i - 1])
+                return -1;
+        }
+        return 0;
+    }
+
+    std::size_t hash() const noexcept {
+        // The finalizer of MurmurHash3 over the folded words
+        std::uint64_t h = this->words[0];
+        for (size_type i = 1; i < Words; i++) {
+            h = (h * 0x9E3779B97F4A7C15ULL) ^ this->words[i];
+        }
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ULL;
+        h ^= h >> 33;
+        return std::size_t(h);
+    }
+
+    std::uint32_t get_cell(size_type pos) const noexcept {
+        assert(pos < kMaxCells);
+        size_type bit = pos * 3;
+        size_type index = bit / 64;
+        size_type shift = bit % 64;
+        std::uint64_t value = this->words[index] >> shift;
+        if (shift > 61) {
+            value |= this->words[index + 1] << (64 - shift);
+        }
+        return std::uint32_t(value & 0x07U);
+    }
+
+    // XOR a 3-bit delta into the field of the cell at pos.
+    void update_cell(size_type pos, std::uint32_t delta) noexcept {
+        assert(pos < kMaxCells);
+        size_type bit = pos * 3;
+        size_type index = bit / 64;
+        size_type shift = bit % 64;
+        this->words[index] ^= std::uint64_t(delta) << shift;
+        if (shift > 61) {
+            this->words[index + 1] ^= std::uint64_t(delta) >> (64 - shift);
+        }
+    }
+
+    // Pack cells[0, count), 21 cells at a time.
+    void pack(const std::uint8_t * cells, size_type count) noexcept {
+        assert(count <= kMaxCells);
+        for (size_type i = 0; i < Words; i++) {
+            this->words[i] = 0;
+        }
+        for (size_type pos = 0; pos < count; pos += 21) {
+            size_type chunk = ((count - pos) < 21) ? (count - pos) : 21;
+            std::uint64_t value = CellPack::pack(cells + pos, chunk);
+            size_type bit = pos * 3;
+            size_type index = bit / 64;
+            size_type shift = bit % 64;
+            this->words[index] |= value << shift;
+            if (shift != 0 && (shift + chunk * 3) > 64) {
+                this->words[index + 1] |= value >> (64 - shift);
+            }
+        }
+    }
+};
+
+template <std::size_t Words>
+struct PackedKey_Hash
+{
+    std::size_t operator () (const PackedKey<Words> & key) const
+    {
+        return key.hash();
+    }
+};
+
+template <std::size_t Words>
+struct PackedKey_EqualTo
+{
+    bool operator () (const PackedKey<Words> & lhs, const PackedKey<Words> & rhs) const
+    {
+        return lhs.is_equal(rhs);
+    }
+};
+
+} // namespace AI
+} // namespace MagicBlock
@@ -0,0 +1,561 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <vector>
+#include <map>
+#include <algorithm>        // For std::sort(), std::swap(), until C++11
+#include <utility>          // For std::swap(), since C++11
+
+#if defined(_WIN32) || defined(_MSC_VER)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "MagicBlock/AI/ErrorCode.h"
+
+namespace MagicBlock {
+namespace AI {
+
+//
+// A slab allocator inside one large file-backed shared mapping.
+//
+// The mapping is cut into 2 MB chunks and each chunk belongs to one segment
+// (a group of trie root children), so the nodes of a segment are packed in
+// their own pages. A chunk is cut into 16 KB regions, each region holds the
+// blocks of one size class. The kernel writes cold pages back to the file and
+// faults them in again on demand, and evict_lru() drops the chunks of the
+// least recently used segments by hand.
+//
+// The allocations are routed here by a thread-local Scope, see scoped_malloc() and scoped_free().
+//
+class PagedArena {
+public:
+    typedef std::size_t     size_type;
+
+    static const size_type  kRegionShift = 14;
+    static const size_type  kRegionSize = size_type(1) << kRegionShift;
+    static const size_type  kChunkShift = 21;
+    static const size_type  kChunkSize = size_type(1) << kChunkShift;
+    static const size_type  kChunkRegions = kChunkSize / kRegionSize;
+    static const size_type  kMinAlignment = 16;
+
+    // 16 to 128 step by 16, then 4 classes per power of 2 up to kRegionSize
+    static const size_type  kTinyClasses = 8;
+    static const size_type  kSizeClasses = kTinyClasses + (kRegionShift - 7) * 4;
+    static const size_type  kLargeClass = 0xFF;
+
+    static const size_type  kDefaultSegments = 64;
+
+private:
+    struct RegionInfo {
+        std::uint16_t   segment;
+        std::uint8_t    sizeClass;
+        std::uint8_t    reserved;
+        std::uint32_t   count;          // The region count of a large block
+    };
+
+    struct FreeNode {
+        FreeNode * next;
+    };
+
+    struct Bin {
+        FreeNode *  freeList;
+        char *      cursor;
+        char *      limit;
+    };
+
+    struct Segment {
+        size_type                   lastUse;
+        size_type                   regionCursor;
+        size_type                   regionLimit;
+        std::vector<std::uint32_t>  chunks;
+        // The freed large blocks by region count, they stay in this segment
+        std::map<size_type, std::vector<std::uint32_t>> largeFree;
+    };
+
+    char *                      base_;
+    size_type                   reserved_bytes_;
+    size_type                   chunk_count_;
+    size_type                   next_chunk_;
+    size_type                   used_bytes_;
+    size_type                   segments_;
+    size_type                   tick_;
+
+    std::vector<RegionInfo>     regions_;
+    std::vector<Bin>            bins_;
+    std::vector<Segment>        segment_info_;
+
+#if defined(_WIN32) || defined(_MSC_VER)
+    HANDLE                      file_;
+    HANDLE                      mapping_;
+#else
+    int                         fd_;
+#endif
+
+    static PagedArena *& current_arena() {
+        static thread_local PagedArena * s_arena = nullptr;
+        return s_arena;
+    }
+
+    static size_type & current_segment() {
+        static thread_local size_type s_segment = 0;
+        return s_segment;
+    }
+
+    static size_type class_index(size_type size) {
+        if (size <= 128) {
+            return ((size + 15) / 16 - ((size != 0) ? 1 : 0));
+        }
+        size_type k = 7;
+        while ((size_type(1) << (k + 1)) < size) {
+            k++;
+        }
+        size_type step = size_type(1) << (k - 2);
+        size_type index = (size - (size_type(1) << k) + step - 1) / step;
+        return (kTinyClasses + (k - 7) * 4 + index - 1);
+    }
+
+    static size_type class_size(size_type size_class) {
+        if (size_class < kTinyClasses) {
+            return ((size_class + 1) * 16);
+        }
+        size_type c = size_class - kTinyClasses;
+        size_type k = 7 + c / 4;
+        size_type index = c % 4 + 1;
+        return ((size_type(1) << k) + index * (size_type(1) << (k - 2)));
+    }
+
+    char * region_address(size_type region) const {
+        return (this->base_ + (region << kRegionShift));
+    }
+
+    size_type region_of(const void * ptr) const {
+        return (size_type((const char *)ptr - this->base_) >> kRegionShift);
+    }
+
+    // Take count free chunks from the end of the used part.
+    bool new_chunks(size_type segment, size_type count, size_type & first) {
+        if (this->next_chunk_ + count > this->chunk_count_)
+            return false;
+        first = this->next_chunk_;
+        this->next_chunk_ += count;
+        for (size_type i = 0; i < count; i++) {
+            this->segment_info_[segment].chunks.push_back(std::uint32_t(first + i));
+        }
+        return true;
+    }
+
+    // Take count regions from the current chunk of the segment.
+    bool new_regions(size_type segment, size_type size_class, size_type count, size_type & first) {
+        Segment & info = this->segment_info_[segment];
+        if (count <= kChunkRegions) {
+            if (info.regionLimit - info.regionCursor < count) {
+                size_type chunk;
+                if (!this->new_chunks(segment, 1, chunk))
+                    return false;
+                info.regionCursor = chunk * kChunkRegions;
+                info.regionLimit = info.regionCursor + kChunkRegions;
+            }
+            first = info.regionCursor;
+            info.regionCursor += count;
+        }
+        else {
+            size_type chunk;
+            if (!this->new_chunks(segment, (count + kChunkRegions - 1) / kChunkRegions, chunk))
+                return false;
+            first = chunk * kChunkRegions;
+        }
+
+        for (size_type i = 0; i < count; i++) {
+            RegionInfo & region = this->regions_[first + i];
+            region.segment = std::uint16_t(segment);
+            region.sizeClass = std::uint8_t(size_class);
+            region.reserved = 0;
+            region.count = std::uint32_t((i == 0) ? count : 0);
+        }
+        return true;
+    }
+
+    void * allocate_small(size_type segment, size_type size_class) {
+        Bin & bin = this->bins_[segment * kSizeClasses + size_class];
+        size_type block_size = class_size(size_class);
+        if (bin.freeList != nullptr) {
+            FreeNode * node = bin.freeList;
+            bin.freeList = node->next;
+            this->used_bytes_ += block_size;
+            return (void *)node;
+        }
+        if (size_type(bin.limit - bin.cursor) < block_size) {
+            size_type region;
+            if (!this->new_regions(segment, size_class, 1, region))
+                return nullptr;
+            bin.cursor = this->region_address(region);
+            bin.limit = bin.cursor + kRegionSize;
+        }
+        void * ptr = (void *)bin.cursor;
+        bin.cursor += block_size;
+        this->used_bytes_ += block_size;
+        return ptr;
+    }
+
+    void * allocate_large(size_type segment, size_type size) {
+        size_type count = (size + kRegionSize - 1) >> kRegionShift;
+        size_type first;
+        std::map<size_type, std::vector<std::uint32_t>> & large_free = this->segment_info_[segment].largeFree;
+        auto iter = large_free.find(count);
+        if (iter != large_free.end() && !iter->second.empty()) {
+            first = iter->second.back();
+            iter->second.pop_back();
+            assert(this->regions_[first].segment == segment);
+        }
+        else if (!this->new_regions(segment, kLargeClass, count, first)) {
+            return nullptr;
+        }
+        this->used_bytes_ += count * kRegionSize;
+        return (void *)this->region_address(first);
+    }
+
+    int map_file(const char * filename, size_type reserve_bytes) {
+#if defined(_WIN32) || defined(_MSC_VER)
+        this->file_ = ::CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                                    FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+        if (this->file_ == INVALID_HANDLE_VALUE)
+            return ErrorCode::FileOpenFailed;
+
+        LARGE_INTEGER file_size;
+        file_size.QuadPart = (LONGLONG)reserve_bytes;
+        this->mapping_ = ::CreateFileMappingA(this->file_, nullptr, PAGE_READWRITE,
+                                              file_size.HighPart, file_size.LowPart, nullptr);
+        if (this->mapping_ == nullptr)
+            return ErrorCode::FileMapFailed;
+
+        void * data = ::MapViewOfFile(this->mapping_, FILE_MAP_ALL_ACCESS, 0, 0, reserve_bytes);
+        if (data == nullptr)
+            return ErrorCode::FileMapFailed;
+#else
+        this->fd_ = ::open(filename, O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (this->fd_ < 0)
+            return ErrorCode::FileOpenFailed;
+
+        // A sparse file, the blocks are allocated when the pages are written back.
+        if (::ftruncate(this->fd_, (off_t)reserve_bytes) != 0)
+            return ErrorCode::FileWriteFailed;
+
+        void * data = ::mmap(nullptr, reserve_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, this->fd_, 0);
+        if (data == MAP_FAILED)
+            return ErrorCode::FileMapFailed;
+
+        // The file is only a backing store, remove its name right away.
+        ::unlink(filename);
+#endif
+        this->base_ = (char *)data;
+        return ErrorCode::Success;
+    }
+
+public:
+    PagedArena() noexcept
+        : base_(nullptr), reserved_bytes_(0), chunk_count_(0), next_chunk_(0),
+          used_bytes_(0), segments_(0), tick_(0),
+#if defined(_WIN32) || defined(_MSC_VER)
+          file_(INVALID_HANDLE_VALUE), mapping_(nullptr) {
+#else
+          fd_(-1) {
+#endif
+    }
+
+    PagedArena(const PagedArena & src) = delete;
+    PagedArena & operator = (const PagedArena & rhs) = delete;
+
+    ~PagedArena() {
+        this->close();
+    }
+
+    bool is_open() const {
+        return (this->base_ != nullptr);
+    }
+
+    size_type segments() const {
+        return this->segments_;
+    }
+
+    // The bytes that the file mapping can hold
+    size_type reserved_bytes() const {
+        return this->reserved_bytes_;
+    }
+
+    // The bytes of the chunks in use, it's the size of the touched part of the file
+    size_type mapped_bytes() const {
+        return (this->next_chunk_ * kChunkSize);
+    }
+
+    // The bytes of the live blocks
+    size_type used_bytes() const {
+        return this->used_bytes_;
+    }
+
+    //
+    // Create a temporary backing file of reserve_bytes (sparse where supported),
+    // the file is removed when the arena is closed.
+    //
+    int create(const char * filename, size_type reserve_bytes, size_type segments = kDefaultSegments) {
+        this->close();
+
+        assert(segments > 0 && segments <= 65536);
+        reserve_bytes = (reserve_bytes + kChunkSize - 1) & ~(kChunkSize - 1);
+        if (reserve_bytes == 0 || segments == 0)
+            return ErrorCode::FileMapFailed;
+
+        int status = this->map_file(filename, reserve_bytes);
+        if (ErrorCode::isFailure(status)) {
+            this->close();
+            return status;
+        }
+
+        this->reserved_bytes_ = reserve_bytes;
+        this->chunk_count_ = reserve_bytes >> kChunkShift;
+        this->next_chunk_ = 0;
+        this->used_bytes_ = 0;
+        this->segments_ = segments;
+        this->tick_ = 0;
+
+        this->regions_.resize(reserve_bytes >> kRegionShift);
+        Bin empty_bin = { nullptr, nullptr, nullptr };
+        this->bins_.assign(segments * kSizeClasses, empty_bin);
+        this->segment_info_.resize(segments);
+        for (size_type segment = 0; segment < segments; segment++) {
+            Segment & info = this->segment_info_[segment];
+            info.lastUse = 0;
+            info.regionCursor = 0;
+            info.regionLimit = 0;
+            info.chunks.clear();
+            info.largeFree.clear();
+        }
+        return ErrorCode::Success;
+    }
+
+    void close() {
+        if (this->base_ != nullptr) {
+#if defined(_WIN32) || defined(_MSC_VER)
+            ::UnmapViewOfFile(this->base_);
+#else
+            ::munmap(this->base_, this->reserved_bytes_);
+#endif
+            this->base_ = nullptr;
+        }
+#if defined(_WIN32) || defined(_MSC_VER)
+        if (this->mapping_ != nullptr) {
+            ::CloseHandle(this->mapping_);
+            this->mapping_ = nullptr;
+        }
+        if (this->file_ != INVALID_HANDLE_VALUE) {
+            ::CloseHandle(this->file_);
+            this->file_ = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (this->fd_ >= 0) {
+            ::close(this->fd_);
+            this->fd_ = -1;
+        }
+#endif
+        this->reserved_bytes_ = 0;
+        this->chunk_count_ = 0;
+        this->next_chunk_ = 0;
+        this->used_bytes_ = 0;
+        this->segments_ = 0;
+
+        std::vector<RegionInfo>().swap(this->regions_);
+        std::vector<Bin>().swap(this->bins_);
+        std::vector<Segment>().swap(this->segment_info_);
+    }
+
+    bool owns(const void * ptr) const {
+        return (ptr >= (const void *)this->base_ &&
+                ptr < (const void *)(this->base_ + this->reserved_bytes_));
+    }
+
+    // The segment that the block of ptr was allocated for
+    size_type segment_of(const void * ptr) const {
+        assert(this->owns(ptr));
+        return this->regions_[this->region_of(ptr)].segment;
+    }
+
+    // Return nullptr when the file mapping is full.
+    void * allocate(size_type segment, size_type size) {
+        assert(this->is_open());
+        assert(segment < this->segments_);
+        size = (size + kMinAlignment - 1) & ~(kMinAlignment - 1);
+        if (size <= kRegionSize)
+            return this->allocate_small(segment, class_index(size));
+        else
+            return this->allocate_large(segment, size);
+    }
+
+    void deallocate(void * ptr) {
+        assert(this->owns(ptr));
+        size_type region = this->region_of(ptr);
+        const RegionInfo & info = this->regions_[region];
+        if (info.sizeClass != kLargeClass) {
+            Bin & bin = this->bins_[info.segment * kSizeClasses + info.sizeClass];
+            FreeNode * node = (FreeNode *)ptr;
+            node->next = bin.freeList;
+            bin.freeList = node;
+            this->used_bytes_ -= class_size(info.sizeClass);
+        }
+        else {
+            assert(info.count != 0);
+            this->segment_info_[info.segment].largeFree[info.count].push_back(std::uint32_t(region));
+            this->used_bytes_ -= info.count * kRegionSize;
+        }
+    }
+
+    void touch(size_type segment) {
+        assert(segment < this->segments_);
+        this->segment_info_[segment].lastUse = ++this->tick_;
+    }
+
+    //
+    // Hint the kernel that the pages of the segment can be written back and dropped,
+    // they are faulted in again from the file on the next access.
+    //
+    void advise_cold(size_type segment) {
+        assert(segment < this->segments_);
+#if !(defined(_WIN32) || defined(_MSC_VER))
+        // The page cache may use large folios, so only whole chunks are dropped.
+        const std::vector<std::uint32_t> & chunks = this->segment_info_[segment].chunks;
+        for (size_type i = 0; i < chunks.size(); i++) {
+            size_type offset = size_type(chunks[i]) << kChunkShift;
+            char * address = this->base_ + offset;
+            // Write the dirty pages back, unmap them, then drop them from the page cache.
+            ::msync(address, kChunkSize, MS_SYNC);
+            ::madvise(address, kChunkSize, MADV_DONTNEED);
+            ::posix_fadvise(this->fd_, (off_t)offset, kChunkSize, POSIX_FADV_DONTNEED);
+        }
+#else
+        (void)segment;
+#endif
+    }
+
+    //
+    // Keep the pages of the keep_count most recently used segments only.
+    //
+    size_type evict_lru(size_type keep_count) {
+        std::vector<std::uint32_t> order;
+        order.reserve(this->segments_);
+        for (size_type segment = 0; segment < this->segments_; segment++) {
+            if (!this->segment_info_[segment].chunks.empty())
+                order.push_back(std::uint32_t(segment));
+        }
+        if (order.size() <= keep_count)
+            return 0;
+
+        const std::vector<Segment> & segment_info = this->segment_info_;
+        std::sort(order.begin(), order.end(), [&segment_info](std::uint32_t lhs, std::uint32_t rhs) {
+            return (segment_info[lhs].lastUse < segment_info[rhs].lastUse);
+        });
+
+        size_type evicted = order.size() - keep_count;
+        for (size_type i = 0; i < evicted; i++) {
+            this->advise_cold(order[i]);
+        }
+        return evicted;
+    }
+
+    // Write the dirty pages back to the file.
+    void flush() {
+        if (this->base_ != nullptr && this->next_chunk_ != 0) {
+#if defined(_WIN32) || defined(_MSC_VER)
+            ::FlushViewOfFile(this->base_, this->mapped_bytes());
+#else
+            ::msync(this->base_, this->mapped_bytes(), MS_SYNC);
+#endif
+        }
+    }
+
+    // The bytes of the used regions that are in memory now.
+    size_type resident_bytes() const {
+        size_type bytes = 0;
+#if !(defined(_WIN32) || defined(_MSC_VER))
+        if (this->base_ != nullptr && this->next_chunk_ != 0) {
+            size_type page_size = (size_type)::sysconf(_SC_PAGESIZE);
+            size_type pages = (this->mapped_bytes() + page_size - 1) / page_size;
+            std::vector<unsigned char> in_core(pages);
+            if (::mincore(this->base_, this->mapped_bytes(), in_core.data()) == 0) {
+                for (size_type i = 0; i < pages; i++) {
+                    if (in_core[i] & 1)
+                        bytes += page_size;
+                }
+            }
+        }
+#endif
+        return bytes;
+    }
+
+    //
+    // The current arena and segment of this thread, see SparseBitset.
+    //
+    class Scope {
+    private:
+        PagedArena *    saved_arena_;
+        size_type       saved_segment_;
+
+    public:
+        Scope(PagedArena * arena, size_type segment = 0)
+            : saved_arena_(current_arena()), saved_segment_(current_segment()) {
+            current_arena() = arena;
+            current_segment() = segment;
+            if (arena != nullptr) {
+                arena->touch(segment);
+            }
+        }
+
+        ~Scope() {
+            current_arena() = this->saved_arena_;
+            current_segment() = this->saved_segment_;
+        }
+    };
+
+    //
+    // Allocate from the current arena of this thread, or from the heap
+    // when there is none or it is full.
+    //
+    static void * scoped_malloc(size_type size) {
+        PagedArena * arena = current_arena();
+        if (arena != nullptr) {
+            void * ptr = arena->allocate(current_segment(), size);
+            if (ptr != nullptr)
+                return ptr;
+        }
+        return std::malloc(size);
+    }
+
+    static void scoped_free(void * ptr) {
+        if (ptr != nullptr) {
+            PagedArena * arena = current_arena();
+            if (arena != nullptr && arena->owns(ptr))
+                arena->deallocate(ptr);
+            else
+                std::free(ptr);
+        }
+    }
+};
+
+} // namespace AI
+} // namespace MagicBlock
@@ -17,7 +17,12 @@
 #include "MagicBlock/AI/Number.h"
 #include "MagicBlock/AI/Move.h"
 #include "MagicBlock/AI/CanMoves.h"
+#include "MagicBlock/AI/MoveTable.h"
+#include "MagicBlock/AI/MoveFsm.h"
 #include "MagicBlock/AI/Board.h"
+#include "MagicBlock/AI/BoardSymmetry.h"
+#include "MagicBlock/AI/PackedBoard.h"
+#include "MagicBlock/AI/MoveTree.h"
 #include "MagicBlock/AI/Stage.h"
 #include "MagicBlock/AI/ErrorCode.h"
 #include "MagicBlock/AI/BitSet.h"
@@ -25,7 +30,12 @@
 namespace MagicBlock {
 namespace AI {
 
-template <std::size_t BoardX, std::size_t BoardY, bool AllowRotate = true>
+//
+// BoardType is the board of the search, Board<BoardX, BoardY> or
+// PackedBoard<BoardX, BoardY>. The boards are read as Board<BoardX, BoardY>.
+//
+template <std::size_t BoardX, std::size_t BoardY, bool AllowRotate = true,
+          typename BoardType = Board<BoardX, BoardY>>
 class SlidingColorPuzzle
 {
 public:
@@ -36,11 +46,13 @@ public:
     static const size_type kMapBits = size_type(1U) << (BoardSize * 3);
     static const size_type kSingelColorNums = 4;
 
-    typedef Stage<BoardX, BoardY>                   stage_type;
+    typedef BoardType                               board_type;
+    typedef Stage<BoardX, BoardY, board_type>       stage_type;
     typedef Board<BoardX, BoardY>                   player_board_t;
     typedef Board<BoardX, BoardY>                   target_board_t;
     typedef CanMoves<BoardX, BoardY>                can_moves_t;
     typedef typename can_moves_t::can_move_list_t   can_move_list_t;
+    typedef MoveTable<BoardX, BoardY>               move_table_t;
 
 private:
     Board<BoardX, BoardY> player_board_;
@@ -312,13 +324,13 @@ public:
         return false;
     }
 
-    bool is_satisfy(const Board<BoardX, BoardY> & player,
-                    const Board<BoardX, BoardY> & target) const {
+    template <typename TBoard>
+    bool is_satisfy(const TBoard & player, const TBoard & target) const {
         return (player == target);
     }
 
-    size_type is_satisfy(const Board<BoardX, BoardY> & player,
-                         const Board<BoardX, BoardY> target[4],
+    template <typename TBoard>
+    size_type is_satisfy(const TBoard & player, const TBoard target[4],
                          size_type target_len) const {
         for (size_type index = 0; index < target_len; index++) {
             if (player == target[index]) {
@@ -344,35 +356,75 @@ public:
         if (found_empty) {
             jstd::BitSet<kMapBits> visited;
 
+            board_type target_board[4];
+            for (size_type i = 0; i < this->target_len_; i++) {
+                target_board[i] = board_type(this->target_board_[i]);
+            }
+
+            // The visited set keeps one board of each symmetric class
+            BoardSymmetry<BoardX, BoardY> symmetry;
+#if STAGES_USE_SYMMETRY
+            symmetry.init(this->target_board_, this->target_len_);
+#endif
+            bool use_symmetry = symmetry.is_enabled();
+
             stage_type start;
             start.empty_pos = empty;
             start.last_dir = uint8_t(-1);
             start.rotate_type = 0;
-            start.board = this->player_board_;
-            visited.set(start.board.value());
+            start.board = board_type(this->player_board_);
+            start.value = start.board.value128();
+            if (use_symmetry)
+                visited.set(symmetry.canonical_value(start.board.value()));
+            else
+                visited.set(start.board.value());
 
             std::vector<stage_type> cur_stages;
             std::vector<stage_type> next_stages;
+#if STAGES_USE_MOVE_TREE
+            MoveTree move_tree;
+#endif
 
             cur_stages.push_back(start);
 
             bool exit = false;
             while (cur_stages.size() > 0) {
+#if STAGES_USE_MOVE_FSM
+                const MoveFsm & move_fsm = MoveFsm::getInstance();
+#endif
                 for (size_type i = 0; i < cur_stages.size(); i++) {
                     const stage_type & stage = cur_stages[i];
 
                     uint8_t empty_pos = stage.empty_pos;
-                    const can_move_list_t & can_moves = this->can_moves_[empty_pos];
-                    size_type total_moves = can_moves.size();
-                    for (size_type n = 0; n < total_moves; n++) {
-                        uint8_t cur_dir = can_moves[n].dir;
+                    const MoveEntry * moves = move_table_t::moves(empty_pos);
+                    for (size_type n = 0; n < Dir::Maximum; n++) {
+                        if (moves[n].valid == 0)
+                            continue;
+
+                        uint8_t cur_dir = moves[n].dir;
+#if STAGES_USE_MOVE_FSM
+                        // The FSM is exact only when every board is visited as it is
+                        uint8_t fsm_state = MoveFsm::kStart;
+                        if (use_symmetry) {
+                            if (cur_dir == stage.last_dir)
+                                continue;
+                        }
+                        else {
+                            fsm_state = move_fsm.next(stage.fsm_state, n);
+                            if (fsm_state == MoveFsm::kPruned)
+                                continue;
+                        }
+#else
                         if (cur_dir == stage.last_dir)
                             continue;
+#endif
 
-                        uint8_t move_pos = can_moves[n].pos;
-                        stage_type next_stage(stage.board);
-                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
+                        uint8_t move_pos = moves[n].pos;
+                        stage_type next_stage(stage.board, stage.value);
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
                         size_type board_value = next_stage.board.value();
+                        if (use_symmetry)
+                            board_value = size_type(symmetry.canonical_value(board_value));
                         if (visited.test(board_value))
                             continue;
 
@@ -380,11 +432,21 @@ public:
                         
                         next_stage.empty_pos = move_pos;
                         next_stage.last_dir = Dir::opp_dir(cur_dir);
+#if STAGES_USE_MOVE_FSM
+                        next_stage.fsm_state = fsm_state;
+#endif
                         //next_stage.rotate_type = 0;
+#if STAGES_USE_MOVE_TREE
+                        next_stage.move_node = move_tree.append(stage.move_node, cur_dir);
+#else
                         next_stage.move_seq = stage.move_seq;
                         next_stage.move_seq.push_back(cur_dir);
+#endif
 
-                        if (this->is_satisfy(next_stage.board, this->target_board_, this->target_len_) != size_t(-1)) {
+                        if (this->is_satisfy(next_stage.board, target_board, this->target_len_) != size_t(-1)) {
+#if STAGES_USE_MOVE_TREE
+                            move_tree.get_move_seq(next_stage.move_node, next_stage.move_seq);
+#endif
                             this->move_seq_ = next_stage.move_seq;
                             assert((depth + 1) == next_stage.move_seq.size());
                             solvable = true;
@@ -432,35 +494,75 @@ public:
         if (found_empty) {
             jstd::BitSet<kMapBits> visited;
 
+            board_type target_board[4];
+            for (size_type i = 0; i < this->target_len_; i++) {
+                target_board[i] = board_type(this->target_board_[i]);
+            }
+
+            // The visited set keeps one board of each symmetric class
+            BoardSymmetry<BoardX, BoardY> symmetry;
+#if STAGES_USE_SYMMETRY
+            symmetry.init(this->target_board_, this->target_len_);
+#endif
+            bool use_symmetry = symmetry.is_enabled();
+
             stage_type start;
             start.empty_pos = empty;
             start.last_dir = uint8_t(-1);
             start.rotate_type = 0;
-            start.board = this->player_board_;
-            visited.set(start.board.value());
+            start.board = board_type(this->player_board_);
+            start.value = start.board.value128();
+            if (use_symmetry)
+                visited.set(symmetry.canonical_value(start.board.value()));
+            else
+                visited.set(start.board.value());
 
             std::queue<stage_type> cur_stages;
             std::queue<stage_type> next_stages;
+#if STAGES_USE_MOVE_TREE
+            MoveTree move_tree;
+#endif
 
             cur_stages.push(start);
 
             bool exit = false;
             while (cur_stages.size() > 0) {
+#if STAGES_USE_MOVE_FSM
+                const MoveFsm & move_fsm = MoveFsm::getInstance();
+#endif
                 do {
                     const stage_type & stage = cur_stages.front();
 
                     uint8_t empty_pos = stage.empty_pos;
-                    const can_move_list_t & can_moves = this->can_moves_[empty_pos];
-                    size_type total_moves = can_moves.size();
-                    for (size_type n = 0; n < total_moves; n++) {
-                        uint8_t cur_dir = can_moves[n].dir;
+                    const MoveEntry * moves = move_table_t::moves(empty_pos);
+                    for (size_type n = 0; n < Dir::Maximum; n++) {
+                        if (moves[n].valid == 0)
+                            continue;
+
+                        uint8_t cur_dir = moves[n].dir;
+#if STAGES_USE_MOVE_FSM
+                        // The FSM is exact only when every board is visited as it is
+                        uint8_t fsm_state = MoveFsm::kStart;
+                        if (use_symmetry) {
+                            if (cur_dir == stage.last_dir)
+                                continue;
+                        }
+                        else {
+                            fsm_state = move_fsm.next(stage.fsm_state, n);
+                            if (fsm_state == MoveFsm::kPruned)
+                                continue;
+                        }
+#else
                         if (cur_dir == stage.last_dir)
                             continue;
+#endif
 
-                        uint8_t move_pos = can_moves[n].pos;
-                        stage_type next_stage(stage.board);
-                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
+                        uint8_t move_pos = moves[n].pos;
+                        stage_type next_stage(stage.board, stage.value);
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
                         size_type board_value = next_stage.board.value();
+                        if (use_symmetry)
+                            board_value = size_type(symmetry.canonical_value(board_value));
                         if (visited.test(board_value))
                             continue;
 
@@ -468,11 +570,21 @@ public:
                         
                         next_stage.empty_pos = move_pos;
                         next_stage.last_dir = Dir::opp_dir(cur_dir);
+#if STAGES_USE_MOVE_FSM
+                        next_stage.fsm_state = fsm_state;
+#endif
                         //next_stage.rotate_type = 0;
+#if STAGES_USE_MOVE_TREE
+                        next_stage.move_node = move_tree.append(stage.move_node, cur_dir);
+#else
                         next_stage.move_seq = stage.move_seq;
                         next_stage.move_seq.push_back(cur_dir);
+#endif
 
-                        if (this->is_satisfy(next_stage.board, this->target_board_, this->target_len_) != size_t(-1)) {
+                        if (this->is_satisfy(next_stage.board, target_board, this->target_len_) != size_t(-1)) {
+#if STAGES_USE_MOVE_TREE
+                            move_tree.get_move_seq(next_stage.move_node, next_stage.move_seq);
+#endif
                             this->move_seq_ = next_stage.move_seq;
                             assert((depth + 1) == next_stage.move_seq.size());
                             solvable = true;
@@ -304,6 +304,7 @@ public:
             start.last_dir = uint8_t(-1);
             start.rotate_type = 0;
             start.board = this->player_board_;
+            start.value = start.board.value128();
             visited[empty.value].set(start.board.template compactValue<kEmptyColor>());
 
             std::vector<stage_type> cur_stages;
@@ -325,8 +326,8 @@ public:
                             continue;
 
                         uint8_t move_pos = can_moves[n].pos;
-                        stage_type next_stage(stage.board);
-                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
+                        stage_type next_stage(stage.board, stage.value);
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
                         size_type value64 = next_stage.board.template compactValue<kEmptyColor>();
                         if (visited[move_pos].test(value64))
                             continue;
@@ -400,6 +401,7 @@ public:
             start.last_dir = uint8_t(-1);
             start.rotate_type = 0;
             start.board = this->player_board_;
+            start.value = start.board.value128();
             visited[empty.value].set(start.board.template compactValue<kEmptyColor>());
 
             std::queue<stage_type> cur_stages;
@@ -421,8 +423,8 @@ public:
                             continue;
 
                         uint8_t move_pos = can_moves[n].pos;
-                        stage_type next_stage(stage.board);
-                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
+                        stage_type next_stage(stage.board, stage.value);
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
                         size_type value64 = next_stage.board.template compactValue<kEmptyColor>();
                         if (visited[move_pos].test(value64))
                             continue;
@@ -19,6 +19,7 @@
 #include "MagicBlock/AI/Move.h"
 #include "MagicBlock/AI/CanMoves.h"
 #include "MagicBlock/AI/Board.h"
+#include "MagicBlock/AI/BoardRank.h"
 #include "MagicBlock/AI/Stage.h"
 #include "MagicBlock/AI/Answer.h"
 #include "MagicBlock/AI/ErrorCode.h"
@@ -42,6 +43,7 @@ public:
     typedef Board<BoardX, BoardY>                   player_board_t;
     typedef Board<BoardX, BoardY>                   target_board_t;
     typedef CanMoves<BoardX, BoardY>                can_moves_t;
+    typedef BoardRank<BoardX, BoardY>               board_rank_t;
     typedef typename can_moves_t::can_move_list_t   can_move_list_t;
 
     static const size_type BoardSize = BoardX * BoardY;
@@ -297,6 +299,11 @@ public:
             return this->bitset_solve();
         else if (BoardSize * GridBits <= 64)
             return this->stdset_solve_64();
+
+        // The boards don't fit in value64(), use the ranks of the boards if possible
+        board_rank_t board_rank(this->player_board_, kEmptyColor);
+        if (board_rank.is_valid())
+            return this->stdset_solve_rank(board_rank);
         else
             return this->stdset_solve();
     }
@@ -306,6 +313,10 @@ public:
             return this->bitset_queue_solve();
         else if (BoardSize * GridBits <= 64)
             return this->stdset_queue_solve_64();
+
+        board_rank_t board_rank(this->player_board_, kEmptyColor);
+        if (board_rank.is_valid())
+            return this->stdset_queue_solve_rank(board_rank);
         else
             return this->stdset_queue_solve();
     }
@@ -328,6 +339,7 @@ public:
             start.last_dir = uint8_t(-1);
             start.rotate_type = 0;
             start.board = this->player_board_;
+            start.value = start.board.value128();
             visited.insert(start.board.value64());
 
             std::vector<stage_type> cur_stages;
@@ -349,8 +361,8 @@ public:
                             continue;
 
                         uint8_t move_pos = can_moves[n].pos;
-                        stage_type next_stage(stage.board);
-                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
+                        stage_type next_stage(stage.board, stage.value);
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
                         std::uint64_t value64 = next_stage.board.value64();
                         if (visited.count(value64) > 0)
                             continue;
@@ -436,6 +448,7 @@ public:
             start.last_dir = uint8_t(-1);
             start.rotate_type = 0;
             start.board = this->player_board_;
+            start.value = start.board.value128();
             visited.insert(start.board.value64());
 
             std::queue<stage_type> cur_stages;
@@ -457,8 +470,8 @@ public:
                             continue;
 
                         uint8_t move_pos = can_moves[n].pos;
-                        stage_type next_stage(stage.board);
-                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
+                        stage_type next_stage(stage.board, stage.value);
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
                         std::uint64_t value64 = next_stage.board.value64();
                         if (visited.count(value64) > 0)
                             continue;
@@ -527,7 +540,7 @@ public:
         return solvable;
     }
 
-    bool stdset_solve() {
+    bool stdset_solve_rank(const board_rank_t & board_rank) {
         if (this->is_satisfy(this->player_board_, this->target_board_)) {
             return true;
         }
@@ -538,14 +551,14 @@ public:
         Position empty;
         bool found_empty = this->find_empty(empty);
         if (found_empty) {
-            std::set<Value128> visited;
+            std::set<std::uint64_t> visited;
 
             stage_type start;
             start.empty_pos = empty;
             start.last_dir = uint8_t(-1);
             start.rotate_type = 0;
             start.board = this->player_board_;
-            visited.insert(start.board.value128());
+            visited.insert(board_rank.rank(start.board));
 
             std::vector<stage_type> cur_stages;
             std::vector<stage_type> next_stages;
@@ -558,6 +571,7 @@ public:
                     const stage_type & stage = cur_stages[i];
 
                     uint8_t empty_pos = stage.empty_pos;
+                    std::uint64_t rank = board_rank.rank(stage.board);
                     const can_move_list_t & can_moves = this->can_moves_[empty_pos];
                     size_type total_moves = can_moves.size();
                     for (size_type n = 0; n < total_moves; n++) {
@@ -568,7 +582,226 @@ public:
                         uint8_t move_pos = can_moves[n].pos;
                         stage_type next_stage(stage.board);
                         std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
-                        Value128 value128 = next_stage.board.value128();
+                        std::uint64_t next_rank = board_rank.move(rank, next_stage.board, empty_pos, move_pos);
+                        if (visited.count(next_rank) > 0)
+                            continue;
+
+                        visited.insert(next_rank);
+                        
+                        next_stage.empty_pos = move_pos;
+                        next_stage.last_dir = Dir::opp_dir(cur_dir);
+                        //next_stage.rotate_type = 0;
+                        next_stage.move_seq = stage.move_seq;
+                        next_stage.move_seq.push_back(cur_dir);
+
+                        if (this->is_satisfy(next_stage.board, this->target_board_)) {
+                            size_type total_steps = next_stage.move_seq.size();
+                            assert((depth + 1) == total_steps);
+                            if (this->isMinSteps(total_steps)) {
+                                this->setMinSteps(total_steps);
+                                this->clearAllAnswers();
+                                this->appendAnswer(&this->player_board_, next_stage.board,
+                                    next_stage.move_seq);
+                            }
+                            else if (this->isEqualMinSteps(total_steps)) {
+                                this->appendAnswer(&this->player_board_, next_stage.board,
+                                    next_stage.move_seq);
+                            }
+                            solvable = true;
+                            exit = true;
+                            if (!SearchAllAnswers)
+                                break;
+                        }
+
+                        next_stages.push_back(std::move(next_stage));
+                    }
+
+                    if (!SearchAllAnswers) {
+                        if (exit) {
+                            break;
+                        }
+                    }
+                }
+
+                depth++;
+                if (1) {
+                    printf("depth = %u\n", (uint32_t)depth);
+                    printf("cur.size() = %u, next.size() = %u\n",
+                           (uint32_t)(cur_stages.size()), (uint32_t)(next_stages.size()));
+                    printf("visited.size() = %u\n\n", (uint32_t)(visited.size()));
+                }
+
+                std::swap(cur_stages, next_stages);
+                next_stages.clear();
+
+                if (exit) {
+                    break;
+                }
+            }
+
+            this->setMapUsed(visited.size());
+
+            if (solvable) {
+                //
+            }
+        }
+
+        return solvable;
+    }
+
+    bool stdset_queue_solve_rank(const board_rank_t & board_rank) {
+        if (this->is_satisfy(this->player_board_, this->target_board_)) {
+            return true;
+        }
+
+        bool solvable = false;
+        size_type depth = 0;
+
+        Position empty;
+        bool found_empty = this->find_empty(empty);
+        if (found_empty) {
+            std::set<std::uint64_t> visited;
+
+            stage_type start;
+            start.empty_pos = empty;
+            start.last_dir = uint8_t(-1);
+            start.rotate_type = 0;
+            start.board = this->player_board_;
+            visited.insert(board_rank.rank(start.board));
+
+            std::queue<stage_type> cur_stages;
+            std::queue<stage_type> next_stages;
+
+            cur_stages.push(start);
+
+            bool exit = false;
+            while (cur_stages.size() > 0) {
+                do {
+                    const stage_type & stage = cur_stages.front();
+
+                    uint8_t empty_pos = stage.empty_pos;
+                    std::uint64_t rank = board_rank.rank(stage.board);
+                    const can_move_list_t & can_moves = this->can_moves_[empty_pos];
+                    size_type total_moves = can_moves.size();
+                    for (size_type n = 0; n < total_moves; n++) {
+                        uint8_t cur_dir = can_moves[n].dir;
+                        if (cur_dir == stage.last_dir)
+                            continue;
+
+                        uint8_t move_pos = can_moves[n].pos;
+                        stage_type next_stage(stage.board);
+                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
+                        std::uint64_t next_rank = board_rank.move(rank, next_stage.board, empty_pos, move_pos);
+                        if (visited.count(next_rank) > 0)
+                            continue;
+
+                        visited.insert(next_rank);
+                        
+                        next_stage.empty_pos = move_pos;
+                        next_stage.last_dir = Dir::opp_dir(cur_dir);
+                        //next_stage.rotate_type = 0;
+                        next_stage.move_seq = stage.move_seq;
+                        next_stage.move_seq.push_back(cur_dir);
+
+                        if (this->is_satisfy(next_stage.board, this->target_board_)) {
+                            size_type total_steps = next_stage.move_seq.size();
+                            assert((depth + 1) == total_steps);
+                            if (this->isMinSteps(total_steps)) {
+                                this->setMinSteps(total_steps);
+                                this->clearAllAnswers();
+                                this->appendAnswer(&this->player_board_, next_stage.board,
+                                    next_stage.move_seq);
+                            }
+                            else if (this->isEqualMinSteps(total_steps)) {
+                                this->appendAnswer(&this->player_board_, next_stage.board,
+                                    next_stage.move_seq);
+                            }
+                            solvable = true;
+                            exit = true;
+                            if (!SearchAllAnswers)
+                                break;
+                        }
+
+                        next_stages.push(std::move(next_stage));
+                    }
+
+                    cur_stages.pop();
+
+                    if (!SearchAllAnswers) {
+                        if (exit) {
+                            break;
+                        }
+                    }
+                } while (cur_stages.size() > 0);
+
+                depth++;
+                if (1) {
+                    printf("depth = %u\n", (uint32_t)depth);
+                    printf("cur.size() = %u, next.size() = %u\n",
+                           (uint32_t)(cur_stages.size()), (uint32_t)(next_stages.size()));
+                    printf("visited.size() = %u\n\n", (uint32_t)(visited.size()));
+                }
+
+                std::swap(cur_stages, next_stages);
+
+                if (exit) {
+                    break;
+                }
+            }
+
+            this->setMapUsed(visited.size());
+
+            if (solvable) {
+                //
+            }
+        }
+
+        return solvable;
+    }
+
+    bool stdset_solve() {
+        if (this->is_satisfy(this->player_board_, this->target_board_)) {
+            return true;
+        }
+
+        bool solvable = false;
+        size_type depth = 0;
+
+        Position empty;
+        bool found_empty = this->find_empty(empty);
+        if (found_empty) {
+            std::set<Value128> visited;
+
+            stage_type start;
+            start.empty_pos = empty;
+            start.last_dir = uint8_t(-1);
+            start.rotate_type = 0;
+            start.board = this->player_board_;
+            start.value = start.board.value128();
+            visited.insert(start.value);
+
+            std::vector<stage_type> cur_stages;
+            std::vector<stage_type> next_stages;
+
+            cur_stages.push_back(start);
+
+            bool exit = false;
+            while (cur_stages.size() > 0) {
+                for (size_type i = 0; i < cur_stages.size(); i++) {
+                    const stage_type & stage = cur_stages[i];
+
+                    uint8_t empty_pos = stage.empty_pos;
+                    const can_move_list_t & can_moves = this->can_moves_[empty_pos];
+                    size_type total_moves = can_moves.size();
+                    for (size_type n = 0; n < total_moves; n++) {
+                        uint8_t cur_dir = can_moves[n].dir;
+                        if (cur_dir == stage.last_dir)
+                            continue;
+
+                        uint8_t move_pos = can_moves[n].pos;
+                        stage_type next_stage(stage.board, stage.value);
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
+                        Value128 value128 = next_stage.value;
                         if (visited.count(value128) > 0)
                             continue;
 
@@ -653,7 +886,8 @@ public:
             start.last_dir = uint8_t(-1);
             start.rotate_type = 0;
             start.board = this->player_board_;
-            visited.insert(start.board.value128());
+            start.value = start.board.value128();
+            visited.insert(start.value);
 
             std::queue<stage_type> cur_stages;
             std::queue<stage_type> next_stages;
@@ -674,9 +908,9 @@ public:
                             continue;
 
                         uint8_t move_pos = can_moves[n].pos;
-                        stage_type next_stage(stage.board);
-                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
-                        Value128 value128 = next_stage.board.value128();
+                        stage_type next_stage(stage.board, stage.value);
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
+                        Value128 value128 = next_stage.value;
                         if (visited.count(value128) > 0)
                             continue;
 
@@ -762,6 +996,7 @@ public:
             start.last_dir = uint8_t(-1);
             start.rotate_type = 0;
             start.board = this->player_board_;
+            start.value = start.board.value128();
             visited.set(start.board.value());
 
             std::vector<stage_type> cur_stages;
@@ -783,8 +1018,8 @@ public:
                             continue;
 
                         uint8_t move_pos = can_moves[n].pos;
-                        stage_type next_stage(stage.board);
-                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
+                        stage_type next_stage(stage.board, stage.value);
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
                         size_type board_value = next_stage.board.value();
                         if (visited.test(board_value))
                             continue;
@@ -870,6 +1105,7 @@ public:
             start.last_dir = uint8_t(-1);
             start.rotate_type = 0;
             start.board = this->player_board_;
+            start.value = start.board.value128();
             visited.set(start.board.value());
 
             std::queue<stage_type> cur_stages;
@@ -891,8 +1127,8 @@ public:
                             continue;
 
                         uint8_t move_pos = can_moves[n].pos;
-                        stage_type next_stage(stage.board);
-                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
+                        stage_type next_stage(stage.board, stage.value);
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
                         size_type board_value = next_stage.board.value();
                         if (visited.test(board_value))
                             continue;
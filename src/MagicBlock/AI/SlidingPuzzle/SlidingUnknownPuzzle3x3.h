@@ -308,6 +308,7 @@ public:
             start.last_dir = uint8_t(-1);
             start.rotate_type = 0;
             start.board = this->player_board_;
+            start.value = start.board.value128();
             visited[empty.value].set(start.board.template compactValue<kEmptyColor>());
 
             std::vector<stage_type> cur_stages;
@@ -340,8 +341,8 @@ public:
                             continue;
 
                         uint8_t move_pos = can_moves[n].pos;
-                        stage_type next_stage(stage.board);
-                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
+                        stage_type next_stage(stage.board, stage.value);
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
                         size_type board_value = next_stage.board.template compactValue<kEmptyColor>();
                         if (visited[move_pos].test(board_value))
                             continue;
@@ -434,6 +435,7 @@ public:
             start.last_dir = uint8_t(-1);
             start.rotate_type = 0;
             start.board = this->player_board_;
+            start.value = start.board.value128();
             visited[empty.value].set(start.board.template compactValue<kEmptyColor>());
 
             std::queue<stage_type> cur_stages;
@@ -466,8 +468,8 @@ public:
                             continue;
 
                         uint8_t move_pos = can_moves[n].pos;
-                        stage_type next_stage(stage.board);
-                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
+                        stage_type next_stage(stage.board, stage.value);
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
                         size_type board_value = next_stage.board.template compactValue<kEmptyColor>();
                         if (visited[move_pos].test(board_value))
                             continue;
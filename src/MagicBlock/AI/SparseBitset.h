@@ -16,13 +16,20 @@
 #include <bitset>
 #include <algorithm>        // For std::swap(), until C++11
 #include <utility>          // For std::swap(), since C++11
+#include <iterator>         // For std::forward_iterator_tag
+#include <type_traits>      // For std::conditional<bool, T1, T2>
 #include <exception>
 #include <stdexcept>
 
 #include "MagicBlock/AI/Color.h"
 #include "MagicBlock/AI/Board.h"
 #include "MagicBlock/AI/Value128.h"
+#include "MagicBlock/AI/CellPack.h"
 #include "MagicBlock/AI/Algorithm.h"
+#include "MagicBlock/AI/LayerOrder.h"
+#include "MagicBlock/AI/BloomFilter.h"
+#include "MagicBlock/AI/PagedArena.h"
+#include "MagicBlock/AI/Config.h"
 
 #define SPARSEBITSET_USE_INDEX_SORT     1
 #define SPARSEBITSET_USE_TRIE_INFO      0
@@ -30,35 +37,62 @@
 namespace MagicBlock {
 namespace AI {
 
-template <typename Board, std::size_t Bits, std::size_t Length>
+template <typename Board, std::size_t Bits, std::size_t Length,
+          std::size_t Order = LayerOrder::Interleaved>
 class SparseBitset {
 public:
     typedef std::size_t         size_type;
     typedef std::ptrdiff_t      ssize_type;
 
     typedef Board               board_type;
+    typedef SparseBitset<Board, Bits, Length, Order>    this_type;
 
     static const size_type      BoardX = board_type::Y;
     static const size_type      BoardY = board_type::X;
     static const size_type      BoardSize = board_type::BoardSize;
+    static const size_type      kLayerOrder = Order;
 
     static const size_type      kBitMask = (size_type(1) << Bits) - 1;
 
+    // The id of a row (a trie layer) has Bits * BoardX bits, the rows of
+    // more than 5 cells (18 or 21 bits) use the 32-bit ids.
+    typedef typename std::conditional<
+                (Bits * BoardX <= 16), std::uint16_t, std::uint32_t
+            >::type  ident_type;
+
     static const size_type      kDefaultArrayCapacity = 4;
 
     static const size_type      kArraySizeThreshold = 16384;
     static const size_type      kMaxArraySize = size_type(1) << (Bits * BoardX);
-    static const std::uint16_t  kInvalidIndex = std::uint16_t(-1);
+    static const ident_type     kInvalidIndex = ident_type(-1);
     static const int            kInvalidIndex32 = -1;
 
     static const size_type      kArraySizeSortThersold = 64;
 
+    // A bitmap root of 2^18 or 2^21 children is too large, the wide rows use an array root.
+    static const bool           kBitmapRoot = (Bits * BoardX <= 16);
+
+    static const size_type      kDefaultGroupSize = 8;
+
 #pragma pack(push, 1)
 
     struct LayerInfo {
         size_type maxLayerSize;
         size_type childCount;
         size_type totalLayerSize;
+        size_type totalCapacity;
+        size_type bitmapCount;
+        size_type totalBytes;
+    };
+
+    //
+    // The container policy of one trie layer.
+    //
+    struct LayerPolicy {
+        std::uint32_t initCapacity;         // The capacity of a new array container
+        std::uint32_t bitmapThreshold;      // Switch an array container to bitmap at this size, 0 is always bitmap
+        std::uint32_t sortThreshold;        // Sort the ids when an array grows beyond this capacity
+        std::uint32_t growthRate;           // The capacity growth in percent, 200 is doubling
     };
 
     struct NodeType {
@@ -78,46 +112,46 @@ public:
         IdentArray() noexcept {}
         ~IdentArray() {}
 
-        std::uint16_t getValue(std::uintptr_t * ptr, std::uint16_t index) const {
+        ident_type getValue(std::uintptr_t * ptr, ident_type index) const {
             assert(index != kInvalidIndex);
-            assert(index >= 0 && index < (std::uint16_t)kMaxArraySize);
-            std::uint16_t * pid = (std::uint16_t *)ptr + index;
+            assert(index >= 0 && index < (ident_type)kMaxArraySize);
+            ident_type * pid = (ident_type *)ptr + index;
             return *pid;
         }
 
-        void setValue(std::uintptr_t * ptr, std::uint16_t index, std::uint16_t id) {
+        void setValue(std::uintptr_t * ptr, ident_type index, ident_type id) {
             assert(index != kInvalidIndex);
-            assert(index >= 0 && index < (std::uint16_t)kMaxArraySize);
-            std::uint16_t * pid = (std::uint16_t *)ptr + index;
+            assert(index >= 0 && index < (ident_type)kMaxArraySize);
+            ident_type * pid = (ident_type *)ptr + index;
             assert(pid != nullptr);
             *pid = id;
         }
 
-        void append(std::uintptr_t * ptr, std::uint16_t size, std::uint16_t id) {
+        void append(std::uintptr_t * ptr, ident_type size, ident_type id) {
             assert(size <= kArraySizeThreshold);
             assert(size <= kMaxArraySize);
-            std::uint16_t * pid = (std::uint16_t *)ptr + size;
+            ident_type * pid = (ident_type *)ptr + size;
             assert(pid != nullptr);
             *pid = id;
         }
 
-        int indexOf(std::uintptr_t * ptr, std::uint16_t size, std::uint16_t id) const {
+        int indexOf(std::uintptr_t * ptr, ident_type size, ident_type id) const {
             assert(size <= kArraySizeThreshold);
             assert(size <= kMaxArraySize);
 #if MBG_USE_AVX2
             if (size > 0)
-                return (int)(Algorithm::find_uint16_avx2((std::uint16_t *)ptr, 0, size, id));
+                return (int)(Algorithm::find_ident_avx2((ident_type *)ptr, 0, size, id));
             else
                 return kInvalidIndex32;
 #elif MBG_USE_SSE2
             if (size > 0)
-                return (int)(Algorithm::find_uint16_sse2((std::uint16_t *)ptr, 0, size, id));
+                return (int)(Algorithm::find_ident_sse2((ident_type *)ptr, 0, size, id));
             else
                 return kInvalidIndex32;
 #else
-            std::uint16_t * idFirst = (std::uint16_t *)ptr;
-            std::uint16_t * idLast  = (std::uint16_t *)ptr + size;
-            for (std::uint16_t * pid = idFirst; pid < idLast; pid++) {
+            ident_type * idFirst = (ident_type *)ptr;
+            ident_type * idLast  = (ident_type *)ptr + size;
+            for (ident_type * pid = idFirst; pid < idLast; pid++) {
                 assert(*pid != kInvalidIndex);
                 if (*pid != id)
                     continue;
@@ -128,12 +162,12 @@ public:
 #endif
         }
 
-        int indexOf(std::uintptr_t * ptr, std::uint16_t size, std::uint16_t sorted, std::uint16_t id) const {
+        int indexOf(std::uintptr_t * ptr, ident_type size, ident_type sorted, ident_type id) const {
             assert(size <= kArraySizeThreshold);
             assert(size <= kMaxArraySize);
-#if SPARSEHASHMAP_USE_INDEX_SORT
+#if SPARSEBITSET_USE_INDEX_SORT
             if (sorted > 0) {
-                int index = Algorithm::binary_search((std::uint16_t *)ptr, 0, sorted, id);
+                int index = Algorithm::binary_search((ident_type *)ptr, 0, sorted, id);
                 if (index != kInvalidIndex32)
                     return index;
             }
@@ -141,23 +175,23 @@ public:
             assert(sorted <= size);
 #if MBG_USE_AVX2
             if (sorted < size)
-                return (int)(Algorithm::find_uint16_avx2((std::uint16_t *)ptr, sorted, size, id));
+                return (int)(Algorithm::find_ident_avx2((ident_type *)ptr, sorted, size, id));
             else
                 return kInvalidIndex32;
 #elif MBG_USE_SSE2
             if (sorted < size)
-                return (int)(Algorithm::find_uint16_sse2((std::uint16_t *)ptr, sorted, size, id));
+                return (int)(Algorithm::find_ident_sse2((ident_type *)ptr, sorted, size, id));
             else
                 return kInvalidIndex32;
 #else
-            std::uint16_t * idFirst = (std::uint16_t *)ptr + sorted;
-            std::uint16_t * idLast  = (std::uint16_t *)ptr + size;
-            for (std::uint16_t * pid = idFirst; pid < idLast; pid++) {
+            ident_type * idFirst = (ident_type *)ptr + sorted;
+            ident_type * idLast  = (ident_type *)ptr + size;
+            for (ident_type * pid = idFirst; pid < idLast; pid++) {
                 assert(*pid != kInvalidIndex);
                 if (*pid != id)
                     continue;
                 else
-                    return int(pid - (std::uint16_t *)ptr);
+                    return int(pid - (ident_type *)ptr);
             }
             return kInvalidIndex32;
 #endif
@@ -182,11 +216,11 @@ public:
             return data;
         }
 
-        pointer getValue(std::uintptr_t * ptr, std::uint16_t capacity, int index) const {
+        pointer getValue(std::uintptr_t * ptr, ident_type capacity, int index) const {
             assert(index != kInvalidIndex32);
             assert(index >= 0 && index < (int)capacity);
-            assert(capacity <= std::uint16_t(kMaxArraySize));
-            std::uint16_t * idEnd = reinterpret_cast<std::uint16_t *>(ptr) + capacity;
+            assert(capacity <= ident_type(kMaxArraySize));
+            ident_type * idEnd = reinterpret_cast<ident_type *>(ptr) + capacity;
             pointer data = reinterpret_cast<pointer>(idEnd) + index;
             return data;
         }
@@ -200,27 +234,27 @@ public:
             return data;
         }
 
-        pointer setValue(std::uintptr_t * ptr, std::uint16_t capacity, int index, const value_type & value) {
+        pointer setValue(std::uintptr_t * ptr, ident_type capacity, int index, const value_type & value) {
             assert(index != kInvalidIndex32);
             assert(index >= 0 && index < (int)kMaxArraySize);
-            std::uint16_t * idEnd = reinterpret_cast<std::uint16_t *>(ptr) + capacity;
+            ident_type * idEnd = reinterpret_cast<ident_type *>(ptr) + capacity;
             pointer data = reinterpret_cast<pointer>(idEnd) + index;
             assert(data != nullptr);
             *data = value;
             return data;
         }
 
-        void append(std::uintptr_t * ptr, std::uint16_t size, const value_type & value) {
-            assert(size <= std::uint16_t(kMaxArraySize));
+        void append(std::uintptr_t * ptr, ident_type size, const value_type & value) {
+            assert(size <= ident_type(kMaxArraySize));
             pointer data = reinterpret_cast<pointer>(ptr) + size;
             assert(data != nullptr);
             *data = value;
         }
 
-        void append(std::uintptr_t * ptr, std::uint16_t capacity, std::uint16_t size, const value_type & value) {
-            assert(size <= std::uint16_t(kMaxArraySize));
+        void append(std::uintptr_t * ptr, ident_type capacity, ident_type size, const value_type & value) {
+            assert(size <= ident_type(kMaxArraySize));
             assert(size <= capacity);
-            std::uint16_t * idEnd = reinterpret_cast<std::uint16_t *>(ptr) + capacity;
+            ident_type * idEnd = reinterpret_cast<ident_type *>(ptr) + capacity;
             pointer data = reinterpret_cast<pointer>(idEnd) + size;
             assert(data != nullptr);
             *data = value;
@@ -245,11 +279,11 @@ public:
             return *data;
         }
 
-        value_type getValue(std::uintptr_t * ptr, std::uint16_t capacity, int index) const {
+        value_type getValue(std::uintptr_t * ptr, ident_type capacity, int index) const {
             assert(index != kInvalidIndex32);
             assert(index >= 0 && index < (int)capacity);
-            assert(capacity <= std::uint16_t(kMaxArraySize));
-            std::uint16_t * idEnd = reinterpret_cast<std::uint16_t *>(ptr) + capacity;
+            assert(capacity <= ident_type(kMaxArraySize));
+            ident_type * idEnd = reinterpret_cast<ident_type *>(ptr) + capacity;
             pointer data = reinterpret_cast<pointer>(idEnd) + index;
             return *data;
         }
@@ -263,27 +297,27 @@ public:
             return data;
         }
 
-        pointer setValue(std::uintptr_t * ptr, std::uint16_t capacity, int index, value_type value) {
+        pointer setValue(std::uintptr_t * ptr, ident_type capacity, int index, value_type value) {
             assert(index != kInvalidIndex32);
             assert(index >= 0 && index < (int)kMaxArraySize);
-            std::uint16_t * idEnd = reinterpret_cast<std::uint16_t *>(ptr) + capacity;
+            ident_type * idEnd = reinterpret_cast<ident_type *>(ptr) + capacity;
             pointer data = reinterpret_cast<pointer>(idEnd) + index;
             assert(data != nullptr);
             *data = value;
             return data;
         }
 
-        void append(std::uintptr_t * ptr, std::uint16_t size, value_type value) {
-            assert(size <= std::uint16_t(kMaxArraySize));
+        void append(std::uintptr_t * ptr, ident_type size, value_type value) {
+            assert(size <= ident_type(kMaxArraySize));
             pointer data = reinterpret_cast<pointer>(ptr) + size;
             assert(data != nullptr);
             *data = value;
         }
 
-        void append(std::uintptr_t * ptr, std::uint16_t capacity, std::uint16_t size, value_type value) {
-            assert(size <= std::uint16_t(kMaxArraySize));
+        void append(std::uintptr_t * ptr, ident_type capacity, ident_type size, value_type value) {
+            assert(size <= ident_type(kMaxArraySize));
             assert(size <= capacity);
-            std::uint16_t * idEnd = reinterpret_cast<std::uint16_t *>(ptr) + capacity;
+            ident_type * idEnd = reinterpret_cast<ident_type *>(ptr) + capacity;
             pointer data = reinterpret_cast<pointer>(idEnd) + size;
             assert(data != nullptr);
             *data = value;
@@ -296,10 +330,10 @@ public:
 
     protected:
         // Cardinality
-        std::uint16_t    type_;
-        std::uint16_t    size_;
-        std::uint16_t    capacity_;
-        std::uint16_t    sorted_;
+        ident_type    type_;
+        ident_type    size_;
+        ident_type    capacity_;
+        ident_type    sorted_;
 
         std::uintptr_t * ptr_;
 
@@ -308,15 +342,20 @@ public:
             this->reserve(kDefaultArrayCapacity);
         }
 
+        void init(size_type capacity) {
+            assert(this->size_ == 0);
+            this->reserve(capacity);
+        }
+
     public:
         IContainer() noexcept : type_(NodeType::ArrayContainer), size_(0), capacity_(0), sorted_(0), ptr_(nullptr) {
         }
-        IContainer(std::uint16_t type) noexcept : type_(type), size_(0), capacity_(0), sorted_(0), ptr_(nullptr) {
+        IContainer(ident_type type) noexcept : type_(type), size_(0), capacity_(0), sorted_(0), ptr_(nullptr) {
         }
         IContainer(size_type type, size_type size, size_type capacity, std::uintptr_t * ptr) noexcept
-            : type_(static_cast<std::uint16_t>(type)),
-              size_(static_cast<std::uint16_t>(size)),
-              capacity_(static_cast<std::uint16_t>(capacity)), sorted_(0),
+            : type_(static_cast<ident_type>(type)),
+              size_(static_cast<ident_type>(size)),
+              capacity_(static_cast<ident_type>(capacity)), sorted_(0),
               ptr_(ptr) {
         }
 
@@ -326,6 +365,18 @@ public:
             this->destroy();
         }
 
+        // The containers live in the paged arena of the current scope, if any.
+        static void * operator new(std::size_t size) {
+            void * ptr = PagedArena::scoped_malloc(size);
+            if (ptr == nullptr)
+                throw std::bad_alloc();
+            return ptr;
+        }
+
+        static void operator delete(void * ptr) {
+            PagedArena::scoped_free(ptr);
+        }
+
         size_type type() const {
             return this->type_;
         }
@@ -342,6 +393,15 @@ public:
             return this->sorted_;
         }
 
+        const std::uintptr_t * data() const {
+            return this->ptr_;
+        }
+
+        // The address that the lookup of this id will touch first.
+        virtual const void * getPrefetchAddress(ident_type id) const {
+            return this->ptr_;
+        }
+
         bool isLeaf() const  {
             return (this->type() == NodeType::LeafArrayContainer ||
                     this->type() == NodeType::LeafBitmapContainer);
@@ -356,7 +416,7 @@ public:
 
         void destroy() {
             if (this->ptr_ != nullptr) {
-                std::free(this->ptr_);
+                PagedArena::scoped_free(this->ptr_);
                 this->ptr_ = nullptr;
             }
         }
@@ -385,22 +445,31 @@ public:
             // Not implemented!
         }
 
+        virtual void grow(size_type newCapacity, size_type sortThreshold) {
+            // Not implemented!
+        }
+
+        bool isArray() const  {
+            return (this->type() == NodeType::ArrayContainer ||
+                    this->type() == NodeType::LeafArrayContainer);
+        }
+
         void allocate(size_type allocSize, size_type capacity) {
             assert(this->ptr_ == nullptr);
             assert(capacity != this->capacity());
-            this->ptr_ = (uintptr_t *)std::malloc(allocSize);
-            this->capacity_ = std::uint16_t(capacity);
+            this->ptr_ = (uintptr_t *)PagedArena::scoped_malloc(allocSize);
+            this->capacity_ = ident_type(capacity);
         }
 
         void original_reallocate(size_type newSize, size_type newCapacity) {
             if (newCapacity > this->capacity()) {
                 if (this->ptr_ != nullptr) {
-                    uintptr_t * new_ptr = (uintptr_t *)std::malloc(newSize);
+                    uintptr_t * new_ptr = (uintptr_t *)PagedArena::scoped_malloc(newSize);
                     if (new_ptr != nullptr) {
                         std::memcpy(new_ptr, this->ptr_, this->capacity());
-                        std::free(this->ptr_);
+                        PagedArena::scoped_free(this->ptr_);
                         this->ptr_ = new_ptr;
-                        this->capacity_ = std::uint16_t(newCapacity);
+                        this->capacity_ = ident_type(newCapacity);
                     }
                 }
                 else {
@@ -409,73 +478,77 @@ public:
             }
         }
 
-        virtual IContainer * getChild(std::uint16_t id) const {
+        virtual IContainer * getChild(ident_type id) const {
             // Not implemented!
             return nullptr;
         }
 
         IContainer * getChild(std::size_t id) const {
-            return this->getChild(static_cast<std::uint16_t>(id));
+            return this->getChild(static_cast<ident_type>(id));
         }
 
-        virtual bool hasChild(std::uint16_t id) const {
+        virtual bool hasChild(ident_type id) const {
             // Not implemented!
             return false;
         }
 
         bool hasChild(std::size_t id) const {
-            return this->hasChild(static_cast<std::uint16_t>(id));
+            return this->hasChild(static_cast<ident_type>(id));
         }
 
-        virtual bool hasChild(std::uint16_t id, IContainer *& child) const {
+        virtual bool hasChild(ident_type id, IContainer *& child) const {
             // Not implemented!
             return false;
         }
 
         bool hasChild(std::size_t id, IContainer *& child) const {
-            return this->hasChild(static_cast<std::uint16_t>(id), child);
+            return this->hasChild(static_cast<ident_type>(id), child);
         }
 
-        virtual bool hasLeaf(std::uint16_t id) const {
+        virtual bool hasLeaf(ident_type id) const {
             // Not implemented!
             return false;
         }
 
         bool hasLeaf(std::size_t id) const {
-            return this->hasLeaf(static_cast<std::uint16_t>(id));
+            return this->hasLeaf(static_cast<ident_type>(id));
         }
 
-        virtual void append(std::uint16_t id, IContainer * container) {
+        virtual void append(ident_type id, IContainer * container) {
             // Not implemented!
         }
 
-        IContainer * append(std::uint16_t id) {
+        virtual void setChild(ident_type id, IContainer * child) {
+            // Not implemented!
+        }
+
+        IContainer * append(ident_type id) {
             IContainer * container = new ArrayContainer();
             this->append(id, container);
             return container;
         }
 
         IContainer * append(std::size_t id) {
-            return this->append(static_cast<std::uint16_t>(id));
+            return this->append(static_cast<ident_type>(id));
         }
 
-        LeafContainer * appendLeaf(std::uint16_t id) {
+        LeafContainer * appendLeaf(ident_type id) {
             IContainer * container = new LeafArrayContainer();
             this->append(id, container);
             return static_cast<LeafContainer *>(container);
         }
 
         LeafContainer * appendLeaf(std::size_t id) {
-            return this->appendLeaf(static_cast<std::uint16_t>(id));
+            return this->appendLeaf(static_cast<ident_type>(id));
         }
 
-        virtual int getId(std::uint16_t index) const {
+        virtual int getId(ident_type index) const {
             // Not implemented!
             return kInvalidIndex;
         }
 
         int getId(size_type index) const {
-            return this->getId(static_cast<std::uint16_t>(index));
+            return this->getId(static_cast<ident_type>(index));
         }
 
         virtual IContainer * getValue(int index) const {
@@ -494,7 +567,7 @@ public:
 
         Container() noexcept : IContainer(NodeType::ArrayContainer) {
         }
-        Container(std::uint16_t type) noexcept : IContainer(type) {
+        Container(ident_type type) noexcept : IContainer(type) {
         }
         Container(size_type type, size_type size, size_type capacity, std::uintptr_t * ptr) noexcept
             : IContainer(type, size, capacity, ptr) {
@@ -518,41 +591,41 @@ public:
             // Not implemented!
         }
 
-        bool isExists(std::uint16_t id) const {
+        bool isExists(ident_type id) const {
             IContainer * child;
             bool is_exists = this->hasChild(id, child);
             return (is_exists && (child != nullptr));
         }
 
         bool isExists(size_type id) const {
-            return this->isExists(static_cast<std::uint16_t>(id));
+            return this->isExists(static_cast<ident_type>(id));
         }
 
-        IContainer * getChild(std::uint16_t id) const override {
+        IContainer * getChild(ident_type id) const override {
             // Not implemented!
             return nullptr;
         }
 
-        bool hasChild(std::uint16_t id) const override {
+        bool hasChild(ident_type id) const override {
             // Not implemented!
             return false;
         }
 
-        bool hasChild(std::uint16_t id, IContainer *& child) const override {
+        bool hasChild(ident_type id, IContainer *& child) const override {
             // Not implemented!
             return false;
         }
 
-        bool hasLeaf(std::uint16_t id) const override {
+        bool hasLeaf(ident_type id) const override {
             // Not implemented!
             return false;
         }
 
-        void append(std::uint16_t id, IContainer * container) override {
+        void append(ident_type id, IContainer * container) override {
             // Not implemented!
         }
 
-        int getId(std::uint16_t index) const override {
+        int getId(ident_type index) const override {
             // Not implemented!
             return kInvalidIndex;
         }
@@ -569,7 +642,7 @@ public:
 
         LeafContainer() noexcept : IContainer(NodeType::LeafArrayContainer) {
         }
-        LeafContainer(std::uint16_t type) noexcept : IContainer(type) {
+        LeafContainer(ident_type type) noexcept : IContainer(type) {
         }
         LeafContainer(size_type type, size_type size, size_type capacity, std::uintptr_t * ptr) noexcept
             : IContainer(type, size, capacity, ptr) {
@@ -593,39 +666,39 @@ public:
             // Not implemented!
         }
 
-        bool isExists(std::uint16_t id) const {
+        bool isExists(ident_type id) const {
             return this->hasChild(id);
         }
 
         bool isExists(size_type id) const {
-            return this->isExists(static_cast<std::uint16_t>(id));
+            return this->isExists(static_cast<ident_type>(id));
         }
 
-        IContainer * getChild(std::uint16_t id) const final {
+        IContainer * getChild(ident_type id) const final {
             // Not supported!
             return nullptr;
         }
 
-        bool hasChild(std::uint16_t id) const override {
+        bool hasChild(ident_type id) const override {
             // Not implemented!
             return false;
         }
 
-        bool hasChild(std::uint16_t id, IContainer *& child) const override {
+        bool hasChild(ident_type id, IContainer *& child) const override {
             // Not supported!
             return false;
         }
 
-        bool hasLeaf(std::uint16_t id) const override {
+        bool hasLeaf(ident_type id) const override {
             // Not implemented!
             return false;
         }
 
-        void append(std::uint16_t id, IContainer * container) override {
+        void append(ident_type id, IContainer * container) override {
             // Not supported!
         }
 
-        int getId(std::uint16_t index) const override {
+        int getId(ident_type index) const override {
             // Not implemented!
             return kInvalidIndex;
         }
@@ -641,50 +714,50 @@ public:
         IdentArray               identArray_;
         ValueArray<IContainer *> valueArray_;
 
-        void reallocate(size_type newSize, size_type newCapacity) {
+        void reallocate(size_type newSize, size_type newCapacity, size_type sortThreshold) {
             assert(newCapacity > this->capacity());
             assert(this->ptr_ != nullptr);
             if (true) {
-                std::uintptr_t * new_ptr = (std::uintptr_t *)std::malloc(newSize);
+                std::uintptr_t * new_ptr = (std::uintptr_t *)PagedArena::scoped_malloc(newSize);
                 if (new_ptr != nullptr) {
                     //assert(this->ptr_ != nullptr);
-                    std::uint16_t * indexEnd = (std::uint16_t *)this->ptr_ + this->capacity();
-                    std::uint16_t * newIndexEnd = (std::uint16_t *)new_ptr + newCapacity;
+                    ident_type * indexEnd = (ident_type *)this->ptr_ + this->capacity();
+                    ident_type * newIndexEnd = (ident_type *)new_ptr + newCapacity;
                     Container ** valueFirst = (Container **)indexEnd;
                     Container ** newValueFirst = (Container **)newIndexEnd;
 #if SPARSEBITSET_USE_INDEX_SORT
-                    if (this->capacity() <= kArraySizeSortThersold) {
-                        std::memcpy(new_ptr, this->ptr_, sizeof(std::uint16_t) * this->capacity());
+                    if (this->capacity() <= sortThreshold) {
+                        std::memcpy(new_ptr, this->ptr_, sizeof(ident_type) * this->capacity());
                         std::memcpy(newValueFirst, valueFirst, sizeof(Container *) * this->capacity());
                     }
                     else {
                         if (this->sorted() != 0) {
-                            // Quick sort (second half)
-                            Algorithm::quick_sort((std::uint16_t *)this->ptr_, (std::uintptr_t **)valueFirst,
-                                                  this->capacity() / 2, this->capacity() - 1);
-                            // (Half) Merge sort
-                            Algorithm::merge_sort((std::uint16_t *)this->ptr_, (std::uintptr_t **)valueFirst,
-                                                  (std::uint16_t *)new_ptr, (std::uintptr_t **)newValueFirst,
-                                                  0, this->capacity());
+                            // Quick sort (the unsorted tail)
+                            Algorithm::quick_sort((ident_type *)this->ptr_, (std::uintptr_t **)valueFirst,
+                                                  this->sorted(), this->capacity() - 1);
+                            // Merge the sorted head and tail
+                            Algorithm::merge_sort((ident_type *)this->ptr_, (std::uintptr_t **)valueFirst,
+                                                  (ident_type *)new_ptr, (std::uintptr_t **)newValueFirst,
+                                                  0, this->sorted(), this->capacity());
                             this->sorted_ = this->capacity_;
                         }
                         else {
                             // Quick sort
-                            Algorithm::quick_sort((std::uint16_t *)this->ptr_, (std::uintptr_t **)valueFirst,
+                            Algorithm::quick_sort((ident_type *)this->ptr_, (std::uintptr_t **)valueFirst,
                                                   0, this->capacity() - 1);
                             // Copy sorted array to new buffer
-                            std::memcpy(new_ptr, this->ptr_, sizeof(std::uint16_t) * this->capacity());
+                            std::memcpy(new_ptr, this->ptr_, sizeof(ident_type) * this->capacity());
                             std::memcpy(newValueFirst, valueFirst, sizeof(Container *) * this->capacity());
                             this->sorted_ = this->capacity_;
                         }
                     }
 #else
-                    std::memcpy(new_ptr, this->ptr_, sizeof(std::uint16_t) * this->capacity());
+                    std::memcpy(new_ptr, this->ptr_, sizeof(ident_type) * this->capacity());
                     std::memcpy(newValueFirst, valueFirst, sizeof(Container *) * this->capacity());
 #endif
-                    std::free(this->ptr_);
+                    PagedArena::scoped_free(this->ptr_);
                     this->ptr_ = new_ptr;
-                    this->capacity_ = std::uint16_t(newCapacity);
+                    this->capacity_ = ident_type(newCapacity);
                 }
             }
             else {
@@ -696,6 +769,9 @@ public:
         ArrayContainer() noexcept : Container(NodeType::ArrayContainer) {
             this->init();
         }
+        ArrayContainer(size_type capacity) noexcept : Container(NodeType::ArrayContainer) {
+            this->init(capacity);
+        }
         ArrayContainer(const ArrayContainer & src) = delete;
 
         virtual ~ArrayContainer() {
@@ -708,17 +784,21 @@ public:
 
         void reserve(size_type capacity) final {
             assert(capacity > this->capacity());
-            size_type allocSize = (sizeof(std::uint16_t) + sizeof(Container *)) * capacity;
+            size_type allocSize = (sizeof(ident_type) + sizeof(Container *)) * capacity;
             this->allocate(allocSize, capacity);
         }
 
         void resize(size_type newCapacity) final {
+            this->grow(newCapacity, kArraySizeSortThersold);
+        }
+
+        void grow(size_type newCapacity, size_type sortThreshold) final {
             assert (newCapacity > this->capacity());
-            size_type allocSize = (sizeof(std::uint16_t) + sizeof(Container *)) * newCapacity;
-            this->reallocate(allocSize, newCapacity);
+            size_type allocSize = (sizeof(ident_type) + sizeof(Container *)) * newCapacity;
+            this->reallocate(allocSize, newCapacity, sortThreshold);
         }
 
-        IContainer * getChild(std::uint16_t id) const final {
+        IContainer * getChild(ident_type id) const final {
             int index = this->identArray_.indexOf(this->ptr_, this->size_, this->sorted_, id);
             assert(index >= kInvalidIndex32);
             if (index != kInvalidIndex32) {
@@ -728,13 +808,13 @@ public:
             return nullptr;
         }
 
-        bool hasChild(std::uint16_t id) const final {
+        bool hasChild(ident_type id) const final {
             int index = this->identArray_.indexOf(this->ptr_, this->size_, this->sorted_, id);
             assert(index >= kInvalidIndex32);
             return (index != kInvalidIndex32);
         }
 
-        bool hasChild(std::uint16_t id, IContainer *& child) const final {
+        bool hasChild(ident_type id, IContainer *& child) const final {
             int index = this->identArray_.indexOf(this->ptr_, this->size_, this->sorted_, id);
             assert(index >= kInvalidIndex32);
             if (index != kInvalidIndex32) {
@@ -746,11 +826,17 @@ public:
             return false;
         }
 
-        bool hasLeaf(std::uint16_t value) const final {
+        bool hasLeaf(ident_type value) const final {
             return false;
         }
 
-        void append(std::uint16_t id, IContainer * container) final {
+        void setChild(ident_type id, IContainer * child) final {
+            int index = this->identArray_.indexOf(this->ptr_, this->size_, this->sorted_, id);
+            assert(index != kInvalidIndex32);
+            this->valueArray_.setValue(this->ptr_, this->capacity_, index, child);
+        }
+
+        void append(ident_type id, IContainer * container) final {
             assert(container != nullptr);
             assert(this->size() <= kArraySizeThreshold);
             assert(this->size() <= kMaxArraySize);
@@ -762,7 +848,7 @@ public:
             this->size_++;
         }
 
-        int getId(std::uint16_t index) const final {
+        int getId(ident_type index) const final {
             assert(index < this->size_);
             return this->identArray_.getValue(this->ptr_, index);
         }
@@ -777,41 +863,41 @@ public:
     private:
         IdentArray  identArray_;
 
-        void reallocate(size_type newSize, size_type newCapacity) {
+        void reallocate(size_type newSize, size_type newCapacity, size_type sortThreshold) {
             assert(newCapacity > this->capacity());
             assert(this->ptr_ != nullptr);
             if (true) {
-                uintptr_t * new_ptr = (uintptr_t *)std::malloc(newSize);
+                uintptr_t * new_ptr = (uintptr_t *)PagedArena::scoped_malloc(newSize);
                 if (new_ptr != nullptr) {
                     //assert(this->ptr_ != nullptr);
 #if SPARSEBITSET_USE_INDEX_SORT
-                    if (this->capacity() <= kArraySizeSortThersold) {
-                        std::memcpy(new_ptr, this->ptr_, sizeof(std::uint16_t) * this->capacity());
+                    if (this->capacity() <= sortThreshold) {
+                        std::memcpy(new_ptr, this->ptr_, sizeof(ident_type) * this->capacity());
                     }
                     else {
                         if (this->sorted() != 0) {
-                            // Quick sort (second half)
-                            Algorithm::quick_sort((std::uint16_t *)this->ptr_,
-                                                  this->capacity() / 2, this->capacity() - 1);
-                            // (Half) Merge sort
-                            Algorithm::merge_sort((std::uint16_t *)this->ptr_, (std::uint16_t *)new_ptr,
-                                                  0, this->capacity());
+                            // Quick sort (the unsorted tail)
+                            Algorithm::quick_sort((ident_type *)this->ptr_,
+                                                  this->sorted(), this->capacity() - 1);
+                            // Merge the sorted head and tail
+                            Algorithm::merge_sort((ident_type *)this->ptr_, (ident_type *)new_ptr,
+                                                  0, this->sorted(), this->capacity());
                             this->sorted_ = this->capacity_;
                         }
                         else {
                             // Quick sort
-                            Algorithm::quick_sort((std::uint16_t *)this->ptr_, 0, this->capacity());
+                            Algorithm::quick_sort((ident_type *)this->ptr_, 0, this->capacity() - 1);
                             // Copy sorted array to new buffer
-                            std::memcpy(new_ptr, this->ptr_, sizeof(std::uint16_t) * this->capacity());
+                            std::memcpy(new_ptr, this->ptr_, sizeof(ident_type) * this->capacity());
                             this->sorted_ = this->capacity_;
                         }
                     }
 #else
-                    std::memcpy(new_ptr, this->ptr_, sizeof(std::uint16_t) * this->capacity());
+                    std::memcpy(new_ptr, this->ptr_, sizeof(ident_type) * this->capacity());
 #endif
-                    std::free(this->ptr_);
+                    PagedArena::scoped_free(this->ptr_);
                     this->ptr_ = new_ptr;
-                    this->capacity_ = std::uint16_t(newCapacity);
+                    this->capacity_ = ident_type(newCapacity);
                 }
             }
             else {
@@ -823,6 +909,9 @@ public:
         LeafArrayContainer() noexcept : LeafContainer(NodeType::LeafArrayContainer) {
             this->init();
         }
+        LeafArrayContainer(size_type capacity) noexcept : LeafContainer(NodeType::LeafArrayContainer) {
+            this->init(capacity);
+        }
         LeafArrayContainer(const LeafArrayContainer & src) = delete;
 
         virtual ~LeafArrayContainer() {
@@ -835,32 +924,36 @@ public:
 
         void reserve(size_type capacity) final {
             assert(capacity > this->capacity());
-            size_type allocSize = sizeof(std::uint16_t) * capacity;
+            size_type allocSize = sizeof(ident_type) * capacity;
             this->allocate(allocSize, capacity);
         }
 
         void resize(size_type newCapacity) final {
+            this->grow(newCapacity, kArraySizeSortThersold);
+        }
+
+        void grow(size_type newCapacity, size_type sortThreshold) final {
             assert (newCapacity > this->capacity());
-            size_type allocSize = sizeof(std::uint16_t) * newCapacity;
-            this->reallocate(allocSize, newCapacity);
+            size_type allocSize = sizeof(ident_type) * newCapacity;
+            this->reallocate(allocSize, newCapacity, sortThreshold);
         }
 
-        bool hasChild(std::uint16_t id) const final {
+        bool hasChild(ident_type id) const final {
             return this->hasLeaf(id);
         }
 
-        bool hasChild(std::uint16_t id, IContainer *& child) const final {
+        bool hasChild(ident_type id, IContainer *& child) const final {
             child = nullptr;
             return this->hasLeaf(id);
         }
 
-        bool hasLeaf(std::uint16_t id) const final {
+        bool hasLeaf(ident_type id) const final {
             int index = identArray_.indexOf(this->ptr_, this->size_, this->sorted_, id);
             assert(index >= kInvalidIndex32);
             return (index != kInvalidIndex32);
         }
 
-        void append(std::uint16_t id, IContainer * container) final {
+        void append(ident_type id, IContainer * container) final {
             assert(this->size() <= kArraySizeThreshold);
             assert(this->size() <= kMaxArraySize);
             if (this->size() >= this->capacity()) {
@@ -870,7 +963,7 @@ public:
             this->size_++;
         }
 
-        int getId(std::uint16_t index) const final {
+        int getId(ident_type index) const final {
             assert(index < this->size_);
             return this->identArray_.getValue(this->ptr_, index);
         }
@@ -913,7 +1006,7 @@ public:
             // Do nothing !!
         }
 
-        IContainer * getChild(std::uint16_t id) const final {
+        IContainer * getChild(ident_type id) const final {
             bool exists = this->bitset_.test(id);
             if (exists) {
                 IContainer * child = this->valueArray_.getValue(this->ptr_, id);
@@ -922,12 +1015,16 @@ public:
             return nullptr;
         }
 
-        bool hasChild(std::uint16_t id) const final {
+        const void * getPrefetchAddress(ident_type id) const final {
+            return (const void *)((const char *)&this->bitset_ + id / 8);
+        }
+
+        bool hasChild(ident_type id) const final {
             bool exists = this->bitset_.test(id);
             return exists;
         }
 
-        bool hasChild(std::uint16_t id, IContainer *& child) const final {
+        bool hasChild(ident_type id, IContainer *& child) const final {
             bool exists = this->bitset_.test(id);
             if (exists) {
                 IContainer * nextChild = this->valueArray_.getValue(this->ptr_, id);
@@ -938,17 +1035,22 @@ public:
             return false;
         }
 
-        bool hasLeaf(std::uint16_t id) const final {
+        bool hasLeaf(ident_type id) const final {
             return false;
         }
 
-        void append(std::uint16_t id, IContainer * container) final {
+        void setChild(ident_type id, IContainer * child) final {
+            assert(this->bitset_.test(id));
+            this->valueArray_.setValue(this->ptr_, id, child);
+        }
+
+        void append(ident_type id, IContainer * container) final {
             this->bitset_.set(id);
             this->valueArray_.append(this->ptr_, id, container);
             this->size_++;
         }
 
-        int getId(std::uint16_t index) const final {
+        int getId(ident_type index) const final {
             bool exists = this->bitset_.test(index);
             return (exists ? index : kInvalidIndex32);
         }
@@ -987,30 +1089,29 @@ public:
             // Do nothing !!
         }
 
-        IContainer * getChild(std::uint16_t id) const final {
-            // Do nothing !!
-            return nullptr;
+        const void * getPrefetchAddress(ident_type id) const final {
+            return (const void *)((const char *)&this->bitset_ + id / 8);
         }
 
-        bool hasChild(std::uint16_t id) const final {
+        bool hasChild(ident_type id) const final {
             return this->hasLeaf(id);
         }
 
-        bool hasChild(std::uint16_t id, IContainer *& child) const final {
+        bool hasChild(ident_type id, IContainer *& child) const final {
             child = nullptr;
             return this->hasLeaf(id);
         }
 
-        bool hasLeaf(std::uint16_t id) const final {
+        bool hasLeaf(ident_type id) const final {
             return this->bitset_.test(id);
         }
 
-        void append(std::uint16_t id, IContainer * container) final {
+        void append(ident_type id, IContainer * container) final {
             this->bitset_.set(id);
             this->size_++;
         }
 
-        int getId(std::uint16_t index) const final {
+        int getId(ident_type index) const final {
             bool exists = this->bitset_.test(index);
             return (exists ? index : kInvalidIndex32);
         }
@@ -1051,40 +1152,215 @@ public:
 
 #pragma pack(pop)
 
+    //
+    // A range of root container positions: [first, last).
+    //
+    struct range_type {
+        size_type first;
+        size_type last;
+
+        range_type() noexcept : first(0), last(0) {}
+        range_type(size_type _first, size_type _last) noexcept
+            : first(_first), last(_last) {}
+
+        bool empty() const {
+            return (this->first >= this->last);
+        }
+    };
+
+    struct LookupStep {
+        enum type {
+            Finished,
+            Prefetch,
+            Search
+        };
+    };
+
+    //
+    // The containers on the root-to-leaf path of a key, containers[layer] holds the
+    // id of that layer. It's only valid while the layout version is unchanged.
+    //
+    struct InsertPath {
+        IContainer *    containers[BoardY];
+        size_type       version;
+
+        InsertPath() : version(size_type(-1)) {}
+    };
+
+    //
+    // One in-flight lookup of try_insert_batch().
+    //
+    struct LookupState {
+        const board_type *  board;
+        IContainer *        container;
+        IContainer *        parent;
+        size_type           parent_id;
+        size_type           index;
+        size_type           layer;
+        size_type           layer_id;
+        size_type           step;
+        size_type           version;
+    };
+
+    //
+    // Depth-first walk over the trie, yields one composed board per leaf id.
+    // Only the rows at or below the advanced layer are re-composed each step.
+    //
+    class const_iterator {
+    public:
+        typedef std::forward_iterator_tag   iterator_category;
+        typedef board_type                  value_type;
+        typedef std::ptrdiff_t              difference_type;
+        typedef const board_type *          pointer;
+        typedef const board_type &          reference;
+
+    private:
+        const this_type *   owner_;
+        IContainer *        containers_[BoardY];
+        size_type           pos_[BoardY];
+        size_type           root_last_;
+        board_type          board_;
+
+        void set_end() {
+            this->owner_ = nullptr;
+        }
+
+        // Find the first existing id at or after the current position of this layer,
+        // then descend to the leftmost leaf below it.
+        void seek(size_type layer) {
+            assert(this->owner_ != nullptr);
+            for (;;) {
+                IContainer * container = this->containers_[layer];
+                assert(container != nullptr);
+                size_type last = (layer == 0) ? this->root_last_ : container->end();
+                size_type pos = this->pos_[layer];
+                int id = kInvalidIndex32;
+                while (pos < last) {
+                    id = container->getId(pos);
+                    if (id != kInvalidIndex32)
+                        break;
+                    container->next(pos);
+                }
+                this->pos_[layer] = pos;
+
+                if (pos < last) {
+                    this->owner_->compose_layer_to_board(this->board_, layer, std::uint32_t(id));
+                    if (layer < (BoardY - 1)) {
+                        IContainer * child = container->getValue(pos);
+                        assert(child != nullptr);
+                        layer++;
+                        this->containers_[layer] = child;
+                        this->pos_[layer] = child->begin();
+                        continue;
+                    }
+                    return;
+                }
+                else {
+                    if (layer == 0) {
+                        this->set_end();
+                        return;
+                    }
+                    layer--;
+                    this->containers_[layer]->next(this->pos_[layer]);
+                }
+            }
+        }
+
+    public:
+        const_iterator() noexcept : owner_(nullptr), root_last_(0) {
+        }
+
+        const_iterator(const this_type * owner, size_type first, size_type last)
+            : owner_(owner), root_last_(last) {
+            assert(owner != nullptr);
+            IContainer * root = owner->root_;
+            if (root != nullptr && first < last) {
+                assert(last <= root->end());
+                this->containers_[0] = root;
+                this->pos_[0] = first;
+                this->seek(0);
+            }
+            else {
+                this->set_end();
+            }
+        }
+
+        bool is_end() const {
+            return (this->owner_ == nullptr);
+        }
+
+        reference operator * () const {
+            assert(!this->is_end());
+            return this->board_;
+        }
+
+        pointer operator -> () const {
+            assert(!this->is_end());
+            return &this->board_;
+        }
+
+        const_iterator & operator ++ () {
+            assert(!this->is_end());
+            this->containers_[BoardY - 1]->next(this->pos_[BoardY - 1]);
+            this->seek(BoardY - 1);
+            return *this;
+        }
+
+        const_iterator operator ++ (int) {
+            const_iterator prev(*this);
+            ++(*this);
+            return prev;
+        }
+
+        bool operator == (const const_iterator & rhs) const {
+            if (this->is_end() || rhs.is_end())
+                return (this->owner_ == rhs.owner_);
+            if (this->owner_ != rhs.owner_)
+                return false;
+            for (size_type layer = 0; layer < BoardY; layer++) {
+                if (this->containers_[layer] != rhs.containers_[layer] ||
+                    this->pos_[layer] != rhs.pos_[layer])
+                    return false;
+            }
+            return true;
+        }
+
+        bool operator != (const const_iterator & rhs) const {
+            return !(*this == rhs);
+        }
+    };
+
+    typedef const_iterator  iterator;
+
 private:
     IContainer *    root_;
     size_type       size_;
+    size_type       layout_version_;
     size_type       y_index_[BoardY];
+    size_type       layer_index_[BoardY];
+    LayerPolicy     policy_[BoardY];
+    BlockedBloomFilter  filter_;
+    PagedArena *    arena_;
 #if SPARSEBITSET_USE_TRIE_INFO
     LayerInfo       layer_info_[BoardY];
 #endif
 
     void init() {
-#if 1
-        size_type top = 0, bottom = BoardY - 1;
-        for (size_type yi = 0; yi < (BoardY / 2); yi++) {
-            this->y_index_[yi * 2 + 0] = top++;
-            this->y_index_[yi * 2 + 1] = bottom--;
-        }
-        if ((BoardY % 2) != 0) {
-            this->y_index_[BoardY - 1] = top;
+        LayerOrder::make_index<Order>(this->y_index_);
+        for (size_type layer = 0; layer < BoardY; layer++) {
+            this->layer_index_[this->y_index_[layer]] = layer;
+            this->policy_[layer] = default_layer_policy(layer);
         }
-#else
-        size_type top = BoardY / 2 - 1, bottom = BoardY / 2;
-        if ((BoardY % 2) != 0) {
-            this->y_index_[0] = bottom;
-            bottom++;
-        }
-        for (size_type yi = 0; yi < (BoardY / 2); yi++) {
-            this->y_index_[yi * 2 + 1] = top--;
-            this->y_index_[yi * 2 + 2] = bottom++;
-        }
-#endif
-        this->create_root(NodeType::ArrayContainer);
+        this->create_root();
+    }
+
+    size_type root_type() const {
+        return ((this->policy_[0].bitmapThreshold == 0) ?
+                NodeType::BitmapContainer : NodeType::ArrayContainer);
     }
 
 public:
-    SparseBitset() : root_(nullptr), size_(0) {
+    SparseBitset() : root_(nullptr), size_(0), layout_version_(0), arena_(nullptr) {
         this->init();
     }
 
@@ -1106,14 +1382,20 @@ public:
 
     void destroy() {
         this->destroy_trie();
+        this->filter_.destroy();
         this->size_ = 0;
     }
 
-    IContainer * create_root(size_type type = NodeType::BitmapContainer) {
+    IContainer * create_root() {
+        return this->create_root(this->root_type());
+    }
+
+    IContainer * create_root(size_type type) {
         IContainer * container = nullptr;
         if (this->root_ == nullptr) {
+            PagedArena::Scope scope(this->arena_);
             if (type == NodeType::ArrayContainer)
-                container = new ArrayContainer();
+                container = new ArrayContainer(this->policy_[0].initCapacity);
             else
                 container = new BitmapContainer();
             this->root_ = container;
@@ -1125,11 +1407,115 @@ public:
         this->destroy();
     }
 
+    void clear() {
+        this->destroy();
+        this->create_root();
+    }
+
+    void swap(this_type & other) {
+        if (&other != this) {
+            std::swap(this->root_, other.root_);
+            std::swap(this->size_, other.size_);
+            std::swap(this->policy_, other.policy_);
+            this->filter_.swap(other.filter_);
+            std::swap(this->arena_, other.arena_);
+            this->layout_version_++;
+            other.layout_version_++;
+        }
+    }
+
+    PagedArena * arena() const {
+        return this->arena_;
+    }
+
+    //
+    // Put the nodes into a file-backed paged arena (nullptr is the heap),
+    // the subtrees of each root segment are packed into their own pages.
+    // The trie is cleared, and the arena must outlive it.
+    //
+    void attach_arena(PagedArena * arena) {
+        this->destroy();
+        this->arena_ = arena;
+        this->create_root();
+    }
+
+    //
+    // The arena segment of a board, the whole subtree of a root child is in one segment.
+    // The used root ids are sparse (only 7 of the 8 cell values), so they are spread
+    // by modulo rather than by range.
+    //
+    size_type segment_of(const board_type & board) const {
+        if (this->arena_ == nullptr)
+            return 0;
+        size_type root_id = this->get_layer_value(board, 0);
+        return (root_id % this->arena_->segments());
+    }
+
+    //
+    // Default policy: the root layer of a 5x5 search is nearly dense,
+    // so it uses a flat 2^15 child table (bitmap container) from the start.
+    //
+    static LayerPolicy default_layer_policy(size_type layer) {
+        LayerPolicy policy;
+        policy.initCapacity     = kDefaultArrayCapacity;
+        policy.bitmapThreshold  = (layer == 0 && kBitmapRoot) ? 0 : kArraySizeThreshold;
+        policy.sortThreshold    = kArraySizeSortThersold;
+        policy.growthRate       = 200;
+        return policy;
+    }
+
+    const LayerPolicy & layer_policy(size_type layer) const {
+        assert(layer < BoardY);
+        return this->policy_[layer];
+    }
+
+    void get_layer_policy(LayerPolicy policy[BoardY]) const {
+        for (size_type layer = 0; layer < BoardY; layer++) {
+            policy[layer] = this->policy_[layer];
+        }
+    }
+
+    //
+    // The new policy affects the containers created or grown afterwards,
+    // an empty root is re-created to follow the root layer policy.
+    //
+    void set_layer_policy(size_type layer, const LayerPolicy & policy) {
+        assert(layer < BoardY);
+        this->policy_[layer] = policy;
+        if (this->policy_[layer].initCapacity < 1)
+            this->policy_[layer].initCapacity = 1;
+        if (this->policy_[layer].initCapacity > kArraySizeThreshold)
+            this->policy_[layer].initCapacity = kArraySizeThreshold;
+        if (this->policy_[layer].growthRate <= 100)
+            this->policy_[layer].growthRate = 200;
+
+        if (layer == 0 && this->size_ == 0 && this->root_ != nullptr) {
+            if (this->root_->type() != this->root_type()) {
+                this->destroy_trie();
+                this->create_root();
+                this->layout_version_++;
+            }
+        }
+    }
+
+    void set_layer_policy(const LayerPolicy policy[BoardY]) {
+        for (size_type layer = 0; layer < BoardY; layer++) {
+            this->set_layer_policy(layer, policy[layer]);
+        }
+    }
+
+    void reset_layer_policy() {
+        for (size_type layer = 0; layer < BoardY; layer++) {
+            this->set_layer_policy(layer, default_layer_policy(layer));
+        }
+    }
+
     void destroy_trie_impl(IContainer * container, size_type layer) {
         assert(container != nullptr);
         for (size_type i = container->begin(); i < container->end(); container->next(i)) {
             IContainer * child = container->getValue(i);
-            assert(child != nullptr);
+            if (child == nullptr)
+                continue;
             if (!child->isLeaf()) {
                 this->destroy_trie_impl(child, layer + 1);
             }
@@ -1143,6 +1529,8 @@ public:
             return;
         }
 
+        PagedArena::Scope scope(this->arena_);
+
         for (size_type i = container->begin(); i < container->end(); container->next(i)) {
             IContainer * child = container->getValue(i);
             if (child != nullptr) {
@@ -1157,17 +1545,27 @@ public:
 
     void clear_trie_info() {
 #if SPARSEBITSET_USE_TRIE_INFO
+        clear_layer_info(this->layer_info_);
+#endif
+    }
+
+    static void clear_layer_info(LayerInfo layer_info[BoardY]) {
         for (size_type i = 0; i < BoardY; i++) {
-            this->layer_info_[i].maxLayerSize = 0;
-            this->layer_info_[i].childCount = 0;
-            this->layer_info_[i].totalLayerSize = 0;
+            layer_info[i].maxLayerSize = 0;
+            layer_info[i].childCount = 0;
+            layer_info[i].totalLayerSize = 0;
+            layer_info[i].totalCapacity = 0;
+            layer_info[i].bitmapCount = 0;
+            layer_info[i].totalBytes = 0;
         }
-#endif
     }
 
     size_type get_layer_value(const board_type & board, size_type layer) const {
         size_type y = this->y_index_[layer];
         ssize_type cell_y = y * BoardX;
+        if (Bits == 3) {
+            return size_type(CellPack::pack(&board.cells[cell_y], BoardX));
+        }
         size_type layer_value = 0;
         for (ssize_type x = BoardX - 1; x >= 0; x--) {
             layer_value <<= 3;
@@ -1176,24 +1574,88 @@ public:
         return layer_value;
     }
 
-    void compose_segment_to_board(board_type & board, const std::uint16_t segment_list[BoardY]) {
+    void compose_layer_to_board(board_type & board, size_type layer, std::uint32_t value) const {
+        size_type y = this->y_index_[layer];
+        size_type base_pos = y * BoardX;
+        assert((base_pos + BoardX) <= BoardSize);
+        CellPack::unpack(&board.cells[base_pos], BoardX, value);
+#ifndef NDEBUG
+        for (size_type x = 0; x < BoardX; x++) {
+            std::uint32_t color = board.cells[base_pos + x];
+            assert(color >= Color::First && color < Color::Maximum);
+        }
+#endif
+    }
+
+    void compose_segment_to_board(board_type & board, const ident_type segment_list[BoardY]) const {
         for (size_type index = 0; index < BoardY; index++) {
             std::uint32_t value = (std::uint32_t)segment_list[index];
-            size_type y = this->y_index_[index];
-            size_type base_pos = y * BoardX;
-            for (size_type x = 0; x < BoardX; x++) {
-                std::uint32_t color = value & Color::Mask32;
-                assert(color >= Color::First && color < Color::Maximum);
-                size_type pos = base_pos + x;
-                assert(pos < BoardSize);
-                board.cells[pos] = (std::uint8_t)color;
-                value >>= Color::Shift32;
+            this->compose_layer_to_board(board, index, value);
+        }
+    }
+
+    const_iterator begin() const {
+        if (this->root_ != nullptr)
+            return const_iterator(this, this->root_->begin(), this->root_->end());
+        else
+            return const_iterator();
+    }
+
+    const_iterator begin(const range_type & range) const {
+        return const_iterator(this, range.first, range.last);
+    }
+
+    const_iterator end() const {
+        return const_iterator();
+    }
+
+    range_type full_range() const {
+        if (this->root_ != nullptr)
+            return range_type(this->root_->begin(), this->root_->end());
+        else
+            return range_type();
+    }
+
+    //
+    // Split the root positions into at most n disjoint ranges, balanced by
+    // the size of each root child, so every range can be walked by its own worker.
+    //
+    size_type split(size_type n, std::vector<range_type> & ranges) const {
+        ranges.clear();
+        IContainer * root = this->root_;
+        if (root == nullptr || root->size() == 0 || n == 0) {
+            return 0;
+        }
+
+        size_type total_weight = 0;
+        for (size_type i = root->begin(); i < root->end(); root->next(i)) {
+            IContainer * child = root->getValue(i);
+            if (child != nullptr) {
+                total_weight += child->size();
+            }
+        }
+
+        size_type weight = 0;
+        size_type first = root->begin();
+        for (size_type i = root->begin(); i < root->end(); root->next(i)) {
+            IContainer * child = root->getValue(i);
+            if (child == nullptr)
+                continue;
+            weight += child->size();
+            size_type index = ranges.size();
+            if ((index + 1) < n && (weight * n) >= (total_weight * (index + 1))) {
+                ranges.push_back(range_type(first, i + 1));
+                first = i + 1;
             }
         }
+        if (first < root->end()) {
+            ranges.push_back(range_type(first, root->end()));
+        }
+        return ranges.size();
     }
 
     bool contains(const board_type & board) const {
-        IContainer * container = this->root();
+        const IContainer * container = this->root();
         assert(container != nullptr);
 
         // Normal container
@@ -1262,35 +1724,119 @@ public:
         }
     }
 
+    IContainer * create_container(size_type layer) {
+        assert(layer > 0 && layer < BoardY);
+        const LayerPolicy & policy = this->policy_[layer];
+        if (layer < (BoardY - 1)) {
+            if (policy.bitmapThreshold != 0)
+                return new ArrayContainer(policy.initCapacity);
+            else
+                return new BitmapContainer();
+        }
+        else {
+            if (policy.bitmapThreshold != 0)
+                return new LeafArrayContainer(policy.initCapacity);
+            else
+                return new LeafBitmapContainer();
+        }
+    }
+
+    void grow_container(IContainer * container, size_type layer) {
+        assert(container != nullptr);
+        assert(container->isArray());
+        const LayerPolicy & policy = this->policy_[layer];
+        size_type capacity = container->capacity();
+        size_type new_capacity = capacity * policy.growthRate / 100;
+        if (new_capacity < (capacity + kDefaultArrayCapacity))
+            new_capacity = capacity + kDefaultArrayCapacity;
+        if (new_capacity > kMaxArraySize)
+            new_capacity = kMaxArraySize;
+        container->grow(new_capacity, policy.sortThreshold);
+    }
+
+    IContainer * convert_to_bitmap(IContainer * container) {
+        assert(container != nullptr);
+        assert(container->isArray());
+        IContainer * bitmap;
+        if (!container->isLeaf()) {
+            bitmap = new BitmapContainer();
+            for (size_type i = container->begin(); i < container->end(); container->next(i)) {
+                bitmap->append(ident_type(container->getId(i)), container->getValue(i));
+            }
+        }
+        else {
+            bitmap = new LeafBitmapContainer();
+            for (size_type i = container->begin(); i < container->end(); container->next(i)) {
+                bitmap->append(ident_type(container->getId(i)), nullptr);
+            }
+        }
+        assert(bitmap->size() == container->size());
+        // Only the id array is released, the children are owned by the bitmap now.
+        delete container;
+        return bitmap;
+    }
+
     //
-    // Root -> (ArrayContainer)0 -> (ArrayContainer)1 -> (ArrayContainer)2 -> (LeafArrayContainer)3 -> 4444
+    // Make room for one more id in an existing container, following the layer policy:
+    // switch it to a bitmap container when it reaches the threshold, otherwise grow it.
     //
-    bool insert(const board_type & board) {
-        IContainer * container = this->root();
+    IContainer * prepare_append(IContainer * container, size_type layer,
+                                IContainer * parent, size_type parent_id) {
+        IContainer * prepared = this->prepare_append(container, layer, parent, parent_id, this->root_);
+        if (prepared != container)
+            this->layout_version_++;
+        return prepared;
+    }
+
+    //
+    // Same as above, but a container without parent is replaced in slot.
+    //
+    IContainer * prepare_append(IContainer * container, size_type layer,
+                                IContainer * parent, size_type parent_id, IContainer *& slot) {
         assert(container != nullptr);
-        bool insert_new = false;
+        if (container->isArray()) {
+            const LayerPolicy & policy = this->policy_[layer];
+            if (container->size() >= policy.bitmapThreshold) {
+                IContainer * bitmap = this->convert_to_bitmap(container);
+                if (parent != nullptr)
+                    parent->setChild(ident_type(parent_id), bitmap);
+                else
+                    slot = bitmap;
+                return bitmap;
+            }
+            if (container->size() >= container->capacity()) {
+                this->grow_container(container, layer);
+            }
+        }
+        return container;
+    }
 
+    //
+    // Append the rest of the key from first_layer, the id of first_layer must not exist
+    // in the container. parent is the container of the previous layer (nullptr for root).
+    //
+    void insert_new_from(const board_type & board, size_type first_layer, IContainer * container,
+                         IContainer * parent, size_type parent_id, IContainer ** path = nullptr) {
+        PagedArena::Scope scope(this->arena_, this->segment_of(board));
+        container = this->prepare_append(container, first_layer, parent, parent_id);
+        this->append_from(board, first_layer, container, path);
+        this->size_++;
+    }
+
+    //
+    // Append the rest of the key from first_layer into a prepared container.
+    //
+    void append_from(const board_type & board, size_type first_layer, IContainer * container,
+                     IContainer ** path = nullptr) {
         // Normal container
         size_type layer;
-        for (layer = 0; layer < BoardY - 1; layer++) {
+        for (layer = first_layer; layer < BoardY - 1; layer++) {
+            if (path != nullptr)
+                path[layer] = container;
             size_type layer_id = this->get_layer_value(board, layer);
-            if (!insert_new) {
-                assert(!container->isLeaf());
-                IContainer * child;
-                bool is_exists = container->hasChild(layer_id, child);
-                if (is_exists) {
-                    assert(child != nullptr);
-                    container = child;
-                    continue;
-                }
-                else {
-                    insert_new = true;
-                }
-            }
-            if (layer < (BoardY - 2))
-                container = container->append(layer_id);
-            else
-                container = container->appendLeaf(layer_id);
+            IContainer * child = this->create_container(layer + 1);
+            container->append(ident_type(layer_id), child);
+            container = child;
         }
 
         // Leaf container
@@ -1298,48 +1844,139 @@ public:
             assert(container != nullptr);
             assert(container->isLeaf());
 
+            if (path != nullptr)
+                path[layer] = container;
             size_type layer_id = this->get_layer_value(board, layer);
-            if (!insert_new) {
-                bool is_exists = container->hasLeaf(layer_id);
-                if (is_exists) {
-                    return false;
-                }
-            }
-            container->appendLeaf(layer_id);
-            this->size_++;
+            container->append(ident_type(layer_id), nullptr);
+        }
+    }
+
+    //
+    // The subtree primitives of ConcurrentSparseBitset, which keeps the children of
+    // the root layer by itself. child is the layer 1 container of the root id of
+    // the board (nullptr if there is none yet), it may be created or replaced.
+    // They don't touch the root, size() or the layout version, so the calls on
+    // different children can run at the same time.
+    //
+    bool try_insert_subtree(const board_type & board, IContainer *& child) {
+        if (child == nullptr) {
+            child = this->create_container(1);
+            this->append_from(board, 1, child);
             return true;
         }
+
+        IContainer * container = child;
+        IContainer * parent = nullptr;
+        size_type parent_id = 0;
+
+        size_type layer;
+        for (layer = 1; layer < BoardY - 1; layer++) {
+            size_type layer_id = this->get_layer_value(board, layer);
+            IContainer * next;
+            bool is_exists = container->hasChild(layer_id, next);
+            if (!is_exists)
+                break;
+            parent = container;
+            parent_id = layer_id;
+            container = next;
+        }
+
+        if (layer == BoardY - 1) {
+            size_type layer_id = this->get_layer_value(board, layer);
+            if (container->hasLeaf(layer_id))
+                return false;
+        }
+
+        container = this->prepare_append(container, layer, parent, parent_id, child);
+        this->append_from(board, layer, container);
+        return true;
+    }
+
+    bool contains_subtree(const board_type & board, const IContainer * child) const {
+        if (child == nullptr)
+            return false;
+
+        const IContainer * container = child;
+        size_type layer;
+        for (layer = 1; layer < BoardY - 1; layer++) {
+            size_type layer_id = this->get_layer_value(board, layer);
+            IContainer * next;
+            bool is_exists = container->hasChild(layer_id, next);
+            if (!is_exists)
+                return false;
+            container = next;
+        }
+
+        size_type layer_id = this->get_layer_value(board, layer);
+        return container->hasLeaf(layer_id);
+    }
+
+    //
+    // Take over the root children (kMaxArraySize slots, nullptr is empty) that hold
+    // total_size keys, the slots are cleared.
+    //
+    void assign_root_children(IContainer ** children, size_type total_size) {
+        this->destroy();
+        this->create_root();
+        PagedArena::Scope scope(this->arena_);
+        IContainer * root = this->root_;
+        for (size_type id = 0; id < kMaxArraySize; id++) {
+            if (children[id] != nullptr) {
+                root = this->prepare_append(root, 0, nullptr, 0);
+                root->append(ident_type(id), children[id]);
+                children[id] = nullptr;
+            }
+        }
+        this->size_ = total_size;
+        this->layout_version_++;
+    }
+
+    //
+    // Root -> (ArrayContainer)0 -> (ArrayContainer)1 -> (ArrayContainer)2 -> (LeafArrayContainer)3 -> 4444
+    //
+    bool insert(const board_type & board) {
+        return this->try_insert(board);
     }
 
     //
     // Root -> (ArrayContainer)0 -> (ArrayContainer)1 -> (ArrayContainer)2 -> (LeafArrayContainer)3 -> 4444
     //
     bool try_insert(const board_type & board) {
+        bool insert_new = this->try_insert_trie(board);
+        // Keep the Bloom pre-filter in sync, if it's in use.
+        if (insert_new && !this->filter_.empty()) {
+            this->filter_.insert(board.key());
+        }
+        return insert_new;
+    }
+
+    //
+    // Insert into the trie only, the Bloom pre-filter is not updated.
+    //
+    bool try_insert_trie(const board_type & board) {
         IContainer * container = this->root();
         assert(container != nullptr);
-        bool insert_new = false;
+        IContainer * parent = nullptr;
+        size_type parent_id = 0;
 
         // Normal container
         size_type layer;
         for (layer = 0; layer < BoardY - 1; layer++) {
             size_type layer_id = this->get_layer_value(board, layer);
-            if (!insert_new) {
-                assert(!container->isLeaf());
-                IContainer * child;
-                bool is_exists = container->hasChild(layer_id, child);
-                if (is_exists) {
-                    assert(child != nullptr);
-                    container = child;
-                    continue;
-                }
-                else {
-                    insert_new = true;
-                }
+            assert(!container->isLeaf());
+            IContainer * child;
+            bool is_exists = container->hasChild(layer_id, child);
+            if (is_exists) {
+                assert(child != nullptr);
+                parent = container;
+                parent_id = layer_id;
+                container = child;
+                continue;
+            }
+            else {
+                this->insert_new_from(board, layer, container, parent, parent_id);
+                return true;
             }
-            if (layer < (BoardY - 2))
-                container = container->append(layer_id);
-            else
-                container = container->appendLeaf(layer_id);
         }
 
         // Leaf container
@@ -1348,17 +1985,173 @@ public:
             assert(container->isLeaf());
 
             size_type layer_id = this->get_layer_value(board, layer);
-            if (!insert_new) {
-                bool is_exists = container->hasLeaf(layer_id);
-                if (is_exists) {
-                    return false;
-                }
+            bool is_exists = container->hasLeaf(layer_id);
+            if (is_exists) {
+                return false;
             }
-            container->appendLeaf(layer_id);
-            this->size_++;
+            this->insert_new_from(board, layer, container, parent, parent_id);
+            return true;
+        }
+    }
+
+    //
+    // The first layer whose row has pos1 or pos2, the layers before it are the same
+    // for two boards that only differ in the cells pos1 and pos2.
+    //
+    size_type first_changed_layer(size_type pos1, size_type pos2) const {
+        size_type layer1 = this->layer_index_[pos1 / BoardX];
+        size_type layer2 = this->layer_index_[pos2 / BoardX];
+        return ((layer1 < layer2) ? layer1 : layer2);
+    }
+
+    //
+    // Same as try_insert(), and the containers on the path of board are stored in path.
+    //
+    bool try_insert(const board_type & board, InsertPath & path) {
+        return this->try_insert_from(board, path, 0, path);
+    }
+
+    //
+    // Insert a child board that only differs from its parent from first_layer on.
+    // The search restarts at first_layer of parent_path (the path of the parent board),
+    // unless the layout was changed since then. The path of board is stored in path,
+    // it may be the same as parent_path.
+    //
+    bool try_insert_from(const board_type & board, const InsertPath & parent_path,
+                         size_type first_layer, InsertPath & path) {
+        IContainer * container;
+        IContainer * parent;
+        size_type parent_id;
+        size_type layer;
+        if (first_layer != 0 && parent_path.version == this->layout_version_) {
+            for (layer = 0; layer <= first_layer; layer++) {
+                path.containers[layer] = parent_path.containers[layer];
+            }
+            layer = first_layer;
+            container = path.containers[layer];
+            parent = path.containers[layer - 1];
+            parent_id = this->get_layer_value(board, layer - 1);
+        }
+        else {
+            container = this->root();
+            parent = nullptr;
+            parent_id = 0;
+            layer = 0;
+        }
+        assert(container != nullptr);
+
+        // Normal container
+        for (; layer < BoardY - 1; layer++) {
+            path.containers[layer] = container;
+            size_type layer_id = this->get_layer_value(board, layer);
+            assert(!container->isLeaf());
+            IContainer * child;
+            bool is_exists = container->hasChild(layer_id, child);
+            if (!is_exists)
+                break;
+            assert(child != nullptr);
+            parent = container;
+            parent_id = layer_id;
+            container = child;
+        }
+
+        // Leaf container
+        if (layer == BoardY - 1) {
+            assert(container->isLeaf());
+            path.containers[layer] = container;
+            size_type layer_id = this->get_layer_value(board, layer);
+            if (container->hasLeaf(layer_id)) {
+                path.version = this->layout_version_;
+                return false;
+            }
+        }
+
+        this->insert_new_from(board, layer, container, parent, parent_id, path.containers);
+        path.version = this->layout_version_;
+        if (!this->filter_.empty()) {
+            this->filter_.insert(board.key());
+        }
+        return true;
+    }
+
+    //
+    // Append a key that is known to be new, skip the search in the leaf container.
+    //
+    void insert_unchecked(const board_type & board) {
+        IContainer * container = this->root();
+        assert(container != nullptr);
+        IContainer * parent = nullptr;
+        size_type parent_id = 0;
+
+        size_type layer;
+        for (layer = 0; layer < BoardY - 1; layer++) {
+            size_type layer_id = this->get_layer_value(board, layer);
+            IContainer * child;
+            bool is_exists = container->hasChild(layer_id, child);
+            if (!is_exists)
+                break;
+            parent = container;
+            parent_id = layer_id;
+            container = child;
+        }
+
+        this->insert_new_from(board, layer, container, parent, parent_id);
+    }
+
+    //
+    // The Bloom pre-filter in front of try_insert(), it's keyed on board.key().
+    // When the filter says the key is new, the leaf search is skipped.
+    //
+    const BlockedBloomFilter & filter() const {
+        return this->filter_;
+    }
+
+    const BlockedBloomFilter::Stats & filter_stats() const {
+        return this->filter_.stats();
+    }
+
+    void clear_filter_stats() {
+        this->filter_.clear_stats();
+    }
+
+    void destroy_filter() {
+        this->filter_.destroy();
+    }
+
+    //
+    // Make sure the filter can hold expected_count keys, a smaller one
+    // is rebuilt (twice as large) from the keys in the trie.
+    //
+    void reserve_filter(size_type expected_count,
+                        size_type bits_per_key = BlockedBloomFilter::kDefaultBitsPerKey) {
+        if (expected_count <= this->filter_.capacity())
+            return;
 
+        this->filter_.reserve(expected_count * 2, bits_per_key);
+        for (const_iterator iter = this->begin(); iter != this->end(); ++iter) {
+            this->filter_.insert(iter->key());
+        }
+    }
+
+    bool try_insert_filtered(const board_type & board) {
+        if (this->filter_.empty()) {
+            return this->try_insert(board);
+        }
+
+        BlockedBloomFilter::Stats & stats = this->filter_.stats();
+        bool maybe_exists = this->filter_.test_and_set(board.key());
+        if (!maybe_exists) {
+            stats.definitelyNew++;
+            this->insert_unchecked(board);
             return true;
         }
+        else {
+            stats.maybeExists++;
+            bool insert_new = this->try_insert_trie(board);
+            if (insert_new)
+                stats.falsePositive++;
+            return insert_new;
+        }
     }
 
     //
@@ -1367,15 +2160,20 @@ public:
     void always_insert_new(const board_type & board, size_type last_layer, IContainer * last_container) {
         IContainer * container = last_container;
         assert(container != nullptr);
+        PagedArena::Scope scope(this->arena_, this->segment_of(board));
+
+        // Grow the last container in place, it can't be switched to bitmap without its parent.
+        if (container->isArray() && container->size() >= container->capacity()) {
+            this->grow_container(container, last_layer);
+        }
 
         // Normal container
         size_type layer;
         for (layer = last_layer; layer < BoardY - 1; layer++) {
             size_type layer_id = this->get_layer_value(board, layer);
-            if (layer < (BoardY - 2))
-                container = container->append(layer_id);
-            else
-                container = container->appendLeaf(layer_id);
+            IContainer * child = this->create_container(layer + 1);
+            container->append(ident_type(layer_id), child);
+            container = child;
         }
 
         // Leaf container
@@ -1384,60 +2182,335 @@ public:
             assert(container->isLeaf());
 
             size_type layer_id = this->get_layer_value(board, layer);
-            container->appendLeaf(layer_id);
+            container->append(ident_type(layer_id), nullptr);
         }
 
+        if (!this->filter_.empty()) {
+            this->filter_.insert(board.key());
+        }
         this->size_++;
     }
 
+    static void prefetch_address(const void * address) {
+        _mm_prefetch((const char *)address, _MM_HINT_T0);
+    }
+
+    void start_lookup(LookupState & state, const board_type * boards, size_type index) {
+        state.board = &boards[index];
+        state.container = this->root();
+        state.parent = nullptr;
+        state.parent_id = 0;
+        state.index = index;
+        state.layer = 0;
+        state.layer_id = this->get_layer_value(boards[index], 0);
+        // The root container is always hot, search it directly.
+        state.step = LookupStep::Search;
+        state.version = this->layout_version_;
+    }
+
+    //
+    // A container was switched to bitmap since the last step of this lookup,
+    // walk down again to the same layer, the prefix is known to exist.
+    // It doesn't count as a step, so the order of the lookups is kept.
+    //
+    void relocate_lookup(LookupState & state) {
+        IContainer * container = this->root();
+        IContainer * parent = nullptr;
+        size_type parent_id = 0;
+        for (size_type layer = 0; layer < state.layer; layer++) {
+            size_type layer_id = this->get_layer_value(*state.board, layer);
+            IContainer * child = nullptr;
+            bool is_exists = container->hasChild(layer_id, child);
+            assert(is_exists && child != nullptr);
+            (void)is_exists;
+            parent = container;
+            parent_id = layer_id;
+            container = child;
+        }
+        state.container = container;
+        state.parent = parent;
+        state.parent_id = parent_id;
+        state.version = this->layout_version_;
+    }
+
+    //
+    // Advance one lookup by a single step, return true when it has finished.
+    // A search and the insertion that may follow it are done in the same step,
+    // so the interleaved lookups can never append the same id twice.
+    //
+    bool try_insert_step(LookupState & state, bool * results, size_type & inserted) {
+        if (state.version != this->layout_version_) {
+            this->relocate_lookup(state);
+        }
+
+        if (state.step == LookupStep::Prefetch) {
+            // The container header has been prefetched, now prefetch its data.
+            state.layer_id = this->get_layer_value(*state.board, state.layer);
+            prefetch_address(state.container->getPrefetchAddress(ident_type(state.layer_id)));
+            state.step = LookupStep::Search;
+            return false;
+        }
+
+        assert(state.step == LookupStep::Search);
+        IContainer * container = state.container;
+        assert(container != nullptr);
+
+        bool insert_new;
+        if (state.layer < (BoardY - 1)) {
+            assert(!container->isLeaf());
+            IContainer * child;
+            bool is_exists = container->hasChild(state.layer_id, child);
+            if (is_exists) {
+                assert(child != nullptr);
+                state.parent = container;
+                state.parent_id = state.layer_id;
+                state.container = child;
+                state.layer++;
+                prefetch_address(child);
+                state.step = LookupStep::Prefetch;
+                return false;
+            }
+            insert_new = true;
+        }
+        else {
+            assert(container->isLeaf());
+            insert_new = !container->hasLeaf(state.layer_id);
+        }
+
+        if (insert_new) {
+            this->insert_new_from(*state.board, state.layer, container, state.parent, state.parent_id);
+            if (!this->filter_.empty()) {
+                this->filter_.insert(state.board->key());
+            }
+            inserted++;
+        }
+        if (results != nullptr) {
+            results[state.index] = insert_new;
+        }
+        state.step = LookupStep::Finished;
+        return true;
+    }
+
+    //
+    // Batched try_insert(), in the style of asynchronous memory access chaining:
+    // keep GroupSize lookups in flight and round-robin between them, each one
+    // prefetches its next container before yielding, so the cache misses of
+    // independent boards overlap.
+    //
+    // The slots are never compacted, a board always runs ahead of any later
+    // board that has the same key, so the results are the same as calling
+    // try_insert() on each board in order.
+    //
+    template <size_type GroupSize = kDefaultGroupSize>
+    size_type try_insert_batch(const board_type * boards, size_type count, bool * results = nullptr) {
+        static_assert((GroupSize > 0), "SparseBitset::try_insert_batch(): GroupSize must be greater than 0.");
+        assert(this->root() != nullptr);
+
+        LookupState states[GroupSize];
+        size_type inserted = 0;
+        size_type next = 0;
+        size_type active = 0;
+
+        for (size_type g = 0; g < GroupSize; g++) {
+            if (next < count) {
+                this->start_lookup(states[g], boards, next++);
+                active++;
+            }
+            else {
+                states[g].step = LookupStep::Finished;
+            }
+        }
+
+        while (active > 0) {
+            for (size_type g = 0; g < GroupSize; g++) {
+                LookupState & state = states[g];
+                if (state.step == LookupStep::Finished)
+                    continue;
+                bool finished = this->try_insert_step(state, results, inserted);
+                if (finished) {
+                    if (next < count)
+                        this->start_lookup(state, boards, next++);
+                    else
+                        active--;
+                }
+            }
+        }
+
+        return inserted;
+    }
+
+    //
+    // try_insert() the boards grouped by their arena segment (a stable counting sort),
+    // so the pages of one segment are touched together and the working set stays small.
+    // The results are the same as calling try_insert() on each board in order.
+    //
+    size_type try_insert_clustered(const board_type * boards, size_type count, bool * results = nullptr) {
+        if (this->arena_ == nullptr) {
+            size_type inserted = 0;
+            for (size_type i = 0; i < count; i++) {
+                bool insert_new = this->try_insert(boards[i]);
+                if (results != nullptr)
+                    results[i] = insert_new;
+                inserted += insert_new ? 1 : 0;
+            }
+            return inserted;
+        }
+
+        size_type segments = this->arena_->segments();
+        std::vector<std::uint32_t> offsets(segments + 1, 0);
+        std::vector<std::uint32_t> order(count);
+        for (size_type i = 0; i < count; i++) {
+            offsets[this->segment_of(boards[i]) + 1]++;
+        }
+        for (size_type segment = 0; segment < segments; segment++) {
+            offsets[segment + 1] += offsets[segment];
+        }
+        for (size_type i = 0; i < count; i++) {
+            order[offsets[this->segment_of(boards[i])]++] = std::uint32_t(i);
+        }
+
+        size_type inserted = 0;
+        for (size_type i = 0; i < count; i++) {
+            size_type index = order[i];
+            bool insert_new = this->try_insert(boards[index]);
+            if (results != nullptr)
+                results[index] = insert_new;
+            inserted += insert_new ? 1 : 0;
+        }
+        return inserted;
+    }
+
     bool remove(const board_type & board) {
         return true;
     }
 
-    void count_trie_info_impl(IContainer * container, size_type layer) {
-#if SPARSEBITSET_USE_TRIE_INFO
+    static size_type container_bytes(const IContainer * container) {
+        assert(container != nullptr);
+        switch (container->type()) {
+            case NodeType::ArrayContainer:
+                return (sizeof(ArrayContainer) +
+                        container->capacity() * (sizeof(ident_type) + sizeof(IContainer *)));
+            case NodeType::BitmapContainer:
+                return (sizeof(BitmapContainer) + kMaxArraySize * sizeof(IContainer *));
+            case NodeType::LeafArrayContainer:
+                return (sizeof(LeafArrayContainer) + container->capacity() * sizeof(ident_type));
+            case NodeType::LeafBitmapContainer:
+                return sizeof(LeafBitmapContainer);
+            default:
+                assert(false);
+                return 0;
+        }
+    }
+
+    static void collect_layer_info_impl(const IContainer * container, size_type layer,
+                                        LayerInfo layer_info[BoardY]) {
         assert(container != nullptr);
         size_type layer_size = container->size();
-        if (layer_size > this->layer_info_[layer].maxLayerSize) {
-            this->layer_info_[layer].maxLayerSize = layer_size;
+        if (layer_size > layer_info[layer].maxLayerSize) {
+            layer_info[layer].maxLayerSize = layer_size;
         }
-        this->layer_info_[layer].childCount++;
-        this->layer_info_[layer].totalLayerSize += layer_size;
+        layer_info[layer].childCount++;
+        layer_info[layer].totalLayerSize += layer_size;
+        if (container->isArray())
+            layer_info[layer].totalCapacity += container->capacity();
+        else
+            layer_info[layer].bitmapCount++;
+        layer_info[layer].totalBytes += container_bytes(container);
 
         if (container->isLeaf()) {
             return;
         }
 
         for (size_type i = container->begin(); i < container->end(); container->next(i)) {
-            IContainer * child = container->getValue(i);
-            assert(child != nullptr);
-            this->count_trie_info_impl(child, layer + 1);
+            const IContainer * child = container->getValue(i);
+            if (child != nullptr) {
+                collect_layer_info_impl(child, layer + 1, layer_info);
+            }
         }
-#endif
     }
 
-    void count_trie_info() {
-#if SPARSEBITSET_USE_TRIE_INFO
-        this->clear_trie_info();
-
-        IContainer * container = this->root();
-        if (container == nullptr) {
-            return;
+    //
+    // Count the containers, ids and bytes of each layer.
+    //
+    void collect_layer_info(LayerInfo layer_info[BoardY]) const {
+        clear_layer_info(layer_info);
+        if (this->root() != nullptr) {
+            collect_layer_info_impl(this->root(), 0, layer_info);
         }
+    }
 
-        size_type layer_size = container->size();
-        if (layer_size > this->layer_info_[0].maxLayerSize) {
-            this->layer_info_[0].maxLayerSize = layer_size;
+    size_type memory_usage() const {
+        LayerInfo layer_info[BoardY];
+        this->collect_layer_info(layer_info);
+
+        size_type total_bytes = sizeof(this_type);
+        for (size_type layer = 0; layer < BoardY; layer++) {
+            total_bytes += layer_info[layer].totalBytes;
         }
-        this->layer_info_[0].childCount++;
-        this->layer_info_[0].totalLayerSize += layer_size;
+        return total_bytes;
+    }
 
-        for (size_type i = container->begin(); i < container->end(); container->next(i)) {
-            IContainer * child = container->getValue(i);
-            if (child != nullptr) {
-                this->count_trie_info_impl(child, 1);
+    //
+    // Derive the layer policies from the shape of a trie that has been built,
+    // a trie of the same kind of boards can be built with them next time.
+    //
+    static void tune_layer_policy(const LayerInfo layer_info[BoardY], LayerPolicy policy[BoardY]) {
+        for (size_type layer = 0; layer < BoardY; layer++) {
+            const LayerInfo & info = layer_info[layer];
+            LayerPolicy & layer_policy = policy[layer];
+            layer_policy = default_layer_policy(layer);
+            if (info.childCount == 0)
+                continue;
+
+            bool is_leaf = (layer == BoardY - 1);
+            size_type average_size = info.totalLayerSize / info.childCount;
+
+            // Where a bitmap uses no more bytes than an array holding the same ids,
+            // the array is counted with its average fill ratio.
+            size_type entry_bytes = is_leaf ? sizeof(ident_type)
+                                            : (sizeof(ident_type) + sizeof(IContainer *));
+            size_type bitmap_bytes = is_leaf ? (kMaxArraySize / 8)
+                                             : (kMaxArraySize / 8 + kMaxArraySize * sizeof(IContainer *));
+            size_type bitmap_threshold;
+            if (info.totalCapacity > 0 && info.totalLayerSize > 0) {
+                bitmap_threshold = (bitmap_bytes * info.totalLayerSize) /
+                                   (entry_bytes * info.totalCapacity);
+            }
+            else {
+                bitmap_threshold = bitmap_bytes / entry_bytes;
+            }
+            if (bitmap_threshold > kArraySizeThreshold)
+                bitmap_threshold = kArraySizeThreshold;
+            if (bitmap_threshold < kDefaultArrayCapacity)
+                bitmap_threshold = kDefaultArrayCapacity;
+
+            // There is only one root container and every lookup searches it,
+            // it is cheap to keep it dense unless it holds very few ids.
+            if (layer == 0 && kBitmapRoot && info.maxLayerSize >= kArraySizeSortThersold)
+                layer_policy.bitmapThreshold = 0;
+            else
+                layer_policy.bitmapThreshold = static_cast<std::uint32_t>(bitmap_threshold);
+
+            size_type init_capacity = kDefaultArrayCapacity;
+            while ((init_capacity * 2) <= average_size && init_capacity < 1024) {
+                init_capacity *= 2;
             }
+            layer_policy.initCapacity = static_cast<std::uint32_t>(init_capacity);
+            layer_policy.growthRate = (average_size >= 1024) ? 150 : 200;
         }
+    }
+
+    void autotune_layer_policy() {
+        LayerInfo layer_info[BoardY];
+        LayerPolicy policy[BoardY];
+        this->collect_layer_info(layer_info);
+        tune_layer_policy(layer_info, policy);
+        this->set_layer_policy(policy);
+    }
+
+    void count_trie_info() {
+#if SPARSEBITSET_USE_TRIE_INFO
+        this->collect_layer_info(this->layer_info_);
 #endif
     }
 
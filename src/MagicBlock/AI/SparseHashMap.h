@@ -16,13 +16,18 @@
 #include <bitset>
 #include <algorithm>        // For std::swap(), until C++11
 #include <utility>          // For std::swap(), since C++11
+#include <iterator>         // For std::forward_iterator_tag
 #include <exception>
 #include <stdexcept>
+#include <type_traits>
 
 #include "MagicBlock/AI/Color.h"
 #include "MagicBlock/AI/Board.h"
 #include "MagicBlock/AI/Value128.h"
+#include "MagicBlock/AI/CellPack.h"
 #include "MagicBlock/AI/Algorithm.h"
+#include "MagicBlock/AI/LayerOrder.h"
+#include "MagicBlock/AI/Config.h"
 
 #define SPARSEHASHMAP_USE_INDEX_SORT    1
 #define SPARSEHASHMAP_USE_TRIE_INFO     0
@@ -30,18 +35,26 @@
 namespace MagicBlock {
 namespace AI {
 
-template <typename Key, typename Value, std::size_t Bits, std::size_t Length>
+//
+// The values are stored next to the ids of the leaf containers, so Value
+// must be a small POD type, such as a packed direction and depth.
+//
+template <typename Key, typename Value, std::size_t Bits, std::size_t Length,
+          std::size_t Order = LayerOrder::Interleaved>
 class SparseHashMap {
 public:
     typedef std::size_t         size_type;
     typedef std::ptrdiff_t      ssize_type;
 
+    typedef SparseHashMap<Key, Value, Bits, Length, Order>  this_type;
+
     typedef Key                 key_type;
     typedef Value               value_type;
 
     static const size_type      BoardX = key_type::Y;
     static const size_type      BoardY = key_type::X;
     static const size_type      BoardSize = key_type::BoardSize;
+    static const size_type      kLayerOrder = Order;
 
     static const size_type      kBitMask = (size_type(1) << Bits) - 1;
 
@@ -54,6 +67,9 @@ public:
 
     static const size_type      kArraySizeSortThersold = 64;
 
+    static_assert(std::is_trivially_copyable<Value>::value,
+                  "SparseHashMap<K, V>: V must be trivially copyable.");
+
 #pragma pack(push, 1)
 
     struct LayerInfo {
@@ -828,30 +844,39 @@ public:
                 uintptr_t * new_ptr = (uintptr_t *)std::malloc(newSize);
                 if (new_ptr != nullptr) {
                     //assert(this->ptr_ != nullptr);
+                    std::uint16_t * indexEnd = (std::uint16_t *)this->ptr_ + this->capacity();
+                    std::uint16_t * newIndexEnd = (std::uint16_t *)new_ptr + newCapacity;
+                    value_type * valueFirst = (value_type *)indexEnd;
+                    value_type * newValueFirst = (value_type *)newIndexEnd;
 #if SPARSEHASHMAP_USE_INDEX_SORT
                     if (this->capacity() <= kArraySizeSortThersold) {
                         std::memcpy(new_ptr, this->ptr_, sizeof(std::uint16_t) * this->capacity());
+                        std::memcpy(newValueFirst, valueFirst, sizeof(value_type) * this->capacity());
                     }
                     else {
                         if (this->sorted() != 0) {
                             // Quick sort (second half)
-                            Algorithm::quick_sort((std::uint16_t *)this->ptr_,
+                            Algorithm::quick_sort((std::uint16_t *)this->ptr_, valueFirst,
                                                   this->capacity() / 2, this->capacity() - 1);
                             // (Half) Merge sort
-                            Algorithm::merge_sort((std::uint16_t *)this->ptr_, (std::uint16_t *)new_ptr,
+                            Algorithm::merge_sort((std::uint16_t *)this->ptr_, valueFirst,
+                                                  (std::uint16_t *)new_ptr, newValueFirst,
                                                   0, this->capacity());
                             this->sorted_ = this->capacity_;
                         }
                         else {
                             // Quick sort
-                            Algorithm::quick_sort((std::uint16_t *)this->ptr_, 0, this->capacity());
+                            Algorithm::quick_sort((std::uint16_t *)this->ptr_, valueFirst,
+                                                  0, this->capacity() - 1);
                             // Copy sorted array to new buffer
                             std::memcpy(new_ptr, this->ptr_, sizeof(std::uint16_t) * this->capacity());
+                            std::memcpy(newValueFirst, valueFirst, sizeof(value_type) * this->capacity());
                             this->sorted_ = this->capacity_;
                         }
                     }
 #else
                     std::memcpy(new_ptr, this->ptr_, sizeof(std::uint16_t) * this->capacity());
+                    std::memcpy(newValueFirst, valueFirst, sizeof(value_type) * this->capacity());
 #endif
                     std::free(this->ptr_);
                     this->ptr_ = new_ptr;
@@ -879,13 +904,13 @@ public:
 
         void reserve(size_type capacity) final {
             assert(capacity > this->capacity());
-            size_type allocSize = sizeof(std::uint16_t) * capacity;
+            size_type allocSize = (sizeof(std::uint16_t) + sizeof(value_type)) * capacity;
             this->allocate(allocSize, capacity);
         }
 
         void resize(size_type newCapacity) final {
             assert (newCapacity > this->capacity());
-            size_type allocSize = sizeof(std::uint16_t) * newCapacity;
+            size_type allocSize = (sizeof(std::uint16_t) + sizeof(value_type)) * newCapacity;
             this->reallocate(allocSize, newCapacity);
         }
 
@@ -904,6 +929,16 @@ public:
             return (index != kInvalidIndex32);
         }
 
+        bool hasValue(std::uint16_t id, value_type *& value) const final {
+            int index = identArray_.indexOf(this->ptr_, this->size_, this->sorted_, id);
+            assert(index >= kInvalidIndex32);
+            if (index != kInvalidIndex32) {
+                value = this->valueArray_.getValue(this->ptr_, this->capacity_, index);
+                return true;
+            }
+            return false;
+        }
+
         value_type * appendValue(std::uint16_t id, const value_type & value) final {
             assert(this->size() <= kArraySizeThreshold);
             assert(this->size() <= kMaxArraySize);
@@ -913,7 +948,7 @@ public:
             this->identArray_.append(this->ptr_, this->size_, id);
             this->valueArray_.append(this->ptr_, this->capacity_, this->size_, value);
             this->size_++;
-            return nullptr;
+            return this->valueArray_.getValue(this->ptr_, this->capacity_, this->size_ - 1);
         }
 
         value_type * updateValue(std::uint16_t id, const value_type & value) final {
@@ -937,7 +972,7 @@ public:
 
         value_type * getData(int index) const final {
             assert(index < (int)this->size_);
-            return this->valueArray_.getValue(this->ptr_, index);
+            return this->valueArray_.getValue(this->ptr_, this->capacity_, index);
         }
     };
 
@@ -1068,6 +1103,14 @@ public:
             return this->bitset_.test(id);
         }
 
+        bool hasValue(std::uint16_t id, value_type *& value) const final {
+            bool exists = this->bitset_.test(id);
+            if (exists) {
+                value = this->valueArray_.getValue(this->ptr_, id);
+            }
+            return exists;
+        }
+
         void append(std::uint16_t id, IContainer * container) final {
             this->bitset_.set(id);
             this->size_++;
@@ -1077,17 +1120,15 @@ public:
             assert(this->size() <= kArraySizeThreshold);
             assert(this->size() <= kMaxArraySize);
             this->bitset_.set(id);
-            this->valueArray_.setValue(this->ptr_, id, value);
             this->size_++;
-            return nullptr;
+            return this->valueArray_.setValue(this->ptr_, id, value);
         }
 
         value_type * updateValue(std::uint16_t id, const value_type & value) final {
             assert(this->size() <= kArraySizeThreshold);
             assert(this->size() <= kMaxArraySize);
             assert(this->bitset_.test(id));
-            this->valueArray_.setValue(this->ptr_, id, value);
-            return nullptr;
+            return this->valueArray_.setValue(this->ptr_, id, value);
         }
 
         int getId(std::uint16_t index) const final {
@@ -1100,8 +1141,10 @@ public:
             return nullptr;
         }
 
+        // The values are indexed by the id
         value_type * getData(int index) const final {
-            assert(index < (int)this->size_);
+            assert(index >= 0 && index < (int)kMaxArraySize);
+            assert(this->bitset_.test(index));
             return this->valueArray_.getValue(this->ptr_, index);
         }
     };
@@ -1136,6 +1179,141 @@ public:
 
 #pragma pack(pop)
 
+    //
+    // Visit all of the keys in the trie order, value() is the value of the current key.
+    // The map must not be changed while it's iterated.
+    //
+    class const_iterator {
+    public:
+        typedef std::forward_iterator_tag   iterator_category;
+        typedef key_type                    value_type;
+        typedef std::ptrdiff_t              difference_type;
+        typedef const key_type *            pointer;
+        typedef const key_type &            reference;
+
+    private:
+        const this_type *   owner_;
+        IContainer *        containers_[BoardY];
+        size_type           pos_[BoardY];
+        key_type            board_;
+
+        void set_end() {
+            this->owner_ = nullptr;
+        }
+
+        // Find the first existing id at or after the current position of this layer,
+        // then descend to the leftmost leaf below it.
+        void seek(size_type layer) {
+            assert(this->owner_ != nullptr);
+            for (;;) {
+                IContainer * container = this->containers_[layer];
+                assert(container != nullptr);
+                size_type last = container->end();
+                size_type pos = this->pos_[layer];
+                int id = kInvalidIndex32;
+                while (pos < last) {
+                    id = container->getId(pos);
+                    if (id != kInvalidIndex32)
+                        break;
+                    container->next(pos);
+                }
+                this->pos_[layer] = pos;
+
+                if (pos < last) {
+                    this->owner_->compose_layer_to_board(this->board_, layer, std::uint32_t(id));
+                    if (layer < (BoardY - 1)) {
+                        IContainer * child = container->getValue(pos);
+                        assert(child != nullptr);
+                        layer++;
+                        this->containers_[layer] = child;
+                        this->pos_[layer] = child->begin();
+                        continue;
+                    }
+                    return;
+                }
+                else {
+                    if (layer == 0) {
+                        this->set_end();
+                        return;
+                    }
+                    layer--;
+                    this->containers_[layer]->next(this->pos_[layer]);
+                }
+            }
+        }
+
+    public:
+        const_iterator() noexcept : owner_(nullptr) {
+        }
+
+        explicit const_iterator(const this_type * owner) : owner_(owner) {
+            assert(owner != nullptr);
+            IContainer * root = owner->root_;
+            if (root != nullptr) {
+                this->containers_[0] = root;
+                this->pos_[0] = root->begin();
+                this->seek(0);
+            }
+            else {
+                this->set_end();
+            }
+        }
+
+        bool is_end() const {
+            return (this->owner_ == nullptr);
+        }
+
+        reference operator * () const {
+            assert(!this->is_end());
+            return this->board_;
+        }
+
+        pointer operator -> () const {
+            assert(!this->is_end());
+            return &this->board_;
+        }
+
+        const Value & value() const {
+            assert(!this->is_end());
+            const LeafContainer * leaf = static_cast<const LeafContainer *>(this->containers_[BoardY - 1]);
+            const Value * data = leaf->getData(this->pos_[BoardY - 1]);
+            assert(data != nullptr);
+            return *data;
+        }
+
+        const_iterator & operator ++ () {
+            assert(!this->is_end());
+            this->containers_[BoardY - 1]->next(this->pos_[BoardY - 1]);
+            this->seek(BoardY - 1);
+            return *this;
+        }
+
+        const_iterator operator ++ (int) {
+            const_iterator prev(*this);
+            ++(*this);
+            return prev;
+        }
+
+        bool operator == (const const_iterator & rhs) const {
+            if (this->is_end() || rhs.is_end())
+                return (this->owner_ == rhs.owner_);
+            if (this->owner_ != rhs.owner_)
+                return false;
+            for (size_type layer = 0; layer < BoardY; layer++) {
+                if (this->containers_[layer] != rhs.containers_[layer] ||
+                    this->pos_[layer] != rhs.pos_[layer])
+                    return false;
+            }
+            return true;
+        }
+
+        bool operator != (const const_iterator & rhs) const {
+            return !(*this == rhs);
+        }
+    };
+
+    typedef const_iterator  iterator;
+
 private:
     IContainer *    root_;
     size_type       size_;
@@ -1145,26 +1323,7 @@ private:
 #endif
 
     void init() {
-#if 1
-        size_type top = 0, bottom = BoardY - 1;
-        for (size_type yi = 0; yi < (BoardY / 2); yi++) {
-            this->y_index_[yi * 2 + 0] = top++;
-            this->y_index_[yi * 2 + 1] = bottom--;
-        }
-        if ((BoardY % 2) != 0) {
-            this->y_index_[BoardY - 1] = top;
-        }
-#else
-        size_type top = BoardY / 2 - 1, bottom = BoardY / 2;
-        if ((BoardY % 2) != 0) {
-            this->y_index_[0] = bottom;
-            bottom++;
-        }
-        for (size_type yi = 0; yi < (BoardY / 2); yi++) {
-            this->y_index_[yi * 2 + 1] = top--;
-            this->y_index_[yi * 2 + 2] = bottom++;
-        }
-#endif
+        LayerOrder::make_index<Order>(this->y_index_);
         this->create_root(NodeType::ArrayContainer);
     }
 
@@ -1210,6 +1369,26 @@ public:
         this->destroy();
     }
 
+    void clear() {
+        this->destroy();
+        this->create_root(NodeType::ArrayContainer);
+    }
+
+    void swap(this_type & other) {
+        if (&other != this) {
+            std::swap(this->root_, other.root_);
+            std::swap(this->size_, other.size_);
+        }
+    }
+
+    const_iterator begin() const {
+        return const_iterator(this);
+    }
+
+    const_iterator end() const {
+        return const_iterator();
+    }
+
     void destroy_trie_impl(IContainer * container, size_type layer) {
         assert(container != nullptr);
         for (size_type i = container->begin(); i < container->end(); container->next(i)) {
@@ -1253,6 +1432,9 @@ public:
     size_type get_layer_value(const key_type & board, size_type layer) const {
         size_type y = this->y_index_[layer];
         ssize_type cell_y = y * BoardX;
+        if (Bits == 3) {
+            return size_type(CellPack::pack(&board.cells[cell_y], BoardX));
+        }
         size_type layer_value = 0;
         for (ssize_type x = BoardX - 1; x >= 0; x--) {
             layer_value <<= 3;
@@ -1261,24 +1443,37 @@ public:
         return layer_value;
     }
 
+    void compose_layer_to_board(key_type & board, size_type layer, std::uint32_t value) const {
+        size_type y = this->y_index_[layer];
+        size_type base_pos = y * BoardX;
+        assert((base_pos + BoardX) <= BoardSize);
+        CellPack::unpack(&board.cells[base_pos], BoardX, value);
+#ifndef NDEBUG
+        for (size_type x = 0; x < BoardX; x++) {
+            std::uint32_t color = board.cells[base_pos + x];
+            assert(color >= Color::First && color < Color::Maximum);
+        }
+#endif
+    }
+
     void compose_segment_to_board(key_type & board, const std::uint16_t segment_list[BoardY]) {
         for (size_type index = 0; index < BoardY; index++) {
             std::uint32_t value = (std::uint32_t)segment_list[index];
             size_type y = this->y_index_[index];
             size_type base_pos = y * BoardX;
+            assert((base_pos + BoardX) <= BoardSize);
+            CellPack::unpack(&board.cells[base_pos], BoardX, value);
+#ifndef NDEBUG
             for (size_type x = 0; x < BoardX; x++) {
-                std::uint32_t color = value & Color::Mask32;
+                std::uint32_t color = board.cells[base_pos + x];
                 assert(color >= Color::First && color < Color::Maximum);
-                size_type pos = base_pos + x;
-                assert(pos < BoardSize);
-                board.cells[pos] = (std::uint8_t)color;
-                value >>= Color::Shift32;
             }
+#endif
         }
     }
 
     bool contains(const key_type & board) const {
-        IContainer * container = this->root();
+        IContainer * container = this->root_;
         assert(container != nullptr);
 
         // Normal container
@@ -1311,8 +1506,44 @@ public:
         }
     }
 
+    //
+    // Return the value of the key, or nullptr if the key does not exist.
+    //
+    value_type * find(const key_type & board) const {
+        IContainer * container = this->root_;
+        assert(container != nullptr);
+
+        // Normal container
+        size_type layer;
+        for (layer = 0; layer < BoardY - 1; layer++) {
+            size_type layer_id = this->get_layer_value(board, layer);
+            assert(!container->isLeaf());
+            IContainer * child;
+            bool is_exists = container->hasChild(layer_id, child);
+            if (is_exists) {
+                assert(child != nullptr);
+                container = child;
+            }
+            else {
+                return nullptr;
+            }
+        }
+
+        // Leaf container
+        {
+            assert(container != nullptr);
+            assert(container->isLeaf());
+
+            size_type layer_id = this->get_layer_value(board, layer);
+            LeafContainer * leafContainer = static_cast<LeafContainer *>(container);
+            value_type * value;
+            bool is_exists = leafContainer->hasValue(layer_id, value);
+            return (is_exists ? value : nullptr);
+        }
+    }
+
     bool contains(const key_type & board, size_type & last_layer, IContainer *& last_container) const {
-        IContainer * container = this->root();
+        IContainer * container = this->root_;
         assert(container != nullptr);
 
         // Normal container
@@ -1378,7 +1609,9 @@ protected:
                         continue;
                     }
                     else {
+                        // The leaf id is the value of the next layer
                         leafContainer = static_cast<LeafContainer *>(child);
+                        layer++;
                         break;
                     }
                 }
@@ -1447,7 +1680,9 @@ public:
                         continue;
                     }
                     else {
+                        // The leaf id is the value of the next layer
                         leafContainer = static_cast<LeafContainer *>(child);
+                        layer++;
                         break;
                     }
                 }
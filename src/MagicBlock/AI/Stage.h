@@ -10,6 +10,7 @@
 
 #include "MagicBlock/AI/Move.h"
 #include "MagicBlock/AI/MoveSeq.h"
+#include "MagicBlock/AI/MoveTree.h"
 #include "MagicBlock/AI/Board.h"
 
 namespace MagicBlock {
@@ -17,45 +18,58 @@ namespace AI {
 
 #pragma pack(push, 1)
 
-template <std::size_t BoardX, std::size_t BoardY>
+//
+// BoardType is Board<BoardX, BoardY> or PackedBoard<BoardX, BoardY>.
+//
+template <std::size_t BoardX, std::size_t BoardY,
+          typename BoardType = Board<BoardX, BoardY>>
 struct Stage {
-    typedef Board<BoardX, BoardY> board_type;
+    typedef BoardType board_type;
+    typedef typename board_type::key_type   key_type;
 
     board_type  board;
+    key_type    value;          // board.key(), kept up to date by board.swap_cells()
 
     Position    empty_pos;
     uint8_t     last_dir;
     uint8_t     rotate_type;
+    uint8_t     fsm_state;      // The MoveFsm state of move_seq, see STAGES_USE_MOVE_FSM
+    uint32_t    move_node;      // The MoveTree node of the moves, see STAGES_USE_MOVE_TREE
     MoveSeq     move_seq;
 
-    Stage() noexcept : board(), empty_pos(0), last_dir(0), rotate_type(0), move_seq() {}
+    Stage() noexcept : board(), value(), empty_pos(0), last_dir(0), rotate_type(0), fsm_state(0), move_node(MoveTree::kRoot), move_seq() {}
 
-    Stage(const board_type & _board, Position move_pos,
+    Stage(const board_type & _board, const key_type & _value, Position move_pos,
           uint8_t cur_dir, const MoveSeq & _move_seq) noexcept
-        : board(_board), empty_pos(move_pos), last_dir(Dir::opp_dir(cur_dir)),
-          rotate_type(0), move_seq(_move_seq) {
+        : board(_board), value(_value), empty_pos(move_pos), last_dir(Dir::opp_dir(cur_dir)),
+          rotate_type(0), fsm_state(0), move_node(MoveTree::kRoot), move_seq(_move_seq) {
         this->move_seq.push_back(cur_dir);
     }
 
-    Stage(const board_type & _board, Position move_pos,
+    Stage(const board_type & _board, const key_type & _value, Position move_pos,
           uint8_t cur_dir, uint8_t _rotate_type, const MoveSeq & _move_seq) noexcept
-        : board(_board), empty_pos(move_pos), last_dir(Dir::opp_dir(cur_dir)),
-          rotate_type(_rotate_type), move_seq(_move_seq) {
+        : board(_board), value(_value), empty_pos(move_pos), last_dir(Dir::opp_dir(cur_dir)),
+          rotate_type(_rotate_type), fsm_state(0), move_node(MoveTree::kRoot), move_seq(_move_seq) {
         this->move_seq.push_back(cur_dir);
     }
 
     Stage(const Stage & src) noexcept
-        : board(src.board), empty_pos(src.empty_pos), last_dir(src.last_dir),
-          rotate_type(src.rotate_type), move_seq(src.move_seq) {
+        : board(src.board), value(src.value), empty_pos(src.empty_pos), last_dir(src.last_dir),
+          rotate_type(src.rotate_type), fsm_state(src.fsm_state), move_node(src.move_node), move_seq(src.move_seq) {
     }
 
     Stage(Stage && src) noexcept
-        : board(src.board), empty_pos(src.empty_pos), last_dir(src.last_dir),
-          rotate_type(src.rotate_type), move_seq(std::move(src.move_seq)) {
+        : board(src.board), value(src.value), empty_pos(src.empty_pos), last_dir(src.last_dir),
+          rotate_type(src.rotate_type), fsm_state(src.fsm_state), move_node(src.move_node), move_seq(std::move(src.move_seq)) {
     }
 
     Stage(const board_type & _board) noexcept
-        : board(_board), empty_pos(0), last_dir(0), rotate_type(0), move_seq() {
+        : board(_board), value(_board.key()), empty_pos(0), last_dir(0), rotate_type(0), fsm_state(0), move_node(MoveTree::kRoot), move_seq() {
+    }
+
+    // The child of a stage, the caller moves a cell with board.swap_cells(pos1, pos2, value).
+    Stage(const board_type & _board, const key_type & _value) noexcept
+        : board(_board), value(_value), empty_pos(0), last_dir(0), rotate_type(0), fsm_state(0), move_node(MoveTree::kRoot), move_seq() {
     }
 
     ~Stage() {}
@@ -72,31 +86,39 @@ struct Stage {
 
     void internal_copy(const Stage & other) noexcept {
         this->board         = other.board;
+        this->value         = other.value;
 
         this->empty_pos     = other.empty_pos;
         this->last_dir      = other.last_dir;
         this->rotate_type   = other.rotate_type;
+        this->fsm_state     = other.fsm_state;
+        this->move_node     = other.move_node;
 
         this->move_seq      = other.move_seq;
     }
 
     void internal_move(Stage && other) noexcept {
         this->board         = other.board;
+        this->value         = other.value;
 
         this->empty_pos     = other.empty_pos;
         this->last_dir      = other.last_dir;
         this->rotate_type   = other.rotate_type;
+        this->fsm_state     = other.fsm_state;
+        this->move_node     = other.move_node;
 
         this->move_seq      = std::move(other.move_seq);
     }
 
     void internal_swap(Stage & other) noexcept {
         this->board.swap(other.board);
+        std::swap(this->value, other.value);
 
         this->empty_pos.swap(other.empty_pos);
         std::swap(this->last_dir, other.last_dir);
         std::swap(this->rotate_type, other.rotate_type);
-        std::swap(this->reserve, other.reserve);
+        std::swap(this->fsm_state, other.fsm_state);
+        std::swap(this->move_node, other.move_node);
 
         this->move_seq.swap(other.move_seq);
     }
@@ -120,9 +142,9 @@ struct Stage {
     }
 };
 
-template <std::size_t BoardX, std::size_t BoardY>
+template <std::size_t BoardX, std::size_t BoardY, typename BoardType>
 inline
-void swap(Stage<BoardX, BoardY> & lhs, Stage<BoardX, BoardY> & rhs) noexcept {
+void swap(Stage<BoardX, BoardY, BoardType> & lhs, Stage<BoardX, BoardY, BoardType> & rhs) noexcept {
     lhs.swap(rhs);
 }
 
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>      // For std::memset()
+
+#include "MagicBlock/AI/Config.h"
+
+#if MBG_USE_AVX2
+#include <immintrin.h>  // For AVX2
+#elif MBG_USE_SSE2
+#include <tmmintrin.h>  // For SSSE3, _mm_shuffle_epi8()
+#endif
+
+#include "MagicBlock/AI/Constant.h"
+#include "MagicBlock/AI/Color.h"
+#include "MagicBlock/AI/Board.h"
+
+namespace MagicBlock {
+namespace AI {
+
+//
+// Compare the target region of a board with all the (rotated) targets at once.
+//
+// The cells of the target region are gathered into one register with two byte
+// shuffles, then compared with every target, one bit per cell. The partial goals
+// (the sides of phase 1, the bands of phase 2) are the bits of their cells, see
+// region_bits() and side_mask().
+//
+template <std::size_t BoardX, std::size_t BoardY,
+          std::size_t TargetX, std::size_t TargetY>
+class TargetMatcher {
+public:
+    typedef std::size_t         size_type;
+    typedef std::ptrdiff_t      ssize_type;
+
+    static const size_type BoardSize = BoardX * BoardY;
+    static const size_type TargetSize = TargetX * TargetY;
+    static const size_type kMaxTargets = MAX_ROTATE_TYPE;
+
+    static const ptrdiff_t kStartX = (BoardX - TargetX) / 2;
+    static const ptrdiff_t kStartY = (BoardY - TargetY) / 2;
+
+    static_assert((TargetSize <= 32), "TargetMatcher: TargetX * TargetY must be <= 32.");
+
+    static const std::uint32_t kFullBits = (TargetSize >= 32) ? 0xFFFFFFFFU :
+                                           ((std::uint32_t(1) << (TargetSize % 32)) - 1);
+
+#if MBG_USE_SSE2 || MBG_USE_AVX2
+    // The region fits in one register, and two 16-byte loads cover the board
+    static const bool kUseSIMD = (TargetSize <= 16 && BoardSize >= 16 && BoardSize <= 32);
+#else
+    static const bool kUseSIMD = false;
+#endif
+
+private:
+    Board<TargetX, TargetY> boards_[kMaxTargets];
+
+    // The first 16 cells of the targets, zero padded
+    std::uint8_t    targets_[kMaxTargets][16];
+    std::uint8_t    gather_low_[16];        // The shuffle of cells [0, 16)
+    std::uint8_t    gather_high_[16];       // The shuffle of cells [BoardSize - 16, BoardSize)
+    std::uint8_t    positions_[TargetSize];
+    size_type       target_len_;
+
+    void init_positions() {
+        std::memset((void *)this->gather_low_, 0x80, sizeof(this->gather_low_));
+        std::memset((void *)this->gather_high_, 0x80, sizeof(this->gather_high_));
+        for (size_type y = 0; y < TargetY; y++) {
+            for (size_type x = 0; x < TargetX; x++) {
+                size_type index = y * TargetX + x;
+                size_type pos = (kStartY + y) * BoardX + (kStartX + x);
+                this->positions_[index] = std::uint8_t(pos);
+                if (index < 16) {
+                    if (pos < 16)
+                        this->gather_low_[index] = std::uint8_t(pos);
+                    else
+                        this->gather_high_[index] = std::uint8_t(pos - (BoardSize - 16));
+                }
+            }
+        }
+    }
+
+    void match_impl(const Board<BoardX, BoardY> & board, std::uint32_t masks[kMaxTargets],
+                    std::false_type) const {
+        for (size_type k = 0; k < this->target_len_; k++) {
+            const Board<TargetX, TargetY> & target = this->boards_[k];
+            std::uint32_t mask = 0;
+            for (size_type index = 0; index < TargetSize; index++) {
+                if (board.cells[this->positions_[index]] == target.cells[index])
+                    mask |= std::uint32_t(1) << index;
+            }
+            masks[k] = mask;
+        }
+    }
+
+#if MBG_USE_SSE2 || MBG_USE_AVX2
+    void match_impl(const Board<BoardX, BoardY> & board, std::uint32_t masks[kMaxTargets],
+                    std::true_type) const {
+        __m128i low  = _mm_loadu_si128((const __m128i *)&board.cells[0]);
+        __m128i high = _mm_loadu_si128((const __m128i *)&board.cells[BoardSize - 16]);
+        __m128i region = _mm_or_si128(
+                _mm_shuffle_epi8(low,  _mm_loadu_si128((const __m128i *)this->gather_low_)),
+                _mm_shuffle_epi8(high, _mm_loadu_si128((const __m128i *)this->gather_high_)));
+#if MBG_USE_AVX2
+        // Two targets in each compare
+        __m256i regions = _mm256_broadcastsi128_si256(region);
+        for (size_type k = 0; k < this->target_len_; k += 2) {
+            __m256i targets = _mm256_loadu_si256((const __m256i *)this->targets_[k]);
+            std::uint32_t equal = (std::uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(regions, targets));
+            masks[k] = equal & kFullBits;
+            masks[k + 1] = (equal >> 16) & kFullBits;
+        }
+#else
+        for (size_type k = 0; k < this->target_len_; k++) {
+            __m128i target = _mm_loadu_si128((const __m128i *)this->targets_[k]);
+            std::uint32_t equal = (std::uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(region, target));
+            masks[k] = equal & kFullBits;
+        }
+#endif
+    }
+#endif // MBG_USE_SSE2 || MBG_USE_AVX2
+
+public:
+    TargetMatcher() : target_len_(0) {
+        std::memset((void *)this->targets_, 0, sizeof(this->targets_));
+        this->init_positions();
+    }
+
+    ~TargetMatcher() {}
+
+    size_type target_len() const { return this->target_len_; }
+
+    void init(const Board<TargetX, TargetY> targets[], size_type target_len) {
+        assert(target_len <= kMaxTargets);
+        std::memset((void *)this->targets_, 0, sizeof(this->targets_));
+        for (size_type k = 0; k < target_len; k++) {
+            this->boards_[k] = targets[k];
+            for (size_type index = 0; index < TargetSize && index < 16; index++) {
+                this->targets_[k][index] = targets[k].cells[index];
+            }
+        }
+        this->target_len_ = target_len;
+    }
+
+    //
+    // Bit i of masks[k] is set when the i-th cell of the target region of board
+    // is the same as the i-th cell of targets[k], k < target_len().
+    //
+    void match(const Board<BoardX, BoardY> & board, std::uint32_t masks[kMaxTargets]) const {
+        this->match_impl(board, masks, std::integral_constant<bool, kUseSIMD>());
+    }
+
+    // Bit k is set when the target region of board is the same as targets[k].
+    std::uint32_t satisfy_mask(const Board<BoardX, BoardY> & board) const {
+        std::uint32_t masks[kMaxTargets];
+        this->match(board, masks);
+        std::uint32_t mask = 0;
+        for (size_type k = 0; k < this->target_len_; k++) {
+            if (masks[k] == kFullBits)
+                mask |= std::uint32_t(1) << k;
+        }
+        return mask;
+    }
+
+    // The bits of the cells [firstTargetX, lastTargetX) x [firstTargetY, lastTargetY) in a match() mask.
+    static std::uint32_t region_bits(size_type firstTargetX, size_type lastTargetX,
+                                     size_type firstTargetY, size_type lastTargetY) {
+        std::uint32_t bits = 0;
+        for (size_type y = firstTargetY; y < lastTargetY; y++) {
+            for (size_type x = firstTargetX; x < lastTargetX; x++) {
+                bits |= std::uint32_t(1) << (y * TargetX + x);
+            }
+        }
+        return bits;
+    }
+
+    static bool is_matched(std::uint32_t equal_mask, std::uint32_t bits) {
+        return ((equal_mask & bits) == bits);
+    }
+
+    //
+    // The matched sides of phase 1 in a match() mask, the same bits as
+    // is_satisfy_phase1_123(): 1 = top, 2 = left, 4 = right, 8 = bottom.
+    //
+    static std::uint32_t side_mask(std::uint32_t equal_mask) {
+        static const std::uint32_t kTopBits    = region_bits(0, TargetX, 0, 1);
+        static const std::uint32_t kLeftBits   = region_bits(0, 1, 0, TargetY);
+        static const std::uint32_t kRightBits  = region_bits(TargetX - 1, TargetX, 0, TargetY);
+        static const std::uint32_t kBottomBits = region_bits(0, TargetX, TargetY - 1, TargetY);
+
+        std::uint32_t mask = 0;
+        if (is_matched(equal_mask, kTopBits))
+            mask |= 1;
+        if (is_matched(equal_mask, kLeftBits))
+            mask |= 2;
+        if (is_matched(equal_mask, kRightBits))
+            mask |= 4;
+        if (is_matched(equal_mask, kBottomBits))
+            mask |= 8;
+        return mask;
+    }
+};
+
+} // namespace AI
+} // namespace MagicBlock
@@ -21,6 +21,7 @@
 #include <stdexcept>
 #include <algorithm>    // For std::swap(), until C++11. std::min()
 #include <utility>      // For std::swap(), since C++11
+#include <type_traits>  // For std::conditional<>
 
 #include "MagicBlock/AI/internal/BaseSolver.h"
 
@@ -28,11 +29,18 @@
 #include "MagicBlock/AI/Color.h"
 #include "MagicBlock/AI/Move.h"
 #include "MagicBlock/AI/CanMoves.h"
+#include "MagicBlock/AI/MoveTable.h"
+#include "MagicBlock/AI/MoveFsm.h"
 #include "MagicBlock/AI/Value128.h"
 #include "MagicBlock/AI/Board.h"
+#include "MagicBlock/AI/MoveTree.h"
+#include "MagicBlock/AI/LayerRegion.h"
+#include "MagicBlock/AI/Value128HashSet.h"
 #include "MagicBlock/AI/Stage.h"
 #include "MagicBlock/AI/SharedData.h"
 #include "MagicBlock/AI/SparseBitset.h"
+#include "MagicBlock/AI/SparseHashMap.h"
+#include "MagicBlock/AI/FrontierSoA.h"
 #include "MagicBlock/AI/Utils.h"
 
 namespace MagicBlock {
@@ -57,27 +65,87 @@ public:
     typedef typename base_type::stage_info_t        stage_info_t;
     typedef typename base_type::can_moves_t         can_moves_t;
     typedef typename base_type::can_move_list_t     can_move_list_t;
+    typedef MoveTable<BoardX, BoardY>               move_table_t;
     typedef typename base_type::player_board_t      player_board_t;
     typedef typename base_type::target_board_t      target_board_t;
     typedef typename base_type::phase2_callback     phase2_callback;
 
     static const size_type BoardSize = BoardX * BoardY;
-    static const size_type kSingelColorNums = (BoardSize - 1) / (Color::Last - 1);
+    static const size_type kSingelColorNums = (BoardSize - 1 + Color::Last - 2) / (Color::Last - 1);
 
     static const ptrdiff_t kStartX = (BoardX - TargetX) / 2;
     static const ptrdiff_t kStartY = (BoardY - TargetY) / 2;
 
-    typedef SparseBitset<Board<BoardX, BoardY>, 3, BoardX * BoardY>     bitset_type;
-    typedef std::set<Value128>                                          stdset_type;
-    typedef std::unordered_set<Value128, Value128_Hash>                 stdset_type_;
-    typedef std::unordered_set<Value128, Value128_Hash>                 std_hashset_t;
+    typedef SparseBitset<Board<BoardX, BoardY>, 3, BoardX * BoardY,
+                         TRIE_LAYER_ORDER>                              bitset_type;
+    typedef typename stage_type::key_type                               key_type;
+    typedef typename Board<BoardX, BoardY>::key_hash_t                  key_hash_t;
+#if STAGES_USE_VALUE128_HASHSET
+    typedef typename std::conditional<std::is_same<key_type, Value128>::value,
+                                      Value128HashSet,
+                                      std::set<key_type>>::type         stdset_type;
+#else
+    typedef std::set<key_type>                                          stdset_type;
+#endif
+    typedef std::unordered_set<key_type, key_hash_t>                    stdset_type_;
+    typedef std::unordered_set<key_type, key_hash_t>                    std_hashset_t;
+
+#if STAGES_USE_LAYER_REGION
+    typedef RegionAllocator<stage_type>                                 stage_allocator_t;
+#else
+    typedef std::allocator<stage_type>                                  stage_allocator_t;
+#endif
+    typedef std::vector<stage_type, stage_allocator_t>                  stage_list_t;
 
 private:
     bitset_type visited_;
     stdset_type visited_set_;
 
-    std::vector<stage_type> curr_stages_;
-    std::vector<stage_type> next_stages_;
+#if STAGES_USE_LAYER_REGION
+    // The stage lists and the trie paths of two depths, see clear_prev_depth()
+    LayerRegion regions_[2];
+#endif
+
+    stage_list_t curr_stages_;
+    stage_list_t next_stages_;
+
+#if STAGES_USE_PATH_REUSE
+    typedef typename bitset_type::InsertPath    path_type;
+#if STAGES_USE_LAYER_REGION
+    typedef RegionAllocator<path_type>          path_allocator_t;
+#else
+    typedef std::allocator<path_type>           path_allocator_t;
+#endif
+    typedef std::vector<path_type, path_allocator_t>    path_list_t;
+
+    // The trie paths of the stages in curr_stages_ and next_stages_
+    path_list_t curr_paths_;
+    path_list_t next_paths_;
+#endif
+
+#if STAGES_USE_TRIE_FRONTIER
+    // The value of a frontier board, see make_frontier_value()
+    typedef SparseHashMap<Board<BoardX, BoardY>, std::uint16_t, 3, BoardX * BoardY,
+                          TRIE_LAYER_ORDER>                             frontier_type;
+
+    // Per-depth tries used as the frontier instead of the stage lists
+    frontier_type curr_frontier_;
+    frontier_type next_frontier_;
+#endif
+
+#if STAGES_USE_MOVE_TREE
+    // The moves of all the stages, see Stage::move_node
+    MoveTree move_tree_;
+#endif
+
+#if STAGES_USE_SOA_FRONTIER
+    typedef FrontierSoA<BoardX, BoardY>         frontier_soa_t;
+    typedef typename frontier_soa_t::Child      soa_child_t;
+
+    // The same stages as curr_stages_ and next_stages_, in structure-of-arrays form
+    frontier_soa_t curr_soa_;
+    frontier_soa_t next_soa_;
+#endif
 
     void init() {
         assert(this->data_ != nullptr);
@@ -97,6 +165,9 @@ private:
 public:
     ForwardSolver(shared_data_type * data) : base_type(data) {
         this->init();
+#if STAGES_USE_LAYER_REGION
+        this->init_layer_regions();
+#endif
     }
 
     ~ForwardSolver() {
@@ -123,31 +194,87 @@ public:
         return this->visited_set_;
     }
 
-    std::vector<stage_type> & curr_stages() {
+    stage_list_t & curr_stages() {
         return this->curr_stages_;
     }
 
-    const std::vector<stage_type> & curr_stages() const {
+    const stage_list_t & curr_stages() const {
         return this->curr_stages_;
     }
 
-    std::vector<stage_type> & next_stages() {
+    stage_list_t & next_stages() {
         return this->next_stages_;
     }
 
-    const std::vector<stage_type> & next_stages() const {
+    const stage_list_t & next_stages() const {
         return this->next_stages_;
     }
 
+#if STAGES_USE_TRIE_FRONTIER
+    frontier_type & curr_frontier() {
+        return this->curr_frontier_;
+    }
+
+    const frontier_type & curr_frontier() const {
+        return this->curr_frontier_;
+    }
+
+    frontier_type & next_frontier() {
+        return this->next_frontier_;
+    }
+
+    const frontier_type & next_frontier() const {
+        return this->next_frontier_;
+    }
+
+    //
+    // The empty position of a frontier board in the low byte, and its MoveFsm state
+    // in the high byte (the last direction without STAGES_USE_MOVE_FSM), the same as
+    // Stage::empty_pos and Stage::fsm_state of the stage lists.
+    //
+    static std::uint16_t make_frontier_value(const stage_type & stage) {
+#if STAGES_USE_MOVE_FSM
+        return make_frontier_value(stage.empty_pos, stage.fsm_state);
+#else
+        return make_frontier_value(stage.empty_pos, stage.last_dir);
+#endif
+    }
+
+    static std::uint16_t make_frontier_value(std::uint8_t empty_pos, std::uint8_t move_state) {
+        return std::uint16_t(empty_pos | (std::uint16_t(move_state) << 8U));
+    }
+#endif
+
     void respawn() {
         this->clear();
         this->visited_.create_root();
+#if STAGES_USE_TRIE_FRONTIER
+        this->curr_frontier_.create_root(frontier_type::NodeType::ArrayContainer);
+        this->next_frontier_.create_root(frontier_type::NodeType::ArrayContainer);
+#endif
     }
 
     void clear() {
         this->visited_.destroy();
         this->curr_stages_.clear();
         this->next_stages_.clear();
+#if STAGES_USE_PATH_REUSE
+        this->curr_paths_.clear();
+        this->next_paths_.clear();
+#endif
+#if STAGES_USE_LAYER_REGION
+        this->init_layer_regions();
+        this->regions_[0].reset();
+        this->regions_[1].reset();
+#endif
+#if STAGES_USE_TRIE_FRONTIER
+        this->curr_frontier_.destroy();
+        this->next_frontier_.destroy();
+#endif
+#if STAGES_USE_SOA_FRONTIER
+        this->curr_soa_.clear();
+        this->next_soa_.clear();
+#endif
     }
 
     size_type calc_next_capacity() const {
@@ -163,27 +290,105 @@ public:
         return next_capacity;
     }
 
+#if STAGES_USE_LAYER_REGION
+    void init_layer_regions() {
+        this->curr_stages_ = stage_list_t(stage_allocator_t(&this->regions_[0]));
+        this->next_stages_ = stage_list_t(stage_allocator_t(&this->regions_[1]));
+#if STAGES_USE_PATH_REUSE
+        this->curr_paths_ = path_list_t(path_allocator_t(&this->regions_[0]));
+        this->next_paths_ = path_list_t(path_allocator_t(&this->regions_[1]));
+#endif
+    }
+
+    // Drop the stages and the paths of next_stages_ at once, the region is reused by the next depth.
+    void reset_next_layer() {
+        stage_allocator_t allocator = this->next_stages_.get_allocator();
+        this->next_stages_ = stage_list_t(allocator);
+#if STAGES_USE_PATH_REUSE
+        this->next_paths_ = path_list_t(path_allocator_t(allocator.region()));
+#endif
+        allocator.region()->reset();
+    }
+#endif
+
     void clear_prev_depth() {
         size_type next_capacity = calc_next_capacity();
         std::swap(this->curr_stages_, this->next_stages_);
+#if STAGES_USE_PATH_REUSE
+        std::swap(this->curr_paths_, this->next_paths_);
+#endif
+#if STAGES_USE_LAYER_REGION
+        this->reset_next_layer();
+#else
         this->next_stages_.clear();
+#if STAGES_USE_PATH_REUSE
+        this->next_paths_.clear();
+#endif
+#endif
         this->next_stages_.reserve(next_capacity);
+#if STAGES_USE_PATH_REUSE
+        this->next_paths_.reserve(next_capacity);
+#endif
+#if STAGES_USE_TRIE_FRONTIER
+        this->curr_frontier_.swap(this->next_frontier_);
+        this->next_frontier_.clear();
+#endif
+#if STAGES_USE_SOA_FRONTIER
+        this->curr_soa_.swap(this->next_soa_);
+        this->next_soa_.clear();
+        this->next_soa_.reserve(next_capacity);
+#endif
+    }
+
+#if STAGES_USE_BLOOM_FILTER
+    void display_filter_stats() const {
+        const BlockedBloomFilter::Stats & stats = this->visited_.filter_stats();
+        size_type total = stats.definitelyNew + stats.maybeExists;
+        printf("filter: blocks = %u, memory = %0.2f MB\n",
+                (uint32_t)this->visited_.filter().blocks(),
+                (double)this->visited_.filter().memory_usage() / (1024.0 * 1024.0));
+        printf("filter: new = %u, maybe = %u, false positive = %u, hit rate = %0.2f %%\n\n",
+                (uint32_t)stats.definitelyNew, (uint32_t)stats.maybeExists,
+                (uint32_t)stats.falsePositive,
+                (total != 0) ? (stats.definitelyNew * 100.0 / total) : 0.0);
+    }
+#endif
+
+    // next_stage is the child of stage by the move cur_dir.
+    void push_move(const stage_type & stage, stage_type & next_stage, uint8_t cur_dir) {
+#if STAGES_USE_MOVE_TREE
+        next_stage.move_node = this->move_tree_.append(stage.move_node, cur_dir);
+#else
+        next_stage.move_seq = stage.move_seq;
+        next_stage.move_seq.push_back(cur_dir);
+#endif
+    }
+
+    // Rebuild stage.move_seq, only the answers need it.
+    void fill_move_seq(stage_type & stage) const {
+#if STAGES_USE_MOVE_TREE
+        this->move_tree_.get_move_seq(stage.move_node, stage.move_seq);
+#else
+        (void)stage;
+#endif
     }
 
-    bool find_stage_in_list(const Value128 & target_value, stage_type & target_stage) {
+    bool find_stage_in_list(const key_type & target_value, stage_type & target_stage) {
         for (size_type i = 0; i < this->curr_stages_.size(); i++) {
             const stage_type & stage = this->curr_stages_[i];
-            const Value128 & value = stage.board.value128();
+            const key_type & value = stage.value;
             if (value == target_value) {
                 target_stage = stage;
+                this->fill_move_seq(target_stage);
                 return true;
             }
         }
         for (size_type i = 0; i < this->next_stages_.size(); i++) {
             const stage_type & stage = this->next_stages_[i];
-            const Value128 & value = stage.board.value128();
+            const key_type & value = stage.value;
             if (value == target_value) {
                 target_stage = stage;
+                this->fill_move_seq(target_stage);
                 return true;
             }
         }
@@ -208,7 +413,7 @@ public:
                 start.last_dir = uint8_t(-1);
                 start.rotate_type = 0;
 
-                Value128 board_value = start.board.value128();
+                key_type board_value = start.value;
                 this->visited_set_.insert(board_value);
                 this->curr_stages_.push_back(start);
             }
@@ -218,33 +423,46 @@ public:
         {
             bool exit = false;
             if (this->curr_stages_.size() > 0) {
+                // Each stage has about 3 next moves
+                reserve_visited(this->visited_set_, this->visited_set_.size() + this->curr_stages_.size() * 3);
+#if STAGES_USE_MOVE_FSM
+                const MoveFsm & move_fsm = MoveFsm::getInstance();
+#endif
                 for (size_type i = 0; i < this->curr_stages_.size(); i++) {
                     const stage_type & stage = this->curr_stages_[i];
 
                     uint8_t empty_pos = stage.empty_pos;
-                    const can_move_list_t & can_moves = this->data_->can_moves[empty_pos];
-                    size_type total_moves = can_moves.size();
-                    for (size_type n = 0; n < total_moves; n++) {
-                        uint8_t cur_dir = can_moves[n].dir;
+                    const MoveEntry * moves = move_table_t::moves(empty_pos);
+                    for (size_type n = 0; n < Dir::Maximum; n++) {
+                        if (moves[n].valid == 0)
+                            continue;
+
+                        uint8_t cur_dir = moves[n].dir;
+#if STAGES_USE_MOVE_FSM
+                        uint8_t fsm_state = move_fsm.next(stage.fsm_state, n);
+                        if (fsm_state == MoveFsm::kPruned)
+                            continue;
+#else
                         if (cur_dir == stage.last_dir)
                             continue;
+#endif
 
-                        uint8_t move_pos = can_moves[n].pos;
+                        uint8_t move_pos = moves[n].pos;
 
-                        stage_type next_stage(stage.board);
-                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
+                        stage_type next_stage(stage.board, stage.value);
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
 
-                        Value128 board_value = next_stage.board.value128();
-                        if (this->visited_set_.count(board_value) > 0)
+                        key_type board_value = next_stage.value;
+                        if (!this->visited_set_.insert(board_value).second)
                             continue;
 
-                        this->visited_set_.insert(board_value);
-
                         next_stage.empty_pos = move_pos;
                         next_stage.last_dir = Dir::opp_dir(cur_dir);
+#if STAGES_USE_MOVE_FSM
+                        next_stage.fsm_state = fsm_state;
+#endif
                         //next_stage.rotate_type = 0;
-                        next_stage.move_seq = stage.move_seq;
-                        next_stage.move_seq.push_back(cur_dir);
+                        this->push_move(stage, next_stage, cur_dir);
 
                         this->next_stages_.push_back(std::move(next_stage));
                     }
@@ -276,6 +494,232 @@ public:
         return result;
     }
 
+#if STAGES_USE_TRIE_FRONTIER
+    //
+    // Expand the current frontier trie into the next one, the same as the serial
+    // loop of the stage lists: the empty position and the MoveFsm state come from
+    // the frontier value, and the children restart the visited trie search from
+    // the path of their parent.
+    //
+    void bitset_expand_frontier() {
+        typedef typename frontier_type::const_iterator frontier_iterator;
+#if STAGES_USE_MOVE_FSM
+        const MoveFsm & move_fsm = MoveFsm::getInstance();
+#endif
+
+        frontier_iterator iter_end = this->curr_frontier_.end();
+        for (frontier_iterator iter = this->curr_frontier_.begin(); iter != iter_end; ++iter) {
+            Board<BoardX, BoardY> board(*iter);
+            std::uint16_t frontier_value = iter.value();
+            uint8_t empty_pos = uint8_t(frontier_value & 0xFFU);
+            uint8_t move_state = uint8_t(frontier_value >> 8U);
+            assert(board.cells[empty_pos] == Color::Empty);
+
+#if STAGES_USE_PATH_REUSE
+            // The board is visited already, only its path is filled
+            path_type path;
+            bool found_new = this->visited_.try_insert(board, path);
+            assert(!found_new);
+            (void)found_new;
+#endif
+
+            const MoveEntry * moves = move_table_t::moves(empty_pos);
+            for (size_type n = 0; n < Dir::Maximum; n++) {
+                if (moves[n].valid == 0)
+                    continue;
+
+                uint8_t cur_dir = moves[n].dir;
+#if STAGES_USE_MOVE_FSM
+                uint8_t next_state = move_fsm.next(move_state, n);
+                if (next_state == MoveFsm::kPruned)
+                    continue;
+#else
+                if (cur_dir == move_state)
+                    continue;
+                uint8_t next_state = Dir::opp_dir(cur_dir);
+#endif
+
+                uint8_t move_pos = moves[n].pos;
+                std::swap(board.cells[empty_pos], board.cells[move_pos]);
+
+#if STAGES_USE_PATH_REUSE
+                path_type next_path;
+                size_type first_layer = this->visited_.first_changed_layer(empty_pos, move_pos);
+                bool insert_new = this->visited_.try_insert_from(board, path, first_layer, next_path);
+#else
+                bool insert_new = this->visited_.try_insert(board);
+#endif
+                if (insert_new) {
+                    this->next_frontier_.insert(board, make_frontier_value(move_pos, next_state));
+                }
+
+                std::swap(board.cells[empty_pos], board.cells[move_pos]);
+            }
+        }
+    }
+
+#endif // STAGES_USE_TRIE_FRONTIER
+
+#if STAGES_USE_BATCH_INSERT
+    static const size_type kInsertBatchSize = 256;
+    static const size_type kInsertGroupSize = bitset_type::kDefaultGroupSize;
+
+    struct BatchChild {
+        key_type        value;
+        std::uint32_t   stage_index;
+        std::uint8_t    move_pos;
+        std::uint8_t    cur_dir;
+        std::uint8_t    fsm_state;
+    };
+
+    void bitset_flush_batch(const Board<BoardX, BoardY> * boards, const BatchChild * children,
+                            bool * results, size_type count) {
+        this->visited_.template try_insert_batch<kInsertGroupSize>(boards, count, results);
+
+        for (size_type k = 0; k < count; k++) {
+            if (!results[k])
+                continue;
+
+            const BatchChild & child = children[k];
+            const stage_type & stage = this->curr_stages_[child.stage_index];
+
+            stage_type next_stage(boards[k], child.value);
+            next_stage.empty_pos = child.move_pos;
+            next_stage.last_dir = Dir::opp_dir(child.cur_dir);
+#if STAGES_USE_MOVE_FSM
+            next_stage.fsm_state = child.fsm_state;
+#endif
+            next_stage.rotate_type = 0;
+            this->push_move(stage, next_stage, child.cur_dir);
+
+            this->next_stages_.push_back(std::move(next_stage));
+        }
+    }
+
+    //
+    // Same as the serial expansion, but the children are collected and inserted
+    // into the visited trie in batches, so their lookups can be interleaved.
+    //
+    void bitset_expand_batched() {
+        Board<BoardX, BoardY> boards[kInsertBatchSize];
+        BatchChild children[kInsertBatchSize];
+        bool results[kInsertBatchSize];
+        size_type count = 0;
+
+#if STAGES_USE_MOVE_FSM
+        const MoveFsm & move_fsm = MoveFsm::getInstance();
+#endif
+        for (size_type i = 0; i < this->curr_stages_.size(); i++) {
+            const stage_type & stage = this->curr_stages_[i];
+
+            uint8_t empty_pos = stage.empty_pos;
+            const MoveEntry * moves = move_table_t::moves(empty_pos);
+            for (size_type n = 0; n < Dir::Maximum; n++) {
+                if (moves[n].valid == 0)
+                    continue;
+
+                uint8_t cur_dir = moves[n].dir;
+#if STAGES_USE_MOVE_FSM
+                uint8_t fsm_state = move_fsm.next(stage.fsm_state, n);
+                if (fsm_state == MoveFsm::kPruned)
+                    continue;
+#else
+                if (cur_dir == stage.last_dir)
+                    continue;
+#endif
+
+                uint8_t move_pos = moves[n].pos;
+
+                boards[count] = stage.board;
+                children[count].value = stage.value;
+                boards[count].swap_cells(empty_pos, move_pos, children[count].value);
+                children[count].stage_index = std::uint32_t(i);
+                children[count].move_pos = move_pos;
+                children[count].cur_dir = cur_dir;
+#if STAGES_USE_MOVE_FSM
+                children[count].fsm_state = fsm_state;
+#endif
+                count++;
+            }
+
+            if ((count + Dir::Maximum) > kInsertBatchSize) {
+                this->bitset_flush_batch(boards, children, results, count);
+                count = 0;
+            }
+        }
+
+        if (count > 0) {
+            this->bitset_flush_batch(boards, children, results, count);
+        }
+    }
+
+#endif // STAGES_USE_BATCH_INSERT
+
+#if STAGES_USE_SOA_FRONTIER
+    static const size_type kSoaBatchSize = 256;
+
+    void bitset_flush_soa(const Board<BoardX, BoardY> * boards, const soa_child_t * children,
+                          bool * results, size_type count) {
+        this->visited_.template try_insert_batch<bitset_type::kDefaultGroupSize>(boards, count, results);
+
+        for (size_type k = 0; k < count; k++) {
+            if (!results[k])
+                continue;
+
+            const soa_child_t & child = children[k];
+            const stage_type & stage = this->curr_stages_[child.parent];
+            uint8_t last_dir = Dir::opp_dir(child.cur_dir);
+
+            stage_type next_stage(boards[k], child.value);
+            next_stage.empty_pos = child.move_pos;
+            next_stage.last_dir = last_dir;
+#if STAGES_USE_MOVE_FSM
+            next_stage.fsm_state = child.fsm_state;
+#endif
+            next_stage.rotate_type = 0;
+            this->push_move(stage, next_stage, child.cur_dir);
+
+            this->next_stages_.push_back(std::move(next_stage));
+            this->next_soa_.push_back(boards[k], child.move_pos, last_dir, child.fsm_state);
+        }
+    }
+
+    //
+    // The children of kGroupSize parents are made at a time from the SoA frontier,
+    // then inserted into the visited trie in batches. The survivors are kept in both
+    // next_stages_ (for the move sequences and the meeting) and next_soa_.
+    //
+    void bitset_expand_soa() {
+        // The stage list may be changed from outside, e.g. the first depth
+        if (this->curr_soa_.size() != this->curr_stages_.size()) {
+            this->curr_soa_.assign(this->curr_stages_);
+        }
+
+        Board<BoardX, BoardY> boards[kSoaBatchSize];
+        soa_child_t children[kSoaBatchSize];
+        bool results[kSoaBatchSize];
+        size_type count = 0;
+
+        size_type curr_size = this->curr_soa_.size();
+        for (size_type first = 0; first < curr_size; first += frontier_soa_t::kGroupSize) {
+            size_type group_size = curr_size - first;
+            if (group_size > frontier_soa_t::kGroupSize)
+                group_size = frontier_soa_t::kGroupSize;
+            count += this->curr_soa_.expand(first, group_size, &boards[count], &children[count]);
+
+            if ((count + frontier_soa_t::kMaxChildren) > kSoaBatchSize) {
+                this->bitset_flush_soa(boards, children, results, count);
+                count = 0;
+            }
+        }
+
+        if (count > 0) {
+            this->bitset_flush_soa(boards, children, results, count);
+        }
+    }
+
+#endif // STAGES_USE_SOA_FRONTIER
+
     int bitset_solve(size_type depth, size_type max_depth) {
         int result = 0;
         if (depth == 0) {
@@ -294,65 +738,134 @@ public:
                 start.last_dir = uint8_t(-1);
                 start.rotate_type = 0;
                 start.board = this->player_board_;
+                start.value = start.board.key();
 
+#if STAGES_USE_PATH_REUSE
+                path_type start_path;
+                this->visited_.try_insert(start.board, start_path);
+                this->curr_paths_.push_back(start_path);
+#else
                 this->visited_.insert(start.board);
+#endif
+#if STAGES_USE_TRIE_FRONTIER
+                this->curr_frontier_.insert(start.board, make_frontier_value(start));
+#else
                 this->curr_stages_.push_back(start);
+#endif
             }
         }
 
         // Search one depth only
         {
             bool exit = false;
-            if (this->curr_stages_.size() > 0) {
+#if STAGES_USE_TRIE_FRONTIER
+            size_type curr_size = this->curr_frontier_.size();
+#else
+            size_type curr_size = this->curr_stages_.size();
+#endif
+            if (curr_size > 0) {
+#if STAGES_USE_TRIE_FRONTIER
+                this->bitset_expand_frontier();
+#elif STAGES_USE_SOA_FRONTIER
+                this->bitset_expand_soa();
+#elif STAGES_USE_BATCH_INSERT
+                this->bitset_expand_batched();
+#else
+#if STAGES_USE_BLOOM_FILTER
+                // Each stage has about 3 next moves
+                this->visited_.reserve_filter(this->visited_.size() + curr_size * 3);
+                this->visited_.clear_filter_stats();
+#endif
+#if STAGES_USE_MOVE_FSM
+                const MoveFsm & move_fsm = MoveFsm::getInstance();
+#endif
                 for (size_type i = 0; i < this->curr_stages_.size(); i++) {
                     stage_type & stage = this->curr_stages_[i];
 
                     uint8_t empty_pos = stage.empty_pos;
-                    const can_move_list_t & can_moves = this->data_->can_moves[empty_pos];
-                    size_type total_moves = can_moves.size();
-                    for (size_type n = 0; n < total_moves; n++) {
-                        uint8_t cur_dir = can_moves[n].dir;
+                    const MoveEntry * moves = move_table_t::moves(empty_pos);
+                    for (size_type n = 0; n < Dir::Maximum; n++) {
+                        if (moves[n].valid == 0)
+                            continue;
+
+                        uint8_t cur_dir = moves[n].dir;
+#if STAGES_USE_MOVE_FSM
+                        uint8_t fsm_state = move_fsm.next(stage.fsm_state, n);
+                        if (fsm_state == MoveFsm::kPruned)
+                            continue;
+#else
                         if (cur_dir == stage.last_dir)
                             continue;
+#endif
 
-                        uint8_t move_pos = can_moves[n].pos;
+                        uint8_t move_pos = moves[n].pos;
 #if STAGES_USE_EMPLACE_PUSH
-                        std::swap(stage.board.cells[empty_pos], stage.board.cells[move_pos]);
+                        stage.board.swap_cells(empty_pos, move_pos, stage.value);
 
                         bool insert_new = this->visited_.try_insert(stage.board);
                         if (!insert_new) {
-                            std::swap(stage.board.cells[empty_pos], stage.board.cells[move_pos]);
+                            stage.board.swap_cells(empty_pos, move_pos, stage.value);
                             continue;
                         }
 
-                        this->next_stages_.emplace_back(stage.board, move_pos, cur_dir, stage.move_seq);
+                        this->next_stages_.emplace_back(stage.board, stage.value, move_pos, cur_dir, stage.move_seq);
+#if STAGES_USE_MOVE_FSM
+                        this->next_stages_.back().fsm_state = fsm_state;
+#endif
+#if STAGES_USE_MOVE_TREE
+                        this->next_stages_.back().move_seq.clear();
+                        this->push_move(stage, this->next_stages_.back(), cur_dir);
+#endif
 
-                        std::swap(stage.board.cells[empty_pos], stage.board.cells[move_pos]);
+                        stage.board.swap_cells(empty_pos, move_pos, stage.value);
+#else
+                        stage_type next_stage(stage.board, stage.value);
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
+
+#if STAGES_USE_BLOOM_FILTER
+                        bool insert_new = this->visited_.try_insert_filtered(next_stage.board);
+#elif STAGES_USE_PATH_REUSE
+                        path_type next_path;
+                        size_type first_layer = this->visited_.first_changed_layer(empty_pos, move_pos);
+                        bool insert_new = this->visited_.try_insert_from(next_stage.board, this->curr_paths_[i],
+                                                                         first_layer, next_path);
 #else
-                        stage_type next_stage(stage.board);
-                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
-
                         bool insert_new = this->visited_.try_insert(next_stage.board);
+#endif
                         if (!insert_new) {
                             continue;
                         }
 
                         next_stage.empty_pos = move_pos;
                         next_stage.last_dir = Dir::opp_dir(cur_dir);
+#if STAGES_USE_MOVE_FSM
+                        next_stage.fsm_state = fsm_state;
+#endif
                         //next_stage.rotate_type = 0;
-                        next_stage.move_seq = stage.move_seq;
-                        next_stage.move_seq.push_back(cur_dir);
+                        this->push_move(stage, next_stage, cur_dir);
 
                         this->next_stages_.push_back(std::move(next_stage));
+#if STAGES_USE_PATH_REUSE && !STAGES_USE_BLOOM_FILTER
+                        this->next_paths_.push_back(next_path);
+#endif
 #endif // STAGES_USE_EMPLACE_PUSH
                     }
                 }
+#endif // STAGES_USE_TRIE_FRONTIER
 
                 depth++;
+#if STAGES_USE_TRIE_FRONTIER
+                size_type next_size = this->next_frontier_.size();
+#else
+                size_type next_size = this->next_stages_.size();
+#endif
                 printf("ForwardSolver::  depth = %u\n", (uint32_t)depth);
                 printf("cur.size() = %u, next.size() = %u\n",
-                        (uint32_t)(this->curr_stages_.size()), (uint32_t)(this->next_stages_.size()));
+                        (uint32_t)curr_size, (uint32_t)next_size);
                 printf("visited.size() = %u\n\n", (uint32_t)(this->visited_.size()));
+#if STAGES_USE_BLOOM_FILTER && !STAGES_USE_TRIE_FRONTIER && !STAGES_USE_SOA_FRONTIER && !STAGES_USE_BATCH_INSERT
+                this->display_filter_stats();
+#endif
 
                 if (depth >= max_depth) {
                     exit = true;
@@ -376,7 +889,7 @@ public:
         return result;
     }
 
-    int bitset_find_stage(const Value128 & target_value, stage_type & target_stage, size_type max_depth) {
+    int bitset_find_stage(const key_type & target_value, stage_type & target_stage, size_type max_depth) {
         size_u satisfy_result = this->is_satisfy(this->player_board_,
                                                  this->target_board_,
                                                  this->target_len_);
@@ -395,27 +908,39 @@ public:
             start.last_dir = uint8_t(-1);
             start.rotate_type = 0;
             start.board = this->player_board_;
+            start.value = start.board.key();
 
             this->visited_.insert(start.board);
             this->curr_stages_.push_back(start);
 
             bool exit = false;
             while (this->curr_stages_.size() > 0) {
+#if STAGES_USE_MOVE_FSM
+                const MoveFsm & move_fsm = MoveFsm::getInstance();
+#endif
                 for (size_type i = 0; i < this->curr_stages_.size(); i++) {
                     const stage_type & stage = this->curr_stages_[i];
 
                     uint8_t empty_pos = stage.empty_pos;
-                    const can_move_list_t & can_moves = this->data_->can_moves[empty_pos];
-                    size_type total_moves = can_moves.size();
-                    for (size_type n = 0; n < total_moves; n++) {
-                        uint8_t cur_dir = can_moves[n].dir;
+                    const MoveEntry * moves = move_table_t::moves(empty_pos);
+                    for (size_type n = 0; n < Dir::Maximum; n++) {
+                        if (moves[n].valid == 0)
+                            continue;
+
+                        uint8_t cur_dir = moves[n].dir;
+#if STAGES_USE_MOVE_FSM
+                        uint8_t fsm_state = move_fsm.next(stage.fsm_state, n);
+                        if (fsm_state == MoveFsm::kPruned)
+                            continue;
+#else
                         if (cur_dir == stage.last_dir)
                             continue;
+#endif
 
-                        uint8_t move_pos = can_moves[n].pos;
+                        uint8_t move_pos = moves[n].pos;
 
-                        stage_type next_stage(stage.board);
-                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
+                        stage_type next_stage(stage.board, stage.value);
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
 
                         bool insert_new = this->visited_.try_insert(next_stage.board);
                         if (!insert_new) {
@@ -424,14 +949,17 @@ public:
 
                         next_stage.empty_pos = move_pos;
                         next_stage.last_dir = Dir::opp_dir(cur_dir);
+#if STAGES_USE_MOVE_FSM
+                        next_stage.fsm_state = fsm_state;
+#endif
                         next_stage.rotate_type = 0;
-                        next_stage.move_seq = stage.move_seq;
-                        next_stage.move_seq.push_back(cur_dir);
+                        this->push_move(stage, next_stage, cur_dir);
 
-                        Value128 board_value = next_stage.board.value128();
+                        key_type board_value = next_stage.value;
                         if (board_value == target_value) {
                             result = 1;
                             exit = true;
+                            this->fill_move_seq(next_stage);
                             target_stage = next_stage;
                             this->move_seq_ = next_stage.move_seq;
                             break;
@@ -454,7 +982,11 @@ public:
 #endif
                 size_type next_capacity = calc_next_capacity();
                 std::swap(this->curr_stages_, this->next_stages_);
+#if STAGES_USE_LAYER_REGION
+                this->reset_next_layer();
+#else
                 this->next_stages_.clear();
+#endif
                 this->next_stages_.reserve(next_capacity);
 
                 if (result != 1 && depth >= max_depth) {
@@ -45,10 +45,11 @@ namespace MagicBlock {
 namespace AI {
 namespace TwoEndpoint {
 
-template <std::size_t BoardX, std::size_t BoardY>
+// The segments are the trie ids of the rows, see SparseBitset::ident_type.
+template <std::size_t BoardX, std::size_t BoardY, typename IdentT = std::uint16_t>
 struct SegmentPair {
-    std::uint16_t fw_segments[BoardY];
-    std::uint16_t bw_segments[BoardY];
+    IdentT fw_segments[BoardY];
+    IdentT bw_segments[BoardY];
 };
 
 template <std::size_t BoardX, std::size_t BoardY,
@@ -75,7 +76,7 @@ public:
     typedef typename stage_type::board_type         board_type;
 
     static const size_type BoardSize = BoardX * BoardY;
-    static const size_type kSingelColorNums = (BoardSize - 1) / (Color::Last - 1);
+    static const size_type kSingelColorNums = (BoardSize - 1 + Color::Last - 2) / (Color::Last - 1);
 
     static const ptrdiff_t kStartX = (BoardX - TargetX) / 2;
     static const ptrdiff_t kStartY = (BoardY - TargetY) / 2;
@@ -83,10 +84,16 @@ public:
     typedef ForwardSolver <BoardX, BoardY, TargetX, TargetY, false,       SolverType::Full,         phase2_callback>  TForwardSolver;
     typedef BackwardSolver<BoardX, BoardY, TargetX, TargetY, AllowRotate, SolverType::BackwardFull, phase2_callback>  TBackwardSolver;
 
+    typedef typename TForwardSolver::stage_list_t               fw_stage_list_t;
+    typedef typename TBackwardSolver::stage_list_t              bw_stage_list_t;
+
     typedef typename TForwardSolver::bitset_type::IContainer     ForwardContainer;
     typedef typename TBackwardSolver::bitset_type::IContainer    BackwardContainer;
 
-    typedef SegmentPair<BoardX, BoardY> segment_pair_t;
+    typedef typename TForwardSolver::bitset_type::ident_type     ident_type;
+    typedef typename board_type::key_type                        key_type;
+
+    typedef SegmentPair<BoardX, BoardY, ident_type> segment_pair_t;
 
 private:
     Board<BoardX, BoardY> fw_answer_board_;
@@ -109,63 +116,30 @@ public:
         // TODO:
     }
 
+    // The meeting boards of the last find_trie_intersection(), as the segments of each layer.
+    const std::vector<segment_pair_t> & segment_list() const {
+        return this->segment_list_;
+    }
+
+    // The segment of a row, 3 bits per cell, see SparseBitset::get_layer_value().
     bool is_coincident(int fw_value, int bw_value) const {
+        static const size_type kRowCells = TForwardSolver::bitset_type::BoardX;
         std::uint32_t fw_value32 = (std::uint32_t)fw_value;
         std::uint32_t bw_value32 = (std::uint32_t)bw_value;
 
-        std::uint32_t fw_color = fw_value32 & 0x00000007U;
-        std::uint32_t bw_color = bw_value32 & 0x00000007U;
-        if (bw_color == std::uint32_t(Color::Unknown)) {
-            if (fw_color == std::uint32_t(Color::Empty)) {
-                return false;
-            }
-        }
-        else if (bw_color != fw_color) {
-            return false;
-        }
-
-        fw_color = fw_value32 & (0x00000007U << 3U);
-        bw_color = bw_value32 & (0x00000007U << 3U);
-        if (bw_color == std::uint32_t(Color::Unknown << 3U)) {
-            if (fw_color == std::uint32_t(Color::Empty << 3U)) {
-                return false;
-            }
-        }
-        else if (bw_color != fw_color) {
-            return false;
-        }
-
-        fw_color = fw_value32 & (0x00000007U << 6U);
-        bw_color = bw_value32 & (0x00000007U << 6U);
-        if (bw_color == std::uint32_t(Color::Unknown << 6U)) {
-            if (fw_color == std::uint32_t(Color::Empty << 6U)) {
-                return false;
-            }
-        }
-        else if (bw_color != fw_color) {
-            return false;
-        }
-
-        fw_color = fw_value32 & (0x00000007U << 9U);
-        bw_color = bw_value32 & (0x00000007U << 9U);
-        if (bw_color == std::uint32_t(Color::Unknown << 9U)) {
-            if (fw_color == std::uint32_t(Color::Empty << 9U)) {
-                return false;
+        for (size_type cell = 0; cell < kRowCells; cell++) {
+            std::uint32_t fw_color = fw_value32 & 0x00000007U;
+            std::uint32_t bw_color = bw_value32 & 0x00000007U;
+            if (bw_color == std::uint32_t(Color::Unknown)) {
+                if (fw_color == std::uint32_t(Color::Empty)) {
+                    return false;
+                }
             }
-        }
-        else if (bw_color != fw_color) {
-            return false;
-        }
-
-        fw_color = fw_value32 & (0x00000007U << 12U);
-        bw_color = bw_value32 & (0x00000007U << 12U);
-        if (bw_color == std::uint32_t(Color::Unknown << 12U)) {
-            if (fw_color == std::uint32_t(Color::Empty << 12U)) {
+            else if (bw_color != fw_color) {
                 return false;
             }
-        }
-        else if (bw_color != fw_color) {
-            return false;
+            fw_value32 >>= 3U;
+            bw_value32 >>= 3U;
         }
 
         return true;
@@ -236,16 +210,19 @@ public:
         return (fw_value32 == bw_value32);
     }
 
-    int travel_forward_visited_leaf(ForwardContainer * fw_container, BackwardContainer * bw_container, size_type layer) {
+    template <typename FwContainer, typename BwContainer>
+    int travel_forward_visited_leaf(FwContainer * fw_container, BwContainer * bw_container, size_type layer) {
         assert(fw_container != nullptr);
         assert(bw_container != nullptr);
         int total = 0;
         for (size_type i = fw_container->begin(); i < fw_container->end(); fw_container->next(i)) {
             int fw_value = fw_container->getId(i);
-            assert(fw_value != -1);
+            if (fw_value == -1)
+                continue;
             for (size_type j = bw_container->begin(); j < bw_container->end(); bw_container->next(j)) {
                 int bw_value = bw_container->getId(j);
-                assert(bw_value != -1);
+                if (bw_value == -1)
+                    continue;
                 // It's overlapped ?
                 bool overlapped = this->is_coincident(fw_value, bw_value);
                 if (overlapped) {
@@ -263,18 +240,21 @@ public:
         return total;
     }
 
-    int travel_forward_visited(ForwardContainer * fw_container, BackwardContainer * bw_container, size_type layer) {
+    template <typename FwContainer, typename BwContainer>
+    int travel_forward_visited(FwContainer * fw_container, BwContainer * bw_container, size_type layer) {
         assert(fw_container != nullptr);
         assert(bw_container != nullptr);
         int total = 0;
         for (size_type i = fw_container->begin(); i < fw_container->end(); fw_container->next(i)) {
             int fw_value = fw_container->getId(i);
-            assert(fw_value != -1);
-            ForwardContainer * fw_child = fw_container->getValue(i);
+            if (fw_value == -1)
+                continue;
+            FwContainer * fw_child = fw_container->getValue(i);
             assert (fw_child != nullptr);
             for (size_type j = bw_container->begin(); j < bw_container->end(); bw_container->next(j)) {
                 int bw_value = bw_container->getId(j);
-                assert(bw_value != -1);
+                if (bw_value == -1)
+                    continue;
                 // It's overlapped ?
                 bool overlapped = this->is_coincident(fw_value, bw_value);
                 if (overlapped) {
@@ -282,7 +262,7 @@ public:
                     this->segment_pair_.fw_segments[layer] = fw_value;
                     this->segment_pair_.bw_segments[layer] = bw_value;
                     
-                    BackwardContainer * bw_child = bw_container->getValue(j);
+                    BwContainer * bw_child = bw_container->getValue(j);
                     assert (bw_child != nullptr);
 
                     if (!fw_child->isLeaf()) {
@@ -303,39 +283,63 @@ public:
 
     int find_intersection(typename TForwardSolver::bitset_type & forward_visited,
                           typename TBackwardSolver::bitset_type & backward_visited) {
-        ForwardContainer * fw_container = forward_visited.root();
+        return this->find_trie_intersection(forward_visited, backward_visited);
+    }
+
+    //
+    // The two tries must use the same layer order, the segments of a layer
+    // are the same rows on both sides.
+    //
+    template <typename FwBitset, typename BwBitset>
+    int find_trie_intersection(FwBitset & forward_visited, BwBitset & backward_visited) {
+        static_assert((FwBitset::kLayerOrder == BwBitset::kLayerOrder),
+                      "Game::find_trie_intersection(): The layer orders must be the same.");
+        typedef typename FwBitset::IContainer   FwContainer;
+        typedef typename BwBitset::IContainer   BwContainer;
+
+        FwContainer * fw_container = forward_visited.root();
         if (fw_container == nullptr)
             return false;
 
-        BackwardContainer * bw_container = backward_visited.root();
+        BwContainer * bw_container = backward_visited.root();
         if (bw_container == nullptr)
             return false;
 
         int total = 0;
         this->segment_list_.clear();
 
+        // The root containers may be bitmaps, collect the backward root entries
+        // once, so that the inner loop doesn't scan the whole bitmap every time.
+        std::vector<std::pair<int, BwContainer *>> bw_entries;
+        bw_entries.reserve(bw_container->size());
+        for (size_type j = bw_container->begin(); j < bw_container->end(); bw_container->next(j)) {
+            int bw_value = bw_container->getId(j);
+            if (bw_value != -1) {
+                BwContainer * bw_child = bw_container->getValue(j);
+                assert(bw_child != nullptr);
+                bw_entries.push_back(std::make_pair(bw_value, bw_child));
+            }
+        }
+
         for (size_type i = fw_container->begin(); i < fw_container->end(); fw_container->next(i)) {
             int fw_value = fw_container->getId(i);
             if (fw_value != -1) {
-                ForwardContainer * fw_child = fw_container->getValue(i);
+                FwContainer * fw_child = fw_container->getValue(i);
                 assert(fw_child != nullptr);
-                for (size_type j = bw_container->begin(); j < bw_container->end(); bw_container->next(j)) {
-                    int bw_value = bw_container->getId(j);
-                    if (bw_value != -1) {
-                        // It's overlapped ?
-                        bool overlapped = this->is_coincident(fw_value, bw_value);
-                        if (overlapped) {
-                            // Record the board segment value of layer 0
-                            this->segment_pair_.fw_segments[0] = fw_value;
-                            this->segment_pair_.bw_segments[0] = bw_value;
-
-                            BackwardContainer * bw_child = bw_container->getValue(j);
-                            assert(bw_child != nullptr);
-
-                            // Travel the next layer
-                            int count = this->travel_forward_visited(fw_child, bw_child, 1);
-                            total += count;
-                        }
+                for (size_type j = 0; j < bw_entries.size(); j++) {
+                    int bw_value = bw_entries[j].first;
+                    // It's overlapped ?
+                    bool overlapped = this->is_coincident(fw_value, bw_value);
+                    if (overlapped) {
+                        // Record the board segment value of layer 0
+                        this->segment_pair_.fw_segments[0] = fw_value;
+                        this->segment_pair_.bw_segments[0] = bw_value;
+
+                        BwContainer * bw_child = bw_entries[j].second;
+
+                        // Travel the next layer
+                        int count = this->travel_forward_visited(fw_child, bw_child, 1);
+                        total += count;
                     }
                 }
             }
@@ -624,8 +628,8 @@ public:
         return total;
     }
 
-    int find_intersection_value128(const std::vector<stage_type> & fw_stages,
-                                   const std::vector<stage_type> & bw_stages) {
+    int find_intersection_value128(const fw_stage_list_t & fw_stages,
+                                   const bw_stage_list_t & bw_stages) {
 
         std::vector<std::pair<Value128, Value128>> curr_list;
         std::vector<std::pair<Value128, Value128>> next_list;
@@ -638,7 +642,7 @@ public:
             bool is_first = true;
             for (size_type i = 0; i< bw_stages.size(); i++) {
                 const stage_type & bw_stage = bw_stages[i];
-                Value128 bw_value128 = bw_stage.board.value128();
+                Value128 bw_value128 = bw_stage.value;
                 if (!is_first) {
                     for (size_type j = 0; j < cache_value_list.size(); j++) {
                         const Value128 & fw_value128 = cache_value_list[j];
@@ -651,7 +655,7 @@ public:
                     is_first = false;
                     for (size_type j = 0; j< fw_stages.size(); j++) {
                         const stage_type & fw_stage = fw_stages[j];
-                        Value128 fw_value128 = fw_stage.board.value128();
+                        Value128 fw_value128 = fw_stage.value;
                         cache_value_list.push_back(fw_value128);
                         if (this->template is_coincident_low<10, 15>(fw_value128.low, bw_value128.low)) {
                             curr_list.push_back(std::make_pair(fw_value128, bw_value128));
@@ -666,7 +670,7 @@ public:
             bool is_first = true;
             for (size_type i = 0; i < fw_stages.size(); i++) {
                 const stage_type & fw_stage = fw_stages[i];
-                Value128 fw_value128 = fw_stage.board.value128();
+                Value128 fw_value128 = fw_stage.value;
                 if (!is_first) {
                     for (size_type j = 0; j < cache_value_list.size(); j++) {
                         const Value128 & bw_value128 = cache_value_list[j];
@@ -679,7 +683,7 @@ public:
                     is_first = false;
                     for (size_type j = 0; j < bw_stages.size(); j++) {
                         const stage_type & bw_stage = bw_stages[j];
-                        Value128 bw_value128 = bw_stage.board.value128();
+                        Value128 bw_value128 = bw_stage.value;
                         cache_value_list.push_back(bw_value128);
                         if (this->template is_coincident_low<10, 15>(fw_value128.low, bw_value128.low)) {
                             curr_list.push_back(std::make_pair(fw_value128, bw_value128));
@@ -747,8 +751,8 @@ public:
         return total;
     }
 
-    int find_intersection_value128_auto(const std::vector<stage_type> & fw_stages,
-                                        const std::vector<stage_type> & bw_stages) {
+    int find_intersection_value128_auto(const fw_stage_list_t & fw_stages,
+                                        const bw_stage_list_t & bw_stages) {
 
         std::vector<std::pair<Value128, Value128>> curr_list;
         std::vector<std::pair<Value128, Value128>> next_list;
@@ -760,7 +764,7 @@ public:
 
             bool is_first = true;
             for (auto const & bw_stage : bw_stages) {
-                Value128 bw_value128 = bw_stage.board.value128();
+                Value128 bw_value128 = bw_stage.value;
                 if (!is_first) {
                     for (auto const & fw_value128 : cache_value_list) {
                         if (this->template is_coincident_low<10, 15>(fw_value128.low, bw_value128.low)) {
@@ -771,7 +775,7 @@ public:
                 else {
                     is_first = false;
                     for (auto const & fw_stage : fw_stages) {
-                        Value128 fw_value128 = fw_stage.board.value128();
+                        Value128 fw_value128 = fw_stage.value;
                         cache_value_list.push_back(fw_value128);
                         if (this->template is_coincident_low<10, 15>(fw_value128.low, bw_value128.low)) {
                             curr_list.push_back(std::make_pair(fw_value128, bw_value128));
@@ -785,7 +789,7 @@ public:
 
             bool is_first = true;
             for (auto const & fw_stage : fw_stages) {
-                Value128 fw_value128 = fw_stage.board.value128();
+                Value128 fw_value128 = fw_stage.value;
                 if (!is_first) {
                     for (auto const & bw_value128 : cache_value_list) {
                         if (this->template is_coincident_low<10, 15>(fw_value128.low, bw_value128.low)) {
@@ -796,7 +800,7 @@ public:
                 else {
                     is_first = false;
                     for (auto const & bw_stage : bw_stages) {
-                        Value128 bw_value128 = bw_stage.board.value128();
+                        Value128 bw_value128 = bw_stage.value;
                         cache_value_list.push_back(bw_value128);
                         if (this->template is_coincident_low<10, 15>(fw_value128.low, bw_value128.low)) {
                             curr_list.push_back(std::make_pair(fw_value128, bw_value128));
@@ -861,8 +865,8 @@ public:
     }
 
 #if 0
-    int find_intersection(const std::vector<stage_type> & fw_stages,
-                          const std::vector<stage_type> & bw_stages) {
+    int find_intersection(const fw_stage_list_t & fw_stages,
+                          const bw_stage_list_t & bw_stages) {
 
         std::map<std::uint32_t, std::vector<std::uint32_t> *> value_map;
 
@@ -990,8 +994,8 @@ public:
         for (size_type i = 0; i< curr_list.size(); i++) {
             const std::pair<std::uint32_t, std::uint32_t> & val_pair = curr_list[i];
             if (this->template is_coincident<20, 25>(fw_stages[val_pair.first].board, bw_stages[val_pair.second].board)) {
-                Value128 fw_value128 = fw_stages[val_pair.first].board.value128();
-                Value128 bw_value128 = bw_stages[val_pair.second].board.value128();
+                Value128 fw_value128 = fw_stages[val_pair.first].value;
+                Value128 bw_value128 = bw_stages[val_pair.second].value;
                 this->board_value_list_.push_back(std::make_pair(fw_value128, bw_value128));
                 total++;
             }
@@ -1001,8 +1005,8 @@ public:
         return total;
     }
 #else
-    int find_intersection(const std::vector<stage_type> & fw_stages,
-                          const std::vector<stage_type> & bw_stages) {
+    int find_intersection(const fw_stage_list_t & fw_stages,
+                          const bw_stage_list_t & bw_stages) {
 
         std::map<std::uint32_t, std::vector<std::uint32_t> *> value_map;
 
@@ -1130,8 +1134,8 @@ public:
         for (size_type i = 0; i< curr_list.size(); i++) {
             const std::pair<std::uint32_t, std::uint32_t> & val_pair = curr_list[i];
             if (this->template is_coincident<20, 25>(fw_stages[val_pair.first].board, bw_stages[val_pair.second].board)) {
-                Value128 fw_value128 = fw_stages[val_pair.first].board.value128();
-                Value128 bw_value128 = bw_stages[val_pair.second].board.value128();
+                Value128 fw_value128 = fw_stages[val_pair.first].value;
+                Value128 bw_value128 = bw_stages[val_pair.second].value;
                 this->board_value_list_.push_back(std::make_pair(fw_value128, bw_value128));
                 total++;
             }
@@ -1212,6 +1216,9 @@ public:
     }
 
     bool stdset_solve(size_type max_forward_depth, size_type max_backward_depth) {
+        // The intersection of the std::set<Value128> is compared on the Value128 bits
+        static_assert((BoardSize <= 42), "Game::stdset_solve(): Use bitset_solve() for the boards over 42 cells.");
+
         if (this->is_satisfy(this->data_.player_board,
                              this->data_.target_board,
                              this->data_.target_len) != 0) {
@@ -1446,7 +1453,7 @@ public:
 
                         fw_stage.move_seq.clear();
 
-                        Value128 fw_board_value = this->fw_answer_board_.value128();
+                        key_type fw_board_value = this->fw_answer_board_.key();
                         bool fw_found = forward_solver.find_stage_in_list(fw_board_value, fw_stage);
                         if (fw_found) {
                             printf("-----------------------------------------------\n\n");
@@ -1466,7 +1473,7 @@ public:
 
                         bw_stage.move_seq.clear();
 
-                        Value128 bw_board_value = this->bw_answer_board_.value128();
+                        key_type bw_board_value = this->bw_answer_board_.key();
                         bool bw_found = backward_solver.find_stage_in_list(bw_board_value, bw_stage);
                         if (bw_found) {
                             printf("-----------------------------------------------\n\n");
@@ -13,6 +13,7 @@
 #include <iostream>
 #include <fstream>
 #include <cstring>
+#include <string>
 #include <vector>
 #include <set>
 #include <exception>
@@ -84,6 +85,9 @@ public:
     typedef TwoEndpoint::ForwardSolver<BoardX, BoardY, TargetX, TargetY, false,       SolverType::Full,         phase2_callback>  TForwardSolver;
     typedef              Phase1Solver <BoardX, BoardY, TargetX, TargetY, AllowRotate, SolverType::BackwardFull, phase2_callback>  TBackwardSolver;
 
+    typedef typename TForwardSolver::stage_list_t               fw_stage_list_t;
+    typedef typename TBackwardSolver::stage_list_t              bw_stage_list_t;
+
     typedef typename TForwardSolver::bitset_type::IContainer     ForwardContainer;
     typedef typename TBackwardSolver::bitset_type::IContainer    BackwardContainer;
 
@@ -98,6 +102,9 @@ private:
 
     std::vector<std::pair<Value128, Value128>> board_value_list_;
 
+    // The file of the phase1 cache, see set_cache_file()
+    std::string cache_file_;
+
 public:
     IDAGame() : base_type() {
     }
@@ -110,6 +117,15 @@ public:
         // TODO:
     }
 
+    //
+    // bitset_solve() maps the phase1 cache from this file, or builds the cache
+    // and saves it there when the file can't be opened. A file of another
+    // target or depth is not opened, it's built and saved again.
+    //
+    void set_cache_file(const char * filename) {
+        this->cache_file_ = (filename != nullptr) ? filename : "";
+    }
+
     bool is_coincident(int fw_value, int bw_value) const {
         std::uint32_t fw_value32 = (std::uint32_t)fw_value;
         std::uint32_t bw_value32 = (std::uint32_t)bw_value;
@@ -635,8 +651,8 @@ public:
         return total;
     }
 
-    int find_intersection_value128(const std::vector<stage_type> & fw_stages,
-                                   const std::vector<stage_type> & bw_stages) {
+    int find_intersection_value128(const fw_stage_list_t & fw_stages,
+                                   const bw_stage_list_t & bw_stages) {
 
         std::vector<std::pair<Value128, Value128>> curr_list;
         std::vector<std::pair<Value128, Value128>> next_list;
@@ -649,7 +665,7 @@ public:
             bool is_first = true;
             for (size_type i = 0; i< bw_stages.size(); i++) {
                 const stage_type & bw_stage = bw_stages[i];
-                Value128 bw_value128 = bw_stage.board.value128();
+                Value128 bw_value128 = bw_stage.value;
                 if (!is_first) {
                     for (size_type j = 0; j < cache_value_list.size(); j++) {
                         const Value128 & fw_value128 = cache_value_list[j];
@@ -662,7 +678,7 @@ public:
                     is_first = false;
                     for (size_type j = 0; j< fw_stages.size(); j++) {
                         const stage_type & fw_stage = fw_stages[j];
-                        Value128 fw_value128 = fw_stage.board.value128();
+                        Value128 fw_value128 = fw_stage.value;
                         cache_value_list.push_back(fw_value128);
                         if (this->template is_coincident_low<10, 15>(fw_value128.low, bw_value128.low)) {
                             curr_list.push_back(std::make_pair(fw_value128, bw_value128));
@@ -677,7 +693,7 @@ public:
             bool is_first = true;
             for (size_type i = 0; i < fw_stages.size(); i++) {
                 const stage_type & fw_stage = fw_stages[i];
-                Value128 fw_value128 = fw_stage.board.value128();
+                Value128 fw_value128 = fw_stage.value;
                 if (!is_first) {
                     for (size_type j = 0; j < cache_value_list.size(); j++) {
                         const Value128 & bw_value128 = cache_value_list[j];
@@ -690,7 +706,7 @@ public:
                     is_first = false;
                     for (size_type j = 0; j < bw_stages.size(); j++) {
                         const stage_type & bw_stage = bw_stages[j];
-                        Value128 bw_value128 = bw_stage.board.value128();
+                        Value128 bw_value128 = bw_stage.value;
                         cache_value_list.push_back(bw_value128);
                         if (this->template is_coincident_low<10, 15>(fw_value128.low, bw_value128.low)) {
                             curr_list.push_back(std::make_pair(fw_value128, bw_value128));
@@ -758,8 +774,8 @@ public:
         return total;
     }
 
-    int find_intersection_value128_auto(const std::vector<stage_type> & fw_stages,
-                                        const std::vector<stage_type> & bw_stages) {
+    int find_intersection_value128_auto(const fw_stage_list_t & fw_stages,
+                                        const bw_stage_list_t & bw_stages) {
 
         std::vector<std::pair<Value128, Value128>> curr_list;
         std::vector<std::pair<Value128, Value128>> next_list;
@@ -771,7 +787,7 @@ public:
 
             bool is_first = true;
             for (auto const & bw_stage : bw_stages) {
-                Value128 bw_value128 = bw_stage.board.value128();
+                Value128 bw_value128 = bw_stage.value;
                 if (!is_first) {
                     for (auto const & fw_value128 : cache_value_list) {
                         if (this->template is_coincident_low<10, 15>(fw_value128.low, bw_value128.low)) {
@@ -782,7 +798,7 @@ public:
                 else {
                     is_first = false;
                     for (auto const & fw_stage : fw_stages) {
-                        Value128 fw_value128 = fw_stage.board.value128();
+                        Value128 fw_value128 = fw_stage.value;
                         cache_value_list.push_back(fw_value128);
                         if (this->template is_coincident_low<10, 15>(fw_value128.low, bw_value128.low)) {
                             curr_list.push_back(std::make_pair(fw_value128, bw_value128));
@@ -796,7 +812,7 @@ public:
 
             bool is_first = true;
             for (auto const & fw_stage : fw_stages) {
-                Value128 fw_value128 = fw_stage.board.value128();
+                Value128 fw_value128 = fw_stage.value;
                 if (!is_first) {
                     for (auto const & bw_value128 : cache_value_list) {
                         if (this->template is_coincident_low<10, 15>(fw_value128.low, bw_value128.low)) {
@@ -807,7 +823,7 @@ public:
                 else {
                     is_first = false;
                     for (auto const & bw_stage : bw_stages) {
-                        Value128 bw_value128 = bw_stage.board.value128();
+                        Value128 bw_value128 = bw_stage.value;
                         cache_value_list.push_back(bw_value128);
                         if (this->template is_coincident_low<10, 15>(fw_value128.low, bw_value128.low)) {
                             curr_list.push_back(std::make_pair(fw_value128, bw_value128));
@@ -872,8 +888,8 @@ public:
     }
 
 #if 0
-    int find_intersection(const std::vector<stage_type> & fw_stages,
-                          const std::vector<stage_type> & bw_stages) {
+    int find_intersection(const fw_stage_list_t & fw_stages,
+                          const bw_stage_list_t & bw_stages) {
 
         std::map<std::uint32_t, std::vector<std::uint32_t> *> value_map;
 
@@ -1001,8 +1017,8 @@ public:
         for (size_type i = 0; i< curr_list.size(); i++) {
             const std::pair<std::uint32_t, std::uint32_t> & val_pair = curr_list[i];
             if (this->template is_coincident<20, 25>(fw_stages[val_pair.first].board, bw_stages[val_pair.second].board)) {
-                Value128 fw_value128 = fw_stages[val_pair.first].board.value128();
-                Value128 bw_value128 = bw_stages[val_pair.second].board.value128();
+                Value128 fw_value128 = fw_stages[val_pair.first].value;
+                Value128 bw_value128 = bw_stages[val_pair.second].value;
                 this->board_value_list_.push_back(std::make_pair(fw_value128, bw_value128));
                 total++;
             }
@@ -1012,8 +1028,8 @@ public:
         return total;
     }
 #else
-    int find_intersection(const std::vector<stage_type> & fw_stages,
-                          const std::vector<stage_type> & bw_stages) {
+    int find_intersection(const fw_stage_list_t & fw_stages,
+                          const bw_stage_list_t & bw_stages) {
 
         std::map<std::uint32_t, std::vector<std::uint32_t> *> value_map;
 
@@ -1141,8 +1157,8 @@ public:
         for (size_type i = 0; i< curr_list.size(); i++) {
             const std::pair<std::uint32_t, std::uint32_t> & val_pair = curr_list[i];
             if (this->template is_coincident<20, 25>(fw_stages[val_pair.first].board, bw_stages[val_pair.second].board)) {
-                Value128 fw_value128 = fw_stages[val_pair.first].board.value128();
-                Value128 bw_value128 = bw_stages[val_pair.second].board.value128();
+                Value128 fw_value128 = fw_stages[val_pair.first].value;
+                Value128 bw_value128 = bw_stages[val_pair.second].value;
                 this->board_value_list_.push_back(std::make_pair(fw_value128, bw_value128));
                 total++;
             }
@@ -1401,7 +1417,23 @@ public:
             TForwardSolver forward_solver(&this->data_);
             TBackwardSolver backward_solver(&this->data_);
 
-            backward_solver.bitset_prepare(18);
+            static const size_type kPrepareDepth = 18;
+
+            bool cache_mapped = false;
+            if (!this->cache_file_.empty()) {
+                int openStatus = backward_solver.open_cache(this->cache_file_.c_str(), kPrepareDepth);
+                cache_mapped = ErrorCode::isSuccess(openStatus);
+            }
+
+            backward_solver.bitset_prepare(kPrepareDepth);
+
+            if (!this->cache_file_.empty() && !cache_mapped) {
+                int saveStatus = backward_solver.save_cache(this->cache_file_.c_str());
+                if (ErrorCode::isFailure(saveStatus)) {
+                    printf("save_cache(\"%s\") = %d (Error: %s)\n\n", this->cache_file_.c_str(),
+                           saveStatus, ErrorCode::toString(saveStatus));
+                }
+            }
 
             int forward_status, backward_status;
             size_type forward_depth = 0;
@@ -154,6 +154,13 @@ public:
         return this->player_board_[0];
     }
 
+    // The start board of phase1, the cells outside of the prototype are unknown.
+    const Board<BoardX, BoardY> & getPhase1PlayerBoard(size_type rotate_type, size_type phase1_type) const {
+        assert(rotate_type < MAX_ROTATE_TYPE);
+        assert(phase1_type < kMaxPhase1Type);
+        return this->player_board_[rotate_type][phase1_type];
+    }
+
     Board<BoardX, BoardY> & getTargetBoard() {
         return this->target_board_;
     }
@@ -28,12 +28,17 @@
 #include "MagicBlock/AI/Color.h"
 #include "MagicBlock/AI/Move.h"
 #include "MagicBlock/AI/CanMoves.h"
+#include "MagicBlock/AI/MoveTable.h"
+#include "MagicBlock/AI/MoveFsm.h"
 #include "MagicBlock/AI/Value128.h"
 #include "MagicBlock/AI/Board.h"
 #include "MagicBlock/AI/Stage.h"
 #include "MagicBlock/AI/SharedData.h"
 #include "MagicBlock/AI/SparseBitset.h"
 #include "MagicBlock/AI/SparseHashMap.h"
+#include "MagicBlock/AI/FrozenSparseHashMap.h"
+#include "MagicBlock/AI/ErrorCode.h"
+#include "MagicBlock/AI/Value128HashSet.h"
 #include "MagicBlock/AI/Utils.h"
 
 namespace MagicBlock {
@@ -58,17 +63,35 @@ public:
     typedef typename base_type::stage_info_t        stage_info_t;
     typedef typename base_type::can_moves_t         can_moves_t;
     typedef typename base_type::can_move_list_t     can_move_list_t;
+    typedef MoveTable<BoardX, BoardY>               move_table_t;
     typedef typename base_type::player_board_t      player_board_t;
     typedef typename base_type::target_board_t      target_board_t;
     typedef typename base_type::phase2_callback     phase2_callback;
 
-    typedef SparseBitset<Board<BoardX, BoardY>, 3, BoardX * BoardY>             bitset_type;
-    typedef SparseHashMap<Board<BoardX, BoardY>, MoveSeq, 3, BoardX * BoardY>   sparse_hashmap_t;
-    typedef typename sparse_hashmap_t::insert_return_type                       insert_return_t;
+    //
+    // The value of the phase1 cache, one byte per board:
+    //
+    //   bit 0 - 1: the direction of the last move,
+    //   bit 2 - 7: the depth of the board.
+    //
+    // The move sequence of a board is rebuilt from its parents, see get_cache_move_seq().
+    //
+    typedef std::uint8_t    cache_value_t;
 
+    typedef SparseBitset<Board<BoardX, BoardY>, 3, BoardX * BoardY>                 bitset_type;
+    typedef SparseHashMap<Board<BoardX, BoardY>, cache_value_t, 3, BoardX * BoardY> sparse_hashmap_t;
+    typedef typename sparse_hashmap_t::insert_return_type                           insert_return_t;
+    typedef FrozenSparseHashMap<Board<BoardX, BoardY>, cache_value_t, 3, BoardX * BoardY>
+                                                                                    frozen_cache_t;
+
+#if STAGES_USE_VALUE128_HASHSET
+    typedef Value128HashSet                                             stdset_type;
+#else
     typedef std::set<Value128>                                          stdset_type;
+#endif
     typedef std::unordered_set<Value128, Value128_Hash>                 stdset_type_;
     typedef std::unordered_set<Value128, Value128_Hash>                 std_hashset_t;
+    typedef std::vector<stage_type>                                     stage_list_t;
 
     static const size_type BoardSize = BoardX * BoardY;
     static const size_type kSingelColorNums = (BoardSize - 1) / (Color::Last - 1);
@@ -102,11 +125,25 @@ private:
 
     sparse_hashmap_t phase1_cache_;
 
-    std::vector<stage_type> curr_stages_;
-    std::vector<stage_type> next_stages_;
+    // The phase1 cache mapped from a file by open_cache(), used instead of phase1_cache_
+    frozen_cache_t frozen_cache_;
+
+    // The max depth of the phase1 cache or the cache file
+    size_type cache_depth_;
+
+    stage_list_t curr_stages_;
+    stage_list_t next_stages_;
+
+#if STAGES_USE_PATH_REUSE
+    typedef typename bitset_type::InsertPath    path_type;
+
+    // The trie paths of the stages in curr_stages_ and next_stages_
+    std::vector<path_type> curr_paths_;
+    std::vector<path_type> next_paths_;
+#endif
 
 public:
-    Phase1Solver(shared_data_type * data) : base_type(data) {
+    Phase1Solver(shared_data_type * data) : base_type(data), cache_depth_(0) {
         this->init();
     }
 
@@ -134,19 +171,19 @@ public:
         return this->visited_set_;
     }
 
-    std::vector<stage_type> & curr_stages() {
+    stage_list_t & curr_stages() {
         return this->curr_stages_;
     }
 
-    const std::vector<stage_type> & curr_stages() const {
+    const stage_list_t & curr_stages() const {
         return this->curr_stages_;
     }
 
-    std::vector<stage_type> & next_stages() {
+    stage_list_t & next_stages() {
         return this->next_stages_;
     }
 
-    const std::vector<stage_type> & next_stages() const {
+    const stage_list_t & next_stages() const {
         return this->next_stages_;
     }
 
@@ -159,6 +196,10 @@ public:
         this->visited_.destroy();
         this->curr_stages_.clear();
         this->next_stages_.clear();
+#if STAGES_USE_PATH_REUSE
+        this->curr_paths_.clear();
+        this->next_paths_.clear();
+#endif
     }
 
     size_type calc_next_capacity() const {
@@ -179,12 +220,17 @@ public:
         std::swap(this->curr_stages_, this->next_stages_);
         this->next_stages_.clear();
         this->next_stages_.reserve(next_capacity);
+#if STAGES_USE_PATH_REUSE
+        std::swap(this->curr_paths_, this->next_paths_);
+        this->next_paths_.clear();
+        this->next_paths_.reserve(next_capacity);
+#endif
     }
 
     bool find_stage_in_list(const Value128 & target_value, stage_type & target_stage) {
         for (size_type i = 0; i < this->curr_stages_.size(); i++) {
             const stage_type & stage = this->curr_stages_[i];
-            const Value128 & value = stage.board.value128();
+            const Value128 & value = stage.value;
             if (value == target_value) {
                 target_stage = stage;
                 return true;
@@ -192,7 +238,7 @@ public:
         }
         for (size_type i = 0; i < this->next_stages_.size(); i++) {
             const stage_type & stage = this->next_stages_[i];
-            const Value128 & value = stage.board.value128();
+            const Value128 & value = stage.value;
             if (value == target_value) {
                 target_stage = stage;
                 return true;
@@ -203,9 +249,138 @@ public:
 
     static const size_type MAX_PHASE1_PREPARE_DEPTH = 18;
 
+    static_assert((MAX_PHASE1_PREPARE_DEPTH < 64),
+                  "Phase1Solver: the depth of the cache value is only 6 bits.");
+
+    static cache_value_t make_cache_value(size_type dir, size_type depth) {
+        assert(dir < Dir::Maximum);
+        assert(depth <= MAX_PHASE1_PREPARE_DEPTH);
+        return cache_value_t((depth << 2) | (dir & 0x03));
+    }
+
+    static size_type get_cache_dir(cache_value_t value) {
+        return size_type(value & 0x03);
+    }
+
+    static size_type get_cache_depth(cache_value_t value) {
+        return size_type(value >> 2);
+    }
+
+    sparse_hashmap_t & phase1_cache() {
+        return this->phase1_cache_;
+    }
+
+    const sparse_hashmap_t & phase1_cache() const {
+        return this->phase1_cache_;
+    }
+
+    const frozen_cache_t & frozen_cache() const {
+        return this->frozen_cache_;
+    }
+
+    // The cache value of a board, from the cache file if one is open.
+    const cache_value_t * find_cache(const Board<BoardX, BoardY> & board) const {
+        if (this->frozen_cache_.is_mapped())
+            return this->frozen_cache_.find(board);
+        else
+            return this->phase1_cache_.find(board);
+    }
+
+    //
+    // The source of a cache file: a key of the phase1 boards of the target and
+    // the max depth, a file of another target or depth is not opened.
+    //
+    typename frozen_cache_t::Source cache_source(size_type max_depth) const {
+        std::uint64_t key = std::uint64_t(this->target_len_);
+        for (size_type i = 0; i < this->target_len_; i++) {
+            for (size_type j = 0; j < kMaxPhase1Type; j++) {
+                Value128 value = this->player_board_[i][j].value128();
+                key = (key ^ value.low) * 0x9E3779B97F4A7C15ULL;
+                key = (key ^ value.high) * 0x9E3779B97F4A7C15ULL;
+                key ^= key >> 29;
+            }
+        }
+        return typename frozen_cache_t::Source(key, max_depth);
+    }
+
+    //
+    // Write the phase1 cache made by bitset_prepare() to a file, it can be
+    // mapped again by open_cache() with the same target and max depth.
+    //
+    int save_cache(const char * filename) const {
+        frozen_cache_t frozen(this->phase1_cache_);
+        return frozen.save(filename, this->cache_source(this->cache_depth_));
+    }
+
+    //
+    // Map a file written by save_cache(), bitset_prepare(max_depth) will not
+    // rebuild the cache.
+    //
+    int open_cache(const char * filename, size_type max_depth) {
+        max_depth = std::min(max_depth, MAX_PHASE1_PREPARE_DEPTH);
+        int status = this->frozen_cache_.open(filename, this->cache_source(max_depth));
+        if (ErrorCode::isSuccess(status)) {
+            this->cache_depth_ = max_depth;
+        }
+        return status;
+    }
+
+    //
+    // Rebuild the move sequence of a board in the phase1 cache: undo the last
+    // move of the board until a start board (depth 0) is reached.
+    //
+    bool get_cache_move_seq(const Board<BoardX, BoardY> & board, MoveSeq & move_seq) const {
+        const cache_value_t * value = this->find_cache(board);
+        if (value == nullptr)
+            return false;
+
+        Board<BoardX, BoardY> cur_board(board);
+        Position empty_pos;
+        bool found_empty = this->find_empty(cur_board, empty_pos);
+        if (!found_empty)
+            return false;
+
+        // The values of a cache file are checked, a broken chain returns false
+        std::uint8_t dir_list[MAX_PHASE1_PREPARE_DEPTH];
+        size_type total_depth = get_cache_depth(*value);
+        if (total_depth > MAX_PHASE1_PREPARE_DEPTH)
+            return false;
+        size_type depth = total_depth;
+        while (depth > 0) {
+            std::uint8_t cur_dir = std::uint8_t(get_cache_dir(*value));
+            std::uint8_t prev_pos = Dir::template getMovePos<BoardX, BoardY>(Dir::opp_dir(cur_dir), empty_pos);
+            if (prev_pos == std::uint8_t(-1))
+                return false;
+            std::swap(cur_board.cells[empty_pos], cur_board.cells[prev_pos]);
+            empty_pos = prev_pos;
+            depth--;
+            dir_list[depth] = cur_dir;
+
+            value = this->find_cache(cur_board);
+            if (value == nullptr || get_cache_depth(*value) != depth)
+                return false;
+        }
+
+        move_seq.clear();
+        for (size_type i = 0; i < total_depth; i++) {
+            move_seq.push_back(dir_list[i]);
+        }
+        return true;
+    }
+
     void bitset_prepare(size_type max_depth) {
-        bool solvable = false;
         max_depth = std::min(max_depth, MAX_PHASE1_PREPARE_DEPTH);
+        if (this->frozen_cache_.is_mapped()) {
+            if (this->cache_depth_ == max_depth) {
+                printf("Phase1Solver:: the cache is mapped from a file\n");
+                printf("cache.size() = %u\n\n", (uint32_t)(this->frozen_cache_.size()));
+                return;
+            }
+            this->frozen_cache_.clear();
+        }
+        this->cache_depth_ = max_depth;
+
+        bool solvable = false;
 
         size_type depth = 0;
 
@@ -225,6 +400,7 @@ public:
 
                     stage_type start;
                     start.board = this->player_board_[i][j];
+                    start.value = start.board.value128();
                     start.empty_pos = empty_pos;
                     start.last_dir = uint8_t((empty_pos.value << 2) | 0x03);
                     start.rotate_type = uint8_t((i & 0x03U) | ((j & 0x0FU) << 2U));
@@ -232,7 +408,7 @@ public:
                     // Restore unknown color
                     this->player_board_[i][j].cells[empty_pos] = Color::Unknown;
 
-                    insert_return_t result = this->phase1_cache_.try_insert(start.board, MoveSeq());
+                    insert_return_t result = this->phase1_cache_.try_insert(start.board, make_cache_value(0, 0));
                     bool insert_new = result.second;
                     if (!insert_new) {
                         continue;
@@ -247,39 +423,52 @@ public:
         printf("cache.size() = %u\n\n", (uint32_t)(this->phase1_cache_.size()));
 
         while (curr_stages.size() > 0) {
+#if STAGES_USE_MOVE_FSM
+            const MoveFsm & move_fsm = MoveFsm::getInstance();
+#endif
             for (size_type i = 0; i < curr_stages.size(); i++) {
                 stage_type & stage = curr_stages[i];
 
                 uint8_t empty_pos = stage.empty_pos;
-                const can_move_list_t & can_moves = this->data_->can_moves[empty_pos];
-                size_type total_moves = can_moves.size();
-                for (size_type n = 0; n < total_moves; n++) {
-                    uint8_t cur_dir = can_moves[n].dir;
+                const MoveEntry * moves = move_table_t::moves(empty_pos);
+                for (size_type n = 0; n < Dir::Maximum; n++) {
+                    if (moves[n].valid == 0)
+                        continue;
+
+                    uint8_t cur_dir = moves[n].dir;
                     assert(cur_dir >= 0 && cur_dir < Dir::Maximum);
+#if STAGES_USE_MOVE_FSM
+                    uint8_t fsm_state = move_fsm.next(stage.fsm_state, n);
+                    if (fsm_state == MoveFsm::kPruned)
+                        continue;
+#else
                     if ((cur_dir == (stage.last_dir & 0x03)) && (depth != 0))
                         continue;
+#endif
 
-                    uint8_t move_pos = can_moves[n].pos;
+                    uint8_t move_pos = moves[n].pos;
 #if STAGES_USE_EMPLACE_PUSH
-                    std::swap(stage.board.cells[empty_pos], stage.board.cells[move_pos]);
+                    stage.board.swap_cells(empty_pos, move_pos, stage.value);
 
-                    bool insert_new = this->phase1_cache_.try_insert(stage.board);
+                    insert_return_t result = this->phase1_cache_.try_insert(stage.board, make_cache_value(cur_dir, depth + 1));
+                    bool insert_new = result.second;
                     if (!insert_new) {
-                        std::swap(stage.board.cells[empty_pos], stage.board.cells[move_pos]);
+                        stage.board.swap_cells(empty_pos, move_pos, stage.value);
                         continue;
                     }
 
-                    this->next_stages_.emplace_back(stage.board, move_pos, cur_dir, stage.rotate_type, stage.move_seq);
+                    next_stages.emplace_back(stage.board, stage.value, move_pos, cur_dir, stage.rotate_type, MoveSeq());
+#if STAGES_USE_MOVE_FSM
+                    next_stages.back().fsm_state = fsm_state;
+#endif
 
-                    std::swap(stage.board.cells[empty_pos], stage.board.cells[move_pos]);
+                    stage.board.swap_cells(empty_pos, move_pos, stage.value);
 #else
-                    stage_type next_stage(stage.board);
-                    std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
-
-                    next_stage.move_seq = stage.move_seq;
-                    next_stage.move_seq.push_back(cur_dir);
+                    stage_type next_stage(stage.board, stage.value);
+                    next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
 
-                    insert_return_t result = this->phase1_cache_.try_insert(next_stage.board, next_stage.move_seq);
+                    // The move sequence is kept by the cache value
+                    insert_return_t result = this->phase1_cache_.try_insert(next_stage.board, make_cache_value(cur_dir, depth + 1));
                     bool insert_new = result.second;
                     if (!insert_new) {
                         continue;
@@ -287,6 +476,9 @@ public:
 
                     next_stage.empty_pos = move_pos;
                     next_stage.last_dir = ((stage.last_dir) & 0xFC) | Dir::opp_dir(cur_dir);
+#if STAGES_USE_MOVE_FSM
+                    next_stage.fsm_state = fsm_state;
+#endif
                     next_stage.rotate_type = stage.rotate_type;
 
                     next_stages.push_back(std::move(next_stage));
@@ -343,6 +535,7 @@ public:
 
                         stage_type start;
                         start.board = this->player_board_[i][j];
+                        start.value = start.board.value128();
                         start.empty_pos = empty_pos;
                         start.last_dir = uint8_t((empty_pos.value << 2) | 0x03);
                         start.rotate_type = uint8_t((i & 0x03U) | ((j & 0x0FU) << 2U));
@@ -364,31 +557,45 @@ public:
         {
             bool exit = false;
             if (this->curr_stages_.size() > 0) {
+                // Each stage has about 3 next moves
+                reserve_visited(this->visited_set_, this->visited_set_.size() + this->curr_stages_.size() * 3);
+#if STAGES_USE_MOVE_FSM
+                const MoveFsm & move_fsm = MoveFsm::getInstance();
+#endif
                 for (size_type i = 0; i < this->curr_stages_.size(); i++) {
                     const stage_type & stage = this->curr_stages_[i];
 
                     uint8_t empty_pos = stage.empty_pos;
-                    const can_move_list_t & can_moves = this->data_->can_moves[empty_pos];
-                    size_type total_moves = can_moves.size();
-                    for (size_type n = 0; n < total_moves; n++) {
-                        uint8_t cur_dir = can_moves[n].dir;
+                    const MoveEntry * moves = move_table_t::moves(empty_pos);
+                    for (size_type n = 0; n < Dir::Maximum; n++) {
+                        if (moves[n].valid == 0)
+                            continue;
+
+                        uint8_t cur_dir = moves[n].dir;
                         assert(cur_dir >= 0 && cur_dir < Dir::Maximum);
+#if STAGES_USE_MOVE_FSM
+                        uint8_t fsm_state = move_fsm.next(stage.fsm_state, n);
+                        if (fsm_state == MoveFsm::kPruned)
+                            continue;
+#else
                         if ((cur_dir == (stage.last_dir & 0x03)) && (depth != 0))
                             continue;
+#endif
 
-                        uint8_t move_pos = can_moves[n].pos;
+                        uint8_t move_pos = moves[n].pos;
 
-                        stage_type next_stage(stage.board);
-                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
+                        stage_type next_stage(stage.board, stage.value);
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
 
-                        Value128 board_value = next_stage.board.value128();
-                        if (this->visited_set_.count(board_value) > 0)
+                        Value128 board_value = next_stage.value;
+                        if (!this->visited_set_.insert(board_value).second)
                             continue;
 
-                        this->visited_set_.insert(board_value);
-
                         next_stage.empty_pos = move_pos;
                         next_stage.last_dir = ((stage.last_dir) & 0xFC) | Dir::opp_dir(cur_dir);
+#if STAGES_USE_MOVE_FSM
+                        next_stage.fsm_state = fsm_state;
+#endif
                         next_stage.rotate_type = stage.rotate_type;
                         next_stage.move_seq = stage.move_seq;
                         next_stage.move_seq.push_back(cur_dir);
@@ -439,6 +646,7 @@ public:
 
                         stage_type start;
                         start.board = this->player_board_[i][j];
+                        start.value = start.board.value128();
                         start.empty_pos = empty_pos;
                         start.last_dir = uint8_t((empty_pos.value << 2) | 0x03);
                         start.rotate_type = uint8_t((i & 0x03U) | ((j & 0x0FU) << 2U));
@@ -446,10 +654,18 @@ public:
                         // Restore unknown color
                         this->player_board_[i][j].cells[empty_pos] = Color::Unknown;
 
+#if STAGES_USE_PATH_REUSE
+                        path_type start_path;
+                        bool insert_new = this->visited_.try_insert(start.board, start_path);
+#else
                         bool insert_new = this->visited_.try_insert(start.board);
+#endif
                         if (!insert_new) {
                             continue;
                         }
+#if STAGES_USE_PATH_REUSE
+                        this->curr_paths_.push_back(start_path);
+#endif
                         this->curr_stages_.push_back(start);
                     }
                 }
@@ -460,47 +676,74 @@ public:
         {
             bool exit = false;
             if (this->curr_stages_.size() > 0) {
+#if STAGES_USE_MOVE_FSM
+                const MoveFsm & move_fsm = MoveFsm::getInstance();
+#endif
                 for (size_type i = 0; i < this->curr_stages_.size(); i++) {
                     stage_type & stage = this->curr_stages_[i];
 
                     uint8_t empty_pos = stage.empty_pos;
-                    const can_move_list_t & can_moves = this->data_->can_moves[empty_pos];
-                    size_type total_moves = can_moves.size();
-                    for (size_type n = 0; n < total_moves; n++) {
-                        uint8_t cur_dir = can_moves[n].dir;
+                    const MoveEntry * moves = move_table_t::moves(empty_pos);
+                    for (size_type n = 0; n < Dir::Maximum; n++) {
+                        if (moves[n].valid == 0)
+                            continue;
+
+                        uint8_t cur_dir = moves[n].dir;
                         assert(cur_dir >= 0 && cur_dir < Dir::Maximum);
+#if STAGES_USE_MOVE_FSM
+                        uint8_t fsm_state = move_fsm.next(stage.fsm_state, n);
+                        if (fsm_state == MoveFsm::kPruned)
+                            continue;
+#else
                         if ((cur_dir == (stage.last_dir & 0x03)) && (depth != 0))
                             continue;
+#endif
 
-                        uint8_t move_pos = can_moves[n].pos;
+                        uint8_t move_pos = moves[n].pos;
 #if STAGES_USE_EMPLACE_PUSH
-                        std::swap(stage.board.cells[empty_pos], stage.board.cells[move_pos]);
+                        stage.board.swap_cells(empty_pos, move_pos, stage.value);
 
                         bool insert_new = this->visited_.try_insert(stage.board);
                         if (!insert_new) {
-                            std::swap(stage.board.cells[empty_pos], stage.board.cells[move_pos]);
+                            stage.board.swap_cells(empty_pos, move_pos, stage.value);
                             continue;
                         }
 
-                        this->next_stages_.emplace_back(stage.board, move_pos, cur_dir, stage.rotate_type, stage.move_seq);
+                        this->next_stages_.emplace_back(stage.board, stage.value, move_pos, cur_dir, stage.rotate_type, stage.move_seq);
+#if STAGES_USE_MOVE_FSM
+                        this->next_stages_.back().fsm_state = fsm_state;
+#endif
 
-                        std::swap(stage.board.cells[empty_pos], stage.board.cells[move_pos]);
+                        stage.board.swap_cells(empty_pos, move_pos, stage.value);
+#else
+                        stage_type next_stage(stage.board, stage.value);
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
+
+#if STAGES_USE_PATH_REUSE
+                        path_type next_path;
+                        size_type first_layer = this->visited_.first_changed_layer(empty_pos, move_pos);
+                        bool insert_new = this->visited_.try_insert_from(next_stage.board, this->curr_paths_[i],
+                                                                         first_layer, next_path);
 #else
-                        stage_type next_stage(stage.board);
-                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
-
                         bool insert_new = this->visited_.try_insert(next_stage.board);
+#endif
                         if (!insert_new) {
                             continue;
                         }
 
                         next_stage.empty_pos = move_pos;
                         next_stage.last_dir = ((stage.last_dir) & 0xFC) | Dir::opp_dir(cur_dir);
+#if STAGES_USE_MOVE_FSM
+                        next_stage.fsm_state = fsm_state;
+#endif
                         next_stage.rotate_type = stage.rotate_type;
                         next_stage.move_seq = stage.move_seq;
                         next_stage.move_seq.push_back(cur_dir);
 
                         this->next_stages_.push_back(std::move(next_stage));
+#if STAGES_USE_PATH_REUSE
+                        this->next_paths_.push_back(next_path);
+#endif
 #endif // STAGES_USE_EMPLACE_PUSH
                     }
                 }
@@ -550,6 +793,7 @@ public:
 
                     stage_type start;
                     start.board = this->player_board_[i][j];
+                    start.value = start.board.value128();
                     start.empty_pos = empty_pos;
                     start.last_dir = uint8_t((empty_pos.value << 2) | 0x03);
                     start.rotate_type = uint8_t((i & 0x03U) | ((j & 0x0FU) << 2U));
@@ -562,7 +806,7 @@ public:
                         continue;
                     }
 
-                    Value128 board_value = start.board.value128();
+                    Value128 board_value = start.value;
                     if (board_value == target_value) {
                         target_stage = start;
                         return 1;
@@ -575,22 +819,33 @@ public:
 
         bool exit = false;
         while (this->curr_stages_.size() > 0) {
+#if STAGES_USE_MOVE_FSM
+            const MoveFsm & move_fsm = MoveFsm::getInstance();
+#endif
             for (size_type i = 0; i < this->curr_stages_.size(); i++) {
                 const stage_type & stage = this->curr_stages_[i];
 
                 uint8_t empty_pos = stage.empty_pos;
-                const can_move_list_t & can_moves = this->data_->can_moves[empty_pos];
-                size_type total_moves = can_moves.size();
-                for (size_type n = 0; n < total_moves; n++) {
-                    uint8_t cur_dir = can_moves[n].dir;
+                const MoveEntry * moves = move_table_t::moves(empty_pos);
+                for (size_type n = 0; n < Dir::Maximum; n++) {
+                    if (moves[n].valid == 0)
+                        continue;
+
+                    uint8_t cur_dir = moves[n].dir;
                     assert(cur_dir >= 0 && cur_dir < Dir::Maximum);
+#if STAGES_USE_MOVE_FSM
+                    uint8_t fsm_state = move_fsm.next(stage.fsm_state, n);
+                    if (fsm_state == MoveFsm::kPruned)
+                        continue;
+#else
                     if ((cur_dir == (stage.last_dir & 0x03)) && (depth != 0))
                         continue;
+#endif
 
-                    uint8_t move_pos = can_moves[n].pos;
+                    uint8_t move_pos = moves[n].pos;
 
-                    stage_type next_stage(stage.board);
-                    std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
+                    stage_type next_stage(stage.board, stage.value);
+                    next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
 
                     bool insert_new = this->visited_.try_insert(next_stage.board);
                     if (!insert_new) {
@@ -599,11 +854,14 @@ public:
 
                     next_stage.empty_pos = move_pos;
                     next_stage.last_dir = ((stage.last_dir) & 0xFC) | Dir::opp_dir(cur_dir);
+#if STAGES_USE_MOVE_FSM
+                    next_stage.fsm_state = fsm_state;
+#endif
                     next_stage.rotate_type = stage.rotate_type;
                     next_stage.move_seq = stage.move_seq;
                     next_stage.move_seq.push_back(cur_dir);
 
-                    Value128 board_value = next_stage.board.value128();
+                    Value128 board_value = next_stage.value;
                     if (board_value == target_value) {
                         result = 1;
                         exit = true;
@@ -66,7 +66,7 @@ public:
     typedef Solver<BoardX, BoardY - 2, TargetX, TargetY - 1, false, SolverType::Phase2_Compact, phase2_callback>  CompactPhase2Solver;
 
     static const size_type BoardSize = BoardX * BoardY;
-    static const size_type kSingelColorNums = (BoardSize - 1) / (Color::Last - 1);
+    static const size_type kSingelColorNums = (BoardSize - 1 + Color::Last - 2) / (Color::Last - 1);
 
     static const ptrdiff_t kStartX = (BoardX - TargetX) / 2;
     static const ptrdiff_t kStartY = (BoardY - TargetY) / 2;
@@ -50,15 +50,19 @@ public:
 
     typedef typename base_type::shared_data_type    shared_data_type;
     typedef typename base_type::stage_type          stage_type;
+    typedef typename stage_type::key_type           key_type;
     typedef typename base_type::stage_info_t        stage_info_t;
     typedef typename base_type::can_moves_t         can_moves_t;
     typedef typename base_type::can_move_list_t     can_move_list_t;
     typedef typename base_type::player_board_t      player_board_t;
     typedef typename base_type::target_board_t      target_board_t;
     typedef typename base_type::phase2_callback     phase2_callback;
+    typedef typename base_type::goal_counter_t      goal_counter_t;
+    typedef typename base_type::goal_summary_t      goal_summary_t;
+    typedef typename base_type::target_matcher_t    target_matcher_t;
 
     static const size_type BoardSize = BoardX * BoardY;
-    static const size_type kSingelColorNums = (BoardSize - 1) / (Color::Last - 1);
+    static const size_type kSingelColorNums = (BoardSize - 1 + Color::Last - 2) / (Color::Last - 1);
 
     static const ptrdiff_t kStartX = (BoardX - TargetX) / 2;
     static const ptrdiff_t kStartY = (BoardY - TargetY) / 2;
@@ -288,7 +292,7 @@ public:
         Position first_empty;
         bool found_empty = this->find_empty(this->player_board_, first_empty);
         if (found_empty) {
-            std::set<Value128> visited;
+            std::set<key_type> visited;
 
             stage_type start;
             start.empty_pos = first_empty;
@@ -301,6 +305,7 @@ public:
                                                                      first_empty, rotate_index, this->data_->phase2.phase1_type);
                 if (first_move_pos == size_type(-1)) {
                     start.board = this->player_board_;
+                    start.value = start.board.key();
                 }
                 else {
                     player_board_t player_board(this->player_board_);
@@ -309,14 +314,16 @@ public:
                     std::uint8_t move_dir = Dir::template getDir<BoardX, BoardY>(first_move_pos, first_empty);
                     start.move_seq.push_back(move_dir);
                     start.board = player_board;
+                    start.value = start.board.key();
                     depth++;
                 }
             }
             else {
                 start.rotate_type = 0;
                 start.board = this->player_board_;
+                start.value = start.board.key();
             }
-            visited.insert(start.board.value128());
+            visited.insert(start.value);
 
             std::vector<stage_type> cur_stages;
             std::vector<stage_type> next_stages;
@@ -336,10 +343,10 @@ public:
                         if (cur_dir == stage.last_dir)
                             continue;
 
-                        stage_type next_stage(stage.board);
+                        stage_type next_stage(stage.board, stage.value);
                         uint8_t move_pos = can_moves[n].pos;
-                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
-                        Value128 board_value = next_stage.board.value128();
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
+                        key_type board_value = next_stage.value;
                         if (visited.count(board_value) > 0)
                             continue;
 
@@ -410,7 +417,7 @@ public:
         Position first_empty;
         bool found_empty = this->find_empty(this->player_board_, first_empty);
         if (found_empty) {
-            std::set<Value128> visited;
+            std::set<key_type> visited;
 
             stage_type start;
             start.empty_pos = first_empty;
@@ -423,6 +430,7 @@ public:
                                                                      first_empty, rotate_index, this->data_->phase2.phase1_type);
                 if (first_move_pos == size_type(-1)) {
                     start.board = this->player_board_;
+                    start.value = start.board.key();
                 }
                 else {
                     player_board_t player_board(this->player_board_);
@@ -431,14 +439,16 @@ public:
                     std::uint8_t move_dir = Dir::template getDir<BoardX, BoardY>(first_move_pos, first_empty);
                     start.move_seq.push_back(move_dir);
                     start.board = player_board;
+                    start.value = start.board.key();
                     depth++;
                 }
             }
             else {
                 start.rotate_type = 0;
                 start.board = this->player_board_;
+                start.value = start.board.key();
             }
-            visited.insert(start.board.value128());
+            visited.insert(start.value);
 
             std::vector<stage_type> cur_stages;
             std::vector<stage_type> next_stages;
@@ -464,9 +474,9 @@ public:
                                 continue;
                         }
 
-                        stage_type next_stage(stage.board);
-                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
-                        Value128 board_value = next_stage.board.value128();
+                        stage_type next_stage(stage.board, stage.value);
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
+                        key_type board_value = next_stage.value;
                         if (visited.count(board_value) > 0) {
                             continue;
                         }
@@ -603,7 +613,7 @@ public:
         Position first_empty;
         bool found_empty = this->find_empty(this->player_board_, first_empty);
         if (found_empty) {
-            std::set<Value128> visited;
+            std::set<key_type> visited;
 
             stage_type start;
             start.empty_pos = first_empty;
@@ -616,6 +626,7 @@ public:
                                                                      first_empty, rotate_index, this->data_->phase2.phase1_type);
                 if (first_move_pos == size_type(-1)) {
                     start.board = this->player_board_;
+                    start.value = start.board.key();
                 }
                 else {
                     player_board_t player_board(this->player_board_);
@@ -624,14 +635,16 @@ public:
                     std::uint8_t move_dir = Dir::template getDir<BoardX, BoardY>(first_move_pos, first_empty);
                     start.move_seq.push_back(move_dir);
                     start.board = player_board;
+                    start.value = start.board.key();
                     depth++;
                 }
             }
             else {
                 start.rotate_type = 0;
                 start.board = this->player_board_;
+                start.value = start.board.key();
             }
-            visited.insert(start.board.value128());
+            visited.insert(start.value);
 
             std::queue<stage_type> cur_stages;
             std::queue<stage_type> next_stages;
@@ -657,9 +670,9 @@ public:
                                 continue;
                         }
 
-                        stage_type next_stage(stage.board);
-                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
-                        Value128 board_value = next_stage.board.value128();
+                        stage_type next_stage(stage.board, stage.value);
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
+                        key_type board_value = next_stage.value;
                         if (visited.count(board_value) > 0) {
                             continue;
                         }
@@ -812,6 +825,7 @@ public:
                                                                      first_empty, rotate_index, this->data_->phase2.phase1_type);
                 if (first_move_pos == size_type(-1)) {
                     start.board = this->player_board_;
+                    start.value = start.board.key();
                 }
                 else {
                     player_board_t player_board(this->player_board_);
@@ -820,12 +834,14 @@ public:
                     std::uint8_t move_dir = Dir::template getDir<BoardX, BoardY>(first_move_pos, first_empty);
                     start.move_seq.push_back(move_dir);
                     start.board = player_board;
+                    start.value = start.board.key();
                     depth++;
                 }
             }
             else {
                 start.rotate_type = 0;
                 start.board = this->player_board_;
+                start.value = start.board.key();
             }
             visited.insert(start.board);
 
@@ -834,6 +850,24 @@ public:
 
             cur_stages.push_back(start);
 
+            size_type max_rotate_index = (AllowRotate ? this->target_len_ : 1);
+#if STAGES_USE_GOAL_COUNTER
+            // The goal summaries of cur_stages and next_stages, in the same order
+            goal_counter_t goal_counter;
+            this->init_goal_counter(goal_counter, max_rotate_index);
+
+            std::vector<goal_summary_t> cur_goals;
+            std::vector<goal_summary_t> next_goals;
+
+            goal_summary_t start_goal;
+            goal_counter.count(start.board, start_goal);
+            cur_goals.push_back(start_goal);
+#endif
+#if STAGES_USE_TARGET_MATCHER
+            target_matcher_t target_matcher;
+            target_matcher.init(this->target_board_, max_rotate_index);
+#endif
+
             bool exit = false;
             while (cur_stages.size()) {
                 for (size_type i = 0; i < cur_stages.size(); i++) {
@@ -854,23 +888,46 @@ public:
                                 continue;
                         }
 
-                        stage_type next_stage(stage.board);
-                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
+                        stage_type next_stage(stage.board, stage.value);
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
 
                         bool insert_new = visited.try_insert(next_stage.board);
                         if (!insert_new) {
                             continue;
                         }
 
+#if STAGES_USE_GOAL_COUNTER
+                        goal_summary_t next_goal = cur_goals[i];
+                        goal_counter.move(next_goal, empty_pos, move_pos, stage.board.cells[move_pos]);
+                        std::uint32_t matched_mask = goal_counter.matched_mask(next_goal);
+#endif
+
                         next_stage.empty_pos = move_pos;
                         next_stage.last_dir = Dir::opp_dir(cur_dir);
                         next_stage.rotate_type = 0;
                         next_stage.move_seq = stage.move_seq;
                         next_stage.move_seq.push_back(cur_dir);
 
-                        size_type max_rotate_index = (AllowRotate ? this->target_len_ : 1);
+#if STAGES_USE_TARGET_MATCHER
+                        std::uint32_t equal_masks[target_matcher_t::kMaxTargets];
+#if STAGES_USE_GOAL_COUNTER
+                        if (matched_mask != 0)
+                            target_matcher.match(next_stage.board, equal_masks);
+#else
+                        target_matcher.match(next_stage.board, equal_masks);
+#endif
+#endif
                         for (size_type index = 0; index < max_rotate_index; index++) {
+#if STAGES_USE_GOAL_COUNTER
+                            // No region of this target is matched, is_satisfy() can't pass
+                            if ((matched_mask & this->goal_slot_mask(index)) == 0)
+                                continue;
+#endif
+#if STAGES_USE_TARGET_MATCHER
+                            size_u satisfy_result = this->is_satisfy_matched(next_stage.board, index, equal_masks[index]);
+#else
                             size_u satisfy_result = this->is_satisfy(next_stage.board, this->target_board_[index], index);
+#endif
                             size_type satisfy_mask = satisfy_result.low;
                             if (satisfy_mask != 0) {
                                 solvable = true;
@@ -893,6 +950,9 @@ public:
                         }
 
                         next_stages.push_back(std::move(next_stage));
+#if STAGES_USE_GOAL_COUNTER
+                        next_goals.push_back(next_goal);
+#endif
                     }
                     if (!(this->is_phase1())) {
                         if (exit) {
@@ -914,6 +974,10 @@ public:
 
                 std::swap(cur_stages, next_stages);
                 next_stages.clear();
+#if STAGES_USE_GOAL_COUNTER
+                std::swap(cur_goals, next_goals);
+                next_goals.clear();
+#endif
 
                 if (this->is_phase1()) {
                     size_type rotate_done = 0;
@@ -220,7 +220,8 @@ public:
             start.empty_pos = empty;
             start.last_dir = uint8_t(-1);
             start.board = this->player_board_;
-            visited.insert(start.board.value128());
+            start.value = start.board.value128();
+            visited.insert(start.value);
 
             std::vector<stage_type> cur_stages;
             std::vector<stage_type> next_stages;
@@ -240,10 +241,10 @@ public:
                         if (cur_dir == stage.last_dir)
                             continue;
 
-                        stage_type next_stage(stage.board);
+                        stage_type next_stage(stage.board, stage.value);
                         uint8_t move_pos = can_moves[n].pos;
-                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
-                        Value128 board_value = next_stage.board.value128();
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
+                        Value128 board_value = next_stage.value;
                         if (visited.count(board_value) > 0)
                             continue;
 
@@ -316,7 +317,8 @@ public:
             start.last_dir = uint8_t(-1);
             start.rotate_type = 0;
             start.board = this->player_board_;
-            visited.insert(start.board.value128());
+            start.value = start.board.value128();
+            visited.insert(start.value);
 
             std::vector<stage_type> cur_stages;
             std::vector<stage_type> next_stages;
@@ -342,9 +344,9 @@ public:
                                 continue;
                         }
 
-                        stage_type next_stage(stage.board);
-                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
-                        Value128 board_value = next_stage.board.value128();
+                        stage_type next_stage(stage.board, stage.value);
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
+                        Value128 board_value = next_stage.value;
                         if (visited.count(board_value) > 0)
                             continue;
 
@@ -484,7 +486,8 @@ public:
             start.last_dir = uint8_t(-1);
             start.rotate_type = 0;
             start.board = this->player_board_;
-            visited.insert(start.board.value128());
+            start.value = start.board.value128();
+            visited.insert(start.value);
 
             std::queue<stage_type> cur_stages;
             std::queue<stage_type> next_stages;
@@ -510,9 +513,9 @@ public:
                                 continue;
                         }
 
-                        stage_type next_stage(stage.board);
-                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
-                        Value128 board_value = next_stage.board.value128();
+                        stage_type next_stage(stage.board, stage.value);
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
+                        Value128 board_value = next_stage.value;
                         if (visited.count(board_value) > 0)
                             continue;
 
@@ -697,6 +700,7 @@ public:
             start.last_dir = uint8_t(-1);
             start.rotate_type = 0;
             start.board = this->player_board_;
+            start.value = start.board.value128();
             visited.insert(start.board);
 
             std::vector<stage_type> cur_stages;
@@ -723,8 +727,8 @@ public:
                                 continue;
                         }
 
-                        stage_type next_stage(stage.board);
-                        std::swap(next_stage.board.cells[empty_pos], next_stage.board.cells[move_pos]);
+                        stage_type next_stage(stage.board, stage.value);
+                        next_stage.board.swap_cells(empty_pos, move_pos, next_stage.value);
 #if 1
                         bool insert_new = visited.try_insert(next_stage.board);
                         if (!insert_new)
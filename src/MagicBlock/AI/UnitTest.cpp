@@ -5,13 +5,42 @@
 #include <cstdio>
 #include <iostream>
 #include <cstring>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
 
 #include "MagicBlock/AI/UnitTest.h"
 #include <MagicBlock/AI/MoveSeq.h>
 #include "MagicBlock/AI/Board.h"
+#include "MagicBlock/AI/CellPack.h"
+#include "MagicBlock/AI/PackedBoard.h"
+#include "MagicBlock/AI/PackedKey.h"
+#include "MagicBlock/AI/CanMoves.h"
+#include "MagicBlock/AI/MoveTable.h"
+#include "MagicBlock/AI/MoveFsm.h"
+#include "MagicBlock/AI/MoveTree.h"
+#include "MagicBlock/AI/LayerRegion.h"
+#include "MagicBlock/AI/Value128HashSet.h"
+#include "MagicBlock/AI/BoardRank.h"
+#include "MagicBlock/AI/BoardSymmetry.h"
+#include "MagicBlock/AI/FrontierSoA.h"
+#include "MagicBlock/AI/GoalCounter.h"
+#include "MagicBlock/AI/TargetMatcher.h"
 #include "MagicBlock/AI/Algorithm.h"
 #include "MagicBlock/AI/jm_malloc.h"
 #include "MagicBlock/AI/SparseBitset.h"
+#include "MagicBlock/AI/SparseHashMap.h"
+#include "MagicBlock/AI/FrozenSparseBitset.h"
+#include "MagicBlock/AI/FrozenSparseHashMap.h"
+#include "MagicBlock/AI/PagedArena.h"
+#include "MagicBlock/AI/ConcurrentSparseBitset.h"
+#include "MagicBlock/AI/TwoEndpoint/Game.h"
+#include "MagicBlock/AI/TwoPhase_ida/IDAGame.h"
+#include "MagicBlock/AI/ErrorCode.h"
 
 #include "MagicBlock/AI/Console.h"
 #include "MagicBlock/AI/CPUWarmUp.h"
@@ -57,6 +86,1603 @@ void SparseTrieBitset_test()
     visited.insert(board);
     visited.insert(board);
 
+    std::size_t count = 0;
+    for (auto iter = visited.begin(); iter != visited.end(); ++iter) {
+        assert(iter->value128() == board.value128());
+        count++;
+    }
+    assert(count == visited.size());
+    (void)count;
+
+    // Random boards, each one is yielded once by the iterator and by the split ranges
+    std::set<Value128> boards;
+    boards.insert(board.value128());
+    std::uint32_t seed = 2024;
+    for (std::size_t i = 0; i < 600; i++) {
+        for (std::size_t cell = 0; cell < 25; cell++) {
+            seed = seed * 1103515245U + 12345U;
+            board.cells[cell] = std::uint8_t(Color::First + (seed >> 16) % 6);
+        }
+        board.cells[(seed >> 8) % 25] = Color::Empty;
+        bool insert_new = visited.try_insert(board);
+        bool ref_new = boards.insert(board.value128()).second;
+        assert(insert_new == ref_new);
+        (void)insert_new;
+        (void)ref_new;
+    }
+    assert(visited.size() == boards.size());
+
+    std::set<Value128> seen;
+    for (auto iter = visited.begin(); iter != visited.end(); ++iter) {
+        assert(boards.count(iter->value128()) == 1);
+        bool is_new = seen.insert(iter->value128()).second;
+        assert(is_new);
+        (void)is_new;
+    }
+    assert(seen.size() == boards.size());
+
+    static const std::size_t split_counts[] = { 1, 2, 3, 4, 7, 16, 1000 };
+    for (std::size_t n : split_counts) {
+        std::vector<decltype(visited)::range_type> ranges;
+        std::size_t range_count = visited.split(n, ranges);
+        assert(range_count == ranges.size());
+        assert(range_count >= 1 && range_count <= n);
+        (void)range_count;
+
+        seen.clear();
+        std::size_t last = visited.full_range().first;
+        for (std::size_t r = 0; r < ranges.size(); r++) {
+            // Disjoint and in order
+            assert(!ranges[r].empty());
+            assert(ranges[r].first >= last);
+            last = ranges[r].last;
+            for (auto iter = visited.begin(ranges[r]); iter != visited.end(); ++iter) {
+                bool is_new = seen.insert(iter->value128()).second;
+                assert(is_new);
+                (void)is_new;
+            }
+        }
+        assert(last <= visited.full_range().last);
+        assert(seen == boards);
+        (void)last;
+    }
+
+    visited.shutdown();
+}
+
+// bitmap_threshold is the threshold of the layers below the root, 0 is the default
+void SparseBitset_path_test_impl(std::uint32_t bitmap_threshold)
+{
+    typedef MagicBlock::AI::SparseBitset<Board<5, 5>, 3, 25, LayerOrder::CenterFirst> bitset_type;
+    typedef bitset_type::InsertPath path_type;
+
+    struct Node {
+        Board<5, 5>     board;
+        std::size_t     empty;
+        path_type       path;
+    };
+
+    bitset_type visited, visited_ref;
+    std::vector<Node> curr, next;
+
+    bitset_type::LayerPolicy policy[5];
+    for (std::size_t layer = 0; layer < 5; layer++) {
+        policy[layer] = bitset_type::default_layer_policy(layer);
+        if (layer != 0 && bitmap_threshold != 0)
+            policy[layer].bitmapThreshold = bitmap_threshold;
+    }
+    visited.set_layer_policy(policy);
+
+    Node start;
+    std::uint32_t seed = 2024;
+    for (std::size_t i = 0; i < 25; i++) {
+        seed = seed * 1103515245U + 12345U;
+        start.board.cells[i] = std::uint8_t(Color::First + (seed >> 16) % 6);
+    }
+    start.empty = 12;
+    start.board.cells[start.empty] = Color::Empty;
+    bool start_new = visited.try_insert(start.board, start.path);
+    bool start_ref_new = visited_ref.try_insert(start.board);
+    assert(start_new && start_ref_new);
+    (void)start_new;
+    (void)start_ref_new;
+    curr.push_back(start);
+
+    // Breadth-first, the children are inserted from the path of their parent
+    static const int offsets[4][2] = { { 0, -1 }, { 0, 1 }, { -1, 0 }, { 1, 0 } };
+    for (std::size_t depth = 0; depth < 9; depth++) {
+        for (std::size_t i = 0; i < curr.size(); i++) {
+            const Node & node = curr[i];
+            std::ptrdiff_t x = std::ptrdiff_t(node.empty % 5), y = std::ptrdiff_t(node.empty / 5);
+            for (std::size_t dir = 0; dir < 4; dir++) {
+                std::ptrdiff_t nx = x + offsets[dir][0], ny = y + offsets[dir][1];
+                if (nx < 0 || nx >= 5 || ny < 0 || ny >= 5)
+                    continue;
+                std::size_t move_pos = std::size_t(ny * 5 + nx);
+                Node child;
+                child.board = node.board;
+                std::swap(child.board.cells[node.empty], child.board.cells[move_pos]);
+                child.empty = move_pos;
+                std::size_t first_layer = visited.first_changed_layer(node.empty, move_pos);
+                bool insert_new = visited.try_insert_from(child.board, node.path, first_layer, child.path);
+                bool ref_new = visited_ref.try_insert(child.board);
+                assert(insert_new == ref_new);
+                (void)ref_new;
+                if (insert_new)
+                    next.push_back(child);
+            }
+        }
+        std::swap(curr, next);
+        next.clear();
+    }
+    assert(visited.size() == visited_ref.size());
+
+    std::size_t count = 0;
+    for (auto iter = visited.begin(); iter != visited.end(); ++iter) {
+        assert(visited_ref.contains(*iter));
+        count++;
+    }
+    assert(count == visited.size());
+    (void)count;
+}
+
+void SparseBitset_path_test()
+{
+    SparseBitset_path_test_impl(0);
+    // The containers are replaced while the paths are in use
+    SparseBitset_path_test_impl(4);
+}
+
+// A random walk of the empty cell, about a third of the boards are repeats
+static void make_walk_boards(std::vector<Board<5, 5>> & boards, std::size_t count, std::uint32_t seed)
+{
+    static const int offsets[4][2] = { { 0, -1 }, { 0, 1 }, { -1, 0 }, { 1, 0 } };
+    Board<5, 5> board;
+    for (std::size_t i = 0; i < 25; i++) {
+        seed = seed * 1103515245U + 12345U;
+        board.cells[i] = std::uint8_t(Color::First + (seed >> 16) % 6);
+    }
+    std::size_t empty = 12;
+    board.cells[empty] = Color::Empty;
+
+    boards.clear();
+    boards.push_back(board);
+    while (boards.size() < count) {
+        seed = seed * 1103515245U + 12345U;
+        if (((seed >> 8) % 8) == 0) {
+            boards.push_back(boards[(seed >> 12) % boards.size()]);
+            continue;
+        }
+        std::size_t dir = (seed >> 16) % 4;
+        std::ptrdiff_t x = std::ptrdiff_t(empty % 5) + offsets[dir][0];
+        std::ptrdiff_t y = std::ptrdiff_t(empty / 5) + offsets[dir][1];
+        if (x < 0 || x >= 5 || y < 0 || y >= 5)
+            continue;
+        std::size_t move_pos = std::size_t(y * 5 + x);
+        std::swap(board.cells[empty], board.cells[move_pos]);
+        empty = move_pos;
+        boards.push_back(board);
+    }
+}
+
+template <std::size_t GroupSize>
+void SparseBitset_batch_test_impl(const std::vector<Board<5, 5>> & boards,
+                                  const std::vector<char> & expected,
+                                  std::size_t expected_size, std::size_t batch_size)
+{
+    MagicBlock::AI::SparseBitset<Board<5, 5>, 3, 25> visited;
+    std::vector<char> results(boards.size());
+    std::size_t inserted = 0;
+    for (std::size_t first = 0; first < boards.size(); first += batch_size) {
+        std::size_t count = std::min(batch_size, boards.size() - first);
+        inserted += visited.template try_insert_batch<GroupSize>(&boards[first], count,
+                                                                 (bool *)&results[first]);
+    }
+    for (std::size_t i = 0; i < boards.size(); i++) {
+        assert(results[i] == expected[i]);
+    }
+    assert(inserted == expected_size);
+    assert(visited.size() == expected_size);
+    (void)inserted;
+    visited.shutdown();
+}
+
+void SparseBitset_batch_test()
+{
+    typedef MagicBlock::AI::SparseBitset<Board<5, 5>, 3, 25> bitset_type;
+
+    std::vector<Board<5, 5>> boards;
+    make_walk_boards(boards, 3000, 2024);
+
+    // The serial try_insert() results are the reference
+    bitset_type visited_ref;
+    std::vector<char> expected(boards.size());
+    for (std::size_t i = 0; i < boards.size(); i++) {
+        expected[i] = visited_ref.try_insert(boards[i]) ? 1 : 0;
+    }
+    std::size_t expected_size = visited_ref.size();
+    assert(expected_size < boards.size());
+
+    // The batch sizes don't divide the board count, nor the group sizes
+    static const std::size_t batch_sizes[] = { 1, 7, 61, 1000, 3000 };
+    for (std::size_t batch_size : batch_sizes) {
+        SparseBitset_batch_test_impl<1>(boards, expected, expected_size, batch_size);
+        SparseBitset_batch_test_impl<3>(boards, expected, expected_size, batch_size);
+        SparseBitset_batch_test_impl<bitset_type::kDefaultGroupSize>(boards, expected, expected_size, batch_size);
+    }
+
+    // One lookup at a time, driven by try_insert_step()
+    bitset_type visited;
+    std::vector<char> results(boards.size());
+    std::size_t inserted = 0;
+    for (std::size_t i = 0; i < boards.size(); i++) {
+        bitset_type::LookupState state;
+        visited.start_lookup(state, boards.data(), i);
+        while (!visited.try_insert_step(state, (bool *)results.data(), inserted)) {
+        }
+        assert(results[i] == expected[i]);
+    }
+    assert(inserted == expected_size);
+    assert(visited.size() == expected_size);
+
+    visited.shutdown();
+    visited_ref.shutdown();
+}
+
+void SparseBitset_policy_test()
+{
+    typedef MagicBlock::AI::SparseBitset<Board<5, 5>, 3, 25> bitset_type;
+
+    // Tiny arrays, so the root, the inner and the leaf containers are all
+    // switched to bitmap while the batch lookups and the paths are in use
+    bitset_type visited;
+    bitset_type::LayerPolicy policy[5];
+    for (std::size_t layer = 0; layer < 5; layer++) {
+        policy[layer] = bitset_type::default_layer_policy(layer);
+        policy[layer].initCapacity = 1;
+        policy[layer].bitmapThreshold = 3;
+    }
+    visited.set_layer_policy(policy);
+
+    std::vector<Board<5, 5>> boards;
+    make_walk_boards(boards, 4000, 7);
+    std::set<Value128> boards_ref;
+
+    // The first half, batched
+    std::size_t half = boards.size() / 2;
+    std::vector<char> results(half);
+    for (std::size_t first = 0; first < half; first += 97) {
+        std::size_t count = std::min(std::size_t(97), half - first);
+        visited.try_insert_batch(&boards[first], count, (bool *)&results[first]);
+    }
+    for (std::size_t i = 0; i < half; i++) {
+        bool ref_new = boards_ref.insert(boards[i].value128()).second;
+        assert((results[i] != 0) == ref_new);
+        (void)ref_new;
+    }
+
+    // The second half, each one from the path of the board before it,
+    // the path is stale whenever a container has been switched since
+    bitset_type::InsertPath path, prev_path;
+    visited.try_insert(boards[half - 1], prev_path);
+    for (std::size_t i = half; i < boards.size(); i++) {
+        std::size_t first_layer = 0;
+        while (first_layer < 4 &&
+               visited.get_layer_value(boards[i], first_layer) == visited.get_layer_value(boards[i - 1], first_layer)) {
+            first_layer++;
+        }
+        bool insert_new = visited.try_insert_from(boards[i], prev_path, first_layer, path);
+        bool ref_new = boards_ref.insert(boards[i].value128()).second;
+        assert(insert_new == ref_new);
+        (void)insert_new;
+        (void)ref_new;
+        prev_path = path;
+    }
+    assert(visited.size() == boards_ref.size());
+
+    bitset_type::LayerInfo layer_info[5];
+    visited.collect_layer_info(layer_info);
+    for (std::size_t layer = 0; layer < 5; layer++) {
+        assert(layer_info[layer].bitmapCount > 0);
+    }
+
+    // The same set as the reference
+    std::set<Value128> seen;
+    for (auto iter = visited.begin(); iter != visited.end(); ++iter) {
+        assert(boards_ref.count(iter->value128()) == 1);
+        seen.insert(iter->value128());
+    }
+    assert(seen == boards_ref);
+    for (std::size_t i = 0; i < boards.size(); i++) {
+        assert(visited.contains(boards[i]));
+    }
+    std::vector<Board<5, 5>> others;
+    make_walk_boards(others, 500, 11);
+    for (std::size_t i = 0; i < others.size(); i++) {
+        assert(visited.contains(others[i]) == (boards_ref.count(others[i].value128()) != 0));
+    }
+
+    visited.shutdown();
+}
+
+template <std::size_t Order>
+void SparseBitset_order_test_impl(const std::vector<Board<5, 5>> & fw_boards,
+                                  const std::vector<Board<5, 5>> & bw_boards,
+                                  const std::set<Value128> & fw_ref,
+                                  const std::set<std::pair<Value128, Value128>> & join_ref)
+{
+    typedef MagicBlock::AI::SparseBitset<Board<5, 5>, 3, 25, Order> bitset_type;
+    typedef TwoEndpoint::Game<5, 5, 3, 3, false> game_type;
+
+    bitset_type forward, backward;
+    for (std::size_t i = 0; i < fw_boards.size(); i++) {
+        forward.try_insert(fw_boards[i]);
+    }
+    for (std::size_t i = 0; i < bw_boards.size(); i++) {
+        backward.try_insert(bw_boards[i]);
+    }
+
+    // The same set in every order
+    assert(forward.size() == fw_ref.size());
+    std::set<Value128> seen;
+    for (auto iter = forward.begin(); iter != forward.end(); ++iter) {
+        bool is_new = seen.insert(iter->value128()).second;
+        assert(is_new);
+        (void)is_new;
+    }
+    assert(seen == fw_ref);
+    for (std::size_t i = 0; i < bw_boards.size(); i++) {
+        assert(forward.contains(bw_boards[i]) == (fw_ref.count(bw_boards[i].value128()) != 0));
+        assert(backward.contains(bw_boards[i]));
+    }
+
+    // The same meeting boards in every order
+    game_type game;
+    int total = game.find_trie_intersection(forward, backward);
+    assert(total == (int)game.segment_list().size());
+    (void)total;
+    std::set<std::pair<Value128, Value128>> join;
+    for (std::size_t i = 0; i < game.segment_list().size(); i++) {
+        Board<5, 5> fw_board, bw_board;
+        forward.compose_segment_to_board(fw_board, game.segment_list()[i].fw_segments);
+        backward.compose_segment_to_board(bw_board, game.segment_list()[i].bw_segments);
+        bool is_new = join.insert(std::make_pair(fw_board.value128(), bw_board.value128())).second;
+        assert(is_new);
+        (void)is_new;
+    }
+    assert(join == join_ref);
+
+    forward.shutdown();
+    backward.shutdown();
+}
+
+void SparseBitset_order_test()
+{
+    std::vector<Board<5, 5>> fw_boards;
+    make_walk_boards(fw_boards, 1500, 2024);
+    std::set<Value128> fw_ref;
+    for (std::size_t i = 0; i < fw_boards.size(); i++) {
+        fw_ref.insert(fw_boards[i].value128());
+    }
+
+    // The backward boards: forward boards with some cells unknown, and random ones
+    std::vector<Board<5, 5>> bw_boards;
+    std::uint32_t seed = 2024;
+    for (std::size_t i = 0; i < 300; i++) {
+        seed = seed * 1103515245U + 12345U;
+        Board<5, 5> board = fw_boards[(seed >> 8) % fw_boards.size()];
+        for (std::size_t cell = 0; cell < 25; cell++) {
+            seed = seed * 1103515245U + 12345U;
+            if ((i % 3) == 2)
+                board.cells[cell] = std::uint8_t(Color::First + (seed >> 16) % 6);
+            else if (((seed >> 16) % 4) == 0 && board.cells[cell] != Color::Empty)
+                board.cells[cell] = Color::Unknown;
+        }
+        bw_boards.push_back(board);
+    }
+
+    // A forward board meets a backward board when each unknown cell is not empty
+    // and the other cells are the same
+    std::set<std::pair<Value128, Value128>> join_ref;
+    for (const Board<5, 5> & fw_board : fw_boards) {
+        for (const Board<5, 5> & bw_board : bw_boards) {
+            bool is_coincident = true;
+            for (std::size_t cell = 0; cell < 25; cell++) {
+                if (bw_board.cells[cell] == Color::Unknown) {
+                    if (fw_board.cells[cell] == Color::Empty) {
+                        is_coincident = false;
+                        break;
+                    }
+                }
+                else if (bw_board.cells[cell] != fw_board.cells[cell]) {
+                    is_coincident = false;
+                    break;
+                }
+            }
+            if (is_coincident)
+                join_ref.insert(std::make_pair(fw_board.value128(), bw_board.value128()));
+        }
+    }
+    assert(join_ref.size() > 0);
+
+    SparseBitset_order_test_impl<LayerOrder::Natural>(fw_boards, bw_boards, fw_ref, join_ref);
+    SparseBitset_order_test_impl<LayerOrder::Interleaved>(fw_boards, bw_boards, fw_ref, join_ref);
+    SparseBitset_order_test_impl<LayerOrder::CenterFirst>(fw_boards, bw_boards, fw_ref, join_ref);
+}
+
+void FrozenSparseBitset_test()
+{
+    MagicBlock::AI::SparseBitset<Board<5, 5>, 3, 25> visited;
+    Board<5, 5> board;
+    for (std::size_t i = 0; i < 25; i++) {
+        board.cells[i] = std::uint8_t(i % 6);
+    }
+    board.cells[12] = Color::Empty;
+
+    // Move the empty cell around, each board is a new one
+    std::size_t empty_pos = 12;
+    for (std::size_t i = 0; i < 200; i++) {
+        std::size_t move_pos = (empty_pos * 7 + i) % 25;
+        if (move_pos == empty_pos)
+            continue;
+        std::swap(board.cells[empty_pos], board.cells[move_pos]);
+        empty_pos = move_pos;
+        visited.insert(board);
+    }
+
+    MagicBlock::AI::FrozenSparseBitset<Board<5, 5>, 3, 25> frozen(visited);
+    assert(frozen.size() == visited.size());
+
+    std::size_t count = 0;
+    for (auto iter = frozen.begin(); iter != frozen.end(); ++iter) {
+        assert(visited.contains(*iter));
+        count++;
+    }
+    assert(count == visited.size());
+
+    for (auto iter = visited.begin(); iter != visited.end(); ++iter) {
+        assert(frozen.contains(*iter));
+    }
+
+    board.cells[0] = Color::Unknown;
+    assert(!frozen.contains(board));
+
+    // Save and map it again
+    const char * filename = "FrozenSparseBitset_test.trie";
+    int status = frozen.save(filename);
+    assert(ErrorCode::isSuccess(status));
+
+    MagicBlock::AI::FrozenSparseBitset<Board<5, 5>, 3, 25> mapped;
+    status = mapped.open(filename);
+    assert(ErrorCode::isSuccess(status));
+    assert(mapped.is_mapped());
+    assert(mapped.size() == visited.size());
+
+    count = 0;
+    for (auto iter = mapped.begin(); iter != mapped.end(); ++iter) {
+        assert(frozen.contains(*iter));
+        count++;
+    }
+    assert(count == visited.size());
+    assert(!mapped.contains(board));
+
+    MagicBlock::AI::FrozenSparseBitset<Board<5, 5>, 3, 25, LayerOrder::Natural> other_order;
+    status = other_order.open(filename);
+    assert(status == ErrorCode::FileLayoutIsMismatched);
+
+    // A file of another source is not opened
+    typedef MagicBlock::AI::FrozenSparseBitset<Board<5, 5>, 3, 25> frozen_type;
+    status = frozen.save(filename, frozen_type::Source(0x1234, 18));
+    assert(ErrorCode::isSuccess(status));
+    status = mapped.open(filename, frozen_type::Source(0x1234, 17));
+    assert(status == ErrorCode::FileSourceIsMismatched);
+    status = mapped.open(filename, frozen_type::Source(0x4321, 18));
+    assert(status == ErrorCode::FileSourceIsMismatched);
+    status = mapped.open(filename, frozen_type::Source(0x1234, 18));
+    assert(ErrorCode::isSuccess(status));
+    mapped.clear();
+
+    // The offsets of a node must go up, a broken file is not opened
+    std::vector<char> bytes;
+    FILE * fp = std::fopen(filename, "rb");
+    assert(fp != nullptr);
+    char buffer[4096];
+    std::size_t read_size;
+    while ((read_size = std::fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+        bytes.insert(bytes.end(), buffer, buffer + read_size);
+    }
+    std::fclose(fp);
+
+    frozen_type::LayerHeader layer;
+    std::memcpy(&layer, bytes.data() + sizeof(frozen_type::FileHeader) + sizeof(layer), sizeof(layer));
+    assert(layer.offset_count >= 3);
+    std::uint32_t offset;
+    std::memcpy(&offset, bytes.data() + layer.offsets_offset + sizeof(offset) * 2, sizeof(offset));
+    std::memcpy(bytes.data() + layer.offsets_offset + sizeof(offset), &offset, sizeof(offset));
+
+    fp = std::fopen(filename, "wb");
+    assert(fp != nullptr);
+    std::size_t write_size = std::fwrite(bytes.data(), 1, bytes.size(), fp);
+    assert(write_size == bytes.size());
+    std::fclose(fp);
+    (void)write_size;
+
+    status = mapped.open(filename, frozen_type::Source(0x1234, 18));
+    assert(status == ErrorCode::FileFormatIsInvalid);
+    assert(!mapped.is_mapped());
+
+    mapped.clear();
+    std::remove(filename);
+    (void)count;
+    (void)status;
+
+    visited.shutdown();
+}
+
+void SparseHashMap_test()
+{
+    typedef MagicBlock::AI::SparseHashMap<Board<5, 5>, std::uint8_t, 3, 25> hashmap_type;
+    hashmap_type cache;
+    std::map<Value128, std::uint8_t> std_map;
+
+    // Only a few cells are changed, so some leaves grow larger than the sort threshold
+    Board<5, 5> board;
+    for (std::size_t i = 0; i < 25; i++) {
+        board.cells[i] = Color::Red;
+    }
+    std::uint32_t seed = 2024;
+    for (std::size_t i = 0; i < 20000; i++) {
+        seed = seed * 1103515245U + 12345U;
+        std::size_t pos = (seed >> 8) % 25;
+        board.cells[pos] = std::uint8_t((seed >> 16) % 8);
+        std::uint8_t value = std::uint8_t(i);
+        hashmap_type::insert_return_type result = cache.try_insert(board, value);
+        bool insert_new = std_map.insert(std::make_pair(board.value128(), value)).second;
+        hashmap_type::insert_return_type again = cache.try_insert(board, value);
+        assert(result.second == insert_new);
+        assert(!again.second);
+        (void)result;
+        (void)insert_new;
+        (void)again;
+    }
+    assert(cache.size() == std_map.size());
+
+    // Every key still has the value of its first insertion
+    for (std::size_t i = 0; i < 20000; i++) {
+        seed = seed * 1103515245U + 12345U;
+        std::size_t pos = (seed >> 8) % 25;
+        board.cells[pos] = std::uint8_t((seed >> 16) % 8);
+        std::uint8_t * value = cache.find(board);
+        auto iter = std_map.find(board.value128());
+        assert((value != nullptr) == (iter != std_map.end()));
+        assert(value == nullptr || *value == iter->second);
+        assert(cache.contains(board) == (value != nullptr));
+        (void)value;
+        (void)iter;
+    }
+
+    // The iterator visits every key once with its value
+    std::size_t count = 0;
+    for (auto iter = cache.begin(); iter != cache.end(); ++iter) {
+        auto std_iter = std_map.find(iter->value128());
+        assert(std_iter != std_map.end());
+        assert(iter.value() == std_iter->second);
+        (void)std_iter;
+        count++;
+    }
+    assert(count == std_map.size());
+    (void)count;
+
+    hashmap_type other;
+    other.swap(cache);
+    assert(cache.size() == 0);
+    assert(cache.begin() == cache.end());
+    assert(other.size() == std_map.size());
+    other.clear();
+    assert(other.size() == 0);
+    assert(other.begin() == other.end());
+    hashmap_type::insert_return_type result = other.insert(board, std::uint8_t(1));
+    assert(result.second);
+    assert(other.begin() != other.end() && *other.begin() == board);
+    (void)result;
+
+    other.destroy();
+    cache.destroy();
+}
+
+void FrozenSparseHashMap_test()
+{
+    typedef MagicBlock::AI::SparseHashMap<Board<5, 5>, std::uint8_t, 3, 25>        hashmap_type;
+    typedef MagicBlock::AI::FrozenSparseHashMap<Board<5, 5>, std::uint8_t, 3, 25>  frozen_type;
+    hashmap_type cache;
+    std::map<Value128, std::uint8_t> std_map;
+
+    // The same boards as SparseHashMap_test(), the ids of some leaves are sorted
+    Board<5, 5> board;
+    for (std::size_t i = 0; i < 25; i++) {
+        board.cells[i] = Color::Red;
+    }
+    std::uint32_t seed = 2024;
+    for (std::size_t i = 0; i < 20000; i++) {
+        seed = seed * 1103515245U + 12345U;
+        std::size_t pos = (seed >> 8) % 25;
+        board.cells[pos] = std::uint8_t((seed >> 16) % 8);
+        std::uint8_t value = std::uint8_t(i);
+        cache.try_insert(board, value);
+        std_map.insert(std::make_pair(board.value128(), value));
+    }
+
+    frozen_type frozen(cache);
+    assert(frozen.size() == std_map.size());
+
+    // Every key has its value, the iterator yields each key once
+    std::size_t count = 0;
+    for (auto iter = frozen.begin(); iter != frozen.end(); ++iter) {
+        auto found = std_map.find(iter->value128());
+        assert(found != std_map.end());
+        assert(frozen.value(iter) == found->second);
+        const std::uint8_t * value = frozen.find(*iter);
+        assert(value != nullptr && *value == found->second);
+        count++;
+        (void)found;
+        (void)value;
+    }
+    assert(count == std_map.size());
+
+    // Save and map it again
+    const char * filename = "FrozenSparseHashMap_test.trie";
+    int status = frozen.save(filename);
+    assert(ErrorCode::isSuccess(status));
+
+    frozen_type mapped;
+    status = mapped.open(filename);
+    assert(ErrorCode::isSuccess(status));
+    assert(mapped.is_mapped());
+    assert(mapped.size() == std_map.size());
+
+    count = 0;
+    for (auto iter = mapped.begin(); iter != mapped.end(); ++iter) {
+        const std::uint8_t * value = frozen.find(*iter);
+        assert(value != nullptr && *value == mapped.value(iter));
+        assert(mapped.find(*iter) == &mapped.value(iter));
+        count++;
+        (void)value;
+    }
+    assert(count == std_map.size());
+
+    board.cells[0] = Color::Unknown;
+    assert(mapped.find(board) == nullptr);
+
+    // The size of the values is a part of the layout
+    MagicBlock::AI::FrozenSparseBitset<Board<5, 5>, 3, 25> bitset;
+    status = bitset.open(filename);
+    assert(status == ErrorCode::FileLayoutIsMismatched);
+
+    MagicBlock::AI::FrozenSparseHashMap<Board<5, 5>, std::uint16_t, 3, 25> other_value;
+    status = other_value.open(filename);
+    assert(status == ErrorCode::FileLayoutIsMismatched);
+
+    mapped.clear();
+    std::remove(filename);
+    (void)count;
+    (void)status;
+
+    cache.destroy();
+}
+
+void CellPack_test()
+{
+    using MagicBlock::AI::CellPack;
+
+    std::uint8_t cells[32];
+    std::uint32_t seed = 2024;
+    for (std::size_t i = 0; i < 2000; i++) {
+        for (std::size_t pos = 0; pos < 32; pos++) {
+            seed = seed * 1103515245U + 12345U;
+            cells[pos] = std::uint8_t((seed >> 16) % 8);
+        }
+        std::size_t count = i % 30;
+        std::uint8_t empty_color = std::uint8_t(i % 8);
+
+        std::uint64_t value = 0, compact = 0;
+        for (std::ptrdiff_t pos = std::ptrdiff_t(count) - 1; pos >= 0; pos--) {
+            value = (value << 3) | cells[pos];
+            if (cells[pos] != empty_color)
+                compact = (compact << 3) | cells[pos];
+        }
+        assert(CellPack::pack(cells, count) == value);
+        assert(CellPack::pack_compact(cells, count, empty_color) == compact);
+
+        std::uint64_t low = 0, high = 0, low128, high128;
+        for (std::ptrdiff_t pos = std::ptrdiff_t(count) - 1; pos >= 0; pos--) {
+            high = (high << 3) | (low >> 61);
+            low = (low << 3) | cells[pos];
+        }
+        CellPack::pack128(cells, count, low128, high128);
+        assert(low128 == low && high128 == high);
+        (void)low128;
+        (void)high128;
+
+        if (count <= 21) {
+            std::uint8_t unpacked[32];
+            std::memset(unpacked, 0xFF, sizeof(unpacked));
+            CellPack::unpack(unpacked, count, value);
+            assert(std::memcmp(unpacked, cells, count) == 0);
+            assert(unpacked[count] == 0xFF);
+        }
+
+        // The scalar kernels, and the BMI2 kernels when they are compiled in
+        assert(CellPack::pack_scalar(cells, count) == value);
+        assert(CellPack::pack_compact_scalar(cells, count, empty_color) == compact);
+        CellPack::pack128_scalar(cells, count, low128, high128);
+        assert(low128 == low && high128 == high);
+#if MBG_CELL_PACK_BMI2
+        assert(CellPack::pack_bmi2(cells, count) == CellPack::pack_scalar(cells, count));
+        assert(CellPack::pack_compact_bmi2(cells, count, empty_color) ==
+               CellPack::pack_compact_scalar(cells, count, empty_color));
+        std::uint64_t low_bmi2, high_bmi2;
+        CellPack::pack128_bmi2(cells, count, low_bmi2, high_bmi2);
+        assert(low_bmi2 == low128 && high_bmi2 == high128);
+        (void)low_bmi2;
+        (void)high_bmi2;
+#endif
+        if (count <= 21) {
+            std::uint8_t unpacked[32], unpacked_scalar[32];
+            std::memset(unpacked, 0xFF, sizeof(unpacked));
+            std::memset(unpacked_scalar, 0xFF, sizeof(unpacked_scalar));
+            CellPack::unpack_scalar(unpacked_scalar, count, value);
+            assert(std::memcmp(unpacked_scalar, cells, count) == 0);
+            assert(unpacked_scalar[count] == 0xFF);
+#if MBG_CELL_PACK_BMI2
+            CellPack::unpack_bmi2(unpacked, count, value);
+            assert(std::memcmp(unpacked, unpacked_scalar, count + 1) == 0);
+#endif
+            (void)unpacked;
+        }
+        (void)value;
+        (void)compact;
+    }
+}
+
+void Value128_update_test()
+{
+    // Random colors, so the cells can be swapped with any other cell, including cell 21
+    Board<5, 5> board;
+    std::uint32_t seed = 2024;
+    for (std::size_t i = 0; i < 25; i++) {
+        seed = seed * 1103515245U + 12345U;
+        board.cells[i] = std::uint8_t((seed >> 16) % 8);
+    }
+    Value128 value = board.value128();
+    for (std::size_t i = 0; i < 20000; i++) {
+        seed = seed * 1103515245U + 12345U;
+        std::size_t pos1 = (seed >> 8) % 25;
+        std::size_t pos2 = (i % 4 == 0) ? 21 : ((seed >> 16) % 25);
+        board.swap_cells(pos1, pos2, value);
+        assert(value == board.value128());
+    }
+    (void)value;
+}
+
+template <std::size_t BoardX, std::size_t BoardY>
+void PackedKey_test_impl()
+{
+    typedef Board<BoardX, BoardY>               board_type;
+    typedef typename board_type::key_type       key_type;
+    static const std::size_t BoardSize = BoardX * BoardY;
+
+    // Random colors, the cells 21 and 42 are split across two words
+    board_type board;
+    std::uint32_t seed = 2024;
+    for (std::size_t i = 0; i < BoardSize; i++) {
+        seed = seed * 1103515245U + 12345U;
+        board.cells[i] = std::uint8_t((seed >> 16) % 8);
+    }
+    key_type key = board.key();
+    for (std::size_t i = 0; i < 20000; i++) {
+        seed = seed * 1103515245U + 12345U;
+        std::size_t pos1 = (seed >> 8) % BoardSize;
+        std::size_t pos2 = (i % 4 == 0) ? ((i % 8 == 0) ? 21 : 42) : ((seed >> 16) % BoardSize);
+        board.swap_cells(pos1, pos2, key);
+        assert(key == board.key());
+        assert(key.hash() == board.key().hash());
+    }
+    for (std::size_t pos = 0; pos < BoardSize; pos++) {
+        assert(key.get_cell(pos) == board.cells[pos]);
+    }
+
+    // The last cell is the highest one
+    board_type larger(board);
+    board.cells[BoardSize - 1] = 0;
+    larger.cells[BoardSize - 1] = 1;
+    assert(board.key() < larger.key());
+    assert(larger.key() > board.key());
+    assert(board.key() != larger.key());
+    assert(board.key().compare(board.key()) == 0);
+    (void)key;
+}
+
+void PackedKey_test()
+{
+    PackedKey_test_impl<8, 8>();
+    PackedKey_test_impl<7, 7>();
+
+    // The 7x7 boards use the 21-bit trie rows and the 32-bit ids
+    typedef MagicBlock::AI::SparseBitset<Board<7, 7>, 3, 49> bitset_type;
+    typedef Board<7, 7>::key_type key_type;
+    static_assert((sizeof(bitset_type::ident_type) == sizeof(std::uint32_t)),
+                  "PackedKey_test(): The ident_type must be 32 bits.");
+
+    bitset_type visited;
+    std::set<key_type> boards;
+    Board<7, 7> board;
+    std::uint32_t seed = 2024;
+    for (std::size_t i = 0; i < 3000; i++) {
+        for (std::size_t pos = 0; pos < 49; pos++) {
+            seed = seed * 1103515245U + 12345U;
+            // A few colors in the first row, so that the root has shared rows
+            board.cells[pos] = std::uint8_t((seed >> 16) % ((pos < 7) ? 2 : 7));
+        }
+        bool insert_new = visited.try_insert(board);
+        bool ref_new = boards.insert(board.key()).second;
+        assert(insert_new == ref_new);
+        assert(visited.contains(board));
+        (void)insert_new;
+        (void)ref_new;
+    }
+    assert(visited.size() == boards.size());
+
+    std::size_t count = 0;
+    for (auto iter = visited.begin(); iter != visited.end(); ++iter) {
+        assert(boards.count(iter->key()) == 1);
+        count++;
+    }
+    assert(count == boards.size());
+
+    MagicBlock::AI::FrozenSparseBitset<Board<7, 7>, 3, 49> frozen(visited);
+    assert(frozen.size() == visited.size());
+    for (auto iter = visited.begin(); iter != visited.end(); ++iter) {
+        assert(frozen.contains(*iter));
+    }
+    (void)count;
+
+    visited.shutdown();
+}
+
+template <std::size_t BoardX, std::size_t BoardY>
+void PackedBoard_test_impl()
+{
+    typedef MagicBlock::AI::PackedBoard<BoardX, BoardY> packed_board_t;
+    static const std::size_t BoardSize = BoardX * BoardY;
+
+    Board<BoardX, BoardY> board;
+    std::uint32_t seed = 2024;
+    for (std::size_t i = 0; i < BoardSize; i++) {
+        seed = seed * 1103515245U + 12345U;
+        board.cells[i] = std::uint8_t((seed >> 16) % 8);
+    }
+    packed_board_t packed(board);
+    Value128 value = board.value128();
+    for (std::size_t i = 0; i < 5000; i++) {
+        seed = seed * 1103515245U + 12345U;
+        std::size_t pos1 = (seed >> 8) % BoardSize;
+        std::size_t pos2 = (seed >> 16) % BoardSize;
+        if (i % 3 == 0) {
+            std::uint8_t color = std::uint8_t((seed >> 24) % 8);
+            board.cells[pos1] = color;
+            packed.set(pos1, color);
+            value = board.value128();
+        }
+        else {
+            std::swap(board.cells[pos1], board.cells[pos2]);
+            packed.swap_cells(pos1, pos2, value);
+        }
+        assert(packed.value128() == board.value128());
+        assert(value == board.value128());
+        assert(packed.value() == board.value());
+        assert(packed.get(pos1) == board.cells[pos1]);
+        assert(packed.to_board() == board);
+        for (std::size_t y = 0; y < BoardY; y++) {
+            assert(packed.row(y) == std::uint32_t(CellPack::pack(&board.cells[y * BoardX], BoardX)));
+        }
+    }
+
+    // Only the cells in the region are compared
+    packed_board_t mask = packed_board_t::region_mask(1, 1, BoardX - 2, BoardY - 2);
+    packed_board_t other(packed);
+    other.set(0, (other.get(0) + 1) % 8);
+    other.set(BoardSize - 1, (other.get(BoardSize - 1) + 1) % 8);
+    assert(other != packed);
+    assert(other.is_equal(packed, mask));
+    other.set(BoardX + 1, (other.get(BoardX + 1) + 1) % 8);
+    assert(!other.is_equal(packed, mask));
+    (void)mask;
+    (void)other;
+}
+
+void PackedBoard_test()
+{
+    PackedBoard_test_impl<3, 3>();
+    PackedBoard_test_impl<5, 3>();
+    PackedBoard_test_impl<5, 5>();
+    PackedBoard_test_impl<6, 6>();
+}
+
+template <std::size_t BoardX, std::size_t BoardY>
+void MoveTable_test_impl()
+{
+    typedef MagicBlock::AI::MoveTable<BoardX, BoardY> move_table_t;
+    typedef MagicBlock::AI::CanMoves<BoardX, BoardY>  can_moves_t;
+    static const std::size_t BoardSize = BoardX * BoardY;
+
+    // The entries are constant expressions
+    static_assert((move_table_t::get(0, Dir::Down).valid == 1), "MoveTable: wrong entry");
+    static_assert((move_table_t::get(0, Dir::Down).pos == BoardX), "MoveTable: wrong entry");
+    static_assert((move_table_t::get(0, Dir::Down).dir == Dir::Up), "MoveTable: wrong entry");
+    static_assert((move_table_t::get(0, Dir::Left).valid == 0), "MoveTable: wrong entry");
+    static_assert((move_table_t::get(BoardSize - 1, Dir::Left).move_shift == (BoardSize - 2) * 3),
+                  "MoveTable: wrong entry");
+
+    can_moves_t & can_moves = can_moves_t::getInstance();
+
+    for (std::size_t pos = 0; pos < BoardSize; pos++) {
+        const MoveEntry * moves = move_table_t::moves(pos);
+        std::size_t count = 0;
+        for (std::size_t n = 0; n < Dir::Maximum; n++) {
+            const MoveEntry & move = moves[n];
+            if (move.valid == 0)
+                continue;
+            assert(count < can_moves[pos].size());
+            assert(move.pos == std::uint8_t(can_moves[pos][count].pos));
+            assert(move.dir == can_moves[pos][count].dir);
+            assert(move.opp_dir == Dir::opp_dir(move.dir));
+            assert(move.first_row <= move.last_row);
+            assert(move.first_row == std::min(pos / BoardX, std::size_t(move.pos) / BoardX));
+            assert(move.last_row == std::max(pos / BoardX, std::size_t(move.pos) / BoardX));
+            assert(move.empty_shift == pos * 3);
+            assert(move.move_shift == std::size_t(move.pos) * 3);
+            count++;
+        }
+        assert(count == can_moves[pos].size());
+        (void)count;
+    }
+}
+
+void MoveTable_test()
+{
+    MoveTable_test_impl<3, 3>();
+    MoveTable_test_impl<5, 3>();
+    MoveTable_test_impl<5, 5>();
+    MoveTable_test_impl<6, 6>();
+}
+
+//
+// BFS of the 3x3 puzzle with distinct tiles (4 bits per cell), returns the parent
+// of each board that is found first, and the number of the children that were tried.
+//
+std::size_t MoveFsm_bfs_3x3(bool use_fsm, std::unordered_map<std::uint64_t, std::uint64_t> & parents)
+{
+    typedef MagicBlock::AI::MoveTable<3, 3> move_table_t;
+
+    struct Node {
+        std::uint64_t   key;
+        std::uint8_t    empty;
+        std::uint8_t    last_dir;
+        std::uint8_t    fsm_state;
+    };
+
+    const MoveFsm & move_fsm = MoveFsm::getInstance();
+    std::size_t tried = 0;
+
+    // The tile of cell i is i, the empty cell is 0
+    std::uint64_t start_key = 0;
+    for (std::uint64_t i = 0; i < 9; i++) {
+        start_key |= i << (i * 4);
+    }
+    Node start = { start_key, 0, std::uint8_t(-1), MoveFsm::kStart };
+    parents.clear();
+    parents.insert(std::make_pair(start_key, start_key));
+
+    std::vector<Node> curr, next;
+    curr.push_back(start);
+    while (curr.size() > 0) {
+        for (std::size_t i = 0; i < curr.size(); i++) {
+            const Node & node = curr[i];
+            const MoveEntry * moves = move_table_t::moves(node.empty);
+            for (std::size_t n = 0; n < Dir::Maximum; n++) {
+                if (moves[n].valid == 0)
+                    continue;
+                std::uint8_t fsm_state = 0;
+                if (use_fsm) {
+                    fsm_state = move_fsm.next(node.fsm_state, n);
+                    if (fsm_state == MoveFsm::kPruned)
+                        continue;
+                }
+                else if (moves[n].dir == node.last_dir) {
+                    continue;
+                }
+                tried++;
+
+                std::uint64_t tile = (node.key >> (moves[n].pos * 4)) & 0x0FU;
+                std::uint64_t key = node.key & ~(std::uint64_t(0x0FU) << (moves[n].pos * 4));
+                key |= tile << (node.empty * 4);
+                if (parents.insert(std::make_pair(key, node.key)).second) {
+                    Node child = { key, moves[n].pos, moves[n].opp_dir, fsm_state };
+                    next.push_back(child);
+                }
+            }
+        }
+        std::swap(curr, next);
+        next.clear();
+    }
+    return tried;
+}
+
+void MoveFsm_test()
+{
+    const MoveFsm & move_fsm = MoveFsm::getInstance();
+    assert(move_fsm.states() > 1 && move_fsm.states() <= MoveFsm::kMaxStates);
+
+    // The reverse move is always pruned
+    for (std::size_t state = 0; state < move_fsm.states(); state++) {
+        for (std::size_t n = 0; n < Dir::Maximum; n++) {
+            std::uint8_t next_state = move_fsm.next(std::uint8_t(state), n);
+            if (next_state != MoveFsm::kPruned) {
+                assert(move_fsm.next(next_state, Dir::opp_dir(std::uint8_t(n))) == MoveFsm::kPruned);
+            }
+        }
+    }
+
+    // The same boards are found from the same parents, with fewer children
+    std::unordered_map<std::uint64_t, std::uint64_t> parents, fsm_parents;
+    std::size_t tried = MoveFsm_bfs_3x3(false, parents);
+    std::size_t fsm_tried = MoveFsm_bfs_3x3(true, fsm_parents);
+    assert(parents.size() == 181440);
+    assert(fsm_parents == parents);
+    assert(fsm_tried < tried);
+    (void)tried;
+    (void)fsm_tried;
+}
+
+void BoardRank_test()
+{
+    // All the ranks of a small board
+    {
+        static const std::uint8_t cells[9] = { 0, 0, 1, 1, 2, 2, 3, 3, Color::Empty };
+        Board<3, 3> board;
+        for (std::size_t pos = 0; pos < 9; pos++) {
+            board.cells[pos] = cells[pos];
+        }
+        BoardRank<3, 3> board_rank(board);
+        assert(board_rank.is_valid());
+        assert(board_rank.total() == 22680);
+        assert(board_rank.rank(board) < board_rank.total());
+        for (std::uint64_t rank = 0; rank < board_rank.total(); rank++) {
+            Board<3, 3> unranked;
+            board_rank.unrank(rank, unranked);
+            assert(board_rank.rank(unranked) == rank);
+        }
+    }
+
+    // The random boards with and without Unknown cells, and the ranks after a move
+    {
+        typedef MoveTable<5, 5> move_table_t;
+        std::uint32_t seed = 2024;
+        for (std::size_t unknowns = 0; unknowns <= 4; unknowns += 4) {
+            Board<5, 5> board;
+            for (std::size_t pos = 0; pos < 24; pos++) {
+                board.cells[pos] = (pos < unknowns) ? std::uint8_t(Color::Unknown) : std::uint8_t(pos / 4);
+            }
+            board.cells[24] = Color::Empty;
+
+            BoardRank<5, 5> board_rank(board);
+            assert(board_rank.is_valid());
+            if (unknowns == 0)
+                assert(board_rank.total() == 81166763427750000ULL);
+
+            for (std::size_t i = 0; i < 1000; i++) {
+                for (std::size_t pos = 24; pos > 0; pos--) {
+                    seed = seed * 1103515245U + 12345U;
+                    std::swap(board.cells[pos], board.cells[(seed >> 16) % (pos + 1)]);
+                }
+                std::uint64_t rank = board_rank.rank(board);
+                Board<5, 5> unranked;
+                board_rank.unrank(rank, unranked);
+                assert(unranked == board);
+
+                std::size_t empty_pos = 0;
+                while (board.cells[empty_pos] != Color::Empty) {
+                    empty_pos++;
+                }
+                const MoveEntry * moves = move_table_t::moves(empty_pos);
+                for (std::size_t n = 0; n < Dir::Maximum; n++) {
+                    if (moves[n].valid == 0)
+                        continue;
+                    Board<5, 5> next_board(board);
+                    std::swap(next_board.cells[empty_pos], next_board.cells[moves[n].pos]);
+                    assert(board_rank.move(rank, next_board, empty_pos, moves[n].pos) ==
+                           board_rank.rank(next_board));
+                }
+            }
+        }
+    }
+
+    // Two empty cells can't be ranked
+    {
+        Board<3, 3> board;
+        for (std::size_t pos = 0; pos < 9; pos++) {
+            board.cells[pos] = (pos < 2) ? std::uint8_t(Color::Empty) : std::uint8_t(pos % 3);
+        }
+        BoardRank<3, 3> board_rank(board);
+        assert(!board_rank.is_valid());
+    }
+}
+
+void BoardSymmetry_test()
+{
+    // Random colors, every symmetry keeps a target of one color
+    {
+        Board<3, 3> targets[1];
+        for (std::size_t pos = 0; pos < 9; pos++) {
+            targets[0].cells[pos] = Color::Red;
+        }
+        BoardSymmetry<3, 3> symmetry;
+        symmetry.init(targets, 1);
+        assert(symmetry.count() == Symmetry::Maximum);
+
+        std::uint32_t seed = 2024;
+        for (std::size_t i = 0; i < 1000; i++) {
+            Board<3, 3> board;
+            for (std::size_t pos = 0; pos < 9; pos++) {
+                seed = seed * 1103515245U + 12345U;
+                board.cells[pos] = std::uint8_t((seed >> 16) % 8);
+            }
+            std::uint64_t canonical = symmetry.canonical_value(board.value());
+            for (std::size_t index = 1; index < symmetry.count(); index++) {
+                Board<3, 3> sym_board;
+                symmetry.transform(board, symmetry.type(index), sym_board);
+                assert(symmetry.transform_value(board.value(), index) == sym_board.value());
+                assert(symmetry.canonical_value(sym_board.value()) == canonical);
+            }
+            (void)canonical;
+        }
+    }
+
+    // All rotations of a target are accepted, the mirrors are not
+    {
+        static const std::uint8_t cells[9] = { 0, 1, 2, 3, 4, 5, 0, 1, Color::Empty };
+        Board<3, 3> targets[4];
+        for (std::size_t pos = 0; pos < 9; pos++) {
+            targets[0].cells[pos] = cells[pos];
+        }
+        targets[0].rotate_to_90(targets[1]);
+        targets[0].rotate_to_180(targets[2]);
+        targets[0].rotate_to_270(targets[3]);
+
+        BoardSymmetry<3, 3> symmetry;
+        symmetry.init(targets, 4);
+        assert(symmetry.count() == 4);
+        symmetry.init(targets, 1);
+        assert(!symmetry.is_enabled());
+    }
+
+    // A rectangle board has no 90 degrees symmetry, and the 5x5 boards use the keys
+    {
+        Board<5, 3> targets[1];
+        for (std::size_t pos = 0; pos < 15; pos++) {
+            targets[0].cells[pos] = Color::Unknown;
+        }
+        BoardSymmetry<5, 3> symmetry;
+        symmetry.init(targets, 1);
+        assert(symmetry.count() == 4);
+
+        Board<5, 5> targets55[1];
+        for (std::size_t pos = 0; pos < 25; pos++) {
+            targets55[0].cells[pos] = std::uint8_t(pos % 7);
+        }
+        BoardSymmetry<5, 5> symmetry55;
+        symmetry55.init(targets55, 1);
+        assert(!symmetry55.is_enabled());
+
+        for (std::size_t pos = 0; pos < 25; pos++) {
+            targets55[0].cells[pos] = Color::Unknown;
+        }
+        symmetry55.init(targets55, 1);
+        assert(symmetry55.count() == Symmetry::Maximum);
+
+        Board<5, 5> board, rotated;
+        for (std::size_t pos = 0; pos < 25; pos++) {
+            board.cells[pos] = std::uint8_t(pos % 7);
+        }
+        board.rotate_to_90(rotated);
+        std::size_t index1, index2;
+        assert(symmetry55.canonical_key(board, index1) == symmetry55.canonical_key(rotated, index2));
+        (void)index1;
+        (void)index2;
+    }
+}
+
+template <std::size_t BoardX, std::size_t BoardY>
+void FrontierSoA_test_impl()
+{
+    typedef FrontierSoA<BoardX, BoardY> frontier_type;
+    typedef typename frontier_type::Child child_type;
+    static const std::size_t BoardSize = BoardX * BoardY;
+
+    // Random parents with one empty cell, every child is the same as a scalar swap_cells()
+    frontier_type frontier;
+    std::vector<Board<BoardX, BoardY>> parents;
+    std::uint32_t seed = 2024;
+    for (std::size_t i = 0; i < 100; i++) {
+        Board<BoardX, BoardY> board;
+        for (std::size_t pos = 0; pos < BoardSize; pos++) {
+            seed = seed * 1103515245U + 12345U;
+            board.cells[pos] = std::uint8_t((seed >> 16) % 6);
+        }
+        seed = seed * 1103515245U + 12345U;
+        std::uint8_t empty_pos = std::uint8_t((seed >> 16) % BoardSize);
+        board.cells[empty_pos] = Color::Empty;
+        parents.push_back(board);
+        frontier.push_back(board, empty_pos, std::uint8_t(-1), MoveFsm::kStart);
+    }
+
+    Board<BoardX, BoardY> boards[frontier_type::kMaxChildren];
+    child_type children[frontier_type::kMaxChildren];
+    std::size_t total = 0;
+    for (std::size_t first = 0; first < frontier.size(); first += frontier_type::kGroupSize) {
+        std::size_t count = frontier.size() - first;
+        if (count > frontier_type::kGroupSize)
+            count = frontier_type::kGroupSize;
+        std::size_t children_count = frontier.expand(first, count, boards, children);
+        for (std::size_t k = 0; k < children_count; k++) {
+            const child_type & child = children[k];
+            assert(child.parent >= first && child.parent < (first + count));
+            Board<BoardX, BoardY> expected = parents[child.parent];
+            typename Board<BoardX, BoardY>::key_type value = expected.key();
+            expected.swap_cells(frontier.empty_pos(child.parent), child.move_pos, value);
+            assert(boards[k] == expected);
+            assert(child.value == value);
+            assert(child.value == boards[k].key());
+        }
+        total += children_count;
+    }
+    // Every parent has 2 ~ 4 moves, none of them is pruned from the start state
+    assert(total >= frontier.size() * 2);
+    (void)total;
+}
+
+void FrontierSoA_test()
+{
+    FrontierSoA_test_impl<3, 3>();
+    FrontierSoA_test_impl<4, 4>();
+    FrontierSoA_test_impl<5, 5>();
+    FrontierSoA_test_impl<6, 5>();
+    FrontierSoA_test_impl<6, 6>();
+}
+
+void GoalCounter_test()
+{
+    // The 4 sides of 4 random targets, the counts follow a random walk of the empty cell
+    GoalCounter<5, 5, 3, 3> counter;
+    Board<3, 3> targets[4];
+    std::uint32_t seed = 2024;
+    for (std::size_t index = 0; index < 4; index++) {
+        for (std::size_t pos = 0; pos < 9; pos++) {
+            seed = seed * 1103515245U + 12345U;
+            targets[index].cells[pos] = std::uint8_t((seed >> 16) % 3);
+        }
+        counter.add_region(targets[index], 0, 3, 0, 1);
+        counter.add_region(targets[index], 0, 1, 0, 3);
+        counter.add_region(targets[index], 2, 3, 0, 3);
+        counter.add_region(targets[index], 0, 3, 2, 3);
+    }
+    assert(counter.slots() == 16);
+
+    Board<5, 5> board;
+    for (std::size_t pos = 0; pos < 25; pos++) {
+        seed = seed * 1103515245U + 12345U;
+        board.cells[pos] = std::uint8_t((seed >> 16) % 3);
+    }
+    std::size_t empty_pos = 12;
+    board.cells[empty_pos] = Color::Empty;
+
+    GoalCounter<5, 5, 3, 3>::Summary summary, expected;
+    counter.count(board, summary);
+    std::size_t matched = 0;
+    for (std::size_t i = 0; i < 20000; i++) {
+        seed = seed * 1103515245U + 12345U;
+        const MoveEntry & entry = MoveTable<5, 5>::get(empty_pos, (seed >> 16) % 4);
+        if (entry.valid == 0)
+            continue;
+        counter.move(summary, empty_pos, entry.pos, board.cells[entry.pos]);
+        std::swap(board.cells[empty_pos], board.cells[entry.pos]);
+        empty_pos = entry.pos;
+
+        counter.count(board, expected);
+        assert(std::memcmp(summary.mismatches, expected.mismatches, sizeof(summary.mismatches)) == 0);
+
+        std::uint32_t mask = 0;
+        for (std::size_t slot = 0; slot < 16; slot++) {
+            static const std::size_t regions[4][4] = {
+                { 0, 3, 0, 1 }, { 0, 1, 0, 3 }, { 2, 3, 0, 3 }, { 0, 3, 2, 3 }
+            };
+            const Board<3, 3> & target = targets[slot / 4];
+            const std::size_t * region = regions[slot % 4];
+            bool is_matched = true;
+            for (std::size_t y = region[2]; y < region[3]; y++) {
+                for (std::size_t x = region[0]; x < region[1]; x++) {
+                    if (board.cells[(y + 1) * 5 + (x + 1)] != target.cells[y * 3 + x])
+                        is_matched = false;
+                }
+            }
+            if (is_matched)
+                mask |= std::uint32_t(1) << slot;
+        }
+        assert(counter.matched_mask(summary) == mask);
+        matched += (mask != 0) ? 1 : 0;
+    }
+    // Three colors, the sides are matched sometimes
+    assert(matched > 0);
+    (void)matched;
+}
+
+template <std::size_t BoardX, std::size_t BoardY, std::size_t TargetX, std::size_t TargetY>
+void TargetMatcher_test_impl()
+{
+    typedef TargetMatcher<BoardX, BoardY, TargetX, TargetY> matcher_type;
+    static const std::size_t kStartX = (BoardX - TargetX) / 2;
+    static const std::size_t kStartY = (BoardY - TargetY) / 2;
+
+    // Random targets and boards in 2 colors, so the sides and the targets are matched sometimes
+    Board<TargetX, TargetY> targets[4];
+    std::uint32_t seed = 2024;
+    for (std::size_t k = 0; k < 4; k++) {
+        for (std::size_t index = 0; index < TargetX * TargetY; index++) {
+            seed = seed * 1103515245U + 12345U;
+            targets[k].cells[index] = std::uint8_t((seed >> 16) % 2);
+        }
+    }
+    matcher_type matcher;
+    matcher.init(targets, 4);
+
+    std::size_t matched_sides = 0;
+    for (std::size_t i = 0; i < 5000; i++) {
+        Board<BoardX, BoardY> board;
+        for (std::size_t pos = 0; pos < BoardX * BoardY; pos++) {
+            seed = seed * 1103515245U + 12345U;
+            board.cells[pos] = std::uint8_t((seed >> 16) % 2);
+        }
+        // Copy a target into the board sometimes
+        if ((i % 7) == 0) {
+            const Board<TargetX, TargetY> & target = targets[(i / 7) % 4];
+            for (std::size_t y = 0; y < TargetY; y++) {
+                for (std::size_t x = 0; x < TargetX; x++) {
+                    board.cells[(kStartY + y) * BoardX + (kStartX + x)] = target.cells[y * TargetX + x];
+                }
+            }
+        }
+
+        std::uint32_t masks[4];
+        matcher.match(board, masks);
+        std::uint32_t satisfy_mask = 0;
+        for (std::size_t k = 0; k < 4; k++) {
+            std::uint32_t expected = 0;
+            for (std::size_t y = 0; y < TargetY; y++) {
+                for (std::size_t x = 0; x < TargetX; x++) {
+                    if (board.cells[(kStartY + y) * BoardX + (kStartX + x)] == targets[k].cells[y * TargetX + x])
+                        expected |= std::uint32_t(1) << (y * TargetX + x);
+                }
+            }
+            assert(masks[k] == expected);
+            if (expected == matcher_type::kFullBits)
+                satisfy_mask |= std::uint32_t(1) << k;
+
+            std::uint32_t sides = matcher_type::side_mask(masks[k]);
+            bool top = true, bottom = true, left = true, right = true;
+            for (std::size_t x = 0; x < TargetX; x++) {
+                top    &= ((expected >> x) & 1) != 0;
+                bottom &= ((expected >> ((TargetY - 1) * TargetX + x)) & 1) != 0;
+            }
+            for (std::size_t y = 0; y < TargetY; y++) {
+                left   &= ((expected >> (y * TargetX)) & 1) != 0;
+                right  &= ((expected >> (y * TargetX + TargetX - 1)) & 1) != 0;
+            }
+            assert(sides == ((top ? 1U : 0U) | (left ? 2U : 0U) | (right ? 4U : 0U) | (bottom ? 8U : 0U)));
+            matched_sides += (sides != 0) ? 1 : 0;
+            (void)top; (void)bottom; (void)left; (void)right;
+        }
+        assert(matcher.satisfy_mask(board) == satisfy_mask);
+        assert((i % 7) != 0 || satisfy_mask != 0);
+    }
+    assert(matched_sides > 0);
+    (void)matched_sides;
+}
+
+void TargetMatcher_test()
+{
+    TargetMatcher_test_impl<5, 5, 3, 3>();
+    TargetMatcher_test_impl<4, 4, 2, 2>();
+    TargetMatcher_test_impl<5, 4, 3, 2>();
+    TargetMatcher_test_impl<6, 6, 4, 4>();
+    TargetMatcher_test_impl<7, 7, 5, 5>();
+}
+
+void BloomFilter_test()
+{
+    MagicBlock::AI::SparseBitset<Board<5, 5>, 3, 25> visited;
+    Board<5, 5> board;
+    for (std::size_t i = 0; i < 25; i++) {
+        board.cells[i] = std::uint8_t(i % 6);
+    }
+    board.cells[12] = Color::Empty;
+    visited.insert(board);
+
+    // The filter is built from the keys already in the trie
+    visited.reserve_filter(400);
+    bool start_new = visited.try_insert_filtered(board);
+    assert(!start_new);
+    (void)start_new;
+
+    std::size_t empty_pos = 12;
+    for (std::size_t i = 0; i < 400; i++) {
+        std::size_t move_pos = (empty_pos * 7 + i) % 25;
+        if (move_pos == empty_pos)
+            continue;
+        std::swap(board.cells[empty_pos], board.cells[move_pos]);
+        empty_pos = move_pos;
+        bool insert_new = visited.try_insert_filtered(board);
+        bool filtered_again = visited.try_insert_filtered(board);
+        bool inserted_again = visited.try_insert(board);
+        assert(!filtered_again);
+        assert(!inserted_again);
+        (void)insert_new;
+        (void)filtered_again;
+        (void)inserted_again;
+    }
+
+    // No key is lost and no key is inserted twice
+    std::size_t count = 0;
+    for (auto iter = visited.begin(); iter != visited.end(); ++iter) {
+        assert(visited.filter().contains(iter->value128()));
+        count++;
+    }
+    assert(count == visited.size());
+
+    const BlockedBloomFilter::Stats & stats = visited.filter_stats();
+    assert(stats.definitelyNew + stats.falsePositive <= visited.size());
+    (void)count;
+    (void)stats;
+
+    visited.shutdown();
+}
+
+void PagedArena_test()
+{
+    PagedArena arena;
+    int status = arena.create("PagedArena_test.arena", 64 * 1024 * 1024, 8);
+    assert(ErrorCode::isSuccess(status));
+
+    MagicBlock::AI::SparseBitset<Board<5, 5>, 3, 25> visited, paged;
+    paged.attach_arena(&arena);
+
+    std::vector<Board<5, 5>> boards;
+    Board<5, 5> board;
+    for (std::size_t i = 0; i < 25; i++) {
+        board.cells[i] = std::uint8_t(i % 6);
+    }
+    board.cells[12] = Color::Empty;
+
+    std::size_t empty_pos = 12;
+    for (std::size_t i = 0; i < 2000; i++) {
+        std::size_t move_pos = (empty_pos * 7 + i) % 25;
+        if (move_pos == empty_pos)
+            continue;
+        std::swap(board.cells[empty_pos], board.cells[move_pos]);
+        empty_pos = move_pos;
+        boards.push_back(board);
+        visited.insert(board);
+    }
+
+    std::unique_ptr<bool[]> results(new bool[boards.size()]);
+    std::size_t inserted = paged.try_insert_clustered(boards.data(), boards.size(), results.get());
+    assert(inserted == visited.size());
+    assert(paged.size() == visited.size());
+    assert(arena.used_bytes() != 0);
+
+    // Drop all the pages, they are read back from the file
+    arena.evict_lru(0);
+    for (std::size_t i = 0; i < boards.size(); i++) {
+        assert(paged.contains(boards[i]));
+        bool insert_new = paged.try_insert(boards[i]);
+        assert(!insert_new);
+        (void)insert_new;
+    }
+
+    paged.destroy();
+    assert(arena.used_bytes() == 0);
+
+    // A freed large block is only reused by its own segment
+    static const std::size_t kLargeSize = PagedArena::kRegionSize * 3;
+    void * large0 = arena.allocate(0, kLargeSize);
+    assert(large0 != nullptr && arena.segment_of(large0) == 0);
+    arena.deallocate(large0);
+    void * large1 = arena.allocate(1, kLargeSize);
+    assert(large1 != nullptr && large1 != large0 && arena.segment_of(large1) == 1);
+    void * large0_again = arena.allocate(0, kLargeSize);
+    assert(large0_again == large0);
+    arena.deallocate(large1);
+    arena.deallocate(large0_again);
+    assert(arena.used_bytes() == 0);
+    (void)large1;
+    (void)status;
+    (void)inserted;
+
+    visited.shutdown();
+}
+
+void ConcurrentSparseBitset_test()
+{
+    static const std::size_t kThreads = 4;
+
+    std::vector<Board<5, 5>> boards;
+    Board<5, 5> board;
+    for (std::size_t i = 0; i < 25; i++) {
+        board.cells[i] = std::uint8_t(i % 6);
+    }
+    board.cells[12] = Color::Empty;
+
+    MagicBlock::AI::SparseBitset<Board<5, 5>, 3, 25> visited;
+    std::size_t empty_pos = 12;
+    for (std::size_t i = 0; i < 20000; i++) {
+        std::size_t move_pos = (empty_pos * 7 + i) % 25;
+        if (move_pos == empty_pos)
+            continue;
+        std::swap(board.cells[empty_pos], board.cells[move_pos]);
+        empty_pos = move_pos;
+        boards.push_back(board);
+        visited.insert(board);
+    }
+
+    // Every thread inserts all the boards, from a different start
+    MagicBlock::AI::ConcurrentSparseBitset<Board<5, 5>, 3, 25> concurrent;
+    std::atomic<std::size_t> inserted(0);
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < kThreads; t++) {
+        threads.emplace_back([&, t]() {
+            std::size_t count = boards.size();
+            std::size_t local = 0;
+            for (std::size_t i = 0; i < count; i++) {
+                if (concurrent.try_insert(boards[(i + t * count / kThreads) % count]))
+                    local++;
+            }
+            inserted += local;
+        });
+    }
+    for (std::size_t t = 0; t < kThreads; t++) {
+        threads[t].join();
+    }
+
+    // Exactly one thread has seen each key as new
+    assert(inserted == visited.size());
+    assert(concurrent.size() == visited.size());
+    for (std::size_t i = 0; i < boards.size(); i++) {
+        assert(concurrent.contains(boards[i]));
+    }
+
+    MagicBlock::AI::SparseBitset<Board<5, 5>, 3, 25> merged;
+    concurrent.detach(merged);
+    assert(merged.size() == visited.size());
+    assert(concurrent.size() == 0);
+
+    std::size_t count = 0;
+    for (auto iter = merged.begin(); iter != merged.end(); ++iter) {
+        assert(visited.contains(*iter));
+        count++;
+    }
+    assert(count == visited.size());
+    (void)count;
+
+    merged.shutdown();
     visited.shutdown();
 }
 
@@ -152,12 +1778,391 @@ void MoveSeq_test()
 #endif
 }
 
+void MoveTree_test()
+{
+    MoveTree tree;
+    std::vector<MoveTree::node_type> nodes;
+    std::vector<MoveSeq> move_seqs;
+
+    // Random prefixes, deeper than the inner MoveSeq and over several blocks
+    std::uint32_t seed = 2024;
+    for (std::size_t i = 0; i < 150000; i++) {
+        seed = seed * 1103515245U + 12345U;
+        std::size_t parent = (seed >> 8) % (nodes.size() + 1);
+        if (parent < nodes.size() && move_seqs[parent].size() >= 100)
+            parent = nodes.size();
+        std::size_t dir = (seed >> 4) % Dir::Maximum;
+
+        MoveTree::node_type parent_node = (parent < nodes.size()) ? nodes[parent] : MoveTree::kRoot;
+        MoveSeq move_seq;
+        if (parent < nodes.size())
+            move_seq = move_seqs[parent];
+        move_seq.push_back(dir);
+
+        MoveTree::node_type node = tree.append(parent_node, dir);
+        assert(node == nodes.size());
+        assert(tree.parent(node) == parent_node);
+        assert(tree.dir(node) == dir);
+        nodes.push_back(node);
+        move_seqs.push_back(move_seq);
+        (void)node;
+    }
+    assert(tree.size() == nodes.size());
+    assert(tree.block_count() == (nodes.size() + MoveTree::kBlockSize - 1) / MoveTree::kBlockSize);
+
+    for (std::size_t i = 0; i < nodes.size(); i += 7) {
+        MoveSeq move_seq;
+        tree.get_move_seq(nodes[i], move_seq);
+        assert(move_seq.size() == move_seqs[i].size());
+        assert(tree.depth(nodes[i]) == move_seqs[i].size());
+        for (std::size_t k = 0; k < move_seq.size(); k++) {
+            assert(move_seq[k] == move_seqs[i][k]);
+        }
+    }
+
+    MoveSeq empty_seq;
+    tree.get_move_seq(MoveTree::kRoot, empty_seq);
+    assert(empty_seq.empty());
+
+    // The deepest node that a MoveSeq holds, one more move throws
+    MoveTree::node_type deep_node = MoveTree::kRoot;
+    MoveSeq deep_expected;
+    for (std::size_t i = 0; i < MoveTree::kMaxDepth; i++) {
+        std::size_t dir = (i * 5 + i / 3) % Dir::Maximum;
+        deep_node = tree.append(deep_node, dir);
+        deep_expected.push_back(dir);
+    }
+    MoveSeq deep_seq;
+    tree.get_move_seq(deep_node, deep_seq);
+    assert(deep_seq.size() == deep_expected.size());
+    for (std::size_t k = 0; k < deep_seq.size(); k++) {
+        assert(deep_seq[k] == deep_expected[k]);
+    }
+
+    bool too_deep = false;
+    try {
+        tree.get_move_seq(tree.append(deep_node, Dir::Up), deep_seq);
+    }
+    catch (const std::runtime_error & ex) {
+        too_deep = true;
+        (void)ex;
+    }
+    assert(too_deep);
+    (void)too_deep;
+
+    // The blocks are kept after clear()
+    std::size_t block_count = tree.block_count();
+    tree.clear();
+    assert(tree.empty() && tree.block_count() == block_count);
+    (void)block_count;
+}
+
+void LayerRegion_test()
+{
+    LayerRegion region;
+
+    // Aligned and disjoint allocations
+    std::vector<std::pair<char *, std::size_t>> blocks;
+    std::uint32_t seed = 2024;
+    for (std::size_t i = 0; i < 2000; i++) {
+        seed = seed * 1103515245U + 12345U;
+        std::size_t size = 1 + (seed >> 8) % 20000;
+        std::size_t alignment = std::size_t(1) << ((seed >> 4) % 7);
+        char * ptr = (char *)region.allocate(size, alignment);
+        assert(((std::size_t)ptr & (alignment - 1)) == 0);
+        std::memset(ptr, int(i & 0xFF), size);
+        blocks.push_back(std::make_pair(ptr, size));
+    }
+    for (std::size_t i = 0; i < blocks.size(); i++) {
+        const char * ptr = blocks[i].first;
+        for (std::size_t k = 0; k < blocks[i].second; k += 97) {
+            assert(ptr[k] == char(i & 0xFF));
+        }
+        (void)ptr;
+    }
+    std::size_t capacity = region.capacity();
+    assert(region.used_bytes() <= capacity);
+
+    // reset() keeps the chunks, the next depth starts from the first one
+    region.reset();
+    assert(region.used_bytes() == 0 && region.capacity() == capacity);
+    void * first_block = region.allocate(64);
+    assert(first_block == (void *)blocks[0].first);
+    (void)first_block;
+
+    // A request larger than the idle chunks releases them
+    region.reset();
+    std::size_t large_size = capacity + LayerRegion::kChunkSize;
+    char * large = (char *)region.allocate(large_size);
+    std::memset(large, 0x5A, large_size);
+    assert(region.chunk_count() == 1);
+    assert(region.capacity() >= large_size);
+    (void)large;
+
+    // Two stage lists swapped between two regions, as clear_prev_depth() does
+    LayerRegion regions[2];
+    typedef std::vector<std::uint64_t, RegionAllocator<std::uint64_t>> list_type;
+    list_type curr_list((RegionAllocator<std::uint64_t>(&regions[0])));
+    list_type next_list((RegionAllocator<std::uint64_t>(&regions[1])));
+    curr_list.push_back(1);
+    for (std::size_t depth = 0; depth < 12; depth++) {
+        for (std::size_t i = 0; i < curr_list.size(); i++) {
+            next_list.push_back(curr_list[i] * 2);
+            next_list.push_back(curr_list[i] * 2 + 1);
+        }
+        std::swap(curr_list, next_list);
+        RegionAllocator<std::uint64_t> allocator = next_list.get_allocator();
+        next_list = list_type(allocator);
+        allocator.region()->reset();
+        assert(curr_list.get_allocator() != next_list.get_allocator());
+    }
+    assert(curr_list.size() == 4096);
+    for (std::size_t i = 0; i < curr_list.size(); i++) {
+        assert(curr_list[i] == 4096 + i);
+    }
+}
+
+void Value128HashSet_test()
+{
+    Value128HashSet hash_set;
+    std::set<Value128> std_set;
+    assert(hash_set.count(Value128(0, 0)) == 0);
+
+    // Random keys with repeats, the same answers as a std::set across the rehashes
+    std::vector<Value128> values;
+    std::uint32_t seed = 2024;
+    for (std::size_t i = 0; i < 20000; i++) {
+        seed = seed * 1103515245U + 12345U;
+        if ((i % 3) == 2) {
+            values.push_back(values[(seed >> 8) % values.size()]);
+            continue;
+        }
+        std::uint64_t low = seed;
+        seed = seed * 1103515245U + 12345U;
+        low = (low << 32) | seed;
+        values.push_back(Value128(low, (seed >> 8) & 0x07U));
+    }
+    for (std::size_t i = 0; i < values.size(); i++) {
+        bool is_new = hash_set.insert(values[i]).second;
+        bool std_is_new = std_set.insert(values[i]).second;
+        assert(is_new == std_is_new);
+        assert(hash_set.contains(values[i]));
+        (void)is_new;
+        (void)std_is_new;
+    }
+    assert(hash_set.size() == std_set.size());
+    assert(hash_set.size() <= hash_set.capacity() - hash_set.capacity() / 8);
+
+    // The iterator visits each key once
+    std::size_t count = 0;
+    for (auto const & value : hash_set) {
+        assert(std_set.count(value) == 1);
+        count++;
+    }
+    assert(count == std_set.size());
+    (void)count;
+
+    // clear() keeps the slots, reserve() makes room for the batch
+    std::size_t capacity = hash_set.capacity();
+    hash_set.clear();
+    assert(hash_set.size() == 0 && hash_set.capacity() == capacity);
+    assert(hash_set.count(values[0]) == 0);
+
+    Value128HashSet batch_set;
+    reserve_visited(batch_set, values.size());
+    capacity = batch_set.capacity();
+    std::vector<char> results(values.size());
+    std::size_t inserted = batch_set.insert_batch(values.data(), values.size(), (bool *)results.data());
+    assert(inserted == std_set.size() && batch_set.size() == std_set.size());
+    assert(batch_set.capacity() == capacity);
+    (void)capacity;
+    std::set<Value128> seen;
+    for (std::size_t i = 0; i < values.size(); i++) {
+        bool is_new = seen.insert(values[i]).second;
+        assert((results[i] != 0) == is_new);
+        (void)is_new;
+    }
+    (void)inserted;
+}
+
+void Phase1Solver_cache_test()
+{
+    typedef TwoPhase::IDAGame<5, 5, 3, 3, false> game_type;
+    typedef game_type::TBackwardSolver solver_type;
+    typedef solver_type::size_type size_type;
+
+    static const char * const target_rows[3] = { "RGB", "WOR", "YWR" };
+    static const char * const player_rows[5] = { "RYWOR", "WYOGB", "BGREO", "RWBYW", "YOGBG" };
+
+    game_type game;
+    for (std::size_t y = 0; y < 3; y++) {
+        for (std::size_t x = 0; x < 3; x++) {
+            game.data().target_board[0].cells[y * 3 + x] = Color::toColor(target_rows[y][x]);
+        }
+    }
+    for (std::size_t y = 0; y < 5; y++) {
+        for (std::size_t x = 0; x < 5; x++) {
+            game.data().player_board.cells[y * 5 + x] = Color::toColor(player_rows[y][x]);
+        }
+    }
+    int err_code = game.verify_board();
+    assert(ErrorCode::isSuccess(err_code));
+    (void)err_code;
+
+    static const size_type kMaxDepth = 6;
+    solver_type solver(&game.data());
+    solver.bitset_prepare(kMaxDepth);
+
+    // The start boards, one unknown cell of a prototype is the empty cell
+    std::vector<Board<5, 5>> start_boards;
+    std::set<Value128> start_values;
+    for (size_type j = 0; j < solver_type::kMaxPhase1Type; j++) {
+        const Board<5, 5> & prototype = solver.getPhase1PlayerBoard(0, j);
+        for (std::size_t pos = 0; pos < 25; pos++) {
+            if (prototype.cells[pos] == Color::Unknown) {
+                Board<5, 5> board = prototype;
+                board.cells[pos] = Color::Empty;
+                start_boards.push_back(board);
+                start_values.insert(board.value128());
+            }
+        }
+    }
+
+    // Random walks from the start boards, the moves of each board are rebuilt
+    // from the one-byte cache values and replayed from a start board
+    std::vector<Board<5, 5>> walk_boards;
+    std::uint32_t seed = 2024;
+    for (std::size_t i = 0; i < 500; i++) {
+        seed = seed * 1103515245U + 12345U;
+        Board<5, 5> board = start_boards[(seed >> 8) % start_boards.size()];
+        Position empty_pos;
+        for (std::size_t pos = 0; pos < 25; pos++) {
+            if (board.cells[pos] == Color::Empty)
+                empty_pos = std::uint8_t(pos);
+        }
+        size_type steps = i % (kMaxDepth + 1);
+        for (size_type step = 0; step < steps; step++) {
+            seed = seed * 1103515245U + 12345U;
+            std::uint8_t move_pos = Dir::template getMovePos<5, 5>(std::uint8_t((seed >> 16) % 4), empty_pos);
+            if (move_pos == std::uint8_t(-1))
+                continue;
+            std::swap(board.cells[empty_pos], board.cells[move_pos]);
+            empty_pos = move_pos;
+        }
+
+        walk_boards.push_back(board);
+
+        const solver_type::cache_value_t * value = solver.phase1_cache().find(board);
+        assert(value != nullptr);
+        MoveSeq move_seq;
+        bool found = solver.get_cache_move_seq(board, move_seq);
+        assert(found);
+        (void)found;
+        assert(move_seq.size() == solver_type::get_cache_depth(*value));
+        assert(move_seq.size() <= steps);
+
+        // Undo the moves, it must be a start board
+        Board<5, 5> start = board;
+        Position pos = empty_pos;
+        for (std::size_t n = move_seq.size(); n > 0; n--) {
+            std::uint8_t prev_pos = Dir::template getMovePos<5, 5>(Dir::opp_dir(std::uint8_t(move_seq[n - 1])), pos);
+            assert(prev_pos != std::uint8_t(-1));
+            std::swap(start.cells[pos], start.cells[prev_pos]);
+            pos = prev_pos;
+        }
+        assert(start_values.count(start.value128()) == 1);
+
+        // Replay the moves from the start board
+        for (std::size_t n = 0; n < move_seq.size(); n++) {
+            std::uint8_t move_pos = Dir::template getMovePos<5, 5>(std::uint8_t(move_seq[n]), pos);
+            assert(move_pos != std::uint8_t(-1));
+            std::swap(start.cells[pos], start.cells[move_pos]);
+            pos = move_pos;
+            value = solver.phase1_cache().find(start);
+            assert(value != nullptr && solver_type::get_cache_depth(*value) == n + 1);
+        }
+        assert(start.value128() == board.value128());
+        (void)value;
+    }
+
+    // A board that isn't in the cache
+    Board<5, 5> other = start_boards[0];
+    for (std::size_t pos = 0; pos < 25; pos++) {
+        if (other.cells[pos] == Color::Unknown)
+            other.cells[pos] = Color::Red;
+    }
+    MoveSeq move_seq;
+    bool other_found = solver.get_cache_move_seq(other, move_seq);
+    assert(!other_found);
+    (void)other_found;
+
+    // Save the cache and map it into another solver, the move sequences are the same
+    const char * filename = "Phase1Solver_cache_test.trie";
+    int status = solver.save_cache(filename);
+    assert(ErrorCode::isSuccess(status));
+    {
+        solver_type mapped_solver(&game.data());
+        // The file is made for kMaxDepth, another depth is not opened
+        status = mapped_solver.open_cache(filename, kMaxDepth - 1);
+        assert(status == ErrorCode::FileSourceIsMismatched);
+        status = mapped_solver.open_cache(filename, kMaxDepth);
+        assert(ErrorCode::isSuccess(status));
+        mapped_solver.bitset_prepare(kMaxDepth);
+        assert(mapped_solver.phase1_cache().size() == 0);
+        assert(mapped_solver.frozen_cache().size() == solver.phase1_cache().size());
+
+        for (std::size_t i = 0; i < walk_boards.size(); i++) {
+            MoveSeq expected, mapped_seq;
+            bool found = solver.get_cache_move_seq(walk_boards[i], expected);
+            bool mapped_found = mapped_solver.get_cache_move_seq(walk_boards[i], mapped_seq);
+            assert(found && mapped_found);
+            assert(mapped_seq.size() == expected.size());
+            for (std::size_t n = 0; n < expected.size(); n++) {
+                assert(mapped_seq[n] == expected[n]);
+            }
+            (void)found;
+            (void)mapped_found;
+        }
+        other_found = mapped_solver.get_cache_move_seq(other, move_seq);
+        assert(!other_found);
+    }
+    std::remove(filename);
+    (void)status;
+}
+
 void find_uint16_test()
 {
     std::uint16_t indexs[128];
     std::fill_n(indexs, 128, 0x1235);
     indexs[100] = 0x1234;
     int index = Algorithm::find_uint16_sse2(indexs, 128, 0x1234);
+    assert(index == 100);
+    (void)index;
+};
+
+void find_uint32_test()
+{
+    std::uint32_t indexs[131];
+    for (std::size_t i = 0; i < 131; i++) {
+        indexs[i] = std::uint32_t(i * 0x10001U);
+    }
+    for (std::size_t i = 0; i < 131; i++) {
+        assert(Algorithm::find_uint32_sse2(indexs, 0, 131, indexs[i]) == int(i));
+        assert(Algorithm::find_uint32_avx2(indexs, 0, 131, indexs[i]) == int(i));
+        assert(Algorithm::binary_search(indexs, 0, 131, indexs[i]) == int(i));
+    }
+    assert(Algorithm::find_uint32_avx2(indexs, 0, 131, 0x12345U) == -1);
+    assert(Algorithm::find_uint32_avx2(indexs, 5, 131, indexs[3]) == -1);
+
+    std::uint32_t seed = 2024;
+    for (std::size_t i = 131; i > 1; i--) {
+        seed = seed * 1103515245U + 12345U;
+        std::swap(indexs[i - 1], indexs[(seed >> 16) % i]);
+    }
+    Algorithm::quick_sort(indexs, 0, 130);
+    for (std::size_t i = 0; i < 131; i++) {
+        assert(indexs[i] == std::uint32_t(i * 0x10001U));
+    }
 };
 
 void jm_mallc_SizeClass_test()
@@ -204,7 +2209,33 @@ void jm_mallc_test()
 void UnitTest()
 {
     SparseTrieBitset_test();
+    SparseBitset_path_test();
+    SparseBitset_batch_test();
+    SparseBitset_policy_test();
+    SparseBitset_order_test();
+    FrozenSparseBitset_test();
+    SparseHashMap_test();
+    FrozenSparseHashMap_test();
+    CellPack_test();
+    Value128_update_test();
+    PackedBoard_test();
+    PackedKey_test();
+    MoveTable_test();
+    MoveFsm_test();
+    BoardRank_test();
+    BoardSymmetry_test();
+    FrontierSoA_test();
+    GoalCounter_test();
+    TargetMatcher_test();
+    BloomFilter_test();
+    PagedArena_test();
+    ConcurrentSparseBitset_test();
     //MoveSeq_test();
+    MoveTree_test();
+    LayerRegion_test();
+    Value128HashSet_test();
+    Phase1Solver_cache_test();
     find_uint16_test();
+    find_uint32_test();
     jm_mallc_test();
 }
@@ -0,0 +1,389 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>      // For std::memset()
+#include <new>          // For std::bad_alloc
+#include <set>
+#include <utility>      // For std::pair<F, S>
+#include <iterator>     // For std::forward_iterator_tag
+
+#include "MagicBlock/AI/Config.h"
+
+#if MBG_USE_SSE2 || MBG_USE_AVX2
+#include <emmintrin.h>  // For SSE2
+#include <xmmintrin.h>  // For _mm_prefetch()
+#endif
+
+#include "MagicBlock/AI/Value128.h"
+#include "MagicBlock/AI/support/RT_PowerOf2.h"
+
+namespace MagicBlock {
+namespace AI {
+
+//
+// An open-addressing hash set of Value128, a visited set for the stdset_solve() paths.
+//
+// The slots are probed in groups of 16 with one control byte per slot (Swiss
+// table style): the control byte is kEmpty or the low 7 bits of the hash, so
+// a group is matched with one SSE2 compare and most of the mismatched keys are
+// never touched. The high bits of the hash pick the first group, the next
+// groups are probed by triangular steps. There is no erase(), so no tombstone.
+//
+class Value128HashSet {
+public:
+    typedef std::size_t     size_type;
+    typedef Value128        value_type;
+    typedef Value128        key_type;
+
+    static const size_type kGroupWidth = 16;
+    static const std::int8_t kEmpty = -128;
+
+    // Prefetch the groups of a batched insert this far ahead
+    static const size_type kPrefetchDistance = 8;
+
+    class const_iterator {
+    public:
+        typedef std::forward_iterator_tag   iterator_category;
+        typedef Value128                    value_type;
+        typedef std::ptrdiff_t              difference_type;
+        typedef const Value128 *            pointer;
+        typedef const Value128 &            reference;
+
+    private:
+        const Value128HashSet * set_;
+        size_type               index_;
+
+        void skip_empty() {
+            while (this->index_ < this->set_->capacity_ &&
+                   this->set_->ctrl_[this->index_] == kEmpty) {
+                this->index_++;
+            }
+        }
+
+    public:
+        const_iterator(const Value128HashSet * set, size_type index) : set_(set), index_(index) {
+            this->skip_empty();
+        }
+
+        size_type index() const { return this->index_; }
+
+        reference operator * () const {
+            return this->set_->slots_[this->index_];
+        }
+
+        pointer operator -> () const {
+            return &this->set_->slots_[this->index_];
+        }
+
+        const_iterator & operator ++ () {
+            this->index_++;
+            this->skip_empty();
+            return *this;
+        }
+
+        const_iterator operator ++ (int) {
+            const_iterator tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        bool operator == (const const_iterator & rhs) const {
+            return (this->index_ == rhs.index_);
+        }
+
+        bool operator != (const const_iterator & rhs) const {
+            return (this->index_ != rhs.index_);
+        }
+    };
+
+    typedef const_iterator  iterator;
+
+private:
+    std::int8_t *   ctrl_;
+    Value128 *      slots_;
+    size_type       size_;
+    size_type       capacity_;
+    size_type       group_mask_;
+    size_type       growth_left_;
+
+    // The full 128 bits go through two multiply-xorshift rounds, the low and
+    // the high cells of a board both move the group index and the control byte.
+    static std::uint64_t hash(const Value128 & value) {
+        std::uint64_t h = value.low ^ (value.high * 0x9E3779B97F4A7C15ULL);
+        h ^= h >> 32;
+        h *= 0xD6E8FEB86659FD93ULL;
+        h ^= h >> 32;
+        h *= 0xD6E8FEB86659FD93ULL;
+        h ^= h >> 32;
+        return h;
+    }
+
+    static std::int8_t hash_ctrl(std::uint64_t hash) {
+        return std::int8_t(hash & 0x7F);
+    }
+
+    size_type hash_group(std::uint64_t hash) const {
+        return (size_type(hash >> 7) & this->group_mask_);
+    }
+
+    // Bit i is set when ctrl[i] == value.
+    static std::uint32_t match_group(const std::int8_t * ctrl, std::int8_t value) {
+#if MBG_USE_SSE2 || MBG_USE_AVX2
+        __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+        return (std::uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(char(value))));
+#else
+        std::uint32_t mask = 0;
+        for (size_type i = 0; i < kGroupWidth; i++) {
+            if (ctrl[i] == value)
+                mask |= std::uint32_t(1) << i;
+        }
+        return mask;
+#endif
+    }
+
+    static size_type max_load(size_type capacity) {
+        return (capacity - capacity / 8);
+    }
+
+    static size_type capacity_for(size_type count) {
+        size_type capacity = kGroupWidth;
+        while (max_load(capacity) < count) {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+
+    void allocate(size_type capacity) {
+        assert(capacity >= kGroupWidth && (capacity & (capacity - 1)) == 0);
+        this->ctrl_ = (std::int8_t *)std::malloc(capacity);
+        this->slots_ = (Value128 *)std::malloc(capacity * sizeof(Value128));
+        if (this->ctrl_ == nullptr || this->slots_ == nullptr) {
+            std::free(this->ctrl_);
+            std::free(this->slots_);
+            throw std::bad_alloc();
+        }
+        std::memset((void *)this->ctrl_, kEmpty, capacity);
+        this->capacity_ = capacity;
+        this->group_mask_ = capacity / kGroupWidth - 1;
+        this->growth_left_ = max_load(capacity) - this->size_;
+    }
+
+    void rehash(size_type new_capacity) {
+        std::int8_t * old_ctrl = this->ctrl_;
+        Value128 *    old_slots = this->slots_;
+        size_type     old_capacity = this->capacity_;
+
+        this->allocate(new_capacity);
+        for (size_type i = 0; i < old_capacity; i++) {
+            if (old_ctrl[i] != kEmpty) {
+                std::uint64_t h = hash(old_slots[i]);
+                size_type index = this->find_empty(h);
+                this->ctrl_[index] = hash_ctrl(h);
+                std::memcpy((void *)&this->slots_[index], (const void *)&old_slots[i], sizeof(Value128));
+            }
+        }
+        std::free(old_ctrl);
+        std::free(old_slots);
+    }
+
+    size_type find_empty(std::uint64_t h) const {
+        size_type group = this->hash_group(h);
+        size_type step = 0;
+        for (;;) {
+            const std::int8_t * ctrl = this->ctrl_ + group * kGroupWidth;
+            std::uint32_t empty_mask = match_group(ctrl, kEmpty);
+            if (empty_mask != 0) {
+                return (group * kGroupWidth + jstd::run_time::BitScanForward_nonzero(empty_mask));
+            }
+            step++;
+            group = (group + step) & this->group_mask_;
+        }
+    }
+
+    //
+    // Return the slot of value, or the empty slot to insert it into.
+    // There is always an empty slot, the load factor is at most 7/8.
+    //
+    size_type find_slot(const Value128 & value, std::uint64_t h, bool & found) const {
+        std::int8_t h2 = hash_ctrl(h);
+        size_type group = this->hash_group(h);
+        size_type step = 0;
+        for (;;) {
+            const std::int8_t * ctrl = this->ctrl_ + group * kGroupWidth;
+            std::uint32_t mask = match_group(ctrl, h2);
+            while (mask != 0) {
+                size_type index = group * kGroupWidth + jstd::run_time::BitScanForward_nonzero(mask);
+                if (this->slots_[index].is_equal(value)) {
+                    found = true;
+                    return index;
+                }
+                mask &= mask - 1;
+            }
+            std::uint32_t empty_mask = match_group(ctrl, kEmpty);
+            if (empty_mask != 0) {
+                found = false;
+                return (group * kGroupWidth + jstd::run_time::BitScanForward_nonzero(empty_mask));
+            }
+            step++;
+            group = (group + step) & this->group_mask_;
+        }
+    }
+
+    std::pair<iterator, bool> insert_hashed(const Value128 & value, std::uint64_t h) {
+        if (this->growth_left_ == 0) {
+            this->rehash((this->capacity_ != 0) ? (this->capacity_ * 2) : kGroupWidth);
+        }
+        bool found;
+        size_type index = this->find_slot(value, h, found);
+        if (!found) {
+            this->ctrl_[index] = hash_ctrl(h);
+            std::memcpy((void *)&this->slots_[index], (const void *)&value, sizeof(Value128));
+            this->size_++;
+            this->growth_left_--;
+        }
+        return std::make_pair(iterator(this, index), !found);
+    }
+
+    void prefetch_group(std::uint64_t h) const {
+#if MBG_USE_SSE2 || MBG_USE_AVX2
+        size_type index = this->hash_group(h) * kGroupWidth;
+        _mm_prefetch((const char *)(this->ctrl_ + index), _MM_HINT_T0);
+        _mm_prefetch((const char *)(this->slots_ + index), _MM_HINT_T0);
+#else
+        (void)h;
+#endif
+    }
+
+public:
+    Value128HashSet() : ctrl_(nullptr), slots_(nullptr), size_(0),
+                        capacity_(0), group_mask_(0), growth_left_(0) {
+    }
+
+    Value128HashSet(const Value128HashSet & src) = delete;
+    Value128HashSet & operator = (const Value128HashSet & rhs) = delete;
+
+    ~Value128HashSet() {
+        this->destroy();
+    }
+
+    void destroy() {
+        std::free(this->ctrl_);
+        std::free(this->slots_);
+        this->ctrl_ = nullptr;
+        this->slots_ = nullptr;
+        this->size_ = 0;
+        this->capacity_ = 0;
+        this->group_mask_ = 0;
+        this->growth_left_ = 0;
+    }
+
+    size_type size() const {
+        return this->size_;
+    }
+
+    bool empty() const {
+        return (this->size_ == 0);
+    }
+
+    size_type capacity() const {
+        return this->capacity_;
+    }
+
+    size_type memory_usage() const {
+        return (this->capacity_ * (sizeof(std::int8_t) + sizeof(Value128)));
+    }
+
+    const_iterator begin() const {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const {
+        return const_iterator(this, this->capacity_);
+    }
+
+    void clear() {
+        if (this->capacity_ != 0) {
+            std::memset((void *)this->ctrl_, kEmpty, this->capacity_);
+        }
+        this->size_ = 0;
+        this->growth_left_ = max_load(this->capacity_);
+    }
+
+    // Make room for count values without a rehash, e.g. from the predicted size of the next depth.
+    void reserve(size_type count) {
+        size_type new_capacity = capacity_for(count);
+        if (new_capacity > this->capacity_) {
+            if (this->capacity_ != 0)
+                this->rehash(new_capacity);
+            else
+                this->allocate(new_capacity);
+        }
+    }
+
+    size_type count(const Value128 & value) const {
+        if (this->size_ == 0)
+            return 0;
+        bool found;
+        this->find_slot(value, hash(value), found);
+        return (found ? 1 : 0);
+    }
+
+    bool contains(const Value128 & value) const {
+        return (this->count(value) != 0);
+    }
+
+    std::pair<iterator, bool> insert(const Value128 & value) {
+        return this->insert_hashed(value, hash(value));
+    }
+
+    //
+    // Insert values[0, count), results[i] is true when values[i] is new.
+    // The hashes are computed first and the groups are prefetched ahead of the
+    // probes, so the cache misses of a batch overlap.
+    //
+    size_type insert_batch(const Value128 * values, size_type count, bool * results) {
+        this->reserve(this->size_ + count);
+
+        static const size_type kBatchSize = 64;
+        std::uint64_t hashes[kBatchSize];
+        size_type inserted = 0;
+        for (size_type first = 0; first < count; first += kBatchSize) {
+            size_type batch_size = ((count - first) < kBatchSize) ? (count - first) : kBatchSize;
+            for (size_type i = 0; i < batch_size; i++) {
+                hashes[i] = hash(values[first + i]);
+                if (i < kPrefetchDistance)
+                    this->prefetch_group(hashes[i]);
+            }
+            for (size_type i = 0; i < batch_size; i++) {
+                if ((i + kPrefetchDistance) < batch_size)
+                    this->prefetch_group(hashes[i + kPrefetchDistance]);
+                bool is_new = this->insert_hashed(values[first + i], hashes[i]).second;
+                results[first + i] = is_new;
+                inserted += is_new ? 1 : 0;
+            }
+        }
+        return inserted;
+    }
+};
+
+// Reserve the room of a visited set, a std::set has nothing to reserve.
+template <typename Key, typename Compare, typename Allocator>
+inline void reserve_visited(std::set<Key, Compare, Allocator> & visited, std::size_t count) {
+    (void)visited;
+    (void)count;
+}
+
+inline void reserve_visited(Value128HashSet & visited, std::size_t count) {
+    visited.reserve(count);
+}
+
+} // namespace AI
+} // namespace MagicBlock
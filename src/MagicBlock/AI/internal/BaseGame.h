@@ -63,7 +63,8 @@ public:
     typedef std::function<bool(size_type, size_type, const stage_type & stage)> phase2_callback;
 
     static const size_type BoardSize = BoardX * BoardY;
-    static const size_type kSingelColorNums = (BoardSize - 1) / (Color::Last - 1);
+    // Rounded up, the cells of a 6x6 board (35) can't be divided evenly by the colors.
+    static const size_type kSingelColorNums = (BoardSize - 1 + Color::Last - 2) / (Color::Last - 1);
 
     static const ptrdiff_t kStartX = (BoardX - TargetX) / 2;
     static const ptrdiff_t kStartY = (BoardY - TargetY) / 2;
@@ -118,6 +119,14 @@ public:
         return this->best_move_seq_;
     }
 
+    shared_data_type & data() {
+        return this->data_;
+    }
+
+    const shared_data_type & data() const {
+        return this->data_;
+    }
+
     const std::vector<MoveInfo> & getAnswer() const {
         return this->best_answer_;
     }
@@ -26,6 +26,8 @@
 #include "MagicBlock/AI/CanMoves.h"
 #include "MagicBlock/AI/Value128.h"
 #include "MagicBlock/AI/Board.h"
+#include "MagicBlock/AI/GoalCounter.h"
+#include "MagicBlock/AI/TargetMatcher.h"
 #include "MagicBlock/AI/Stage.h"
 #include "MagicBlock/AI/SharedData.h"
 #include "MagicBlock/AI/Utils.h"
@@ -55,8 +57,12 @@ public:
     typedef typename shared_data_type::target_board_t       target_board_t;
     typedef Phase2CallBack                                  phase2_callback;
 
+    typedef GoalCounter<BoardX, BoardY, TargetX, TargetY>   goal_counter_t;
+    typedef typename goal_counter_t::Summary                goal_summary_t;
+    typedef TargetMatcher<BoardX, BoardY, TargetX, TargetY> target_matcher_t;
+
     static const size_type BoardSize = BoardX * BoardY;
-    static const size_type kSingelColorNums = (BoardSize - 1) / (Color::Last - 1);
+    static const size_type kSingelColorNums = (BoardSize - 1 + Color::Last - 2) / (Color::Last - 1);
 
     static const ptrdiff_t kStartX = (BoardX - TargetX) / 2;
     static const ptrdiff_t kStartY = (BoardY - TargetY) / 2;
@@ -471,15 +477,108 @@ protected:
         return move_pos;
     }
 
+    // The regions of a target in the goal counter, see init_goal_counter().
+    static size_type goal_regions() {
+        return ((N_SolverType == SolverType::Phase1_123) ? MAX_PHASE1_TYPE : 1);
+    }
+
+    // The slots of the target of rotate_index in the goal counter.
+    static std::uint32_t goal_slot_mask(size_type rotate_index) {
+        return (((std::uint32_t(1) << goal_regions()) - 1) << (rotate_index * goal_regions()));
+    }
+
+    //
+    // The regions that must be matched for is_satisfy() to pass: the 4 sides of
+    // phase 1, the 2 rows or columns of phase 2 (456), or the whole target.
+    //
+    void init_goal_counter(goal_counter_t & counter, size_type target_len) {
+        counter.clear();
+        for (size_type index = 0; index < target_len; index++) {
+            const Board<TargetX, TargetY> & target = this->target_board_[index];
+            if (N_SolverType == SolverType::Phase1_123) {
+                counter.add_region(target, 0, TargetX, 0, 1);
+                counter.add_region(target, 0, 1, 0, TargetY);
+                counter.add_region(target, TargetX - 1, TargetX, 0, TargetY);
+                counter.add_region(target, 0, TargetX, TargetY - 1, TargetY);
+            }
+            else if (N_SolverType == SolverType::Phase2_456) {
+                size_type phase1_type = this->data_->phase2.phase1_type;
+                if (phase1_type == 0)
+                    counter.add_region(target, 0, TargetX, 0, 2);
+                else if (phase1_type == 1)
+                    counter.add_region(target, 0, 2, 0, TargetY);
+                else if (phase1_type == 2)
+                    counter.add_region(target, TargetX - 2, TargetX, 0, TargetY);
+                else
+                    counter.add_region(target, 0, TargetX, TargetY - 2, TargetY);
+            }
+            else {
+                counter.add_region(target, 0, TargetX, 0, TargetY);
+            }
+        }
+    }
+
+    //
+    // Same as is_satisfy(player, target_board_[rotate_index], rotate_index), equal_mask
+    // is the mask of the target from target_matcher_t::match(), so the target region
+    // isn't scanned again.
+    //
+    size_type is_satisfy_matched(const Board<BoardX, BoardY> & player,
+                                 size_type rotate_index, std::uint32_t equal_mask) {
+        if (N_SolverType == SolverType::Phase1_123) {
+            size_type sides = target_matcher_t::side_mask(equal_mask);
+            if (sides == 0)
+                return 0;
+            return this->is_satisfy_phase1_sides(player, rotate_index, sides);
+        }
+        else if (N_SolverType == SolverType::Phase2_456) {
+            static const std::uint32_t kBandBits[MAX_PHASE1_TYPE] = {
+                target_matcher_t::region_bits(0, TargetX, 0, 2),
+                target_matcher_t::region_bits(0, 2, 0, TargetY),
+                target_matcher_t::region_bits(TargetX - 2, TargetX, 0, TargetY),
+                target_matcher_t::region_bits(0, TargetX, TargetY - 2, TargetY)
+            };
+            size_type phase1_type = this->data_->phase2.phase1_type;
+            assert(phase1_type < MAX_PHASE1_TYPE);
+            bool is_matched = target_matcher_t::is_matched(equal_mask, kBandBits[phase1_type]);
+            if (!is_matched)
+                return 0;
+            return this->is_satisfy_phase2_band(player, is_matched);
+        }
+        else {
+            bool is_matched = target_matcher_t::is_matched(equal_mask, target_matcher_t::kFullBits);
+            size_u result(0, (is_matched ? 1 : 0));
+            return result.value;
+        }
+    }
+
     size_type is_satisfy_phase1_123(const Board<BoardX, BoardY> & player,
                                     const Board<TargetX, TargetY> & target,
                                     size_type rotate_index) {
+        size_type sides = 0;
+        if (partial_target_is_satisfy(player, target, 0, TargetX, 0, 1))
+            sides |= 1;
+        if (partial_target_is_satisfy(player, target, 0, 1, 0, TargetY))
+            sides |= 2;
+        if (partial_target_is_satisfy(player, target, TargetX - 1, TargetX, 0, TargetY))
+            sides |= 4;
+        if (partial_target_is_satisfy(player, target, 0, TargetX, TargetY - 1, TargetY))
+            sides |= 8;
+        return this->is_satisfy_phase1_sides(player, rotate_index, sides);
+    }
+
+    //
+    // The phase 1 goal test of the matched sides (1 = top, 2 = left, 4 = right, 8 = bottom),
+    // the colors left outside of a side must be enough for the rest of the target.
+    //
+    size_type is_satisfy_phase1_sides(const Board<BoardX, BoardY> & player,
+                                      size_type rotate_index, size_type sides) {
         size_type mask = 0;
 
         // Top partial
         static const ptrdiff_t TopY = kStartY;
 
-        if (partial_target_is_satisfy(player, target, 0, TargetX, 0, 1)) {
+        if ((sides & 1) != 0) {
             count_partial_color_nums_reverse(player, 0, BoardX, 0, TopY + 1);
             size_type empties = this->partial_colors_[Color::Empty];
             if (empties == 0) {
@@ -508,7 +607,7 @@ protected:
         // Left partial
         static const ptrdiff_t LeftX = kStartX;
 
-        if (partial_target_is_satisfy(player, target, 0, 1, 0, TargetY)) {
+        if ((sides & 2) != 0) {
             count_partial_color_nums_reverse(player, 0, LeftX + 1, 0, BoardY);
             size_type empties = this->partial_colors_[Color::Empty];
             if (empties == 0) {
@@ -537,7 +636,7 @@ protected:
         // Right partial
         static const ptrdiff_t RightX = kStartX + TargetX - 1;
 
-        if (partial_target_is_satisfy(player, target, TargetX - 1, TargetX, 0, TargetY)) {
+        if ((sides & 4) != 0) {
             count_partial_color_nums_reverse(player, RightX, BoardX, 0, BoardY);
             size_type empties = this->partial_colors_[Color::Empty];
             if (empties == 0) {
@@ -566,7 +665,7 @@ protected:
         // Bottom partial
         static const ptrdiff_t BottomY = kStartY + TargetY - 1;
 
-        if (partial_target_is_satisfy(player, target, 0, TargetX, TargetY - 1, TargetY)) {
+        if ((sides & 8) != 0) {
             count_partial_color_nums_reverse(player, 0, BoardX, BottomY, BoardY);
             size_type empties = this->partial_colors_[Color::Empty];
             if (empties == 0) {
@@ -612,13 +711,28 @@ protected:
 
     size_type is_satisfy_phase2_456(const Board<BoardX, BoardY> & player,
                                     const Board<TargetX, TargetY> & target) {
+        bool is_matched;
+        size_type phase1_type = this->data_->phase2.phase1_type;
+        if (phase1_type == 0)
+            is_matched = partial_target_is_satisfy(player, target, 0, TargetX, 0, 2);
+        else if (phase1_type == 1)
+            is_matched = partial_target_is_satisfy(player, target, 0, 2, 0, TargetY);
+        else if (phase1_type == 2)
+            is_matched = partial_target_is_satisfy(player, target, TargetX - 2, TargetX, 0, TargetY);
+        else
+            is_matched = partial_target_is_satisfy(player, target, 0, TargetX, TargetY - 2, TargetY);
+        return this->is_satisfy_phase2_band(player, is_matched);
+    }
+
+    // The phase 2 (456) goal test when the 2 rows or columns of the band are matched.
+    size_type is_satisfy_phase2_band(const Board<BoardX, BoardY> & player, bool is_matched) {
         size_type mask = 0;
 
         if (this->data_->phase2.phase1_type == 0) {
             // Top partial
             static const ptrdiff_t TopY = kStartY;
 
-            if (partial_target_is_satisfy(player, target, 0, TargetX, 0, 2)) {
+            if (is_matched) {
                 count_partial_color_nums(player, 0, BoardX, TopY + 2, BoardY);
                 bool is_valid = check_partial_color_nums();
                 if (is_valid)
@@ -629,7 +743,7 @@ protected:
             // Left partial
             static const ptrdiff_t LeftX = kStartX;
 
-            if (partial_target_is_satisfy(player, target, 0, 2, 0, TargetY)) {
+            if (is_matched) {
                 count_partial_color_nums(player, LeftX + 2, BoardX, 0, BoardY);
                 bool is_valid = check_partial_color_nums();
                 if (is_valid)
@@ -640,7 +754,7 @@ protected:
             // Right partial
             static const ptrdiff_t RightX = kStartX + TargetX - 1;
 
-            if (partial_target_is_satisfy(player, target, TargetX - 2, TargetX, 0, TargetY)) {
+            if (is_matched) {
                 count_partial_color_nums(player, 0, kStartX + 1, 0, BoardY);
                 bool is_valid = check_partial_color_nums();
                 if (is_valid)
@@ -651,7 +765,7 @@ protected:
             // Bottom partial
             static const ptrdiff_t BottomY = kStartY + TargetY - 1;
 
-            if (partial_target_is_satisfy(player, target, 0, TargetX, TargetY - 2, TargetY)) {
+            if (is_matched) {
                 count_partial_color_nums(player, 0, BoardX, 0, kStartY + 1);
                 bool is_valid = check_partial_color_nums();
                 if (is_valid)